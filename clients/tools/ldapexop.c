@@ -46,6 +46,7 @@ usage( void )
 	fprintf( stderr, _("       %s [options] whoami\n"), prog);
 	fprintf( stderr, _("       %s [options] cancel <id>\n"), prog);
 	fprintf( stderr, _("       %s [options] refresh <DN> [<ttl>]\n"), prog);
+	fprintf( stderr, _("       %s [options] snapshot <DN> <file>\n"), prog);
 	tool_common_usage();
 	exit( EXIT_FAILURE );
 }
@@ -76,6 +77,7 @@ main( int argc, char *argv[] )
 	LDAPControl **ctrls = NULL;
 	int		id, code;
 	LDAPMessage	*res = NULL;
+	FILE		*snapfp = NULL;
 
 	tool_init( TOOL_EXOP );
 	prog = lutil_progname( "ldapexop", argc, argv );
@@ -161,6 +163,37 @@ main( int argc, char *argv[] )
 			goto skip;
 		}
 
+	} else if ( strcasecmp( argv[ 0 ], "snapshot" ) == 0 ) {
+		struct berval	dn;
+
+		if ( argc != 3 ) {
+			fprintf( stderr, _("need DN and file\n\n") );
+			usage();
+		}
+
+		dn.bv_val = argv[ 1 ];
+		dn.bv_len = strlen( dn.bv_val );
+
+		if ( strcmp( argv[ 2 ], "-" ) == 0 ) {
+			snapfp = stdout;
+		} else {
+			snapfp = fopen( argv[ 2 ], "wb" );
+			if ( snapfp == NULL ) {
+				perror( argv[ 2 ] );
+				rc = EXIT_FAILURE;
+				goto skip;
+			}
+		}
+
+		tool_server_controls( ld, NULL, 0 );
+
+		rc = ldap_extended_operation( ld, LDAP_EXOP_X_SNAPSHOT, &dn, NULL, NULL, &id );
+		if ( rc != LDAP_SUCCESS ) {
+			tool_perror( "ldap_extended_operation", rc, NULL, NULL, NULL, NULL );
+			rc = EXIT_FAILURE;
+			goto skip;
+		}
+
 	} else {
 		char *p;
 
@@ -219,13 +252,41 @@ main( int argc, char *argv[] )
 		tv.tv_sec = 0;
 		tv.tv_usec = 100000;
 
-		rc = ldap_result( ld, LDAP_RES_ANY, LDAP_MSG_ALL, &tv, &res );
+		/* snapshot data arrives in intermediate responses;
+		 * take them one at a time instead of chaining them */
+		rc = ldap_result( ld, LDAP_RES_ANY,
+			snapfp ? LDAP_MSG_ONE : LDAP_MSG_ALL, &tv, &res );
 		if ( rc < 0 ) {
 			tool_perror( "ldap_result", rc, NULL, NULL, NULL, NULL );
 			rc = EXIT_FAILURE;
 			goto skip;
 		}
 
+		if ( rc == LDAP_RES_INTERMEDIATE && snapfp != NULL ) {
+			struct berval	*retdata = NULL;
+
+			rc = ldap_parse_intermediate( ld, res, NULL, &retdata, NULL, 0 );
+			if ( rc != LDAP_SUCCESS ) {
+				tool_perror( "ldap_parse_intermediate", rc, NULL, NULL, NULL, NULL );
+				rc = EXIT_FAILURE;
+				goto skip;
+			}
+			if ( retdata != NULL ) {
+				if ( fwrite( retdata->bv_val, 1, retdata->bv_len, snapfp )
+					!= retdata->bv_len )
+				{
+					perror( argv[ 2 ] );
+					ber_bvfree( retdata );
+					rc = EXIT_FAILURE;
+					goto skip;
+				}
+				ber_bvfree( retdata );
+			}
+			ldap_msgfree( res );
+			res = NULL;
+			continue;
+		}
+
 		if ( rc != 0 ) {
 			break;
 		}
@@ -286,6 +347,14 @@ main( int argc, char *argv[] )
 
 		printf( "newttl=%d\n", newttl );
 
+	} else if ( strcasecmp( argv[ 0 ], "snapshot" ) == 0 ) {
+		/* data was written as it arrived */
+		if ( snapfp != stdout && fclose( snapfp ) ) {
+			perror( argv[ 2 ] );
+			code = LDAP_LOCAL_ERROR;
+		}
+		snapfp = NULL;
+
 	} else if ( tool_is_oid( argv[ 0 ] ) ) {
 		char		*retoid = NULL;
 		struct berval	*retdata = NULL;
@@ -348,6 +417,12 @@ main( int argc, char *argv[] )
 	ber_memvfree( (void **) refs );
 
 skip:
+	/* don't leave a truncated snapshot behind */
+	if ( snapfp != NULL && snapfp != stdout ) {
+		fclose( snapfp );
+		unlink( argv[ 2 ] );
+	}
+
 	/* disconnect from server */
 	if ( res )
 		ldap_msgfree( res );
@@ -303,6 +303,12 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
 #define MDB_NORDAHEAD	0x800000
 	/** don't initialize malloc'd memory before writing to datafile */
 #define MDB_NOMEMINIT	0x1000000
+	/** ask for transparent huge pages on the map */
+#define MDB_HUGEPAGE	0x2000000
+	/** interleave the file's pages across NUMA nodes when opening */
+#define MDB_NUMAINTERLEAVE	0x4000000
+	/** lock the branch pages of all databases in memory */
+#define MDB_MLOCKBRANCH	0x40000000
 /** @} */
 
 /**	@defgroup	mdb_dbi_open	Database Flags
@@ -356,6 +362,9 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
  * pages sequentially.
  */
 #define MDB_CP_COMPACT	0x01
+/** With #MDB_CP_COMPACT: walk independent subtrees in parallel threads.
+ */
+#define MDB_CP_PARALLEL	0x02
 /*	@} */
 
 /** @brief Cursor Get operations.
@@ -614,6 +623,29 @@ int  mdb_env_create(MDB_env **env);
 	 *		caller is expected to overwrite all of the memory that was
 	 *		reserved in that case.
 	 *		This flag may be changed at any time using #mdb_env_set_flags().
+	 *	<li>#MDB_HUGEPAGE
+	 *		Ask the OS to back the map with transparent huge pages, which
+	 *		cuts TLB misses on large databases. Whether file pages can be
+	 *		mapped huge depends on the OS and filesystem; where they can't,
+	 *		the flag has no effect. It is defeated by #MDB_NORDAHEAD.
+	 *		The option is not implemented on Windows.
+	 *	<li>#MDB_NUMAINTERLEAVE
+	 *		Read the data file into memory when the environment is opened,
+	 *		spreading its pages evenly across the NUMA nodes the process may
+	 *		use. File pages are placed by the policy of whichever thread first
+	 *		reads them, so without this the placement depends on which threads
+	 *		happen to touch which pages. Pages already in memory are not moved,
+	 *		and pages added later are placed by the threads that write them.
+	 *		To bind the database to particular nodes instead, run the
+	 *		process under a bind policy, e.g. with numactl(8).
+	 *		The option is only implemented on Linux.
+	 *	<li>#MDB_MLOCKBRANCH
+	 *		Lock the branch pages of every database in memory when the
+	 *		environment is opened, and again whenever the map is resized,
+	 *		so that lookups never fault on the upper levels of the trees.
+	 *		Branch pages created after that are not locked until the next
+	 *		time. The process must be allowed to lock enough memory.
+	 *		The option is not implemented on Windows.
 	 * </ul>
 	 * @param[in] mode The UNIX permissions to set on created files and semaphores.
 	 * This parameter is ignored on Windows.
@@ -681,6 +713,13 @@ int  mdb_env_copyfd(MDB_env *env, mdb_filehandle_t fd);
 	 *		pages and sequentially renumber all pages in output. This option
 	 *		consumes more CPU and runs more slowly than the default.
 	 *		Currently it fails if the environment has suffered a page leak.
+	 *	<li>#MDB_CP_PARALLEL - With #MDB_CP_COMPACT, split the trees into
+	 *		independent subtrees and copy them in one worker thread per CPU,
+	 *		all within the same read-only transaction. This shortens the time
+	 *		the copy holds back page reuse. The subtrees are counted before
+	 *		they are copied, so the pages above the overflow pages are read
+	 *		twice. It needs an output that supports positioned writes;
+	 *		otherwise, and on Windows, the copy is done in a single thread.
 	 * </ul>
 	 * @return A non-zero error value on failure and 0 on success.
 	 */
@@ -742,6 +781,33 @@ int  mdb_env_info(MDB_env *env, MDB_envinfo *stat);
 	 */
 int  mdb_env_sync(MDB_env *env, int force);
 
+	/** @brief Flush the meta page to disk, batched with other committers.
+	 *
+	 * Make sure that the given transaction is durable, sharing the
+	 * flush with other threads in this process that call this function
+	 * concurrently. This is meant for write transactions committed with
+	 * #MDB_NOMETASYNC: each committer then calls this function with the ID
+	 * of its transaction. One thread at a time flushes, on behalf of all
+	 * transactions committed so far, while the others wait for it. A
+	 * thread finds its transaction already on disk if a flush that
+	 * started after its commit has finished.
+	 *
+	 * Such a commit still flushes its data pages before it writes its
+	 * meta page, so a system crash before the flush ends loses the
+	 * transaction but leaves a consistent database: it opens at the
+	 * last transaction whose meta page reached the disk. Pages freed
+	 * by unflushed transactions are not reused until they are flushed,
+	 * so long gaps between flushes make the database grow.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] txnid The ID of a committed transaction, as returned by
+	 *	#mdb_txn_id() before the commit.
+	 * @param[in] usec How many microseconds the flushing thread waits for
+	 *	more commits to join its flush before it starts. 0 to not wait.
+	 * @return A non-zero error value on failure and 0 on success. Errors
+	 * are the same as for #mdb_env_sync().
+	 */
+int  mdb_env_sync_txn(MDB_env *env, size_t txnid, unsigned int usec);
+
 	/** @brief Close the environment and release the memory map.
 	 *
 	 * Only a single thread may call this function. All transactions, databases,
@@ -863,6 +929,29 @@ int  mdb_env_set_mapsize(MDB_env *env, size_t size);
 	 */
 int  mdb_env_set_maxreaders(MDB_env *env, unsigned int readers);
 
+	/** @brief Set the most dirty pages a write transaction keeps in memory.
+	 *
+	 * A write transaction holds the pages it modifies in malloc'd memory
+	 * until it commits. Once it has this many, some of them are spilled:
+	 * written out to their final place in the data file early, to be read
+	 * back and copied again if they are modified again. Very large
+	 * transactions can turn into a stream of random writes to the data
+	 * file this way. Raising the limit keeps more of the transaction in
+	 * process memory, which the OS may page out to swap under pressure
+	 * rather than to the data file. The default and the minimum is 131071
+	 * pages. Each page of the limit also costs 16 bytes of address space
+	 * for the dirty list, committed only as it is used.
+	 * This function may only be called after #mdb_env_create() and before #mdb_env_open().
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] pages The most dirty pages before spilling
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified, or the environment is already open.
+	 * </ul>
+	 */
+int  mdb_env_set_dirtylimit(MDB_env *env, unsigned int pages);
+
 	/** @brief Get the maximum number of threads/reader slots for the environment.
 	 *
 	 * @param[in] env An environment handle returned by #mdb_env_create()
@@ -955,6 +1044,10 @@ int  mdb_env_set_assert(MDB_env *env, MDB_assert_func *func);
 	 * <ul>
 	 *	<li>#MDB_RDONLY
 	 *		This transaction will not perform any write operations.
+	 *	<li>#MDB_NOMETASYNC
+	 *		Don't flush the meta page to disk when committing this
+	 *		transaction, as for the environment flag of the same name.
+	 *		See #mdb_env_sync_txn() to make it durable later.
 	 * </ul>
 	 * @param[out] txn Address where the new #MDB_txn handle will be stored
 	 * @return A non-zero error value on failure and 0 on success. Some possible
@@ -1052,6 +1145,32 @@ void mdb_txn_reset(MDB_txn *txn);
 	 */
 int  mdb_txn_renew(MDB_txn *txn);
 
+	/** @brief Cut free pages off the end of the data file.
+	 *
+	 * Gather all the free pages that no reader can still see, and
+	 * release those that form a contiguous run at the end of the used
+	 * space, so that the environment's last page number goes down. Used
+	 * together with #mdb_cursor_compact(), which moves pages out of the
+	 * way, this lets a write transaction give back space left by mass
+	 * deletes without an offline #mdb_env_copy2() with #MDB_CP_COMPACT.
+	 *
+	 * The data file itself is truncated by a later call, once all
+	 * readers have moved past the transaction that released the pages.
+	 * This is not done with #MDB_WRITEMAP or on Windows, where the file
+	 * always has the size of the map.
+	 * @param[in] txn A top-level write transaction handle returned by
+	 * #mdb_txn_begin()
+	 * @param[out] npages Address where the number of pages released will
+	 * be stored
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EACCES - an attempt was made to write in a read-only transaction.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_txn_shrink(MDB_txn *txn, size_t *npages);
+
 /** Compat with version <= 0.9.4, avoid clash with libmdb from MDB Tools project */
 #define mdb_open(txn,name,flags,dbi)	mdb_dbi_open(txn,name,flags,dbi)
 /** Compat with version <= 0.9.4, avoid clash with libmdb from MDB Tools project */
@@ -1445,6 +1564,31 @@ MDB_dbi mdb_cursor_dbi(MDB_cursor *cursor);
 int  mdb_cursor_get(MDB_cursor *cursor, MDB_val *key, MDB_val *data,
 			    MDB_cursor_op op);
 
+	/** @brief Retrieve the data items for a batch of keys.
+	 *
+	 * This is equivalent to calling #mdb_cursor_get() with #MDB_SET for
+	 * each key in turn, but when the keys are in ascending order it avoids
+	 * descending the tree from the root for every key: the cursor steps
+	 * across to sibling leaf pages, and the leaf pages holding upcoming
+	 * keys are handed to the OS for readahead before they are needed.
+	 * Unsorted keys are handled correctly, only more slowly.
+	 * On return the cursor is positioned on the last key that was found.
+	 * See #mdb_get() for restrictions on using the output values.
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[in] keys An array of \b count keys to look up
+	 * @param[out] data An array of \b count items. Each is set to the
+	 * data for the corresponding key, or to a NULL address and zero length
+	 * if the key was not found.
+	 * @param[in] count The number of keys
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_get_multi(MDB_cursor *cursor, MDB_val *keys, MDB_val *data,
+			    unsigned int count);
+
 	/** @brief Store by cursor.
 	 *
 	 * This function stores key/data pairs into the database.
@@ -1544,6 +1688,36 @@ int  mdb_cursor_del(MDB_cursor *cursor, unsigned int flags);
 	 */
 int  mdb_cursor_count(MDB_cursor *cursor, size_t *countp);
 
+	/** @brief Move the pages of a database toward the start of the file.
+	 *
+	 * Walk the database from the given key and rewrite, in place, the
+	 * items that live on pages numbered \b limit or above, including
+	 * their overflow pages and sub-databases. Rewritten pages are copied
+	 * into free pages, lowest first, and the old ones are freed. This is
+	 * done until \b *npages pages have been moved or the end of the
+	 * database is reached. The walk stops early once no free page is
+	 * left below \b limit, and leaves alone overflow items that no free
+	 * run below \b limit can hold, so that it never grows the file.
+	 * The walk can be resumed in a later write
+	 * transaction from the key it stopped at, so that a large database
+	 * is compacted in small steps. See #mdb_txn_shrink().
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * in a write transaction
+	 * @param[in,out] key The key to start at, or an empty key to start at
+	 * the first item. On return with 0, the key to resume at. Its data
+	 * is only valid until the end of the transaction.
+	 * @param[in] limit The lowest page number to move pages away from.
+	 * @param[in,out] npages On input, the most pages to move. On return,
+	 * the number of pages moved.
+	 * @return A non-zero error value on failure, 0 if there is more to do
+	 * and #MDB_NOTFOUND at the end of the database. Some possible errors are:
+	 * <ul>
+	 *	<li>EACCES - an attempt was made to write in a read-only transaction.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_compact(MDB_cursor *cursor, MDB_val *key, size_t limit, unsigned int *npages);
+
 	/** @brief Compare two data items according to a particular database.
 	 *
 	 * This returns a comparison as if the two data items were keys in the
@@ -84,6 +84,10 @@ extern int cacheflush(char *addr, int nbytes, int cache);
 #define CACHEFLUSH(addr, bytes, cache)
 #endif
 
+#ifdef __linux
+#include <sys/syscall.h>	/* NUMA memory policy, see #mdb_env_interleave() */
+#endif
+
 #if defined(__linux) && !defined(MDB_FDATASYNC_WORKS)
 /** fdatasync is broken on ext3/ext4fs on older kernels, see
  *	description in #mdb_env_open2 comments. You can safely
@@ -1141,8 +1145,9 @@ struct MDB_txn {
  *	@{
  */
 	/** #mdb_txn_begin() flags */
-#define MDB_TXN_BEGIN_FLAGS	MDB_RDONLY
+#define MDB_TXN_BEGIN_FLAGS	(MDB_RDONLY|MDB_NOMETASYNC)
 #define MDB_TXN_RDONLY		MDB_RDONLY	/**< read-only transaction */
+#define MDB_TXN_NOMETASYNC	MDB_NOMETASYNC	/**< don't sync meta on commit */
 	/* internal txn flags */
 #define MDB_TXN_WRITEMAP	MDB_WRITEMAP	/**< copy of #MDB_env flag in writers */
 #define MDB_TXN_FINISHED	0x01		/**< txn is finished or never began */
@@ -1252,6 +1257,34 @@ typedef struct MDB_pgstate {
 	txnid_t		mf_pglast;	/**< ID of last used record, or 0 if !mf_pghead */
 } MDB_pgstate;
 
+	/** A run of contiguous page numbers in me_pghead */
+typedef struct MDB_pgrun {
+	pgno_t		mr_pgno;	/**< lowest page number of the run */
+	pgno_t		mr_len;		/**< number of pages in the run */
+} MDB_pgrun;
+
+	/** Size classes of #MDB_pgruns. Runs shorter than #MDB_PGRUN_EXACT
+	 *	pages get a class per length, longer runs a class per power of 2.
+	 */
+#define MDB_PGRUN_EXACT		32
+#define MDB_PGRUN_CLASSES	64
+
+	/** Index of the multi-page runs in me_pghead, by run length, so
+	 *	that #mdb_page_alloc() need not scan me_pghead for a range of
+	 *	overflow pages. Each class is sorted by length, then by page
+	 *	number, in descending order, so the shortest and lowest run is
+	 *	last. Entries may be stale; each is checked against me_pghead
+	 *	before use.
+	 */
+typedef struct MDB_pgruns {
+	pgno_t		*mr_head;	/**< the me_pghead indexed, or NULL if out of sync */
+	pgno_t		mr_len;		/**< length of mr_head when last synced */
+	unsigned	mr_total;	/**< number of runs in all classes */
+	unsigned	mr_num[MDB_PGRUN_CLASSES];	/**< runs in each class */
+	unsigned	mr_max[MDB_PGRUN_CLASSES];	/**< room in each class */
+	MDB_pgrun	*mr_runs[MDB_PGRUN_CLASSES];
+} MDB_pgruns;
+
 	/** The database environment. */
 struct MDB_env {
 	HANDLE		me_fd;		/**< The main data file */
@@ -1271,6 +1304,9 @@ struct MDB_env {
 	unsigned int	me_maxreaders;	/**< size of the reader table */
 	/** Max #MDB_txninfo.%mti_numreaders of interest to #mdb_env_close() */
 	volatile int	me_close_readers;
+	unsigned int	me_rscan;	/**< reader slot to look for a free one from */
+	int			me_oldest_slot;	/**< reader slot holding me_oldest, or -1 */
+	txnid_t		me_oldest;		/**< oldest reader txnid last time we scanned */
 	MDB_dbi		me_numdbs;		/**< number of DBs opened */
 	MDB_dbi		me_maxdbs;		/**< size of the DB table */
 	MDB_PID_T	me_pid;		/**< process ID of this env */
@@ -1289,14 +1325,25 @@ struct MDB_env {
 	unsigned int	*me_dbiseqs;	/**< array of dbi sequence numbers */
 	pthread_key_t	me_txkey;	/**< thread-key for readers */
 	txnid_t		me_pgoldest;	/**< ID of oldest reader last time we looked */
+	txnid_t		me_shrunk;		/**< txn that released the end of the file, 0 once truncated */
 	MDB_pgstate	me_pgstate;		/**< state of old pages from freeDB */
+	MDB_pgruns	me_pgruns;		/**< runs of pages in me_pghead */
+#ifndef _WIN32
+	pthread_mutex_t	me_sync_mutex;	/**< protects me_synced, me_unsynced, me_syncing */
+	pthread_cond_t	me_sync_cond;	/**< signalled when a group sync ends */
+	txnid_t		me_synced;		/**< last txn known to be on disk */
+	txnid_t		me_unsynced;	/**< last txn whose meta was not synced */
+	int			me_syncing;		/**< a group sync is in progress */
+#endif
 #	define		me_pglast	me_pgstate.mf_pglast
 #	define		me_pghead	me_pgstate.mf_pghead
 	MDB_page	*me_dpages;		/**< list of malloc'd blocks for re-use */
 	/** IDL of pages that became unused in a write txn */
 	MDB_IDL		me_free_pgs;
-	/** ID2L of pages written during a write txn. Length MDB_IDL_UM_SIZE. */
+	/** ID2L of pages written during a write txn. Length me_dirty_max+1. */
 	MDB_ID2L	me_dirty_list;
+	/** Most dirty pages a write txn holds in memory before spilling */
+	unsigned int	me_dirty_max;
 	/** Max number of freelist items that can fit in a single overflow page */
 	int			me_maxfree_1pg;
 	/** Max size of a node on a page */
@@ -1378,6 +1425,8 @@ static int	mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata,
 static int  mdb_env_read_header(MDB_env *env, MDB_meta *meta);
 static MDB_meta *mdb_env_pick_meta(const MDB_env *env);
 static int  mdb_env_write_meta(MDB_txn *txn);
+static int  mdb_env_lock_branches(MDB_env *env);
+static int  mdb_fsize(HANDLE fd, size_t *size);
 #if defined(MDB_USE_POSIX_MUTEX) && !defined(MDB_ROBUST_SUPPORTED) /* Drop unused excl arg */
 # define mdb_env_close0(env, excl) mdb_env_close1(env)
 #endif
@@ -2048,8 +2097,8 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 	 * of the dirty pages. Testing revealed this to be a good tradeoff,
 	 * better than 1/2, 1/4, or 1/10.
 	 */
-	if (need < MDB_IDL_UM_MAX / 8)
-		need = MDB_IDL_UM_MAX / 8;
+	if (need < txn->mt_env->me_dirty_max / 8)
+		need = txn->mt_env->me_dirty_max / 8;
 
 	/* Save the page IDs of all the pages we're flushing */
 	/* flush from the tail forward, this saves a lot of shifting later on. */
@@ -2093,22 +2142,49 @@ done:
 	return rc;
 }
 
-/** Find oldest txnid still referenced. Expects txn->mt_txnid > 0. */
+/** Find oldest txnid still referenced. Expects txn->mt_txnid > 0.
+ *
+ * New readers always start at the latest txnid, so the oldest one
+ * referenced never goes down. While the reader slot that held it the
+ * last time we scanned still does, it is still the oldest and we need
+ * not scan the reader table again.
+ */
 static txnid_t
 mdb_find_oldest(MDB_txn *txn)
 {
-	int i;
+	MDB_env *env = txn->mt_env;
+	int i, slot = -1;
 	txnid_t mr, oldest = txn->mt_txnid - 1;
-	if (txn->mt_env->me_txns) {
-		MDB_reader *r = txn->mt_env->me_txns->mti_readers;
-		for (i = txn->mt_env->me_txns->mti_numreaders; --i >= 0; ) {
-			if (r[i].mr_pid) {
-				mr = r[i].mr_txnid;
-				if (oldest > mr)
-					oldest = mr;
+	if (env->me_txns) {
+		MDB_reader *r = env->me_txns->mti_readers;
+		i = env->me_oldest_slot;
+		if (i >= 0 && r[i].mr_pid && r[i].mr_txnid == env->me_oldest) {
+			if (oldest > env->me_oldest)
+				oldest = env->me_oldest;
+		} else {
+			for (i = env->me_txns->mti_numreaders; --i >= 0; ) {
+				if (r[i].mr_pid) {
+					mr = r[i].mr_txnid;
+					if (oldest > mr) {
+						oldest = mr;
+						slot = i;
+					}
+				}
 			}
+			env->me_oldest_slot = slot;
+			env->me_oldest = oldest;
 		}
 	}
+#ifndef _WIN32
+	/* Until the metas of unsynced commits are on disk, a crash
+	 * goes back to the last synced txn. Its pages must stay intact,
+	 * as if it had a reader.
+	 */
+	pthread_mutex_lock(&env->me_sync_mutex);
+	if (env->me_unsynced > env->me_synced && oldest > env->me_synced)
+		oldest = env->me_synced;
+	pthread_mutex_unlock(&env->me_sync_mutex);
+#endif
 	return oldest;
 }
 
@@ -2131,6 +2207,242 @@ mdb_page_dirty(MDB_txn *txn, MDB_page *mp)
 	txn->mt_dirty_room--;
 }
 
+/** Return the size class of a run of \b len pages, len > 1. */
+static unsigned
+mdb_pgrun_class(pgno_t len)
+{
+	unsigned c = MDB_PGRUN_EXACT - 2;
+
+	if (len < MDB_PGRUN_EXACT)
+		return len - 2;
+	while ((len >>= 1) >= MDB_PGRUN_EXACT && c < MDB_PGRUN_CLASSES-1)
+		c++;
+	return c;
+}
+
+/** Return the index of the first entry of size class \b c that sorts
+ * below a run of \b len pages starting at \b pgno.
+ */
+static unsigned
+mdb_pgruns_search(MDB_pgruns *runs, unsigned c, pgno_t len, pgno_t pgno)
+{
+	MDB_pgrun *h = runs->mr_runs[c];
+	unsigned lo = 0, hi = runs->mr_num[c], k;
+
+	while (lo < hi) {
+		k = (lo + hi) >> 1;
+		if (h[k].mr_len > len || (h[k].mr_len == len && h[k].mr_pgno > pgno))
+			lo = k + 1;
+		else
+			hi = k;
+	}
+	return lo;
+}
+
+/** Remove entry \b k from size class \b c */
+static void
+mdb_pgruns_del(MDB_pgruns *runs, unsigned c, unsigned k)
+{
+	unsigned n = --runs->mr_num[c];
+
+	runs->mr_total--;
+	if (k < n)
+		memmove(&runs->mr_runs[c][k], &runs->mr_runs[c][k+1],
+			(n - k) * sizeof(MDB_pgrun));
+}
+
+/** Make room for one more entry in size class \b c.
+ * On failure the index is marked out of sync.
+ * @return 0 on success, ENOMEM on failure.
+ */
+static int
+mdb_pgruns_grow(MDB_pgruns *runs, unsigned c)
+{
+	if (runs->mr_num[c] == runs->mr_max[c]) {
+		unsigned max = runs->mr_max[c] ? runs->mr_max[c] * 2 : 16;
+		MDB_pgrun *r = realloc(runs->mr_runs[c], max * sizeof(MDB_pgrun));
+		if (!r) {
+			runs->mr_head = NULL;
+			return ENOMEM;
+		}
+		runs->mr_runs[c] = r;
+		runs->mr_max[c] = max;
+	}
+	return MDB_SUCCESS;
+}
+
+/** Add a run to the index. Single pages are not indexed.
+ * Runs of the same length are taken lowest first, so runs at the
+ * start of the map get reused first.
+ * On failure the index is marked out of sync.
+ * @return 0 on success, ENOMEM on failure.
+ */
+static int
+mdb_pgruns_add(MDB_pgruns *runs, pgno_t pgno, pgno_t len)
+{
+	unsigned c, k;
+
+	if (len < 2)
+		return MDB_SUCCESS;
+	c = mdb_pgrun_class(len);
+	if (mdb_pgruns_grow(runs, c))
+		return ENOMEM;
+	k = mdb_pgruns_search(runs, c, len, pgno);
+	if (k < runs->mr_num[c])
+		memmove(&runs->mr_runs[c][k+1], &runs->mr_runs[c][k],
+			(runs->mr_num[c] - k) * sizeof(MDB_pgrun));
+	runs->mr_runs[c][k].mr_pgno = pgno;
+	runs->mr_runs[c][k].mr_len = len;
+	runs->mr_num[c]++;
+	runs->mr_total++;
+	return MDB_SUCCESS;
+}
+
+/** Order runs by length, then by page number, descending */
+static int
+mdb_pgrun_cmp(const void *a, const void *b)
+{
+	const MDB_pgrun *ra = a, *rb = b;
+
+	if (ra->mr_len != rb->mr_len)
+		return ra->mr_len < rb->mr_len ? 1 : -1;
+	if (ra->mr_pgno != rb->mr_pgno)
+		return ra->mr_pgno < rb->mr_pgno ? 1 : -1;
+	return 0;
+}
+
+/** Index all runs in \b mop from scratch.
+ * @return 0 on success, ENOMEM on failure.
+ */
+static int
+mdb_pgruns_build(MDB_pgruns *runs, MDB_IDL mop)
+{
+	unsigned c, i, j, k;
+
+	for (c = 0; c < MDB_PGRUN_CLASSES; c++)
+		runs->mr_num[c] = 0;
+	runs->mr_total = 0;
+	/* mop is sorted in descending order. Append the runs, sort later */
+	for (i = mop[0]; i; i = j-1) {
+		for (j = i; j > 1 && mop[j-1] == mop[j]+1; j--) ;
+		if (i == j)
+			continue;
+		c = mdb_pgrun_class(i-j+1);
+		if (mdb_pgruns_grow(runs, c))
+			return ENOMEM;
+		k = runs->mr_num[c]++;
+		runs->mr_runs[c][k].mr_pgno = mop[i];
+		runs->mr_runs[c][k].mr_len = i-j+1;
+		runs->mr_total++;
+	}
+	for (c = 0; c < MDB_PGRUN_CLASSES; c++)
+		if (runs->mr_num[c] > 1)
+			qsort(runs->mr_runs[c], runs->mr_num[c], sizeof(MDB_pgrun),
+				mdb_pgrun_cmp);
+	runs->mr_head = mop;
+	runs->mr_len = mop[0];
+	return MDB_SUCCESS;
+}
+
+/** Index the runs that gained pages when \b idl was merged into \b mop.
+ * Runs absorbed into bigger ones stay in the index until they are
+ * looked up, but force a rebuild once they outnumber the pages.
+ * @return 0 on success, non-zero if the index must be rebuilt.
+ */
+static int
+mdb_pgruns_merge(MDB_pgruns *runs, MDB_IDL mop, MDB_IDL idl)
+{
+	unsigned n, k, lo, hi;
+	pgno_t covered = 0;
+
+	/* Walk idl in ascending order, skipping pages of the last run */
+	for (n = idl[0]; n; n--) {
+		if (idl[n] <= covered)
+			continue;
+		k = mdb_midl_search(mop, idl[n]);
+		for (hi = k; hi > 1 && mop[hi-1] == mop[hi]+1; hi--) ;
+		for (lo = k; lo < mop[0] && mop[lo+1] == mop[lo]-1; lo++) ;
+		covered = mop[hi];
+		if (mdb_pgruns_add(runs, mop[lo], lo-hi+1))
+			return ENOMEM;
+	}
+	if (runs->mr_total > mop[0])
+		return -1;
+	runs->mr_head = mop;
+	runs->mr_len = mop[0];
+	return MDB_SUCCESS;
+}
+
+/** Check an index entry against \b mop, and trim it to the pages
+ * still present. #mdb_page_alloc() only takes pages from the low end
+ * of a run, so its top page is kept as the anchor.
+ * @param[in,out] r the run to check.
+ * @param[out] ip index in \b mop of the lowest page of the run.
+ * @return the number of pages left in the run.
+ */
+static pgno_t
+mdb_pgrun_check(MDB_IDL mop, MDB_pgrun *r, unsigned *ip)
+{
+	pgno_t top = r->mr_pgno + r->mr_len - 1;
+	unsigned k, j;
+
+	k = mdb_midl_search(mop, top);
+	if (k > mop[0] || mop[k] != top)
+		return 0;
+	j = mdb_midl_search(mop, r->mr_pgno);
+	if (j > mop[0] || mop[j] != r->mr_pgno)
+		j--;
+	/* mop has no duplicates, so equal spans mean no holes */
+	if (mop[j] != top - (j - k))
+		return 0;
+	r->mr_pgno = mop[j];
+	r->mr_len = j - k + 1;
+	*ip = j;
+	return r->mr_len;
+}
+
+/** Find the shortest run of at least \b num pages, the lowest of those
+ * of the same length, and remove its \b num lowest pages from the index.
+ * Stale entries met on the way are dropped or moved to their proper place.
+ * @return index in \b mop of the lowest page, or 0 if none was found.
+ */
+static unsigned
+mdb_pgruns_find(MDB_pgruns *runs, MDB_IDL mop, unsigned num)
+{
+	unsigned c = mdb_pgrun_class(num), k, i;
+	MDB_pgrun r;
+
+	for (; c < MDB_PGRUN_CLASSES; c++) {
+		/* The runs long enough come first. Only a power-of-2
+		 * class may hold shorter ones.
+		 */
+		while ((k = mdb_pgruns_search(runs, c, num, 0)) != 0) {
+			r = runs->mr_runs[c][k-1];
+			mdb_pgruns_del(runs, c, k-1);
+			if (!mdb_pgrun_check(mop, &r, &i))
+				continue;
+			if (r.mr_len >= num)
+				goto found;
+			/* Shrunk below num */
+			if (mdb_pgruns_add(runs, r.mr_pgno, r.mr_len))
+				return 0;
+		}
+	}
+	return 0;
+
+found:
+	/* Put back what is left on either side. r may be a stale entry
+	 * for part of a run that has grown since, and the entry of the
+	 * bigger run no longer checks out once its middle is taken.
+	 */
+	for (k = i; k < mop[0] && mop[k+1] == mop[k]-1; k++) ;
+	if (mdb_pgruns_add(runs, mop[k], k - i))
+		return i;
+	for (k = i-num+1; k > 1 && mop[k-1] == mop[k]+1; k--) ;
+	mdb_pgruns_add(runs, mop[i] + num, i-num+1 - k);
+	return i;
+}
+
 /** Allocate page numbers and memory for writing.  Maintain me_pglast,
  * me_pghead and mt_next_pgno.  Set #MDB_TXN_ERROR on failure.
  *
@@ -2138,7 +2450,8 @@ mdb_page_dirty(MDB_txn *txn, MDB_page *mp)
  * are re-used first. Otherwise allocate a new page at mt_next_pgno.
  * Do not modify the freedB, just merge freeDB records into me_pghead[]
  * and move me_pglast to say which records were consumed.  Only this
- * function can create me_pghead and move me_pglast/mt_next_pgno.
+ * function and #mdb_txn_shrink() can create me_pghead and move
+ * me_pglast/mt_next_pgno.
  * @param[in] mc cursor A cursor handle identifying the transaction and
  *	database for which we are allocating.
  * @param[in] num the number of pages to allocate.
@@ -2170,6 +2483,8 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 	MDB_cursor_op op;
 	MDB_cursor m2;
 	int found_old = 0;
+	MDB_pgruns *runs = &env->me_pgruns;
+	int synced = mop && runs->mr_head == mop && runs->mr_len == mop_len;
 
 	/* If there are any loose pages, just use them */
 	if (num == 1 && txn->mt_loose_pgs) {
@@ -2199,12 +2514,20 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 		 * pages at the tail, just truncating the list.
 		 */
 		if (mop_len > n2) {
-			i = mop_len;
-			do {
-				pgno = mop[i];
-				if (mop[i-n2] == pgno+n2)
+			if (n2 && (synced || (synced = !mdb_pgruns_build(runs, mop)))) {
+				/* Look up a big enough run by size */
+				if ((i = mdb_pgruns_find(runs, mop, num)) != 0) {
+					pgno = mop[i];
 					goto search_done;
-			} while (--i > n2);
+				}
+			} else {
+				i = mop_len;
+				do {
+					pgno = mop[i];
+					if (mop[i-n2] == pgno+n2)
+						goto search_done;
+				} while (--i > n2);
+			}
 			if (--retry < 0)
 				break;
 		}
@@ -2279,6 +2602,9 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 		/* Merge in descending sorted order */
 		mdb_midl_xmerge(mop, idl);
 		mop_len = mop[0];
+		/* Keep the run index in step, or leave it to be rebuilt */
+		if (synced)
+			synced = n2 && !mdb_pgruns_merge(runs, mop, idl);
 	}
 
 	/* Use new pages from the map when nothing suitable in the freeDB */
@@ -2304,6 +2630,8 @@ search_done:
 		/* Move any stragglers down */
 		for (j = i-num; j < mop_len; )
 			mop[++j] = mop[++i];
+		if (synced && runs->mr_head == mop)
+			runs->mr_len = mop_len;
 	} else {
 		txn->mt_next_pgno = pgno + num;
 	}
@@ -2460,7 +2788,7 @@ mdb_page_touch(MDB_cursor *mc)
 				return 0;
 			}
 		}
-		mdb_cassert(mc, dl[0].mid < MDB_IDL_UM_MAX);
+		mdb_cassert(mc, dl[0].mid < txn->mt_env->me_dirty_max);
 		/* No - copy it */
 		np = mdb_page_malloc(txn, 1);
 		if (!np)
@@ -2536,6 +2864,54 @@ mdb_env_sync(MDB_env *env, int force)
 	return rc;
 }
 
+int
+mdb_env_sync_txn(MDB_env *env, size_t txnid, unsigned int usec)
+{
+#ifdef _WIN32
+	return mdb_env_sync(env, 1);
+#else
+	txnid_t last;
+	int rc = 0;
+
+	if (env->me_flags & MDB_RDONLY)
+		return EACCES;
+	/* Without a lock region there is no shared txnid to batch on */
+	if (!env->me_txns)
+		return mdb_env_sync(env, 1);
+
+	pthread_mutex_lock(&env->me_sync_mutex);
+	while (env->me_synced < txnid) {
+		/* A sync in progress may have started before our commit.
+		 * Wait for it, then check again.
+		 */
+		if (env->me_syncing) {
+			pthread_cond_wait(&env->me_sync_cond, &env->me_sync_mutex);
+			continue;
+		}
+		env->me_syncing = 1;
+		pthread_mutex_unlock(&env->me_sync_mutex);
+		if (usec) {
+			struct timespec ts;
+			ts.tv_sec = usec / 1000000;
+			ts.tv_nsec = (usec % 1000000) * 1000;
+			nanosleep(&ts, NULL);
+		}
+		/* Every txn up to here has written its meta page */
+		last = env->me_txns->mti_txnid;
+		rc = mdb_env_sync(env, 1);
+		pthread_mutex_lock(&env->me_sync_mutex);
+		env->me_syncing = 0;
+		if (!rc && env->me_synced < last)
+			env->me_synced = last;
+		pthread_cond_broadcast(&env->me_sync_cond);
+		if (rc)
+			break;
+	}
+	pthread_mutex_unlock(&env->me_sync_mutex);
+	return rc;
+#endif
+}
+
 /** Back up parent txn's cursors, then grab the originals for tracking */
 static int
 mdb_cursor_shadow(MDB_txn *src, MDB_txn *dst)
@@ -2679,7 +3055,7 @@ mdb_txn_renew0(MDB_txn *txn)
 	MDB_env *env = txn->mt_env;
 	MDB_txninfo *ti = env->me_txns;
 	MDB_meta *meta;
-	unsigned int i, nr, flags = txn->mt_flags;
+	unsigned int i, j, nr, flags = txn->mt_flags;
 	uint16_t x;
 	int rc, new_notls = 0;
 
@@ -2709,9 +3085,18 @@ mdb_txn_renew0(MDB_txn *txn)
 				if (LOCK_MUTEX(rc, env, rmutex))
 					return rc;
 				nr = ti->mti_numreaders;
-				for (i=0; i<nr; i++)
+				/* Look from after the last slot we claimed, the
+				 * ones before it are likely still in use.
+				 */
+				i = env->me_rscan < nr ? env->me_rscan : 0;
+				for (j = nr; j; j--) {
 					if (ti->mti_readers[i].mr_pid == 0)
 						break;
+					if (++i == nr)
+						i = 0;
+				}
+				if (!j)
+					i = nr;
 				if (i == env->me_maxreaders) {
 					UNLOCK_MUTEX(rmutex);
 					return MDB_READERS_FULL;
@@ -2729,6 +3114,7 @@ mdb_txn_renew0(MDB_txn *txn)
 				if (i == nr)
 					ti->mti_numreaders = ++nr;
 				env->me_close_readers = nr;
+				env->me_rscan = i + 1;
 				r->mr_pid = pid;
 				UNLOCK_MUTEX(rmutex);
 
@@ -2765,7 +3151,7 @@ mdb_txn_renew0(MDB_txn *txn)
 		txn->mt_child = NULL;
 		txn->mt_loose_pgs = NULL;
 		txn->mt_loose_count = 0;
-		txn->mt_dirty_room = MDB_IDL_UM_MAX;
+		txn->mt_dirty_room = env->me_dirty_max;
 		txn->mt_u.dirty_list = env->me_dirty_list;
 		txn->mt_u.dirty_list[0].mid = 0;
 		txn->mt_free_pgs = env->me_free_pgs;
@@ -2868,7 +3254,7 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 		unsigned int i;
 		txn->mt_cursors = (MDB_cursor **)(txn->mt_dbs + env->me_maxdbs);
 		txn->mt_dbiseqs = parent->mt_dbiseqs;
-		txn->mt_u.dirty_list = malloc(sizeof(MDB_ID2)*MDB_IDL_UM_SIZE);
+		txn->mt_u.dirty_list = malloc(sizeof(MDB_ID2)*(env->me_dirty_max+1));
 		if (!txn->mt_u.dirty_list ||
 			!(txn->mt_free_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX)))
 		{
@@ -3018,6 +3404,7 @@ mdb_txn_end(MDB_txn *txn, unsigned mode)
 			/* me_pgstate: */
 			env->me_pghead = NULL;
 			env->me_pglast = 0;
+			env->me_pgruns.mr_head = NULL;
 
 			env->me_txn = NULL;
 			mode = 0;	/* txn == env->me_txn0, do not free() it */
@@ -3066,6 +3453,133 @@ mdb_txn_abort(MDB_txn *txn)
 	mdb_txn_end(txn, MDB_END_ABORT|MDB_END_SLOT|MDB_END_FREE);
 }
 
+/** Merge freeDB records that no reader can see into me_pghead,
+ * as #mdb_page_alloc() would when it runs out of free pages.
+ * @param[in] txn the write transaction.
+ * @param[in] oldest the oldest snapshot still in use.
+ * @param[in] all merge every such record, else only the next one.
+ * @return 0 on success, non-zero on failure. MDB_NOTFOUND if only
+ * the next record was asked for and there is none.
+ */
+static int
+mdb_pghead_load(MDB_txn *txn, txnid_t oldest, int all)
+{
+	MDB_env *env = txn->mt_env;
+	MDB_cursor m2;
+	MDB_val key, data;
+	MDB_cursor_op op;
+	txnid_t last;
+	pgno_t *mop, *idl;
+	int rc;
+
+	mdb_cursor_init(&m2, txn, FREE_DBI, NULL);
+	last = env->me_pglast;
+	op = MDB_FIRST;
+	if (last) {
+		op = MDB_SET_RANGE;
+		last++;
+		key.mv_data = &last;
+		key.mv_size = sizeof(last);
+	}
+	mop = env->me_pghead;
+	while ((rc = mdb_cursor_get(&m2, &key, NULL, op)) == MDB_SUCCESS) {
+		op = MDB_NEXT;
+		last = *(txnid_t*)key.mv_data;
+		if (oldest <= last)
+			break;
+		if ((rc = mdb_node_read(&m2,
+			NODEPTR(m2.mc_pg[m2.mc_top], m2.mc_ki[m2.mc_top]), &data)) != MDB_SUCCESS)
+			return rc;
+		idl = (MDB_ID *) data.mv_data;
+		if (!mop) {
+			if (!(env->me_pghead = mop = mdb_midl_alloc(idl[0])))
+				return ENOMEM;
+		} else {
+			if ((rc = mdb_midl_need(&env->me_pghead, idl[0])) != 0)
+				return rc;
+			mop = env->me_pghead;
+		}
+		env->me_pglast = last;
+		mdb_midl_xmerge(mop, idl);
+		if (!all)
+			return MDB_SUCCESS;
+	}
+	if (rc == MDB_SUCCESS)
+		rc = MDB_NOTFOUND;
+	return rc == MDB_NOTFOUND && all ? MDB_SUCCESS : rc;
+}
+
+int
+mdb_txn_shrink(MDB_txn *txn, size_t *npages)
+{
+	MDB_env *env;
+	txnid_t oldest;
+	pgno_t pgno, *mop;
+	unsigned i, j, n;
+	int rc;
+
+	if (txn == NULL || npages == NULL || txn->mt_parent)
+		return EINVAL;
+	*npages = 0;
+
+	if (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_BLOCKED))
+		return (txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
+
+	env = txn->mt_env;
+	oldest = mdb_find_oldest(txn);
+	env->me_pgoldest = oldest;
+
+#ifndef _WIN32
+	/* Pages released earlier may still lie inside the last page of an
+	 * older snapshot, which mdb_env_copy() reads up to. Only drop them
+	 * from the file once no reader has such a snapshot.
+	 */
+	if (env->me_shrunk && oldest >= env->me_shrunk) {
+		if (ftruncate(env->me_fd, (off_t)txn->mt_next_pgno * env->me_psize) < 0) {
+			rc = ErrCode();
+			goto fail;
+		}
+		env->me_shrunk = 0;
+	}
+#endif
+
+	/* Know all the free tail pages */
+	if ((rc = mdb_pghead_load(txn, oldest, 1)) != MDB_SUCCESS)
+		goto fail;
+	mop = env->me_pghead;
+	if (!mop)
+		return MDB_SUCCESS;
+
+	/* me_pghead is sorted in descending order, so the pages at the
+	 * end of the file come first.
+	 */
+	pgno = txn->mt_next_pgno;
+	n = mop[0];
+	for (i = 1; i <= n && mop[i] == pgno-1; i++)
+		pgno--;
+	if (pgno < txn->mt_next_pgno) {
+		i--;
+		mop[0] = n -= i;
+		for (j = 1; j <= n; j++)
+			mop[j] = mop[j+i];
+		env->me_pgruns.mr_head = NULL;
+		*npages = txn->mt_next_pgno - pgno;
+		txn->mt_next_pgno = pgno;
+		txn->mt_flags |= MDB_TXN_DIRTY;
+#ifndef _WIN32
+		if (!(env->me_flags & MDB_WRITEMAP))
+			env->me_shrunk = txn->mt_txnid;
+#endif
+		DPRINTF(("shrink txn %"Z"u to %"Z"u pages, released %"Z"u",
+			txn->mt_txnid, pgno, *npages));
+	}
+	return MDB_SUCCESS;
+
+fail:
+	txn->mt_flags |= MDB_TXN_ERROR;
+	return rc;
+}
+
 /** Save the freelist as of this transaction to the freeDB.
  * This changes the freelist. Keep trying until it stabilizes.
  */
@@ -3565,7 +4079,7 @@ mdb_txn_commit(MDB_txn *txn)
 				}
 			}
 		} else { /* Simplify the above for single-ancestor case */
-			len = MDB_IDL_UM_MAX - txn->mt_dirty_room;
+			len = env->me_dirty_max - txn->mt_dirty_room;
 		}
 		/* Merge our dirty list with parent's */
 		y = src[0].mid;
@@ -3649,6 +4163,7 @@ mdb_txn_commit(MDB_txn *txn)
 
 	mdb_midl_free(env->me_pghead);
 	env->me_pghead = NULL;
+	env->me_pgruns.mr_head = NULL;
 	mdb_midl_shrink(&txn->mt_free_pgs);
 
 #if (MDB_DEBUG) > 2
@@ -3659,6 +4174,21 @@ mdb_txn_commit(MDB_txn *txn)
 		(rc = mdb_env_sync(env, 0)) ||
 		(rc = mdb_env_write_meta(txn)))
 		goto fail;
+#ifndef _WIN32
+	/* Track what is on disk, for mdb_find_oldest() */
+	if (!(env->me_flags & (MDB_NOSYNC|MDB_MAPASYNC))) {
+		pthread_mutex_lock(&env->me_sync_mutex);
+		if ((env->me_flags | txn->mt_flags) & MDB_NOMETASYNC) {
+			/* Syncing our pages also synced the previous meta */
+			if (env->me_synced < txn->mt_txnid - 1)
+				env->me_synced = txn->mt_txnid - 1;
+			env->me_unsynced = txn->mt_txnid;
+		} else if (env->me_synced < txn->mt_txnid) {
+			env->me_synced = txn->mt_txnid;
+		}
+		pthread_mutex_unlock(&env->me_sync_mutex);
+	}
+#endif
 	end_mode = MDB_END_COMMITTED|MDB_END_UPDATE;
 
 done:
@@ -3829,7 +4359,7 @@ mdb_env_write_meta(MDB_txn *txn)
 		toggle, txn->mt_dbs[MAIN_DBI].md_root));
 
 	env = txn->mt_env;
-	flags = env->me_flags;
+	flags = env->me_flags | (txn->mt_flags & MDB_TXN_NOMETASYNC);
 	mp = env->me_metas[toggle];
 	mapsize = env->me_metas[toggle ^ 1]->mm_mapsize;
 	/* Persist any increases of mapsize config */
@@ -3954,7 +4484,9 @@ mdb_env_create(MDB_env **env)
 		return ENOMEM;
 
 	e->me_maxreaders = DEFAULT_READERS;
+	e->me_dirty_max = MDB_IDL_UM_MAX;
 	e->me_maxdbs = e->me_numdbs = CORE_DBS;
+	e->me_oldest_slot = -1;
 	e->me_fd = INVALID_HANDLE_VALUE;
 	e->me_lfd = INVALID_HANDLE_VALUE;
 	e->me_mfd = INVALID_HANDLE_VALUE;
@@ -3964,6 +4496,20 @@ mdb_env_create(MDB_env **env)
 #endif
 	e->me_pid = getpid();
 	GET_PAGESIZE(e->me_os_psize);
+#ifndef _WIN32
+	{
+		int rc;
+		if ((rc = pthread_mutex_init(&e->me_sync_mutex, NULL)) != 0) {
+			free(e);
+			return rc;
+		}
+		if ((rc = pthread_cond_init(&e->me_sync_cond, NULL)) != 0) {
+			pthread_mutex_destroy(&e->me_sync_mutex);
+			free(e);
+			return rc;
+		}
+	}
+#endif
 	VGMEMP_CREATE(e,0,0);
 	*env = e;
 	return MDB_SUCCESS;
@@ -4041,6 +4587,10 @@ mdb_env_map(MDB_env *env, void *addr)
 #endif /* POSIX_MADV_RANDOM */
 #endif /* MADV_RANDOM */
 	}
+#ifdef MADV_HUGEPAGE
+	if (flags & MDB_HUGEPAGE)
+		madvise(env->me_map, env->me_mapsize, MADV_HUGEPAGE);
+#endif
 #endif /* _WIN32 */
 
 	/* Can happen because the address argument to mmap() is just a
@@ -4058,6 +4608,115 @@ mdb_env_map(MDB_env *env, void *addr)
 	return MDB_SUCCESS;
 }
 
+/** Spread the pages of the data file across the NUMA nodes we may use.
+ *	Pages of a shared file mapping are allocated by the memory policy
+ *	of the thread that faults them in, not by the policy of the
+ *	mapping, so the only way to place them is to read them in under
+ *	an interleave policy, which is done here for the calling thread.
+ * @param[in] env An environment handle.
+ */
+static void ESECT
+mdb_env_interleave(MDB_env *env)
+{
+#if defined(SYS_get_mempolicy) && defined(SYS_set_mempolicy)
+#define MDB_NUMA_NODES	1024	/* enough for any MAX_NUMNODES */
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE	3
+#endif
+#ifndef MPOL_F_MEMS_ALLOWED
+#define MPOL_F_MEMS_ALLOWED	(1<<2)
+#endif
+	unsigned long mask[MDB_NUMA_NODES / (CHAR_BIT * sizeof(long))];
+	unsigned long omask[MDB_NUMA_NODES / (CHAR_BIT * sizeof(long))];
+	int mode;
+	size_t size = 0;
+
+	if (syscall(SYS_get_mempolicy, &mode, omask, MDB_NUMA_NODES, NULL, 0) ||
+		syscall(SYS_get_mempolicy, NULL, mask, MDB_NUMA_NODES, NULL,
+			MPOL_F_MEMS_ALLOWED) ||
+		syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask, MDB_NUMA_NODES))
+		return;
+	if (mdb_fsize(env->me_fd, &size) == MDB_SUCCESS) {
+		if (size > env->me_mapsize)
+			size = env->me_mapsize;
+#ifdef MADV_POPULATE_READ
+		if (madvise(env->me_map, size, MADV_POPULATE_READ))
+#endif
+			madvise(env->me_map, size, MADV_WILLNEED);
+	}
+	syscall(SYS_set_mempolicy, mode, omask, MDB_NUMA_NODES);
+#endif
+}
+
+/** Lock the branch pages of a tree in memory.
+ * @param[in] mc A cursor for page lookups.
+ * @param[in] pgno The root of the tree.
+ * @param[in] subs Non-zero to also visit the named databases
+ *	recorded in the leaves, which are otherwise skipped.
+ * @return 0 on success, non-zero on failure.
+ */
+static int ESECT
+mdb_page_lock_branches(MDB_cursor *mc, pgno_t pgno, int subs)
+{
+#ifndef _WIN32
+	MDB_env *env = mc->mc_txn->mt_env;
+	MDB_page *mp;
+	MDB_node *node;
+	MDB_db db;
+	unsigned int i;
+	size_t off;
+	int rc;
+
+	if ((rc = mdb_page_get(mc, pgno, &mp, NULL)) != MDB_SUCCESS)
+		return rc;
+	if (IS_BRANCH(mp)) {
+		off = (size_t)mp & (env->me_os_psize - 1);
+		if (mlock((char *)mp - off, env->me_psize + off))
+			return ErrCode();
+		for (i=0; i<NUMKEYS(mp); i++) {
+			rc = mdb_page_lock_branches(mc, NODEPGNO(NODEPTR(mp, i)), subs);
+			if (rc)
+				return rc;
+		}
+	} else if (subs && IS_LEAF(mp) && !IS_LEAF2(mp)) {
+		for (i=0; i<NUMKEYS(mp); i++) {
+			node = NODEPTR(mp, i);
+			if ((node->mn_flags & (F_SUBDATA|F_DUPDATA)) != F_SUBDATA)
+				continue;
+			memcpy(&db, NODEDATA(node), sizeof(db));
+			if (db.md_root != P_INVALID &&
+				(rc = mdb_page_lock_branches(mc, db.md_root, 0)))
+				return rc;
+		}
+	}
+#endif
+	return MDB_SUCCESS;
+}
+
+/** Lock the branch pages of all the databases in memory.
+ *	The main DB is walked in full to find the named DBs.
+ * @param[in] env An environment handle.
+ * @return 0 on success, non-zero on failure.
+ */
+static int ESECT
+mdb_env_lock_branches(MDB_env *env)
+{
+	MDB_txn *txn;
+	MDB_cursor mc;
+	int i, rc;
+
+	if ((rc = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn)) != MDB_SUCCESS)
+		return rc;
+	for (i=FREE_DBI; i<=MAIN_DBI && !rc; i++) {
+		if (txn->mt_dbs[i].md_root == P_INVALID)
+			continue;
+		mdb_cursor_init(&mc, txn, i, NULL);
+		rc = mdb_page_lock_branches(&mc, txn->mt_dbs[i].md_root, i == MAIN_DBI);
+	}
+	mdb_txn_abort(txn);
+	return rc;
+}
+
 int ESECT
 mdb_env_set_mapsize(MDB_env *env, size_t size)
 {
@@ -4089,6 +4748,9 @@ mdb_env_set_mapsize(MDB_env *env, size_t size)
 	env->me_mapsize = size;
 	if (env->me_psize)
 		env->me_maxpg = env->me_mapsize / env->me_psize;
+	/* the old map's locks went with it */
+	if (env->me_map && (env->me_flags & MDB_MLOCKBRANCH))
+		return mdb_env_lock_branches(env);
 	return MDB_SUCCESS;
 }
 
@@ -4111,9 +4773,21 @@ mdb_env_set_maxreaders(MDB_env *env, unsigned int readers)
 }
 
 int ESECT
-mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers)
+mdb_env_set_dirtylimit(MDB_env *env, unsigned int pages)
 {
-	if (!env || !readers)
+	if (env->me_map)
+		return EINVAL;
+	/* Silently round up to the default, the minimum */
+	if (pages < MDB_IDL_UM_MAX)
+		pages = MDB_IDL_UM_MAX;
+	env->me_dirty_max = pages;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers)
+{
+	if (!env || !readers)
 		return EINVAL;
 	*readers = env->me_maxreaders;
 	return MDB_SUCCESS;
@@ -4951,7 +5625,8 @@ fail:
 	 */
 #define	CHANGEABLE	(MDB_NOSYNC|MDB_NOMETASYNC|MDB_MAPASYNC|MDB_NOMEMINIT)
 #define	CHANGELESS	(MDB_FIXEDMAP|MDB_NOSUBDIR|MDB_RDONLY| \
-	MDB_WRITEMAP|MDB_NOTLS|MDB_NOLOCK|MDB_NORDAHEAD)
+	MDB_WRITEMAP|MDB_NOTLS|MDB_NOLOCK|MDB_NORDAHEAD| \
+	MDB_HUGEPAGE|MDB_NUMAINTERLEAVE|MDB_MLOCKBRANCH)
 
 #if VALID_FLAGS & PERSISTENT_FLAGS & (CHANGEABLE|CHANGELESS)
 # error "Persistent DB flags & env flags overlap, but both go in mm_flags"
@@ -4977,7 +5652,7 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 		flags &= ~MDB_WRITEMAP;
 	} else {
 		if (!((env->me_free_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX)) &&
-			  (env->me_dirty_list = calloc(MDB_IDL_UM_SIZE, sizeof(MDB_ID2)))))
+			  (env->me_dirty_list = calloc(env->me_dirty_max+1, sizeof(MDB_ID2)))))
 			rc = ENOMEM;
 	}
 	env->me_flags = flags |= MDB_ENV_ACTIVE;
@@ -5047,6 +5722,10 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 				rc = ENOMEM;
 			}
 		}
+		if (!rc && (flags & MDB_NUMAINTERLEAVE))
+			mdb_env_interleave(env);
+		if (!rc && (flags & MDB_MLOCKBRANCH))
+			rc = mdb_env_lock_branches(env);
 	}
 
 leave:
@@ -5080,6 +5759,9 @@ mdb_env_close0(MDB_env *env, int excl)
 	free(env->me_dirty_list);
 	free(env->me_txn0);
 	mdb_midl_free(env->me_free_pgs);
+	for (i = 0; i < MDB_PGRUN_CLASSES; i++)
+		free(env->me_pgruns.mr_runs[i]);
+	memset(&env->me_pgruns, 0, sizeof(env->me_pgruns));
 
 	if (env->me_flags & MDB_ENV_TXKEY) {
 		pthread_key_delete(env->me_txkey);
@@ -5181,6 +5863,10 @@ mdb_env_close(MDB_env *env)
 	}
 
 	mdb_env_close0(env, 0);
+#ifndef _WIN32
+	pthread_cond_destroy(&env->me_sync_cond);
+	pthread_mutex_destroy(&env->me_sync_mutex);
+#endif
 	free(env);
 }
 
@@ -6515,6 +7201,142 @@ fetchm:
 	return rc;
 }
 
+/** Advise the OS that a run of pages will be needed.
+ * @param[in] env The environment.
+ * @param[in] pgno The first page of the run.
+ * @param[in] npages The number of pages in the run.
+ */
+static void
+mdb_page_willneed(MDB_env *env, pgno_t pgno, pgno_t npages)
+{
+#if defined(MADV_WILLNEED) || defined(POSIX_MADV_WILLNEED)
+	char *ptr = env->me_map + pgno * env->me_psize;
+	size_t off = (size_t)ptr & (env->me_os_psize - 1);
+#ifdef MADV_WILLNEED
+	madvise(ptr - off, npages * env->me_psize + off, MADV_WILLNEED);
+#else
+	posix_madvise(ptr - off, npages * env->me_psize + off, POSIX_MADV_WILLNEED);
+#endif
+#endif
+}
+
+/** Advise the OS that the leaf pages holding some keys will be needed.
+ *	Only the children of the current leaf's parent are considered,
+ *	the keys are merged against its separators so that each page
+ *	one of them falls in is advised once. Adjacent pages are advised
+ *	together.
+ * @param[in] mc A cursor positioned on a leaf page.
+ * @param[in] keys The upcoming keys, in ascending order.
+ * @param[in] count The number of keys.
+ */
+static void
+mdb_cursor_prefetch(MDB_cursor *mc, MDB_val *keys, unsigned int count)
+{
+	MDB_page	*mp;
+	MDB_node	*node;
+	MDB_val		 nodekey;
+	pgno_t		 pgno, run = P_INVALID, nrun = 0;
+	unsigned int i, j, nkeys, last;
+
+	if (mc->mc_top < 1)
+		return;
+	mp = mc->mc_pg[mc->mc_top-1];
+	nkeys = NUMKEYS(mp);
+	j = mc->mc_ki[mc->mc_top-1] + 1;
+	last = j - 1;
+	if (j >= nkeys)
+		return;
+	for (i=0; i<count; i++) {
+		node = NODEPTR(mp, j);
+		MDB_GET_KEY2(node, nodekey);
+		if (mc->mc_dbx->md_cmp(&keys[i], &nodekey) < 0)
+			continue;
+		while (j+1 < nkeys) {
+			node = NODEPTR(mp, j+1);
+			MDB_GET_KEY2(node, nodekey);
+			if (mc->mc_dbx->md_cmp(&keys[i], &nodekey) < 0)
+				break;
+			j++;
+		}
+		if (j != last) {
+			pgno = NODEPGNO(NODEPTR(mp, j));
+			if (pgno == run + nrun) {
+				nrun++;
+			} else {
+				if (nrun)
+					mdb_page_willneed(mc->mc_txn->mt_env, run, nrun);
+				run = pgno;
+				nrun = 1;
+			}
+			last = j;
+		}
+		if (j+1 == nkeys)
+			break;
+	}
+	if (nrun)
+		mdb_page_willneed(mc->mc_txn->mt_env, run, nrun);
+}
+
+int
+mdb_cursor_get_multi(MDB_cursor *mc, MDB_val *keys, MDB_val *data,
+    unsigned int count)
+{
+	MDB_page	*parent = NULL, *mp;
+	MDB_node	*node;
+	MDB_val		 nodekey;
+	unsigned int i, ki;
+	int		 rc = MDB_SUCCESS, exact;
+
+	if (mc == NULL || (count && (keys == NULL || data == NULL)))
+		return EINVAL;
+
+	if (mc->mc_txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+
+	for (i=0; i<count; i++) {
+		/* If the key lies in the next leaf, step across to it
+		 * rather than searching again from the root.
+		 */
+		if ((mc->mc_flags & C_INITIALIZED) && mc->mc_top) {
+			mp = mc->mc_pg[mc->mc_top-1];
+			ki = mc->mc_ki[mc->mc_top-1];
+			if (ki + 2 < NUMKEYS(mp)) {
+				node = NODEPTR(mp, ki+1);
+				MDB_GET_KEY2(node, nodekey);
+				if (mc->mc_dbx->md_cmp(&keys[i], &nodekey) >= 0) {
+					node = NODEPTR(mp, ki+2);
+					MDB_GET_KEY2(node, nodekey);
+					if (mc->mc_dbx->md_cmp(&keys[i], &nodekey) < 0 &&
+						(rc = mdb_cursor_sibling(mc, 1)) != MDB_SUCCESS)
+						break;
+				}
+			}
+		}
+		exact = 0;
+		rc = mdb_cursor_set(mc, &keys[i], &data[i], MDB_SET, &exact);
+		if (rc == MDB_NOTFOUND) {
+			data[i].mv_size = 0;
+			data[i].mv_data = NULL;
+			rc = MDB_SUCCESS;
+		} else if (rc) {
+			break;
+		}
+		/* Each time we arrive under a new parent, prefetch the
+		 * leaves that the remaining keys will need.
+		 */
+		if (mc->mc_top && mc->mc_pg[mc->mc_top-1] != parent) {
+			parent = mc->mc_pg[mc->mc_top-1];
+			if (mc->mc_ki[mc->mc_top] < NUMKEYS(mc->mc_pg[mc->mc_top]))
+				mdb_cursor_prefetch(mc, keys+i+1, count-i-1);
+		}
+	}
+
+	if (mc->mc_flags & C_DEL)
+		mc->mc_flags ^= C_DEL;
+
+	return rc;
+}
+
 /** Touch all the pages in the cursor stack. Set mc_top.
  *	Makes sure all the pages are writable, before attempting a write operation.
  * @param[in] mc The cursor to operate on.
@@ -7732,6 +8554,199 @@ mdb_cursor_count(MDB_cursor *mc, size_t *countp)
 	return MDB_SUCCESS;
 }
 
+/** Count the clean pages at or above \b limit that the cursor's
+ * current item lives on, i.e. those a rewrite of the item would move.
+ * \b ovpages gets the size of the item's overflow run if it is one
+ * of them, else 0.
+ */
+static int
+mdb_cursor_tail(MDB_cursor *mc, pgno_t limit, unsigned int *count,
+	unsigned int *ovpages)
+{
+	MDB_page *mp;
+	MDB_node *leaf;
+	MDB_cursor *mx;
+	unsigned int i, n = 0;
+	int rc;
+
+	*ovpages = 0;
+	for (i = 0; i < mc->mc_snum; i++) {
+		mp = mc->mc_pg[i];
+		if (mp->mp_pgno >= limit && !(mp->mp_flags & P_DIRTY))
+			n++;
+	}
+	mp = mc->mc_pg[mc->mc_top];
+	if (!IS_LEAF2(mp)) {
+		leaf = NODEPTR(mp, mc->mc_ki[mc->mc_top]);
+		if (F_ISSET(leaf->mn_flags, F_BIGDATA)) {
+			MDB_page *omp;
+			pgno_t pg;
+			memcpy(&pg, NODEDATA(leaf), sizeof(pg));
+			if (pg >= limit) {
+				if ((rc = mdb_page_get(mc, pg, &omp, NULL)) != 0)
+					return rc;
+				if (!(omp->mp_flags & P_DIRTY)) {
+					n += omp->mp_pages;
+					*ovpages = omp->mp_pages;
+				}
+			}
+		} else if (F_ISSET(leaf->mn_flags, F_SUBDATA)) {
+			mx = &mc->mc_xcursor->mx_cursor;
+			for (i = 0; i < mx->mc_snum; i++) {
+				mp = mx->mc_pg[i];
+				if (mp->mp_pgno >= limit && !(mp->mp_flags & P_DIRTY))
+					n++;
+			}
+		}
+	}
+	*count = n;
+	return MDB_SUCCESS;
+}
+
+/** Is there a run of \b num pages in \b mop that ends below \b limit? */
+static int
+mdb_pgrun_below(MDB_IDL mop, unsigned int num, pgno_t limit)
+{
+	unsigned int i, n2 = num - 1;
+
+	if (!mop)
+		return 0;
+	/* mop is sorted in descending order, walk up from its lowest page */
+	for (i = mop[0]; i > n2 && mop[i] + n2 < limit; i--) {
+		if (mop[i-n2] == mop[i] + n2)
+			return 1;
+	}
+	return 0;
+}
+
+int
+mdb_cursor_compact(MDB_cursor *mc, MDB_val *key, size_t limit, unsigned int *npages)
+{
+	MDB_txn *txn;
+	MDB_val data;
+	MDB_page *mp;
+	MDB_node *leaf;
+	MDB_cursor *mx;
+	MDB_cursor_op op;
+	char *kbuf = NULL;
+	unsigned int i, n, ov, max, moved = 0;
+	int rc;
+
+	if (mc == NULL || key == NULL || npages == NULL)
+		return EINVAL;
+
+	txn = mc->mc_txn;
+	if (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_BLOCKED))
+		return (txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
+
+	max = *npages;
+	*npages = 0;
+	txn->mt_env->me_pgoldest = mdb_find_oldest(txn);
+	rc = mdb_cursor_get(mc, key, &data, key->mv_size ? MDB_SET_RANGE : MDB_FIRST);
+	while (rc == MDB_SUCCESS && moved < max) {
+		if ((rc = mdb_cursor_tail(mc, limit, &n, &ov)) != MDB_SUCCESS)
+			break;
+		op = MDB_NEXT;
+		if (n && ov) {
+			/* Unless a free run below the limit can take the
+			 * overflow run, moving it could grow the file. Fetch
+			 * free pages as mdb_page_alloc() would until one turns up.
+			 */
+			while (!mdb_pgrun_below(txn->mt_env->me_pghead, ov, limit)) {
+				if ((rc = mdb_pghead_load(txn, txn->mt_env->me_pgoldest, 0)) != MDB_SUCCESS)
+					break;
+			}
+			if (rc == MDB_NOTFOUND)
+				n = 0;
+			else if (rc != MDB_SUCCESS) {
+				txn->mt_flags |= MDB_TXN_ERROR;
+				break;
+			}
+			rc = MDB_SUCCESS;
+		}
+		if (n) {
+			pgno_t *mop = txn->mt_env->me_pghead;
+			/* Stop when out of free pages below the limit, moving
+			 * pages to the end of the file would only grow it.
+			 */
+			if (mop && (!mop[0] || mop[mop[0]] >= limit) && !txn->mt_loose_pgs)
+				break;
+			/* Rewriting the item touches every page it lives on,
+			 * which copies them into free pages, lowest first.
+			 * Moving an overflow item deletes and re-adds its node,
+			 * so its key must not point into a dirty leaf.
+			 */
+			if (mc->mc_pg[mc->mc_top]->mp_flags & P_DIRTY) {
+				if (!kbuf && !(kbuf = malloc(ENV_MAXKEY(txn->mt_env)))) {
+					rc = ENOMEM;
+					break;
+				}
+				key->mv_data = memcpy(kbuf, key->mv_data, key->mv_size);
+			}
+			mp = mc->mc_pg[mc->mc_top];
+			leaf = IS_LEAF2(mp) ? NULL : NODEPTR(mp, mc->mc_ki[mc->mc_top]);
+			if (!ov && leaf && F_ISSET(leaf->mn_flags, F_BIGDATA)) {
+				/* Only the branch and leaf pages need to move,
+				 * a put would rewrite the overflow run too.
+				 */
+				if ((rc = mdb_page_spill(mc, NULL, NULL)) != MDB_SUCCESS ||
+					(rc = mdb_cursor_touch(mc)) != MDB_SUCCESS) {
+					txn->mt_flags |= MDB_TXN_ERROR;
+					break;
+				}
+			} else if ((rc = mdb_cursor_put(mc, key, &data, MDB_CURRENT)) != MDB_SUCCESS)
+				break;
+			if (mc->mc_pg[mc->mc_top]->mp_pgno >= limit)
+				break;
+			if (ov) {
+				/* The allocator may have picked a run above the
+				 * limit. That is not growth, but not a move either.
+				 */
+				pgno_t pg;
+				leaf = NODEPTR(mc->mc_pg[mc->mc_top], mc->mc_ki[mc->mc_top]);
+				memcpy(&pg, NODEDATA(leaf), sizeof(pg));
+				if (pg >= limit)
+					n -= ov;
+			}
+			moved += n;
+		} else {
+			/* Nothing to move here, skip to the next item that
+			 * could have pages of its own above the limit.
+			 */
+			mp = mc->mc_pg[mc->mc_top];
+			leaf = IS_LEAF2(mp) ? NULL : NODEPTR(mp, mc->mc_ki[mc->mc_top]);
+			if (leaf && F_ISSET(leaf->mn_flags, F_SUBDATA)) {
+				mx = &mc->mc_xcursor->mx_cursor;
+				mx->mc_ki[mx->mc_top] = NUMKEYS(mx->mc_pg[mx->mc_top]) - 1;
+			} else {
+				for (i = mc->mc_ki[mc->mc_top] + 1; i < NUMKEYS(mp); i++) {
+					pgno_t pg;
+					if (IS_LEAF2(mp))
+						continue;
+					leaf = NODEPTR(mp, i);
+					if (F_ISSET(leaf->mn_flags, F_SUBDATA))
+						break;
+					if (F_ISSET(leaf->mn_flags, F_BIGDATA)) {
+						memcpy(&pg, NODEDATA(leaf), sizeof(pg));
+						if (pg >= limit)
+							break;
+					}
+				}
+				mc->mc_ki[mc->mc_top] = i - 1;
+				op = MDB_NEXT_NODUP;
+			}
+		}
+		rc = mdb_cursor_get(mc, key, &data, op);
+	}
+	if (kbuf && rc == MDB_SUCCESS) {
+		/* Return a key that outlives kbuf */
+		rc = mdb_cursor_get(mc, key, NULL, MDB_GET_CURRENT);
+	}
+	free(kbuf);
+	*npages = moved;
+	return rc;
+}
+
 void
 mdb_cursor_close(MDB_cursor *mc)
 {
@@ -9062,6 +10077,8 @@ typedef struct mdb_copy {
 	HANDLE mc_fd;
 	int mc_toggle;			/**< Buffer number in provider */
 	int mc_new;				/**< (0-2 buffers to write) | (#MDB_EOF at end) */
+	struct mdb_pcopy *mc_pcopy;	/**< Parallel copy this is a worker of, if any */
+	pgno_t mc_wpgno;		/**< Page number of the start of #mc_wbuf[0] in a worker */
 	/** Error code.  Never cleared if set.  Both threads can set nonzero
 	 *	to fail the copy.  Not mutex-protected, LMDB expects atomic int.
 	 */
@@ -9145,7 +10162,96 @@ again:
 #undef DO_WRITE
 }
 
+#ifndef _WIN32
+	/** A page of the source to be copied by a parallel compacting copy.
+	 *	The items of a tree are kept in post-order, so the pages of the
+	 *	copy can be numbered once each item's page count is known.
+	 */
+typedef struct mdb_citem {
+	pgno_t ci_pgno;			/**< source page */
+	pgno_t ci_base;			/**< its first page number in the copy */
+	pgno_t ci_count;		/**< pages it takes in the copy */
+	/** 0 if the subtree under #ci_pgno is walked by one worker. Otherwise
+	 *	the page is a branch split among the preceding ci_span items, and
+	 *	only the page itself is copied for this item.
+	 */
+	unsigned ci_span;
+} mdb_citem;
+
+	/** A DB tree in a parallel compacting copy. */
+typedef struct mdb_ctree {
+	pgno_t ct_root;			/**< root in the source */
+	pgno_t ct_newroot;		/**< root in the copy */
+	unsigned ct_first;		/**< its first item */
+	unsigned ct_num;		/**< its number of items */
+} mdb_ctree;
+
+	/** State shared by the workers of a parallel compacting copy. */
+typedef struct mdb_pcopy {
+	MDB_env *pc_env;
+	MDB_txn *pc_txn;
+	HANDLE pc_fd;
+	off_t pc_off;			/**< file offset of page 0 of the copy */
+	pthread_mutex_t pc_mutex;
+	pthread_cond_t pc_cond;	/**< signaled when items are added or finished */
+	mdb_citem *pc_items;
+	unsigned pc_nitems, pc_maxitems;
+	unsigned pc_next;		/**< next item to hand out */
+	unsigned pc_busy;		/**< workers with an item in hand */
+	mdb_ctree *pc_trees;	/**< main DB first, then the named DBs */
+	unsigned pc_ntrees, pc_maxtrees;
+	unsigned pc_split;		/**< items wanted per tree */
+	int pc_write;			/**< 0 while counting, 1 while copying */
+	volatile int pc_error;
+} mdb_pcopy;
+
+static int mdb_env_ctree_root(mdb_pcopy *pc, pgno_t *root);
+
+	/** Write all of a buffer at the given offset. */
+static int ESECT
+mdb_env_pwrite(HANDLE fd, const char *ptr, size_t len, off_t off)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = pwrite(fd, ptr, len, off);
+		if (n < 0) {
+			if (ErrCode() == EINTR)
+				continue;
+			return ErrCode();
+		}
+		if (n == 0)
+			return EIO;
+		ptr += n;
+		len -= n;
+		off += n;
+	}
+	return MDB_SUCCESS;
+}
+
+	/** Write a parallel copy worker's buffer and any overflow page
+	 *	tail at their place in the copy.
+	 */
+static int ESECT
+mdb_env_cflush(mdb_copy *my)
+{
+	off_t off = my->mc_pcopy->pc_off + (off_t)my->mc_wpgno * my->mc_env->me_psize;
+	int rc;
+
+	rc = mdb_env_pwrite(my->mc_fd, my->mc_wbuf[0], my->mc_wlen[0], off);
+	if (rc == MDB_SUCCESS && my->mc_olen[0])
+		rc = mdb_env_pwrite(my->mc_fd, my->mc_over[0], my->mc_olen[0],
+			off + my->mc_wlen[0]);
+	my->mc_wlen[0] = my->mc_olen[0] = 0;
+	my->mc_wpgno = my->mc_next_pgno;
+	if (rc)
+		my->mc_error = rc;
+	return rc;
+}
+#endif
+
 	/** Give buffer and/or #MDB_EOF to writer thread, await unused buffer.
+	 *	A parallel copy worker writes its buffer itself instead.
 	 *
 	 * @param[in] my control structure.
 	 * @param[in] adjust (1 to hand off 1 buffer) | (MDB_EOF when ending).
@@ -9153,6 +10259,10 @@ again:
 static int ESECT
 mdb_env_cthr_toggle(mdb_copy *my, int adjust)
 {
+#ifndef _WIN32
+	if (my->mc_pcopy)
+		return mdb_env_cflush(my);
+#endif
 	pthread_mutex_lock(&my->mc_mutex);
 	my->mc_new += adjust;
 	pthread_cond_signal(&my->mc_cond);
@@ -9267,11 +10377,19 @@ mdb_env_cwalk(mdb_copy *my, pgno_t *pg, int flags)
 						}
 
 						memcpy(&db, NODEDATA(ni), sizeof(db));
-						my->mc_toggle = toggle;
-						rc = mdb_env_cwalk(my, &db.md_root, ni->mn_flags & F_DUPDATA);
+#ifndef _WIN32
+						/* Named DBs are copied separately */
+						if (my->mc_pcopy && !(ni->mn_flags & F_DUPDATA)) {
+							rc = mdb_env_ctree_root(my->mc_pcopy, &db.md_root);
+						} else
+#endif
+						{
+							my->mc_toggle = toggle;
+							rc = mdb_env_cwalk(my, &db.md_root, ni->mn_flags & F_DUPDATA);
+							toggle = my->mc_toggle;
+						}
 						if (rc)
 							goto done;
-						toggle = my->mc_toggle;
 						memcpy(NODEDATA(ni), &db, sizeof(db));
 					}
 				}
@@ -9326,9 +10444,392 @@ done:
 	return rc;
 }
 
+#ifndef _WIN32
+#ifndef MDB_CP_MAXTHREADS
+	/** Most worker threads used by #MDB_CP_PARALLEL */
+#define MDB_CP_MAXTHREADS	16
+#endif
+	/** Items wanted per tree and worker by #MDB_CP_PARALLEL */
+#define MDB_CP_SPLIT	4
+
+	/** Find the root a named DB has in a parallel compacting copy. */
+static int ESECT
+mdb_env_ctree_root(mdb_pcopy *pc, pgno_t *root)
+{
+	unsigned lo = 1, hi = pc->pc_ntrees, mid;
+
+	if (*root == P_INVALID)
+		return MDB_SUCCESS;
+	while (lo < hi) {
+		mid = (lo + hi) >> 1;
+		if (pc->pc_trees[mid].ct_root < *root)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == pc->pc_ntrees || pc->pc_trees[lo].ct_root != *root)
+		return MDB_CORRUPTED;
+	*root = pc->pc_trees[lo].ct_newroot;
+	return MDB_SUCCESS;
+}
+
+static int ESECT
+mdb_ctree_cmp(const void *a, const void *b)
+{
+	pgno_t x = ((const mdb_ctree *)a)->ct_root;
+	pgno_t y = ((const mdb_ctree *)b)->ct_root;
+	return x < y ? -1 : x > y;
+}
+
+	/** Append an item to a list. */
+static int ESECT
+mdb_citem_add(mdb_citem **items, unsigned *num, unsigned *max,
+	pgno_t pgno, unsigned span)
+{
+	mdb_citem *ci;
+
+	if (*num == *max) {
+		unsigned n = *max ? *max * 2 : 64;
+		ci = realloc(*items, n * sizeof(mdb_citem));
+		if (!ci)
+			return ENOMEM;
+		*items = ci;
+		*max = n;
+	}
+	ci = &(*items)[(*num)++];
+	ci->ci_pgno = pgno;
+	ci->ci_base = 0;
+	ci->ci_count = span ? 1 : 0;
+	ci->ci_span = span;
+	return MDB_SUCCESS;
+}
+
+	/** Split the subtree under a page into about want items, in post-order. */
+static int ESECT
+mdb_env_csplit(MDB_cursor *mc, pgno_t pg, unsigned want,
+	mdb_citem **items, unsigned *num, unsigned *max)
+{
+	MDB_page *mp;
+	unsigned i, n, start = *num;
+	int rc;
+
+	rc = mdb_page_get(mc, pg, &mp, NULL);
+	if (rc)
+		return rc;
+	n = NUMKEYS(mp);
+	if (!IS_BRANCH(mp) || want < 2 || !n)
+		return mdb_citem_add(items, num, max, pg, 0);
+	want = (want + n - 1) / n;
+	for (i=0; i<n; i++) {
+		rc = mdb_env_csplit(mc, NODEPGNO(NODEPTR(mp, i)), want, items, num, max);
+		if (rc)
+			return rc;
+	}
+	return mdb_citem_add(items, num, max, pg, *num - start);
+}
+
+	/** Split a DB tree and queue its items for the workers. */
+static int ESECT
+mdb_env_ctree_add(mdb_pcopy *pc, MDB_cursor *mc, pgno_t root)
+{
+	mdb_citem *items = NULL;
+	mdb_ctree *ct;
+	unsigned num = 0, max = 0, n;
+	int rc;
+
+	rc = mdb_env_csplit(mc, root, pc->pc_split, &items, &num, &max);
+	if (rc)
+		goto done;
+
+	pthread_mutex_lock(&pc->pc_mutex);
+	if (pc->pc_ntrees == pc->pc_maxtrees) {
+		n = pc->pc_maxtrees ? pc->pc_maxtrees * 2 : 16;
+		ct = realloc(pc->pc_trees, n * sizeof(mdb_ctree));
+		if (!ct) {
+			rc = ENOMEM;
+			goto leave;
+		}
+		pc->pc_trees = ct;
+		pc->pc_maxtrees = n;
+	}
+	if (pc->pc_nitems + num > pc->pc_maxitems) {
+		mdb_citem *ci;
+		n = (pc->pc_nitems + num) * 2;
+		ci = realloc(pc->pc_items, n * sizeof(mdb_citem));
+		if (!ci) {
+			rc = ENOMEM;
+			goto leave;
+		}
+		pc->pc_items = ci;
+		pc->pc_maxitems = n;
+	}
+	ct = &pc->pc_trees[pc->pc_ntrees++];
+	ct->ct_root = root;
+	ct->ct_newroot = P_INVALID;
+	ct->ct_first = pc->pc_nitems;
+	ct->ct_num = num;
+	memcpy(pc->pc_items + pc->pc_nitems, items, num * sizeof(mdb_citem));
+	pc->pc_nitems += num;
+	pthread_cond_broadcast(&pc->pc_cond);
+leave:
+	pthread_mutex_unlock(&pc->pc_mutex);
+done:
+	free(items);
+	return rc;
+}
+
+	/** Count the pages a subtree takes in a compacting copy, and
+	 *	queue the named DBs found in it.
+	 */
+static int ESECT
+mdb_env_ccount(mdb_pcopy *pc, MDB_cursor *mc, pgno_t pg, pgno_t *count)
+{
+	MDB_page *mp, *omp;
+	MDB_node *ni;
+	MDB_db db;
+	pgno_t opg;
+	unsigned i, n;
+	int rc;
+
+	rc = mdb_page_get(mc, pg, &mp, NULL);
+	if (rc)
+		return rc;
+	(*count)++;
+	n = NUMKEYS(mp);
+	if (IS_BRANCH(mp)) {
+		for (i=0; i<n && !pc->pc_error; i++) {
+			rc = mdb_env_ccount(pc, mc, NODEPGNO(NODEPTR(mp, i)), count);
+			if (rc)
+				return rc;
+		}
+	} else if (!IS_LEAF2(mp)) {
+		for (i=0; i<n; i++) {
+			ni = NODEPTR(mp, i);
+			if (ni->mn_flags & F_BIGDATA) {
+				/* An overwrite may have left more pages than the data needs */
+				memcpy(&opg, NODEDATA(ni), sizeof(opg));
+				rc = mdb_page_get(mc, opg, &omp, NULL);
+				if (rc)
+					return rc;
+				*count += omp->mp_pages;
+			} else if (ni->mn_flags & F_SUBDATA) {
+				memcpy(&db, NODEDATA(ni), sizeof(db));
+				if (ni->mn_flags & F_DUPDATA) {
+					*count += db.md_branch_pages + db.md_leaf_pages +
+						db.md_overflow_pages;
+				} else if (db.md_root != P_INVALID) {
+					rc = mdb_env_ctree_add(pc, mc, db.md_root);
+					if (rc)
+						return rc;
+				}
+			}
+		}
+	}
+	return MDB_SUCCESS;
+}
+
+	/** Copy one item of a parallel compacting copy. */
+static int ESECT
+mdb_env_citem_copy(mdb_copy *my, unsigned idx)
+{
+	mdb_pcopy *pc = my->mc_pcopy;
+	mdb_citem *ci = &pc->pc_items[idx], *child;
+	MDB_cursor mc = {0};
+	MDB_page *mp, *mo;
+	pgno_t pg = ci->ci_pgno;
+	unsigned i, k;
+	int rc;
+
+	my->mc_next_pgno = my->mc_wpgno = ci->ci_base;
+	if (!ci->ci_span) {
+		rc = mdb_env_cwalk(my, &pg, 0);
+		if (rc == MDB_SUCCESS)
+			rc = mdb_env_cflush(my);
+		if (rc == MDB_SUCCESS &&
+			(my->mc_next_pgno != ci->ci_base + ci->ci_count ||
+			pg != my->mc_next_pgno - 1))
+			rc = MDB_INCOMPATIBLE;	/* sub-DB page counts are off */
+		return rc;
+	}
+
+	/* A split branch page, point it at the copies of its children */
+	mc.mc_txn = my->mc_txn;
+	rc = mdb_page_get(&mc, pg, &mp, NULL);
+	if (rc)
+		return rc;
+	mo = (MDB_page *)my->mc_wbuf[0];
+	mdb_page_copy(mo, mp, my->mc_env->me_psize);
+	mo->mp_pgno = ci->ci_base;
+	for (i = NUMKEYS(mo), k = idx; i-- > 0; ) {
+		child = &pc->pc_items[--k];
+		SETPGNO(NODEPTR(mo, i), child->ci_base + child->ci_count - 1);
+		k -= child->ci_span;
+	}
+	if (k != idx - ci->ci_span)
+		return MDB_CORRUPTED;
+	my->mc_wlen[0] = my->mc_env->me_psize;
+	my->mc_next_pgno++;
+	return mdb_env_cflush(my);
+}
+
+	/** Worker thread for a parallel compacting copy. While counting,
+	 *	it takes the items that are walked, and may queue more of them.
+	 *	While copying, it takes all items.
+	 */
+static THREAD_RET ESECT CALL_CONV
+mdb_env_pcopythr(void *arg)
+{
+	mdb_pcopy *pc = arg;
+	mdb_copy my = {0};
+	MDB_cursor mc = {0};
+	pgno_t pg, count;
+	unsigned idx;
+	int rc = MDB_SUCCESS;
+
+	my.mc_env = pc->pc_env;
+	my.mc_txn = pc->pc_txn;
+	my.mc_fd = pc->pc_fd;
+	my.mc_pcopy = pc;
+	mc.mc_txn = pc->pc_txn;
+	if (pc->pc_write) {
+#ifdef HAVE_MEMALIGN
+		my.mc_wbuf[0] = memalign(pc->pc_env->me_os_psize, MDB_WBUF);
+		if (my.mc_wbuf[0] == NULL)
+			rc = errno;
+#else
+		void *p;
+		if ((rc = posix_memalign(&p, pc->pc_env->me_os_psize, MDB_WBUF)) == 0)
+			my.mc_wbuf[0] = p;
+#endif
+	}
+
+	pthread_mutex_lock(&pc->pc_mutex);
+	while (rc == MDB_SUCCESS && !pc->pc_error) {
+		if (!pc->pc_write) {
+			while (pc->pc_next < pc->pc_nitems && pc->pc_items[pc->pc_next].ci_span)
+				pc->pc_next++;
+		}
+		if (pc->pc_next == pc->pc_nitems) {
+			/* Busy workers may still find named DBs */
+			if (!pc->pc_busy)
+				break;
+			pthread_cond_wait(&pc->pc_cond, &pc->pc_mutex);
+			continue;
+		}
+		idx = pc->pc_next++;
+		pg = pc->pc_items[idx].ci_pgno;	/* items may move while counting */
+		pc->pc_busy++;
+		pthread_mutex_unlock(&pc->pc_mutex);
+		count = 0;
+		if (pc->pc_write)
+			rc = mdb_env_citem_copy(&my, idx);
+		else
+			rc = mdb_env_ccount(pc, &mc, pg, &count);
+		pthread_mutex_lock(&pc->pc_mutex);
+		if (!pc->pc_write)
+			pc->pc_items[idx].ci_count = count;
+		pc->pc_busy--;
+		pthread_cond_broadcast(&pc->pc_cond);
+	}
+	if (rc)
+		pc->pc_error = rc;
+	pthread_cond_broadcast(&pc->pc_cond);
+	pthread_mutex_unlock(&pc->pc_mutex);
+	free(my.mc_wbuf[0]);
+	return (THREAD_RET)0;
+}
+
+	/** Run one phase of a parallel compacting copy. */
+static int ESECT
+mdb_env_pcopy_run(mdb_pcopy *pc, pthread_t *thr, unsigned nthr)
+{
+	unsigned i, j;
+	int rc = MDB_SUCCESS;
+
+	pc->pc_next = 0;
+	for (i=0; i<nthr; i++) {
+		if ((rc = THREAD_CREATE(thr[i], mdb_env_pcopythr, pc)) != 0) {
+			pc->pc_error = rc;
+			break;
+		}
+	}
+	for (j=0; j<i; j++)
+		THREAD_FINISH(thr[j]);
+	return pc->pc_error;
+}
+
+	/** Compacting copy with the trees walked by parallel workers,
+	 *	all in the read-only txn of the serial copy. The subtrees are
+	 *	counted first, so that each can be given the page numbers it
+	 *	will take in the copy and be written at its place in the file.
+	 * @param[in] my control structure of the copy. Its writer thread
+	 *	still writes the meta pages.
+	 * @param[in,out] root main DB root.
+	 * @param[in] off file offset of the copy.
+	 */
+static int ESECT
+mdb_env_copypar(mdb_copy *my, pgno_t *root, off_t off)
+{
+	mdb_pcopy pc = {0};
+	MDB_cursor mc = {0};
+	pthread_t thr[MDB_CP_MAXTHREADS];
+	mdb_ctree *ct;
+	unsigned i, j, nthr;
+	long ncpu;
+	pgno_t next;
+	int rc;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	nthr = ncpu < 1 ? 1 : ncpu > MDB_CP_MAXTHREADS ? MDB_CP_MAXTHREADS : ncpu;
+	pc.pc_env = my->mc_env;
+	pc.pc_txn = my->mc_txn;
+	pc.pc_fd = my->mc_fd;
+	pc.pc_off = off;
+	pc.pc_split = nthr * MDB_CP_SPLIT;
+	if ((rc = pthread_mutex_init(&pc.pc_mutex, NULL)) != 0)
+		return rc;
+	if ((rc = pthread_cond_init(&pc.pc_cond, NULL)) != 0)
+		goto done2;
+
+	mc.mc_txn = my->mc_txn;
+	rc = mdb_env_ctree_add(&pc, &mc, *root);
+	if (rc == MDB_SUCCESS)
+		rc = mdb_env_pcopy_run(&pc, thr, nthr);
+	if (rc)
+		goto done;
+
+	/* Sort the named DBs for lookup, and number them before the
+	 * main DB so that its root is the last page.
+	 */
+	qsort(pc.pc_trees + 1, pc.pc_ntrees - 1, sizeof(mdb_ctree), mdb_ctree_cmp);
+	next = NUM_METAS;
+	for (i = 1; i <= pc.pc_ntrees; i++) {
+		ct = &pc.pc_trees[i % pc.pc_ntrees];
+		for (j = ct->ct_first; j < ct->ct_first + ct->ct_num; j++) {
+			pc.pc_items[j].ci_base = next;
+			next += pc.pc_items[j].ci_count;
+		}
+		ct->ct_newroot = next - 1;
+	}
+
+	pc.pc_write = 1;
+	rc = mdb_env_pcopy_run(&pc, thr, nthr);
+	if (rc == MDB_SUCCESS)
+		*root = pc.pc_trees[0].ct_newroot;
+
+done:
+	free(pc.pc_items);
+	free(pc.pc_trees);
+	pthread_cond_destroy(&pc.pc_cond);
+done2:
+	pthread_mutex_destroy(&pc.pc_mutex);
+	return rc;
+}
+#endif
+
 	/** Copy environment with compaction. */
 static int ESECT
-mdb_env_copyfd1(MDB_env *env, HANDLE fd)
+mdb_env_copyfd1(MDB_env *env, HANDLE fd, unsigned int flags)
 {
 	MDB_meta *mm;
 	MDB_page *mp;
@@ -9337,6 +10838,9 @@ mdb_env_copyfd1(MDB_env *env, HANDLE fd)
 	pthread_t thr;
 	pgno_t root, new_root;
 	int rc = MDB_SUCCESS;
+#ifndef _WIN32
+	off_t off;
+#endif
 
 #ifdef _WIN32
 	if (!(my.mc_mutex = CreateMutex(NULL, FALSE, NULL)) ||
@@ -9431,6 +10935,12 @@ mdb_env_copyfd1(MDB_env *env, HANDLE fd)
 
 	my.mc_wlen[0] = env->me_psize * NUM_METAS;
 	my.mc_txn = txn;
+#ifndef _WIN32
+	if ((flags & MDB_CP_PARALLEL) && root != P_INVALID &&
+		(off = lseek(fd, 0, SEEK_CUR)) != (off_t)-1)
+		rc = mdb_env_copypar(&my, &root, off);
+	else
+#endif
 	rc = mdb_env_cwalk(&my, &root, 0);
 	if (rc == MDB_SUCCESS && root != new_root) {
 		rc = MDB_INCOMPATIBLE;	/* page leak or corrupt DB */
@@ -9561,7 +11071,7 @@ int ESECT
 mdb_env_copyfd2(MDB_env *env, HANDLE fd, unsigned int flags)
 {
 	if (flags & MDB_CP_COMPACT)
-		return mdb_env_copyfd1(env, fd);
+		return mdb_env_copyfd1(env, fd, flags);
 	else
 		return mdb_env_copyfd0(env, fd);
 }
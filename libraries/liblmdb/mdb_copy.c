@@ -40,6 +40,8 @@ int main(int argc,char * argv[])
 			flags |= MDB_NOSUBDIR;
 		else if (argv[1][1] == 'c' && argv[1][2] == '\0')
 			cpflags |= MDB_CP_COMPACT;
+		else if (argv[1][1] == 'p' && argv[1][2] == '\0')
+			cpflags |= MDB_CP_COMPACT|MDB_CP_PARALLEL;
 		else if (argv[1][1] == 'V' && argv[1][2] == '\0') {
 			printf("%s\n", MDB_VERSION_STRING);
 			exit(0);
@@ -48,7 +50,7 @@ int main(int argc,char * argv[])
 	}
 
 	if (argc<2 || argc>3) {
-		fprintf(stderr, "usage: %s [-V] [-c] [-n] srcpath [dstpath]\n", progname);
+		fprintf(stderr, "usage: %s [-V] [-c] [-p] [-n] srcpath [dstpath]\n", progname);
 		exit(EXIT_FAILURE);
 	}
 
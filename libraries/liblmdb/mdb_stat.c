@@ -35,6 +35,46 @@ static void prstat(MDB_stat *ms)
 	printf("  Entries: %"Z"u\n", ms->ms_entries);
 }
 
+static int pgcmp(const void *a, const void *b)
+{
+	size_t x = *(const size_t *)a, y = *(const size_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/* Summarize how the free pages are split into contiguous runs,
+ * by powers of 2 of the run length.
+ */
+static void prfrag(size_t *pgs, size_t n)
+{
+	size_t i, j, len, runs = 0, maxrun = 0;
+	size_t cnt[64] = {0}, tot[64] = {0};
+	int b, maxb = 0;
+
+	qsort(pgs, n, sizeof(size_t), pgcmp);
+	for (i = 0; i < n; i = j) {
+		for (j = i+1; j < n && pgs[j] == pgs[j-1]+1; j++) ;
+		len = j - i;
+		for (b = 0; len >> (b+1); b++) ;
+		cnt[b]++;
+		tot[b] += len;
+		if (b > maxb)
+			maxb = b;
+		if (len > maxrun)
+			maxrun = len;
+		runs++;
+	}
+	printf("  Free runs: %"Z"u, largest %"Z"u pages\n", runs, maxrun);
+	for (b = 0; b <= maxb; b++) {
+		if (!cnt[b])
+			continue;
+		if (b)
+			printf("    %"Z"u-%"Z"u pages: %"Z"u runs, %"Z"u pages\n",
+				(size_t)1 << b, ((size_t)2 << b) - 1, cnt[b], tot[b]);
+		else
+			printf("    1 page: %"Z"u runs\n", cnt[b]);
+	}
+}
+
 static void usage(char *prog)
 {
 	fprintf(stderr, "usage: %s [-V] [-n] [-e] [-r[r]] [-f[f[f]]] [-a|-s subdb] dbpath\n", prog);
@@ -156,7 +196,7 @@ int main(int argc, char *argv[])
 	if (freinfo) {
 		MDB_cursor *cursor;
 		MDB_val key, data;
-		size_t pages = 0, *iptr;
+		size_t pages = 0, *iptr, *allpgs = NULL, nalloc = 0;
 
 		printf("Freelist Status\n");
 		dbi = 0;
@@ -173,6 +213,18 @@ int main(int argc, char *argv[])
 		prstat(&mst);
 		while ((rc = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) == 0) {
 			iptr = data.mv_data;
+			if (pages + *iptr > nalloc) {
+				size_t *p;
+				nalloc = (pages + *iptr) * 2;
+				p = realloc(allpgs, nalloc * sizeof(size_t));
+				if (!p) {
+					fprintf(stderr, "out of memory\n");
+					free(allpgs);
+					goto txn_abort;
+				}
+				allpgs = p;
+			}
+			memcpy(allpgs + pages, iptr+1, *iptr * sizeof(size_t));
 			pages += *iptr;
 			if (freinfo > 1) {
 				char *bad = "";
@@ -201,6 +253,20 @@ int main(int argc, char *argv[])
 		}
 		mdb_cursor_close(cursor);
 		printf("  Free pages: %"Z"u\n", pages);
+		if (pages) {
+			/* Sorting a large freelist takes a while, don't hold
+			 * back page reuse meanwhile.
+			 */
+			mdb_txn_reset(txn);
+			prfrag(allpgs, pages);
+			rc = mdb_txn_renew(txn);
+			if (rc) {
+				fprintf(stderr, "mdb_txn_renew failed, error %d %s\n", rc, mdb_strerror(rc));
+				free(allpgs);
+				goto txn_abort;
+			}
+		}
+		free(allpgs);
 	}
 
 	rc = mdb_open(txn, subname, 0, &dbi);
@@ -329,27 +329,17 @@ int mdb_mid2l_insert( MDB_ID2L ids, MDB_ID2 *id )
 		return -1;
 	}
 
-	if ( ids[0].mid >= MDB_IDL_UM_MAX ) {
-		/* too big */
-		return -2;
-
-	} else {
-		/* insert id */
-		ids[0].mid++;
-		for (i=(unsigned)ids[0].mid; i>x; i--)
-			ids[i] = ids[i-1];
-		ids[x] = *id;
-	}
+	/* insert id */
+	ids[0].mid++;
+	for (i=(unsigned)ids[0].mid; i>x; i--)
+		ids[i] = ids[i-1];
+	ids[x] = *id;
 
 	return 0;
 }
 
 int mdb_mid2l_append( MDB_ID2L ids, MDB_ID2 *id )
 {
-	/* Too big? */
-	if (ids[0].mid >= MDB_IDL_UM_MAX) {
-		return -2;
-	}
 	ids[0].mid++;
 	ids[ids[0].mid] = *id;
 	return 0;
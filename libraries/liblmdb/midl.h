@@ -165,6 +165,7 @@ unsigned mdb_mid2l_search( MDB_ID2L ids, MDB_ID id );
 
 
 	/** Insert an ID2 into a ID2L.
+	 * The caller must make sure the ID2L has room.
 	 * @param[in,out] ids	The ID2L to insert into.
 	 * @param[in] id	The ID2 to insert.
 	 * @return	0 on success, -1 if the ID was already present in the ID2L.
@@ -172,9 +173,10 @@ unsigned mdb_mid2l_search( MDB_ID2L ids, MDB_ID id );
 int mdb_mid2l_insert( MDB_ID2L ids, MDB_ID2 *id );
 
 	/** Append an ID2 into a ID2L.
+	 * The caller must make sure the ID2L has room.
 	 * @param[in,out] ids	The ID2L to append into.
 	 * @param[in] id	The ID2 to append.
-	 * @return	0 on success, -2 if the ID2L is too big.
+	 * @return	0 on success.
 	 */
 int mdb_mid2l_append( MDB_ID2L ids, MDB_ID2 *id );
 
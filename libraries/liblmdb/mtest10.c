@@ -0,0 +1,283 @@
+/* mtest10.c - memory-mapped database tester/toy */
+/*
+ * Copyright 2011-2020 Howard Chu, Symas Corp.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/* Online compaction: fragment a database, compact it in steps with
+ * mdb_cursor_compact() and mdb_txn_shrink(), and check that the file
+ * never grows on the way, ends up smaller, and still holds the same
+ * data.
+ *
+ * 1. Small and overflow items of random sizes, most of them deleted.
+ * 2. Big overflow items with only small holes between them, which
+ *    none of them fits in, followed by small items that do fit.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lmdb.h"
+
+#define E(expr) CHECK((rc = (expr)) == MDB_SUCCESS, #expr)
+#define RES(err, expr) ((rc = expr) == (err) || (CHECK(!rc, #expr), 0))
+#define CHECK(test, msg) ((test) ? (void)0 : ((void)fprintf(stderr, \
+	"%s:%d: %s: %s\n", __FILE__, __LINE__, msg, mdb_strerror(rc)), abort()))
+
+#define DBPATH	"./testdb/mtest10"
+#define NKEYS	3000
+#define PAGEHDRSZ	16
+
+static size_t sizes[NKEYS];
+static char *buf;
+
+static size_t
+last_pgno(MDB_env *env)
+{
+	MDB_envinfo info;
+	int rc;
+
+	E(mdb_env_info(env, &info));
+	return info.me_last_pgno;
+}
+
+static MDB_env *
+setup(MDB_dbi *dbi, unsigned int *psize)
+{
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_stat mst;
+	int rc;
+
+	unlink(DBPATH);
+	unlink(DBPATH "-lock");
+	memset(sizes, 0, sizeof(sizes));
+	E(mdb_env_create(&env));
+	E(mdb_env_set_mapsize(env, 104857600));
+	E(mdb_env_open(env, DBPATH, MDB_NOSUBDIR, 0664));
+	E(mdb_env_stat(env, &mst));
+	*psize = mst.ms_psize;
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, NULL, MDB_INTEGERKEY, dbi));
+	E(mdb_txn_commit(txn));
+	return env;
+}
+
+static void
+put(MDB_txn *txn, MDB_dbi dbi, int k, size_t size)
+{
+	MDB_val key, data;
+	int rc;
+
+	memset(buf, k, size);
+	key.mv_size = sizeof(k);
+	key.mv_data = &k;
+	data.mv_size = size;
+	data.mv_data = buf;
+	E(mdb_put(txn, dbi, &key, &data, 0));
+	sizes[k] = size;
+}
+
+static void
+del(MDB_txn *txn, MDB_dbi dbi, int k)
+{
+	MDB_val key;
+	int rc;
+
+	key.mv_size = sizeof(k);
+	key.mv_data = &k;
+	E(mdb_del(txn, dbi, &key, NULL));
+	sizes[k] = 0;
+}
+
+/* Commit a write, as an empty txn does not advance the txn ID. The
+ * pages freed by a txn are reusable after one more.
+ */
+static void
+nudge(MDB_env *env, MDB_dbi dbi, int shrink)
+{
+	MDB_txn *txn;
+	MDB_val key, data;
+	size_t released;
+	int k = NKEYS, rc;
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	key.mv_size = data.mv_size = sizeof(k);
+	key.mv_data = data.mv_data = &k;
+	E(mdb_put(txn, dbi, &key, &data, 0));
+	if (shrink)
+		E(mdb_txn_shrink(txn, &released));
+	E(mdb_txn_commit(txn));
+}
+
+static void
+verify(MDB_env *env, MDB_dbi dbi)
+{
+	MDB_txn *txn;
+	MDB_val key, data;
+	size_t i;
+	int k, rc, n = 0;
+
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	for (k = 0; k < NKEYS; k++) {
+		key.mv_size = sizeof(k);
+		key.mv_data = &k;
+		if (!sizes[k]) {
+			RES(MDB_NOTFOUND, mdb_get(txn, dbi, &key, &data));
+			continue;
+		}
+		E(mdb_get(txn, dbi, &key, &data));
+		CHECK(data.mv_size == sizes[k], "wrong size");
+		for (i = 0; i < data.mv_size; i++)
+			CHECK(((unsigned char *)data.mv_data)[i] == (unsigned char)k,
+				"wrong data");
+		n++;
+	}
+	mdb_txn_abort(txn);
+	printf("%d items read back\n", n);
+}
+
+/* Compact down to the live pages, as back-mdb does, then check */
+static void
+compact(MDB_env *env, MDB_dbi dbi)
+{
+	MDB_txn *txn;
+	MDB_cursor *cur;
+	MDB_val key, data;
+	size_t before, after, free_pgs, limit, released, high;
+	unsigned int npages, pass_moved, moved = 0;
+	int i, rc, crc, steps, passes;
+
+	nudge(env, dbi, 0);
+
+	before = last_pgno(env);
+	free_pgs = 0;
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	E(mdb_cursor_open(txn, 0, &cur));
+	while ((rc = mdb_cursor_get(cur, &key, &data, MDB_NEXT)) == 0)
+		free_pgs += *(size_t *)data.mv_data;
+	mdb_cursor_close(cur);
+	mdb_txn_abort(txn);
+	limit = before + 1 - free_pgs;
+	limit += limit / 32 + 1;
+	printf("%zu pages, %zu free, moving pages above %zu\n",
+		before + 1, free_pgs, limit);
+
+	/* Passes over the database until one moves nothing. Pages freed
+	 * by a pass only become usable for the next ones.
+	 */
+	high = before;
+	for (passes = 0, pass_moved = 1; pass_moved && passes < 20; passes++) {
+		key.mv_size = 0;
+		pass_moved = 0;
+		for (steps = 0; steps < 1000; steps++) {
+			E(mdb_txn_begin(env, NULL, 0, &txn));
+			E(mdb_cursor_open(txn, dbi, &cur));
+			npages = 64;
+			crc = mdb_cursor_compact(cur, &key, limit, &npages);
+			CHECK((rc = crc) == MDB_SUCCESS || rc == MDB_NOTFOUND,
+				"mdb_cursor_compact");
+			pass_moved += npages;
+			mdb_cursor_close(cur);
+			E(mdb_txn_shrink(txn, &released));
+			if (crc == MDB_NOTFOUND) {
+				E(mdb_txn_commit(txn));
+				break;
+			}
+			/* the key stays valid until the commit */
+			memcpy(buf, key.mv_data, key.mv_size);
+			E(mdb_txn_commit(txn));
+			key.mv_data = buf;
+			if (last_pgno(env) > high)
+				high = last_pgno(env);
+		}
+		CHECK(steps < 1000, "compaction pass did not finish");
+		if (last_pgno(env) > high)
+			high = last_pgno(env);
+		moved += pass_moved;
+	}
+	CHECK(high == before, "compaction grew the file");
+
+	/* Release the rest of the tail */
+	for (i = 0; i < 3; i++)
+		nudge(env, dbi, 1);
+	after = last_pgno(env);
+	printf("%u pages moved in %d passes, last page %zu -> %zu\n",
+		moved, passes, before, after);
+	CHECK(after < before, "compaction did not shrink the file");
+
+	verify(env, dbi);
+}
+
+static void
+fragmented(void)
+{
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	unsigned int psize;
+	int k, rc;
+
+	env = setup(&dbi, &psize);
+	/* Small items interleaved with overflow items of 2 to 8 pages */
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	for (k = 0; k < NKEYS; k++)
+		put(txn, dbi, k, k % 3 ? (size_t)(50 + rand() % 200) :
+			psize + rand() % (7 * psize));
+	E(mdb_txn_commit(txn));
+
+	/* Leave holes of all sizes */
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	for (k = 0; k < NKEYS; k++) {
+		if (rand() % 4 != 0)
+			del(txn, dbi, k);
+	}
+	E(mdb_txn_commit(txn));
+	compact(env, dbi);
+	mdb_env_close(env);
+}
+
+static void
+small_holes(void)
+{
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	unsigned int psize;
+	int k, rc;
+
+	env = setup(&dbi, &psize);
+	/* 2 and 8 page items taking turns, then 2 page items only */
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	for (k = 0; k < NKEYS / 4; k++)
+		put(txn, dbi, k, (k & 1 ? 8 : 2) * psize - PAGEHDRSZ);
+	for (; k < NKEYS / 4 + NKEYS / 10; k++)
+		put(txn, dbi, k, 2 * psize - PAGEHDRSZ);
+	E(mdb_txn_commit(txn));
+
+	/* Only 2 page holes between the 8 page items */
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	for (k = 0; k < NKEYS / 4; k += 2)
+		del(txn, dbi, k);
+	E(mdb_txn_commit(txn));
+	compact(env, dbi);
+	mdb_env_close(env);
+}
+
+int main(int argc,char * argv[])
+{
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+	buf = malloc(8 * 65536);
+	fragmented();
+	small_holes();
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,154 @@
+/* mtest7.c - memory-mapped database tester/toy */
+/*
+ * Copyright 2011-2020 Howard Chu, Symas Corp.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/* Random-read throughput under each of the mapping modes.
+ * Usage: mtest7 [entries [threads [seconds]]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "lmdb.h"
+
+#define E(expr) CHECK((rc = (expr)) == MDB_SUCCESS, #expr)
+#define RES(err, expr) ((rc = expr) == (err) || (CHECK(!rc, #expr), 0))
+#define CHECK(test, msg) ((test) ? (void)0 : ((void)fprintf(stderr, \
+	"%s:%d: %s: %s\n", __FILE__, __LINE__, msg, mdb_strerror(rc)), abort()))
+
+static struct {
+	const char *name;
+	unsigned int flags;
+} modes[] = {
+	{ "default", 0 },
+	{ "nordahead", MDB_NORDAHEAD },
+	{ "hugepage", MDB_HUGEPAGE },
+	{ "numainterleave", MDB_NUMAINTERLEAVE },
+	{ "mlockbranch", MDB_MLOCKBRANCH },
+	{ "all", MDB_HUGEPAGE|MDB_NUMAINTERLEAVE|MDB_MLOCKBRANCH },
+	{ NULL, 0 }
+};
+
+static MDB_env *env;
+static MDB_dbi dbi;
+static long count;
+static volatile int stop;
+
+static double
+now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void *
+reader(void *arg)
+{
+	long *ops = arg, n = 0, kval;
+	unsigned int seed = *ops;
+	MDB_val key, data;
+	MDB_txn *txn;
+	int rc;
+
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	key.mv_size = sizeof(kval);
+	key.mv_data = &kval;
+	while (!stop) {
+		kval = (long)(rand_r(&seed) % count);
+		E(mdb_get(txn, dbi, &key, &data));
+		n++;
+	}
+	mdb_txn_abort(txn);
+	*ops = n;
+	return NULL;
+}
+
+int main(int argc,char * argv[])
+{
+	int i, j, rc, nthreads = 4, secs = 5;
+	long kval, *ops;
+	pthread_t *tids;
+	MDB_val key, data;
+	MDB_txn *txn;
+	MDB_cursor *cursor;
+	char sval[100];
+	double t0, t1;
+
+	count = argc > 1 ? atol(argv[1]) : 1000000;
+	if (argc > 2)
+		nthreads = atoi(argv[2]);
+	if (argc > 3)
+		secs = atoi(argv[3]);
+	tids = malloc(nthreads * sizeof(pthread_t));
+	ops = malloc(nthreads * sizeof(long));
+
+	E(mdb_env_create(&env));
+	E(mdb_env_set_mapsize(env, (size_t)count * 256 + 10485760));
+	E(mdb_env_open(env, "./testdb", MDB_NOSYNC, 0664));
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, NULL, MDB_INTEGERKEY, &dbi));
+	E(mdb_drop(txn, dbi, 0));
+	E(mdb_cursor_open(txn, dbi, &cursor));
+	key.mv_size = sizeof(kval);
+	key.mv_data = &kval;
+	data.mv_size = sizeof(sval);
+	data.mv_data = sval;
+	memset(sval, 'x', sizeof(sval));
+	for (kval = 0; kval < count; kval++)
+		E(mdb_cursor_put(cursor, &key, &data, MDB_APPEND));
+	mdb_cursor_close(cursor);
+	E(mdb_txn_commit(txn));
+	mdb_env_close(env);
+
+	printf("%ld entries, %d threads, %d seconds per mode\n",
+		count, nthreads, secs);
+	for (i = 0; modes[i].name; i++) {
+		E(mdb_env_create(&env));
+		E(mdb_env_set_maxreaders(env, nthreads + 1));
+		t0 = now();
+		rc = mdb_env_open(env, "./testdb",
+			MDB_RDONLY|MDB_NOTLS|modes[i].flags, 0664);
+		t1 = now();
+		if (rc) {
+			printf("%-16s open failed: %s\n", modes[i].name, mdb_strerror(rc));
+			mdb_env_close(env);
+			continue;
+		}
+		E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+		E(mdb_dbi_open(txn, NULL, MDB_INTEGERKEY, &dbi));
+		mdb_txn_abort(txn);
+
+		stop = 0;
+		for (j = 0; j < nthreads; j++) {
+			ops[j] = j + 1;
+			pthread_create(&tids[j], NULL, reader, &ops[j]);
+		}
+		sleep(secs);
+		stop = 1;
+		kval = 0;
+		for (j = 0; j < nthreads; j++) {
+			pthread_join(tids[j], NULL);
+			kval += ops[j];
+		}
+		printf("%-16s %12.0f reads/sec  (open %.3fs)\n", modes[i].name,
+			kval / (double)secs, t1 - t0);
+		mdb_env_close(env);
+	}
+	free(ops);
+	free(tids);
+	return 0;
+}
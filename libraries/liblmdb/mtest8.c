@@ -0,0 +1,250 @@
+/* mtest8.c - memory-mapped database tester/toy */
+/*
+ * Copyright 2011-2020 Howard Chu, Symas Corp.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/* Free page run index: taking a run from the middle of a bigger one
+ * must leave the rest of the bigger run usable.
+ *
+ * Overflow values A, B, C sit next to each other. B is freed one txn
+ * before A and C, so B gets an index entry of its own before the
+ * three merge into one run. A 4-page write then takes B from the
+ * middle, and two 3-page writes must fit in what is left of A and C
+ * instead of growing the file.
+ *
+ * Runs of 32 pages or more share a size class per power of 2. Freed
+ * runs of 40 and 60 pages are in the same class; a 50-page write must
+ * find the 60-page run and a 40-page write the other one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lmdb.h"
+
+#define E(expr) CHECK((rc = (expr)) == MDB_SUCCESS, #expr)
+#define RES(err, expr) ((rc = expr) == (err) || (CHECK(!rc, #expr), 0))
+#define CHECK(test, msg) ((test) ? (void)0 : ((void)fprintf(stderr, \
+	"%s:%d: %s: %s\n", __FILE__, __LINE__, msg, mdb_strerror(rc)), abort()))
+
+#define PAGEHDRSZ	16
+
+static unsigned int psize;
+
+/* Store a value of exactly npages overflow pages */
+static void
+put(MDB_txn *txn, MDB_dbi dbi, const char *k, int npages)
+{
+	MDB_val key, data;
+	int rc;
+
+	key.mv_size = strlen(k);
+	key.mv_data = (void *)k;
+	data.mv_size = npages * psize - PAGEHDRSZ;
+	data.mv_data = malloc(data.mv_size);
+	memset(data.mv_data, k[0], data.mv_size);
+	E(mdb_put(txn, dbi, &key, &data, 0));
+	free(data.mv_data);
+}
+
+static void
+del(MDB_txn *txn, MDB_dbi dbi, const char *k)
+{
+	MDB_val key;
+	int rc;
+
+	key.mv_size = strlen(k);
+	key.mv_data = (void *)k;
+	E(mdb_del(txn, dbi, &key, NULL));
+}
+
+static void
+check(MDB_txn *txn, MDB_dbi dbi, const char *k, int npages)
+{
+	MDB_val key, data;
+	size_t i;
+	int rc;
+
+	key.mv_size = strlen(k);
+	key.mv_data = (void *)k;
+	E(mdb_get(txn, dbi, &key, &data));
+	CHECK(data.mv_size == npages * psize - PAGEHDRSZ, k);
+	for (i = 0; i < data.mv_size; i++)
+		CHECK(((char *)data.mv_data)[i] == k[0], k);
+}
+
+/* Run the scenario, with or without the two writes that should
+ * reuse the remainders. Returns the last page number in use.
+ */
+static size_t
+scenario(const char *path, int tail)
+{
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_stat mst;
+	MDB_envinfo info;
+	MDB_val key, data;
+	char lock[64];
+	int rc;
+
+	unlink(path);
+	snprintf(lock, sizeof(lock), "%s-lock", path);
+	unlink(lock);
+
+	E(mdb_env_create(&env));
+	E(mdb_env_set_mapsize(env, 10485760));
+	E(mdb_env_open(env, path, MDB_NOSUBDIR, 0664));
+	E(mdb_env_stat(env, &mst));
+	psize = mst.ms_psize;
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, NULL, 0, &dbi));
+	put(txn, dbi, "pad", 4);	/* feeds the single page allocations */
+	put(txn, dbi, "sep1", 2);
+	put(txn, dbi, "low", 12);
+	put(txn, dbi, "sep2", 2);
+	put(txn, dbi, "A", 3);
+	put(txn, dbi, "B", 4);
+	put(txn, dbi, "C", 3);
+	put(txn, dbi, "top", 2);	/* keeps the file from shrinking */
+	E(mdb_txn_commit(txn));
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	del(txn, dbi, "pad");
+	del(txn, dbi, "low");
+	del(txn, dbi, "B");
+	E(mdb_txn_commit(txn));
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	del(txn, dbi, "A");
+	del(txn, dbi, "C");
+	E(mdb_txn_commit(txn));
+
+	/* Pages freed by the last txn are still in use by its meta */
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	key.mv_size = data.mv_size = 1;
+	key.mv_data = data.mv_data = "x";
+	E(mdb_put(txn, dbi, &key, &data, 0));
+	E(mdb_txn_commit(txn));
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	put(txn, dbi, "y", 12);		/* indexes B alone, takes low */
+	put(txn, dbi, "w", 13);		/* merges A, C; grows the file */
+	put(txn, dbi, "z", 4);		/* takes B out of A+B+C */
+	if (tail) {
+		put(txn, dbi, "v", 3);
+		put(txn, dbi, "u", 3);
+	}
+	E(mdb_txn_commit(txn));
+
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	check(txn, dbi, "sep1", 2);
+	check(txn, dbi, "sep2", 2);
+	check(txn, dbi, "top", 2);
+	check(txn, dbi, "y", 12);
+	check(txn, dbi, "w", 13);
+	check(txn, dbi, "z", 4);
+	if (tail) {
+		check(txn, dbi, "v", 3);
+		check(txn, dbi, "u", 3);
+	}
+	mdb_txn_abort(txn);
+
+	E(mdb_env_info(env, &info));
+	mdb_env_close(env);
+	return info.me_last_pgno;
+}
+
+/* Free two long runs of the same size class, then write values that
+ * fit in them if tail is set. Returns the last page number in use.
+ */
+static size_t
+scenario_long(const char *path, int tail)
+{
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_stat mst;
+	MDB_envinfo info;
+	MDB_val key, data;
+	char lock[64];
+	int rc;
+
+	unlink(path);
+	snprintf(lock, sizeof(lock), "%s-lock", path);
+	unlink(lock);
+
+	E(mdb_env_create(&env));
+	E(mdb_env_set_mapsize(env, 10485760));
+	E(mdb_env_open(env, path, MDB_NOSUBDIR, 0664));
+	E(mdb_env_stat(env, &mst));
+	psize = mst.ms_psize;
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, NULL, 0, &dbi));
+	put(txn, dbi, "pad", 4);
+	put(txn, dbi, "forty", 40);
+	put(txn, dbi, "sep", 2);
+	put(txn, dbi, "sixty", 60);
+	put(txn, dbi, "top", 2);
+	E(mdb_txn_commit(txn));
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	del(txn, dbi, "pad");
+	del(txn, dbi, "forty");
+	del(txn, dbi, "sixty");
+	E(mdb_txn_commit(txn));
+
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	key.mv_size = data.mv_size = 1;
+	key.mv_data = data.mv_data = "x";
+	E(mdb_put(txn, dbi, &key, &data, 0));
+	E(mdb_txn_commit(txn));
+
+	if (tail) {
+		E(mdb_txn_begin(env, NULL, 0, &txn));
+		put(txn, dbi, "fifty", 50);
+		put(txn, dbi, "40", 40);
+		E(mdb_txn_commit(txn));
+
+		E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+		check(txn, dbi, "fifty", 50);
+		check(txn, dbi, "40", 40);
+		check(txn, dbi, "sep", 2);
+		check(txn, dbi, "top", 2);
+		mdb_txn_abort(txn);
+	}
+
+	E(mdb_env_info(env, &info));
+	mdb_env_close(env);
+	return info.me_last_pgno;
+}
+
+int main(int argc,char * argv[])
+{
+	size_t without, with;
+	int rc = 0;
+
+	without = scenario("./testdb/mtest8a", 0);
+	with = scenario("./testdb/mtest8b", 1);
+	printf("last page without remainder writes %zu, with %zu\n",
+		without, with);
+	CHECK(with == without, "remainder writes grew the file");
+
+	without = scenario_long("./testdb/mtest8a", 0);
+	with = scenario_long("./testdb/mtest8b", 1);
+	printf("last page without long run writes %zu, with %zu\n",
+		without, with);
+	CHECK(with == without, "long run writes grew the file");
+	return 0;
+}
@@ -0,0 +1,292 @@
+/* mtest9.c - memory-mapped database tester/toy */
+/*
+ * Copyright 2011-2020 Howard Chu, Symas Corp.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/* Crashes inside the group commit window.
+ *
+ * The writes and syncs of the library are intercepted to keep track of
+ * what a system crash could leave on disk. Synced writes and writes
+ * through the O_DSYNC fd are durable; any other write may or may not
+ * have reached the disk. After each commit made with MDB_NOMETASYNC,
+ * and some mdb_env_sync_txn() calls, two crash images are checked:
+ *
+ * 1. All the unsynced meta page writes reached the disk, none of the
+ *    data page writes did. This is a crash between the data writes
+ *    and the meta write of a commit that did not order them.
+ * 2. All the unsynced data page writes reached the disk, none of the
+ *    meta page writes did.
+ *
+ * Each image must open at a committed txn, with that txn's values.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "lmdb.h"
+
+#define E(expr) CHECK((rc = (expr)) == MDB_SUCCESS, #expr)
+#define RES(err, expr) ((rc = expr) == (err) || (CHECK(!rc, #expr), 0))
+#define CHECK(test, msg) ((test) ? (void)0 : ((void)fprintf(stderr, \
+	"%s:%d: %s: %s\n", __FILE__, __LINE__, msg, mdb_strerror(rc)), abort()))
+
+#define DBPATH	"./testdb/mtest9"
+#define IMGPATH	"./testdb/mtest9.crash"
+#define NVALS	64
+#define NTXNS	200
+
+/* The data file being tracked, 0 if none */
+static ino_t db_ino;
+static size_t psize;
+/* Durable data pages plus all the meta page writes */
+static char *img;
+static size_t img_size;
+/* Durable meta pages */
+static char *metas;
+/* Values of each committed txn */
+static char expect[NTXNS + 8][NVALS];
+
+static int
+tracked(int fd)
+{
+	struct stat st;
+
+	return db_ino && !fstat(fd, &st) && st.st_ino == db_ino;
+}
+
+static void
+load(int fd)
+{
+	struct stat st;
+	ssize_t n;
+	size_t off;
+
+	fstat(fd, &st);
+	img_size = st.st_size;
+	img = realloc(img, img_size);
+	for (off = 0; off < img_size; off += n) {
+		n = pread(fd, img + off, img_size - off, off);
+		if (n <= 0)
+			abort();
+	}
+	memcpy(metas, img, 2 * psize);
+}
+
+static void
+apply(char *dst, size_t dsize, const void *buf, size_t n, off_t off)
+{
+	if ((size_t)off < dsize)
+		memcpy(dst + off, buf, n < dsize - off ? n : dsize - off);
+}
+
+ssize_t
+pwrite(int fd, const void *buf, size_t n, off_t off)
+{
+	ssize_t rc = syscall(SYS_pwrite64, fd, buf, n, off);
+
+	if (rc > 0 && tracked(fd)) {
+		if (fcntl(fd, F_GETFL) & O_DSYNC) {
+			apply(img, img_size, buf, rc, off);
+			apply(metas, 2 * psize, buf, rc, off);
+		} else if ((size_t)off < 2 * psize) {
+			apply(img, img_size, buf, rc, off);
+		}
+	}
+	return rc;
+}
+
+int
+fdatasync(int fd)
+{
+	int rc = syscall(SYS_fdatasync, fd);
+
+	if (!rc && tracked(fd))
+		load(fd);
+	return rc;
+}
+
+int
+fsync(int fd)
+{
+	int rc = syscall(SYS_fsync, fd);
+
+	if (!rc && tracked(fd))
+		load(fd);
+	return rc;
+}
+
+static void
+put(MDB_txn *txn, MDB_dbi dbi, int k, char fill, size_t size)
+{
+	MDB_val key, data;
+	int rc;
+
+	key.mv_size = sizeof(k);
+	key.mv_data = &k;
+	data.mv_size = size;
+	data.mv_data = malloc(size);
+	memset(data.mv_data, fill, size);
+	E(mdb_put(txn, dbi, &key, &data, 0));
+	free(data.mv_data);
+}
+
+/* Every value is filled with one byte, the one of its txn */
+static void
+verify(const char *path)
+{
+	MDB_env *env;
+	MDB_envinfo info;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_cursor *cur;
+	MDB_val key, data;
+	char *want;
+	size_t i;
+	int rc, n = 0, k;
+
+	E(mdb_env_create(&env));
+	E(mdb_env_set_mapsize(env, 104857600));
+	E(mdb_env_open(env, path, MDB_NOSUBDIR|MDB_RDONLY|MDB_NOLOCK, 0664));
+	E(mdb_env_info(env, &info));
+	CHECK(info.me_last_txnid < NTXNS + 8, "txnid out of range");
+	want = expect[info.me_last_txnid];
+	E(mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	E(mdb_dbi_open(txn, NULL, 0, &dbi));
+	E(mdb_cursor_open(txn, dbi, &cur));
+	while ((rc = mdb_cursor_get(cur, &key, &data, MDB_NEXT)) == 0) {
+		char c = *(char *)data.mv_data;
+		for (i = 1; i < data.mv_size; i++)
+			CHECK(((char *)data.mv_data)[i] == c, "value overwritten");
+		k = *(int *)key.mv_data;
+		CHECK(k >= 0 && k < NVALS && c == want[k], "wrong value");
+		n++;
+	}
+	CHECK(rc == MDB_NOTFOUND, "mdb_cursor_get");
+	for (k = 0; k < NVALS; k++)
+		n -= want[k] != 0;
+	CHECK(n == 0, "entries lost");
+	mdb_cursor_close(cur);
+	mdb_txn_abort(txn);
+	mdb_env_close(env);
+}
+
+static void
+write_image(const char *src, size_t size)
+{
+	FILE *f;
+	int rc = 0;
+
+	CHECK((f = fopen(IMGPATH, "wb")) != NULL, "fopen");
+	CHECK(fwrite(src, 1, size, f) == size, "fwrite");
+	fclose(f);
+}
+
+static void
+crash(void)
+{
+	FILE *f;
+	char *cur;
+	struct stat st;
+	int rc = 0;
+
+	/* 1. the metas got ahead of the data */
+	write_image(img, img_size);
+	verify(IMGPATH);
+
+	/* 2. the data got ahead of the metas */
+	CHECK(!stat(DBPATH, &st), "stat");
+	cur = malloc(st.st_size);
+	CHECK((f = fopen(DBPATH, "rb")) != NULL, "fopen");
+	CHECK(fread(cur, 1, st.st_size, f) == (size_t)st.st_size, "fread");
+	fclose(f);
+	memcpy(cur, metas, 2 * psize);
+	write_image(cur, st.st_size);
+	free(cur);
+	verify(IMGPATH);
+}
+
+int main(int argc,char * argv[])
+{
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	MDB_stat mst;
+	struct stat st;
+	unsigned int seed = argc > 1 ? atoi(argv[1]) : 9;
+	size_t id;
+	int i, j, k, rc, fd, syncs = 0;
+
+	unlink(DBPATH);
+	unlink(DBPATH "-lock");
+	E(mdb_env_create(&env));
+	E(mdb_env_set_mapsize(env, 104857600));
+	E(mdb_env_open(env, DBPATH, MDB_NOSUBDIR, 0664));
+	E(mdb_env_stat(env, &mst));
+	psize = mst.ms_psize;
+	metas = malloc(2 * psize);
+
+	/* A first durable txn */
+	E(mdb_txn_begin(env, NULL, 0, &txn));
+	E(mdb_dbi_open(txn, NULL, 0, &dbi));
+	id = mdb_txn_id(txn);
+	CHECK(id < 8, "txnid");
+	for (k = 0; k < NVALS; k++) {
+		expect[id][k] = 'a';
+		put(txn, dbi, k, 'a', 3 * psize);
+	}
+	E(mdb_txn_commit(txn));
+
+	CHECK(!stat(DBPATH, &st), "stat");
+	CHECK((fd = open(DBPATH, O_RDONLY)) >= 0, "open");
+	load(fd);
+	close(fd);
+	db_ino = st.st_ino;
+
+	/* Overwrite, delete and grow values, so that commits reuse the
+	 * pages freed by earlier ones and extend the file.
+	 */
+	for (j = 0; j < NTXNS; j++) {
+		E(mdb_txn_begin(env, NULL, MDB_NOMETASYNC, &txn));
+		id = mdb_txn_id(txn);
+		memcpy(expect[id], expect[id - 1], NVALS);
+		for (i = 0; i < 8; i++) {
+			k = rand_r(&seed) % NVALS;
+			if (rand_r(&seed) % 4 == 0) {
+				MDB_val key;
+				key.mv_size = sizeof(k);
+				key.mv_data = &k;
+				RES(MDB_NOTFOUND, mdb_del(txn, dbi, &key, NULL));
+				expect[id][k] = 0;
+			} else {
+				expect[id][k] = 'a' + rand_r(&seed) % 26;
+				put(txn, dbi, k, expect[id][k],
+					1 + rand_r(&seed) % (4 * psize));
+			}
+		}
+		E(mdb_txn_commit(txn));
+		crash();
+		if (rand_r(&seed) % 8 == 0) {
+			E(mdb_env_sync_txn(env, id, 0));
+			syncs++;
+			crash();
+		}
+	}
+	mdb_env_close(env);
+	db_ino = 0;
+	printf("%d commits, %d group syncs: every crash image consistent\n",
+		NTXNS, syncs);
+	unlink(IMGPATH);
+	return 0;
+}
@@ -106,6 +106,7 @@ typedef struct bm_context_t {
 	int                     *nretries;  /* number of times to retry a failed send on an msc */
 	struct berval	        c_peer_name; /* peer name of original op->o_conn*/
 	SlapReply               *candidates;
+	struct timespec		*bc_sent;	/* when the request was sent to each target */
 } bm_context_t;
 
 typedef struct a_metasingleconn_t {
@@ -333,16 +334,19 @@ typedef struct a_metatarget_t {
 #define META_BACK_CFG_MAX_TIMEOUT_LOOP          0x70000
 	slap_mask_t		mt_rep_flags;
 	int                     mt_timeout_ops;
+	/* response time estimate in usec, see asyncmeta_target_latency() */
+	ldap_pvt_thread_mutex_t	mt_latency_mutex;
+	long			mt_latency;
+	long			mt_latency_dev;
+	time_t			mt_latency_time;
+#define META_LATENCY_MAX	(60 * 1000000L)
+/* seconds without a sample that halve the estimate */
+#define META_LATENCY_HALFLIFE	10
 } a_metatarget_t;
 
-typedef struct a_metadncache_t {
-	ldap_pvt_thread_mutex_t mutex;
-	Avlnode			*tree;
-
-#define META_DNCACHE_DISABLED   (0)
-#define META_DNCACHE_FOREVER    ((time_t)(-1))
-	time_t			ttl;  /* seconds; 0: no cache, -1: no expiry */
-} a_metadncache_t;
+/* the dn cache is shared with back-meta; see back-ldap/dncache.c */
+#define META_DNCACHE_DISABLED   LDAP_DNCACHE_DISABLED
+#define META_DNCACHE_FOREVER    LDAP_DNCACHE_FOREVER
 
 typedef struct a_metacandidates_t {
 	int			mc_ntargets;
@@ -376,7 +380,7 @@ typedef struct a_metainfo_t {
 	LDAP_REBIND_PROC	*mi_rebind_f;
 	LDAP_URLLIST_PROC	*mi_urllist_f;
 
-	a_metadncache_t		mi_cache;
+	ldap_dncache_t		mi_cache;
 
 	struct {
 		int						mic_num;
@@ -397,6 +401,7 @@ typedef struct a_metainfo_t {
 #define	META_BACK_F_PROXYAUTHZ_ALWAYS	(0x08000000U)	/* users always proxyauthz */
 #define	META_BACK_F_PROXYAUTHZ_ANON	(0x10000000U)	/* anonymous always proxyauthz */
 #define	META_BACK_F_PROXYAUTHZ_NOANON	(0x20000000U)	/* anonymous remains anonymous */
+#define	META_BACK_F_LATENCY_ROUTING	(0x40000000U)
 
 #define	META_BACK_ONERR_STOP(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_ONERR_STOP )
 #define	META_BACK_ONERR_REPORT(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_ONERR_REPORT )
@@ -406,6 +411,7 @@ typedef struct a_metainfo_t {
 #define META_BACK_PROXYAUTHZ_ALWAYS(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_PROXYAUTHZ_ALWAYS )
 #define META_BACK_PROXYAUTHZ_ANON(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_PROXYAUTHZ_ANON )
 #define META_BACK_PROXYAUTHZ_NOANON(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_PROXYAUTHZ_NOANON )
+#define META_BACK_LATENCY_ROUTING(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_LATENCY_ROUTING )
 
 #define META_BACK_QUARANTINE(mi)	LDAP_BACK_ISSET( (mi), LDAP_BACK_F_QUARANTINE )
 
@@ -526,6 +532,17 @@ asyncmeta_select_unique_candidate(
 	a_metainfo_t		*mi,
 	struct berval		*ndn );
 
+extern void
+asyncmeta_select_replicas(
+	a_metainfo_t		*mi,
+	int			*selected );
+
+extern int
+asyncmeta_next_replica(
+	a_metainfo_t		*mi,
+	int			candidate,
+	SlapReply		*candidates );
+
 extern int
 asyncmeta_clear_unused_candidates(
 	Operation		*op,
@@ -533,39 +550,8 @@ asyncmeta_clear_unused_candidates(
 	a_metaconn_t            *mc,
 	SlapReply	*candidates);
 
-/*
- * Dn cache stuff (experimental)
- */
-extern int
-asyncmeta_dncache_cmp(
-	const void		*c1,
-	const void		*c2 );
-
-extern int
-asyncmeta_dncache_dup(
-	void			*c1,
-	void			*c2 );
-
-#define META_TARGET_NONE	(-1)
+#define META_TARGET_NONE	LDAP_DNCACHE_TARGET_NONE
 #define META_TARGET_MULTIPLE	(-2)
-extern int
-asyncmeta_dncache_get_target(
-	a_metadncache_t		*cache,
-	struct berval		*ndn );
-
-extern int
-meta_dncache_update_entry(
-	a_metadncache_t		*cache,
-	struct berval		*ndn,
-	int			target );
-
-extern int
-asyncmeta_dncache_delete_entry(
-	a_metadncache_t		*cache,
-	struct berval		*ndn );
-
-extern void
-asyncmeta_dncache_free( void *entry );
 
 extern int
 asyncmeta_subtree_destroy( a_metasubtree_t *ms );
@@ -605,6 +591,10 @@ Operation* asyncmeta_copy_op(Operation *op);
 void asyncmeta_clear_bm_context(bm_context_t *bc);
 
 int asyncmeta_add_message_queue(a_metaconn_t *mc, bm_context_t *bc);
+void asyncmeta_target_sent(bm_context_t *bc, int candidate);
+void asyncmeta_target_latency(a_metatarget_t *mt, bm_context_t *bc, int candidate);
+void asyncmeta_target_failed(a_metatarget_t *mt);
+long asyncmeta_target_score(a_metatarget_t *mt, time_t now);
 void asyncmeta_drop_bc(a_metaconn_t *mc, bm_context_t *bc);
 void asyncmeta_drop_bc_from_fconn(bm_context_t *bc);
 
@@ -745,10 +735,6 @@ void asyncmeta_log_conns(a_metainfo_t *mi);
 
 void asyncmeta_get_timestamp(char *buf);
 
-int
-asyncmeta_dncache_update_entry(a_metadncache_t	*cache,
-			       struct berval	*ndn,
-			       int 		target );
 
 void
 asyncmeta_dnattr_result_rewrite(a_dncookie		*dc,
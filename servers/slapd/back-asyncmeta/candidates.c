@@ -213,6 +213,123 @@ asyncmeta_select_unique_candidate(
 	return candidate;
 }
 
+/*
+ * targets with the same naming context and no subtree or filter
+ * restrictions hold the same data, as far as latency-routing is
+ * concerned
+ */
+static int
+asyncmeta_is_replica(
+	a_metatarget_t	*mt1,
+	a_metatarget_t	*mt2 )
+{
+	return mt1->mt_subtree == NULL && mt2->mt_subtree == NULL
+		&& mt1->mt_filter == NULL && mt2->mt_filter == NULL
+		&& mt1->mt_scope == mt2->mt_scope
+		&& dn_match( &mt1->mt_nsuffix, &mt2->mt_nsuffix );
+}
+
+/*
+ * asyncmeta_select_replicas
+ *
+ * with latency-routing, sets selected[ i ] to the replica of target i
+ * that is expected to answer first, see asyncmeta_target_score().
+ * Quarantined replicas are only used if no other is available.
+ */
+void
+asyncmeta_select_replicas(
+	a_metainfo_t	*mi,
+	int		*selected )
+{
+	int		i, j;
+	time_t		now = slap_get_time();
+
+	for ( i = 0; i < mi->mi_ntargets; i++ ) {
+		selected[ i ] = -1;
+	}
+
+	for ( i = 0; i < mi->mi_ntargets; i++ ) {
+		a_metatarget_t	*mt = mi->mi_targets[ i ];
+		int		best = i, quarantined;
+		long		score;
+
+		if ( selected[ i ] != -1 ) {
+			continue;
+		}
+
+		quarantined = ( mt->mt_isquarantined != LDAP_BACK_FQ_NO );
+		score = asyncmeta_target_score( mt, now );
+		for ( j = i + 1; j < mi->mi_ntargets; j++ ) {
+			a_metatarget_t	*rt = mi->mi_targets[ j ];
+			int		q;
+			long		s;
+
+			if ( selected[ j ] != -1 || !asyncmeta_is_replica( mt, rt ) ) {
+				continue;
+			}
+
+			q = ( rt->mt_isquarantined != LDAP_BACK_FQ_NO );
+			s = asyncmeta_target_score( rt, now );
+			if ( q < quarantined || ( q == quarantined && s < score ) ) {
+				best = j;
+				quarantined = q;
+				score = s;
+			}
+		}
+
+		for ( j = i; j < mi->mi_ntargets; j++ ) {
+			a_metatarget_t	*rt = mi->mi_targets[ j ];
+
+			if ( j != i && ( selected[ j ] != -1 || !asyncmeta_is_replica( mt, rt ) ) ) {
+				continue;
+			}
+
+			selected[ j ] = best;
+		}
+	}
+}
+
+/*
+ * asyncmeta_next_replica
+ *
+ * returns the best replica of candidate that has not been tried
+ * yet by the operation, or -1
+ */
+int
+asyncmeta_next_replica(
+	a_metainfo_t	*mi,
+	int		candidate,
+	SlapReply	*candidates )
+{
+	a_metatarget_t	*mt = mi->mi_targets[ candidate ];
+	int		j, best = -1, quarantined = 0;
+	long		score = 0;
+
+	for ( j = 0; j < mi->mi_ntargets; j++ ) {
+		a_metatarget_t	*rt = mi->mi_targets[ j ];
+		int		q;
+		long		s;
+
+		if ( j == candidate
+			|| META_IS_CANDIDATE( &candidates[ j ] )
+			|| candidates[ j ].sr_msgid != META_MSGID_UNDEFINED
+			|| !asyncmeta_is_replica( mt, rt ) )
+		{
+			continue;
+		}
+
+		q = ( rt->mt_isquarantined != LDAP_BACK_FQ_NO );
+		s = asyncmeta_target_score( rt, slap_get_time() );
+		if ( best == -1 || q < quarantined || ( q == quarantined && s < score ) ) {
+			best = j;
+			quarantined = q;
+			score = s;
+		}
+	}
+
+	return best;
+}
+
 /*
  * asyncmeta_clear_unused_candidates
  *
@@ -59,6 +59,8 @@ enum {
 	LDAP_BACK_CFG_MAX_TIMEOUT_OPS,
 	LDAP_BACK_CFG_MAX_PENDING_OPS,
 	LDAP_BACK_CFG_MAX_TARGET_CONNS,
+	LDAP_BACK_CFG_LATENCY_ROUTING,
+	LDAP_BACK_CFG_DNCACHE_SIZE,
 	LDAP_BACK_CFG_LAST_BASE,
 };
 
@@ -281,6 +283,15 @@ static ConfigTable a_metacfg[] = {
 			"SYNTAX OMsDirectoryString "
 			"SINGLE-VALUE )",
 		NULL, NULL },
+	{ "dncache-size", "entries", 2, 2, 0,
+		ARG_MAGIC|ARG_ULONG|LDAP_BACK_CFG_DNCACHE_SIZE,
+		asyncmeta_back_cf_gen, "( OLcfgDbAt:3.120 "
+			"NAME 'olcDbDnCacheSize' "
+			"DESC 'max number of entries in the dncache' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger "
+			"SINGLE-VALUE )",
+		NULL, NULL },
 	{ "bind-timeout", "microseconds", 2, 2, 0,
 		ARG_MAGIC|ARG_ULONG|LDAP_BACK_CFG_BIND_TIMEOUT,
 		asyncmeta_back_cf_gen, "( OLcfgDbAt:3.107 "
@@ -377,6 +388,15 @@ static ConfigTable a_metacfg[] = {
 	  "SINGLE-VALUE )",
 	  NULL, NULL },
 
+	{ "latency-routing", "true|FALSE", 2, 2, 0,
+	  ARG_MAGIC|ARG_ON_OFF|LDAP_BACK_CFG_LATENCY_ROUTING,
+	  asyncmeta_back_cf_gen, "( OLcfgDbAt:3.118 "
+	  "NAME 'olcDbLatencyRouting' "
+	  "DESC 'Route reads to the replica expected to answer first' "
+	  "SYNTAX OMsBoolean "
+	  "SINGLE-VALUE )",
+	  NULL, NULL },
+
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED,
 		NULL, NULL, NULL, NULL }
 };
@@ -410,6 +430,7 @@ static ConfigOCs a_metaocs[] = {
 		"DESC 'Asyncmeta backend configuration' "
 		"SUP olcDatabaseConfig "
 		"MAY ( olcDbDnCacheTtl "
+			"$ olcDbDnCacheSize "
 			"$ olcDbIdleTimeout "
 			"$ olcDbOnErr "
 			"$ olcDbPseudoRootBindDefer "
@@ -417,6 +438,7 @@ static ConfigOCs a_metaocs[] = {
 	                "$ olcDbMaxTimeoutOps"
 	                "$ olcDbMaxPendingOps "
 	                "$ olcDbMaxTargetConns"
+	                "$ olcDbLatencyRouting "
 			/* defaults, may be overridden per-target */
 			COMMON_ATTRS
 		") )",
@@ -484,6 +506,7 @@ asyncmeta_back_new_target(
 	mt = ch_calloc( sizeof( a_metatarget_t ), 1 );
 
 	ldap_pvt_thread_mutex_init( &mt->mt_uri_mutex );
+	ldap_pvt_thread_mutex_init( &mt->mt_latency_mutex );
 
 	mt->mt_idassert_mode = LDAP_BACK_IDASSERT_LEGACY;
 	mt->mt_idassert_authmethod = LDAP_AUTH_NONE;
@@ -1022,19 +1045,23 @@ asyncmeta_back_cf_gen( ConfigArgs *c )
 		/* Base attrs */
 
 		case LDAP_BACK_CFG_DNCACHE_TTL:
-			if ( mi->mi_cache.ttl == META_DNCACHE_DISABLED ) {
+			if ( mi->mi_cache.dc_ttl == META_DNCACHE_DISABLED ) {
 				return 1;
-			} else if ( mi->mi_cache.ttl == META_DNCACHE_FOREVER ) {
+			} else if ( mi->mi_cache.dc_ttl == META_DNCACHE_FOREVER ) {
 				BER_BVSTR( &bv, "forever" );
 			} else {
 				char	buf[ SLAP_TEXT_BUFLEN ];
 
-				lutil_unparse_time( buf, sizeof( buf ), mi->mi_cache.ttl );
+				lutil_unparse_time( buf, sizeof( buf ), mi->mi_cache.dc_ttl );
 				ber_str2bv( buf, 0, 0, &bv );
 			}
 			value_add_one( &c->rvalue_vals, &bv );
 			break;
 
+		case LDAP_BACK_CFG_DNCACHE_SIZE:
+			c->value_ulong = mi->mi_cache.dc_size;
+			break;
+
 		case LDAP_BACK_CFG_IDLE_TIMEOUT:
 			if ( mi->mi_idle_timeout == 0 ) {
 				return 1;
@@ -1060,6 +1087,10 @@ asyncmeta_back_cf_gen( ConfigArgs *c )
 			c->value_int = META_BACK_DEFER_ROOTDN_BIND( mi );
 			break;
 
+		case LDAP_BACK_CFG_LATENCY_ROUTING:
+			c->value_int = META_BACK_LATENCY_ROUTING( mi );
+			break;
+
 		case LDAP_BACK_CFG_CONNPOOLMAX:
 			c->value_int = mi->mi_conn_priv_max;
 			break;
@@ -1508,7 +1539,11 @@ asyncmeta_back_cf_gen( ConfigArgs *c )
 		switch( c->type ) {
 		/* Base attrs */
 		case LDAP_BACK_CFG_DNCACHE_TTL:
-			mi->mi_cache.ttl = META_DNCACHE_DISABLED;
+			mi->mi_cache.dc_ttl = META_DNCACHE_DISABLED;
+			break;
+
+		case LDAP_BACK_CFG_DNCACHE_SIZE:
+			mi->mi_cache.dc_size = LDAP_DNCACHE_SIZE_DEFAULT;
 			break;
 
 		case LDAP_BACK_CFG_IDLE_TIMEOUT:
@@ -1523,6 +1558,10 @@ asyncmeta_back_cf_gen( ConfigArgs *c )
 			mi->mi_flags &= ~META_BACK_F_DEFER_ROOTDN_BIND;
 			break;
 
+		case LDAP_BACK_CFG_LATENCY_ROUTING:
+			mi->mi_flags &= ~META_BACK_F_LATENCY_ROUTING;
+			break;
+
 		case LDAP_BACK_CFG_CONNPOOLMAX:
 			mi->mi_conn_priv_max = LDAP_BACK_CONN_PRIV_MIN;
 			break;
@@ -2057,13 +2096,18 @@ asyncmeta_back_cf_gen( ConfigArgs *c )
 		}
 		break;
 
+	case LDAP_BACK_CFG_DNCACHE_SIZE:
+	/* max number of entries in dn cache; 0 means unbounded */
+		mi->mi_cache.dc_size = c->value_ulong;
+		break;
+
 	case LDAP_BACK_CFG_DNCACHE_TTL:
 	/* ttl of dn cache */
 		if ( strcasecmp( c->argv[ 1 ], "forever" ) == 0 ) {
-			mi->mi_cache.ttl = META_DNCACHE_FOREVER;
+			mi->mi_cache.dc_ttl = META_DNCACHE_FOREVER;
 
 		} else if ( strcasecmp( c->argv[ 1 ], "disabled" ) == 0 ) {
-			mi->mi_cache.ttl = META_DNCACHE_DISABLED;
+			mi->mi_cache.dc_ttl = META_DNCACHE_DISABLED;
 
 		} else {
 			unsigned long	t;
@@ -2075,7 +2119,7 @@ asyncmeta_back_cf_gen( ConfigArgs *c )
 				Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
 				return 1;
 			}
-			mi->mi_cache.ttl = (time_t)t;
+			mi->mi_cache.dc_ttl = (time_t)t;
 		}
 		break;
 
@@ -2195,6 +2239,14 @@ asyncmeta_back_cf_gen( ConfigArgs *c )
 		}
 		break;
 
+	case LDAP_BACK_CFG_LATENCY_ROUTING:
+		if ( c->value_int ) {
+			mi->mi_flags |= META_BACK_F_LATENCY_ROUTING;
+		} else {
+			mi->mi_flags &= ~META_BACK_F_LATENCY_ROUTING;
+		}
+		break;
+
 	case LDAP_BACK_CFG_CONNPOOLMAX:
 	/* privileged connections pool max size ? */
 		if ( mi->mi_ntargets > 0 ) {
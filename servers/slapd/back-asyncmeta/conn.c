@@ -520,6 +520,7 @@ asyncmeta_getconn(
 			err = LDAP_SUCCESS,
 			new_conn = 0,
 			ncandidates = 0;
+	int		*replicas = NULL;
 
 
 	meta_op_type	op_type = META_OP_REQUIRE_SINGLE;
@@ -670,8 +671,8 @@ asyncmeta_getconn(
 	/*
 	 * looks in cache, if any
 	 */
-	if ( mi->mi_cache.ttl != META_DNCACHE_DISABLED ) {
-		cached = i = asyncmeta_dncache_get_target( &mi->mi_cache, &op->o_req_ndn );
+	if ( mi->mi_cache.dc_ttl != META_DNCACHE_DISABLED ) {
+		cached = i = mi->mi_ldap_extra->dncache_get_target( &mi->mi_cache, &op->o_req_ndn );
 	}
 
 	if ( op_type == META_OP_REQUIRE_SINGLE ) {
@@ -722,6 +723,15 @@ asyncmeta_getconn(
 			return NULL;
 		}
 
+		/* reads may go to any replica of the target */
+		if ( op->o_tag == LDAP_REQ_COMPARE && META_BACK_LATENCY_ROUTING( mi ) ) {
+			replicas = op->o_tmpalloc( mi->mi_ntargets * sizeof( int ), op->o_tmpmemctx );
+			asyncmeta_select_replicas( mi, replicas );
+			i = replicas[ i ];
+			op->o_tmpfree( replicas, op->o_tmpmemctx );
+			replicas = NULL;
+		}
+
 		Debug( LDAP_DEBUG_TRACE,
 		       "==>asyncmeta__getconn: got target=%d for ndn=\"%s\" from cache\n",
 		       i, op->o_req_ndn.bv_val );
@@ -777,11 +787,21 @@ asyncmeta_getconn(
 		LDAP_BACK_CONN_ISANON_SET( mc );
 	}
 
+		/* only search the replica expected to answer first */
+		if ( META_BACK_LATENCY_ROUTING( mi ) ) {
+			replicas = op->o_tmpalloc( mi->mi_ntargets * sizeof( int ), op->o_tmpmemctx );
+			asyncmeta_select_replicas( mi, replicas );
+		}
+
 		for ( i = 0; i < mi->mi_ntargets; i++ ) {
 			a_metatarget_t		*mt = mi->mi_targets[ i ];
 
 			META_CANDIDATE_RESET( &candidates[ i ] );
 
+			if ( replicas && replicas[ i ] != i ) {
+				continue;
+			}
+
 			if ( i == cached
 				|| asyncmeta_is_candidate( mt, &op->o_req_ndn,
 					op->o_tag == LDAP_REQ_SEARCH ? op->ors_scope : LDAP_SCOPE_SUBTREE ) )
@@ -837,6 +857,9 @@ asyncmeta_getconn(
 							asyncmeta_back_conn_free( mc );
 
 						}
+						if ( replicas ) {
+							op->o_tmpfree( replicas, op->o_tmpmemctx );
+						}
 						return NULL;
 					}
 
@@ -846,6 +869,11 @@ asyncmeta_getconn(
 			}
 		}
 
+		if ( replicas ) {
+			op->o_tmpfree( replicas, op->o_tmpmemctx );
+			replicas = NULL;
+		}
+
 		if ( ncandidates == 0 ) {
 			if ( rs->sr_err == LDAP_SUCCESS ) {
 				rs->sr_err = LDAP_NO_SUCH_OBJECT;
@@ -1001,6 +1029,7 @@ a_metaconn_t *
 asyncmeta_get_next_mc( a_metainfo_t *mi )
 {
 	a_metaconn_t *mc = NULL;
+	int i;
 
 	ldap_pvt_thread_mutex_lock( &mi->mi_mc_mutex );
 	if (mi->mi_next_conn >= mi->mi_num_conns-1) {
@@ -1010,6 +1039,18 @@ asyncmeta_get_next_mc( a_metainfo_t *mi )
 	}
 
 	mc = &mi->mi_conns[mi->mi_next_conn];
+	if ( META_BACK_LATENCY_ROUTING( mi ) ) {
+		/* queue behind the fewest pending operations; starting
+		 * from the round-robin choice keeps ties rotating.
+		 * pending_ops is only read, a stale value is harmless */
+		for ( i = 1; i < mi->mi_num_conns; i++ ) {
+			a_metaconn_t *tmp = &mi->mi_conns[ ( mi->mi_next_conn + i ) % mi->mi_num_conns ];
+
+			if ( tmp->pending_ops < mc->pending_ops ) {
+				mc = tmp;
+			}
+		}
+	}
 	ldap_pvt_thread_mutex_unlock( &mi->mi_mc_mutex );
 	return mc;
 }
@@ -81,6 +81,7 @@ int asyncmeta_new_bm_context(Operation *op,
 	(*new_bc)->candidates = op->o_tmpcalloc(ntargets, sizeof(SlapReply),op->o_tmpmemctx);
 	(*new_bc)->msgids = op->o_tmpcalloc(ntargets, sizeof(int),op->o_tmpmemctx);
 	(*new_bc)->nretries = op->o_tmpcalloc(ntargets, sizeof(int),op->o_tmpmemctx);
+	(*new_bc)->bc_sent = op->o_tmpcalloc(ntargets, sizeof(struct timespec),op->o_tmpmemctx);
 	(*new_bc)->c_peer_name = op->o_conn->c_peer_name;
 	(*new_bc)->is_root = be_isroot( op );
 
@@ -204,6 +205,111 @@ int asyncmeta_add_message_queue(a_metaconn_t *mc, bm_context_t *bc)
 	return LDAP_SUCCESS;
 }
 
+/*
+ * Halve the estimate of mt for every META_LATENCY_HALFLIFE seconds
+ * since its last sample, so that a replica that was slow or failed
+ * is tried again after a while, however busy the others are.
+ * Called with mt_latency_mutex held.
+ */
+static void
+asyncmeta_target_age(a_metatarget_t *mt, time_t now)
+{
+	time_t halvings = ( now - mt->mt_latency_time ) / META_LATENCY_HALFLIFE;
+
+	if ( halvings <= 0 )
+		return;
+	if ( halvings >= 32 ) {
+		mt->mt_latency = mt->mt_latency_dev = 0;
+	} else {
+		mt->mt_latency >>= halvings;
+		mt->mt_latency_dev >>= halvings;
+	}
+	mt->mt_latency_time += halvings * META_LATENCY_HALFLIFE;
+}
+
+/*
+ * Record when the request of bc was sent to candidate, so that the
+ * time spent queued or binding is not taken for target latency.
+ */
+void
+asyncmeta_target_sent(bm_context_t *bc, int candidate)
+{
+	clock_gettime( CLOCK_MONOTONIC, &bc->bc_sent[ candidate ] );
+}
+
+/*
+ * Fold the time mt took to answer the request of bc sent to candidate
+ * into its response time estimate: a moving average and mean deviation
+ * weighted as in the TCP retransmission timer (RFC 6298), so that
+ * latency-routing can prefer the replica whose answer is expected first.
+ */
+void
+asyncmeta_target_latency(a_metatarget_t *mt, bm_context_t *bc, int candidate)
+{
+	struct timespec now, *sent = &bc->bc_sent[ candidate ];
+	long rtt, err;
+
+	/* the request never made it to the target */
+	if ( sent->tv_sec == 0 && sent->tv_nsec == 0 )
+		return;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	rtt = ( now.tv_sec - sent->tv_sec ) * 1000000L
+		+ ( now.tv_nsec - sent->tv_nsec ) / 1000;
+	if ( rtt <= 0 )
+		rtt = 1;
+
+	ldap_pvt_thread_mutex_lock( &mt->mt_latency_mutex );
+	asyncmeta_target_age( mt, slap_get_time() );
+	if ( mt->mt_latency == 0 ) {
+		mt->mt_latency = rtt;
+		mt->mt_latency_dev = rtt / 2;
+	} else {
+		err = rtt - mt->mt_latency;
+		mt->mt_latency += err / 8;
+		if ( mt->mt_latency <= 0 )
+			mt->mt_latency = 1;
+		if ( err < 0 )
+			err = -err;
+		mt->mt_latency_dev += ( err - mt->mt_latency_dev ) / 4;
+	}
+	mt->mt_latency_time = slap_get_time();
+	ldap_pvt_thread_mutex_unlock( &mt->mt_latency_mutex );
+}
+
+/*
+ * A target that could not be reached is taken to be slow, for longer
+ * after each failure, until an answer brings the estimate back down.
+ */
+void
+asyncmeta_target_failed(a_metatarget_t *mt)
+{
+	ldap_pvt_thread_mutex_lock( &mt->mt_latency_mutex );
+	asyncmeta_target_age( mt, slap_get_time() );
+	mt->mt_latency = mt->mt_latency * 2 + 1000000L;
+	if ( mt->mt_latency > META_LATENCY_MAX )
+		mt->mt_latency = META_LATENCY_MAX;
+	mt->mt_latency_time = slap_get_time();
+	ldap_pvt_thread_mutex_unlock( &mt->mt_latency_mutex );
+}
+
+/*
+ * The upper estimate of the response time of mt as of now: average
+ * plus twice the deviation, so that replicas with an erratic tail
+ * are avoided.
+ */
+long
+asyncmeta_target_score(a_metatarget_t *mt, time_t now)
+{
+	long score;
+
+	ldap_pvt_thread_mutex_lock( &mt->mt_latency_mutex );
+	asyncmeta_target_age( mt, now );
+	score = mt->mt_latency + 2 * mt->mt_latency_dev;
+	ldap_pvt_thread_mutex_unlock( &mt->mt_latency_mutex );
+
+	return score;
+}
 
 void
 asyncmeta_drop_bc(a_metaconn_t *mc, bm_context_t *bc)
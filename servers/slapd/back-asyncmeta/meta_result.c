@@ -218,8 +218,8 @@ asyncmeta_send_entry(
 	/*
 	 * cache dn
 	 */
-	if ( mi->mi_cache.ttl != META_DNCACHE_DISABLED ) {
-		( void )asyncmeta_dncache_update_entry( &mi->mi_cache,
+	if ( mi->mi_cache.dc_ttl != META_DNCACHE_DISABLED ) {
+		( void )mi->mi_ldap_extra->dncache_update_entry( &mi->mi_cache,
 				&ent.e_nname, target );
 	}
 
@@ -900,6 +900,7 @@ asyncmeta_handle_search_msg(LDAPMessage *res, a_metaconn_t *mc, bm_context_t *bc
 			Debug( LDAP_DEBUG_TRACE,
 			       "%s asyncmeta_handle_search_msg: msc %p result\n",
 			       op->o_log_prefix, msc );
+			asyncmeta_target_latency( mt, bc, i );
 			candidates[ i ].sr_type = REP_RESULT;
 			candidates[ i ].sr_msgid = META_MSGID_IGNORE;
 			/* NOTE: ignores response controls
@@ -1230,6 +1231,7 @@ int asyncmeta_handle_common_result(LDAPMessage *msg, a_metaconn_t *mc, bm_contex
 
 	op = bc->op;
 	rs = &bc->rs;
+	asyncmeta_target_latency( mt, bc, candidate );
 	save_text = rs->sr_text,
 	save_matched = rs->sr_matched;
 	save_ref = rs->sr_ref;
@@ -182,6 +182,7 @@ asyncmeta_back_modrdn_start(Operation *op,
 		case LDAP_SUCCESS:
 			retcode = META_SEARCH_CANDIDATE;
 			asyncmeta_set_msc_time(msc);
+			asyncmeta_target_sent( bc, candidate );
 			goto done;
 
 		case LDAP_SERVER_DOWN:
@@ -609,6 +609,7 @@ done_pr:;
 		case LDAP_SUCCESS:
 			retcode = META_SEARCH_CANDIDATE;
 			asyncmeta_set_msc_time(msc);
+			asyncmeta_target_sent( bc, candidate );
 			goto done;
 
 		case LDAP_SERVER_DOWN:
@@ -668,6 +669,66 @@ doreturn:;
 	return retcode;
 }
 
+/*
+ * with latency-routing, a target that could not be reached is replaced
+ * by the best replica not tried yet by this search; returns its index,
+ * or -1 if there is none left
+ */
+static int
+asyncmeta_search_failover(
+	Operation	*op,
+	SlapReply	*rs,
+	a_metaconn_t	*mc,
+	SlapReply	*candidates,
+	int		candidate )
+{
+	a_metainfo_t	*mi = mc->mc_info;
+	int		j, rc;
+
+	if ( !META_BACK_LATENCY_ROUTING( mi ) ) {
+		return -1;
+	}
+
+	asyncmeta_target_failed( mi->mi_targets[ candidate ] );
+
+	while ( ( j = asyncmeta_next_replica( mi, candidate, candidates ) ) >= 0 ) {
+		ldap_pvt_thread_mutex_lock( &mc->mc_om_mutex );
+		rc = asyncmeta_init_one_conn( op, rs, mc, j,
+				LDAP_BACK_CONN_ISPRIV( mc ), LDAP_BACK_DONTSEND, 0 );
+		ldap_pvt_thread_mutex_unlock( &mc->mc_om_mutex );
+		if ( rc == LDAP_SUCCESS ) {
+			break;
+		}
+		/* don't try it again */
+		candidates[ j ].sr_msgid = META_MSGID_IGNORE;
+	}
+
+	if ( j < 0 ) {
+		return -1;
+	}
+
+	Debug( LDAP_DEBUG_TRACE, "%s asyncmeta_back_search: target %d unavailable, "
+	       "trying replica %d\n", op->o_log_prefix, candidate, j );
+
+	/* the replica answers in place of the target */
+	META_CANDIDATE_CLEAR( &candidates[ candidate ] );
+	candidates[ candidate ].sr_msgid = META_MSGID_IGNORE;
+
+	META_CANDIDATE_SET( &candidates[ j ] );
+	candidates[ j ].sr_err = LDAP_SUCCESS;
+	candidates[ j ].sr_matched = NULL;
+	candidates[ j ].sr_text = NULL;
+	candidates[ j ].sr_ref = NULL;
+	candidates[ j ].sr_ctrls = NULL;
+	candidates[ j ].sr_nentries = 0;
+	candidates[ j ].sr_type = -1;
+
+	rs->sr_err = LDAP_SUCCESS;
+	rs->sr_text = NULL;
+
+	return j;
+}
+
 int
 asyncmeta_back_search( Operation *op, SlapReply *rs )
 {
@@ -676,6 +737,7 @@ asyncmeta_back_search( Operation *op, SlapReply *rs )
 	int		rc = 0;
 	int		ncandidates = 0, initial_candidates = 0;
 	long		i;
+	int		j;
 	SlapReply	*candidates = NULL;
 	void *thrctx = op->o_threadctx;
 	bm_context_t *bc;
@@ -774,8 +836,11 @@ asyncmeta_back_search( Operation *op, SlapReply *rs )
 
 	for ( i = 0; i < mi->mi_ntargets; i++ ) {
 		if ( !META_IS_CANDIDATE( &candidates[ i ] )
-			|| candidates[ i ].sr_err != LDAP_SUCCESS )
+			|| candidates[ i ].sr_err != LDAP_SUCCESS
+			|| candidates[ i ].sr_msgid != META_MSGID_UNDEFINED )
 		{
+			/* not a candidate, or a replica failover
+			 * sent us back over targets already handled */
 			continue;
 		}
 retry:
@@ -816,6 +881,13 @@ retry:
 			if (rc == META_SEARCH_ERR) {
 				META_CANDIDATE_CLEAR(&candidates[i]);
 				candidates[ i ].sr_msgid = META_MSGID_IGNORE;
+				if ( ( j = asyncmeta_search_failover( op, rs, mc, candidates, i ) ) >= 0 ) {
+					ncandidates--;
+					if ( j < i ) {
+						i = j - 1;
+					}
+					continue;
+				}
 				if ( META_BACK_ONERR_STOP( mi ) ) {
 					asyncmeta_handle_onerr_stop(op,rs,mc,bc,i);
 					goto finish;
@@ -831,6 +903,14 @@ retry:
 			Debug( LDAP_DEBUG_TRACE, "%s asyncmeta_back_search: NOT_CANDIDATE "
 			       "cnd=\"%ld\"\n", op->o_log_prefix, i );
 			candidates[ i ].sr_msgid = META_MSGID_IGNORE;
+			if ( candidates[ i ].sr_err != LDAP_SUCCESS
+				&& ( j = asyncmeta_search_failover( op, rs, mc, candidates, i ) ) >= 0 )
+			{
+				if ( j < i ) {
+					i = j - 1;
+				}
+				continue;
+			}
 			break;
 
 		case META_SEARCH_NEED_BIND:
@@ -849,6 +929,13 @@ retry:
 			candidates[ i ].sr_msgid = META_MSGID_IGNORE;
 			candidates[ i ].sr_type = REP_RESULT;
 
+			if ( ( j = asyncmeta_search_failover( op, rs, mc, candidates, i ) ) >= 0 ) {
+				if ( j < i ) {
+					i = j - 1;
+				}
+				continue;
+			}
+
 			if ( META_BACK_ONERR_STOP( mi ) ) {
 				asyncmeta_handle_onerr_stop(op,rs,mc,bc,i);
 				goto finish;
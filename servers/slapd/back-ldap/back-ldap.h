@@ -137,6 +137,7 @@ typedef struct ldapconn_t {
 #define	LDAP_BACK_FCONN_ABANDON	(0x00000040U)
 #define	LDAP_BACK_FCONN_ISIDASR	(0x00000080U)
 #define	LDAP_BACK_FCONN_CACHED	(0x00000100U)
+#define	LDAP_BACK_FCONN_ISMUX	(0x00000200U)
 
 #define	LDAP_BACK_CONN_ISBOUND(lc)		LDAP_BACK_CONN_ISSET((lc), LDAP_BACK_FCONN_ISBOUND)
 #define	LDAP_BACK_CONN_ISBOUND_SET(lc)		LDAP_BACK_CONN_SET((lc), LDAP_BACK_FCONN_ISBOUND)
@@ -170,14 +171,27 @@ typedef struct ldapconn_t {
 #define	LDAP_BACK_CONN_CACHED(lc)		LDAP_BACK_CONN_ISSET((lc), LDAP_BACK_FCONN_CACHED)
 #define	LDAP_BACK_CONN_CACHED_SET(lc)		LDAP_BACK_CONN_SET((lc), LDAP_BACK_FCONN_CACHED)
 #define	LDAP_BACK_CONN_CACHED_CLEAR(lc)		LDAP_BACK_CONN_CLEAR((lc), LDAP_BACK_FCONN_CACHED)
+#define	LDAP_BACK_CONN_ISMUX(lc)		LDAP_BACK_CONN_ISSET((lc), LDAP_BACK_FCONN_ISMUX)
+#define	LDAP_BACK_CONN_ISMUX_SET(lc)		LDAP_BACK_CONN_SET((lc), LDAP_BACK_FCONN_ISMUX)
 
 	LDAP			*lc_ld;
 	unsigned long		lc_connid;
 	struct berval		lc_cred;
 	struct berval 		lc_bound_ndn;
 	unsigned		lc_flags;
+
+	/* searches waiting for results from the daemon event loop;
+	 * protected by li_async_mutex */
+	struct ldap_back_search_t	*lc_async;
+	Connection		*lc_async_conn;
+	int			lc_async_active;
+	struct ldapconn_t	*lc_async_next;
 } ldapconn_t;
 
+/* see ldap_back_search_deferred() */
+typedef struct ldap_back_search_t ldap_back_search_t;
+typedef int (ldap_back_search_step_f)( void *ctx, ldap_back_search_t *ls, void *arg );
+
 typedef struct ldap_avl_info_t {
 	ldap_pvt_thread_mutex_t		lai_mutex;
 	Avlnode				*lai_tree;
@@ -337,6 +351,8 @@ typedef struct ldapinfo_t {
 
 #define LDAP_BACK_F_ONERR_STOP		(0x00400000U)
 
+#define LDAP_BACK_F_ASYNC_SEARCH	(0x00800000U)
+
 #define	LDAP_BACK_ISSET_F(ff,f)		( ( (ff) & (f) ) == (f) )
 #define	LDAP_BACK_ISMASK_F(ff,m,f)	( ( (ff) & (m) ) == (f) )
 
@@ -379,6 +395,7 @@ typedef struct ldapinfo_t {
 #define	LDAP_BACK_NOUNDEFFILTER(li)	LDAP_BACK_ISSET( (li), LDAP_BACK_F_NOUNDEFFILTER)
 #define	LDAP_BACK_OMIT_UNKNOWN_SCHEMA(li)		LDAP_BACK_ISSET( (li), LDAP_BACK_F_OMIT_UNKNOWN_SCHEMA)
 #define	LDAP_BACK_ONERR_STOP(li)	LDAP_BACK_ISSET( (li), LDAP_BACK_F_ONERR_STOP)
+#define	LDAP_BACK_ASYNC_SEARCH(li)	LDAP_BACK_ISSET( (li), LDAP_BACK_F_ASYNC_SEARCH)
 
 	int			li_version;
 
@@ -398,6 +415,17 @@ typedef struct ldapinfo_t {
 	 * and LDAP_BACK_CONN_PRIV_MAX ! */
 #define	LDAP_BACK_CONN_PRIV_DEFAULT	(16)
 
+	/* connections shared by all the operations that are proxied
+	 * with the proxied authorization control; responses are told
+	 * apart by msgid, so each connection carries many operations */
+	struct lc_conn_priv_q	li_conn_mux;
+	int			li_conn_mux_num;
+	int			li_conn_mux_pending;
+	int			li_conn_mux_max;
+	unsigned long		li_conn_mux_ops;
+	unsigned long		li_conn_mux_shared;
+	unsigned		li_conn_mux_peak;
+
 	ldap_monitor_info_t	li_monitor_info;
 
 	sig_atomic_t		li_isquarantined;
@@ -417,6 +445,11 @@ typedef struct ldapinfo_t {
 
 	ldap_pvt_thread_mutex_t li_counter_mutex;
 	ldap_pvt_mp_t		li_ops_completed[SLAP_OP_LAST];
+
+	/* connections with asynchronous searches in flight */
+	ldap_pvt_thread_mutex_t	li_async_mutex;
+	ldapconn_t		*li_async_conns;
+	struct re_s		*li_async_task;
 } ldapinfo_t;
 
 #define	LDAP_ERR_OK(err) ((err) == LDAP_SUCCESS || (err) == LDAP_COMPARE_FALSE || (err) == LDAP_COMPARE_TRUE)
@@ -458,6 +491,59 @@ typedef enum ldap_back_send_t {
 #define LDAP_BACK_PRINT_CONNTREE 0
 #endif /* !LDAP_BACK_PRINT_CONNTREE */
 
+/*
+ * DN to target cache shared by back-meta and back-asyncmeta.
+ * Entries are spread by DN hash over LDAP_DNCACHE_SHARDS shards,
+ * each with its own mutex; a shard holds at most
+ * dc_size / LDAP_DNCACHE_SHARDS entries and recycles them
+ * in CLOCK order (see dncache.c)
+ */
+#define LDAP_DNCACHE_SHARDS		16
+#define LDAP_DNCACHE_DISABLED		(0)
+#define LDAP_DNCACHE_FOREVER		((time_t)(-1))
+#define LDAP_DNCACHE_SIZE_DEFAULT	(65536UL)
+#define LDAP_DNCACHE_TARGET_NONE	(-1)
+
+typedef struct ldap_dncache_shard_t {
+	ldap_pvt_thread_mutex_t		ds_mutex;
+	Avlnode				*ds_tree;
+	/* CLOCK ring and hand */
+	struct ldap_dncache_entry_t	*ds_hand;
+	unsigned long			ds_num;
+
+	/* statistics */
+	unsigned long			ds_hits;
+	unsigned long			ds_misses;
+	unsigned long			ds_evictions;
+} ldap_dncache_shard_t;
+
+typedef struct ldap_dncache_t {
+	time_t				dc_ttl;
+	/* max number of entries; 0 means unbounded */
+	unsigned long			dc_size;
+	ldap_dncache_shard_t		dc_shards[ LDAP_DNCACHE_SHARDS ];
+
+	/* cn=Monitor */
+	void				*dc_monitor_cb;
+	struct berval			dc_monitor_ndn;
+} ldap_dncache_t;
+
+/*
+ * counters of the chain overlay
+ */
+typedef struct ldap_chain_stats_t {
+	ldap_pvt_thread_mutex_t		cs_mutex;
+	/* referral URIs found in, or missing from, the per-URI cache */
+	unsigned long			cs_uri_hits;
+	unsigned long			cs_uri_misses;
+	/* continuation references chased concurrently */
+	unsigned long			cs_deferred;
+
+	/* cn=Monitor */
+	void				*cs_monitor_cb;
+	struct berval			cs_monitor_ndn;
+} ldap_chain_stats_t;
+
 typedef struct ldap_extra_t {
 	int (*proxy_authz_ctrl)( Operation *op, SlapReply *rs, struct berval *bound_ndn,
 		int version, slap_idassert_t *si, LDAPControl	*ctrl );
@@ -469,6 +555,14 @@ typedef struct ldap_extra_t {
 	int (*retry_info_parse)( char *in, slap_retry_info_t *ri, char *buf, ber_len_t buflen );
 	int (*retry_info_unparse)( slap_retry_info_t *ri, struct berval *bvout );
 	int (*connid2str)( const ldapconn_base_t *lc, char *buf, ber_len_t buflen );
+	int (*dncache_init)( ldap_dncache_t *cache );
+	void (*dncache_destroy)( ldap_dncache_t *cache );
+	int (*dncache_get_target)( ldap_dncache_t *cache, struct berval *ndn );
+	int (*dncache_update_entry)( ldap_dncache_t *cache, struct berval *ndn, int target );
+	int (*dncache_delete_entry)( ldap_dncache_t *cache, struct berval *ndn );
+	int (*dncache_monitor_db_init)( BackendDB *be );
+	int (*dncache_monitor_db_open)( BackendDB *be, ldap_dncache_t *cache );
+	int (*dncache_monitor_db_close)( BackendDB *be, ldap_dncache_t *cache );
 } ldap_extra_t;
 
 LDAP_END_DECL
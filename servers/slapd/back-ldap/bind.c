@@ -170,7 +170,21 @@ ldap_back_conndnlc_cmp( const void *c1, const void *c2 );
 ldapconn_t *
 ldap_back_conn_delete( ldapinfo_t *li, ldapconn_t *lc )
 {
-	if ( LDAP_BACK_PCONN_ISPRIV( lc ) ) {
+	if ( LDAP_BACK_CONN_ISMUX( lc ) ) {
+		if ( LDAP_BACK_CONN_CACHED( lc ) ) {
+			assert( lc->lc_q.tqe_prev != NULL );
+			assert( li->li_conn_mux_num > 0 );
+			li->li_conn_mux_num--;
+			LDAP_TAILQ_REMOVE( &li->li_conn_mux, lc, lc_q );
+			LDAP_TAILQ_ENTRY_INIT( lc, lc_q );
+			LDAP_BACK_CONN_CACHED_CLEAR( lc );
+
+		} else {
+			assert( LDAP_BACK_CONN_TAINTED( lc ) );
+			assert( lc->lc_q.tqe_prev == NULL );
+		}
+
+	} else if ( LDAP_BACK_PCONN_ISPRIV( lc ) ) {
 		if ( LDAP_BACK_CONN_CACHED( lc ) ) {
 			assert( lc->lc_q.tqe_prev != NULL );
 			assert( li->li_conn_priv[ LDAP_BACK_CONN2PRIV( lc ) ].lic_num > 0 );
@@ -800,7 +814,8 @@ ldap_back_getconn(
 	ldapconn_t	*lc = NULL,
 			lc_curr = {{ 0 }};
 	int		refcnt = 1,
-			lookupconn = !( sendok & LDAP_BACK_BINDING );
+			lookupconn = !( sendok & LDAP_BACK_BINDING ),
+			mux_reserved = 0;
 
 	/* if the server is quarantined, and
 	 * - the current interval did not expire yet, or
@@ -883,6 +898,13 @@ ldap_back_getconn(
 				lc_curr.lc_local_ndn = *binddn;
 				LDAP_BACK_PCONN_ROOTDN_SET( &lc_curr, op );
 				LDAP_BACK_CONN_ISIDASSERT_SET( &lc_curr );
+				/* the assertion travels with each operation
+				 * unless it is established by the bind */
+				if ( li->li_conn_mux_max > 0
+					&& !( li->li_idassert_flags & LDAP_BACK_AUTH_NATIVE_AUTHZ ) )
+				{
+					LDAP_BACK_CONN_ISMUX_SET( &lc_curr );
+				}
 
 			} else if ( isproxyauthz && ( li->li_idassert_flags & LDAP_BACK_AUTH_OVERRIDE ) ) {
 				lc_curr.lc_local_ndn = slap_empty_bv;
@@ -903,7 +925,55 @@ ldap_back_getconn(
 	if ( lookupconn ) {
 retry_lock:
 		ldap_pvt_thread_mutex_lock( &li->li_conninfo.lai_mutex );
-		if ( LDAP_BACK_PCONN_ISPRIV( &lc_curr ) ) {
+		if ( LDAP_BACK_CONN_ISMUX( &lc_curr ) ) {
+			ldapconn_t	*tmplc;
+
+			/* lookup the least loaded conn that's not binding */
+			LDAP_TAILQ_FOREACH( tmplc, &li->li_conn_mux, lc_q ) {
+				if ( tmplc->lc_conn != lc_curr.lc_conn
+					|| LDAP_BACK_CONN_BINDING( tmplc ) )
+				{
+					continue;
+				}
+
+				if ( lc == NULL || tmplc->lc_refcnt < lc->lc_refcnt ) {
+					lc = tmplc;
+					if ( lc->lc_refcnt == 0 ) {
+						break;
+					}
+				}
+			}
+
+			/* grow the pool before stacking operations
+			 * on a connection that is already busy */
+			if ( ( lc == NULL || lc->lc_refcnt > 0 )
+				&& li->li_conn_mux_num + li->li_conn_mux_pending < li->li_conn_mux_max )
+			{
+				li->li_conn_mux_pending++;
+				mux_reserved = 1;
+				lc = NULL;
+
+			} else if ( lc == NULL && !LDAP_BACK_USE_TEMPORARIES( li ) ) {
+				/* everything is binding; wait for it */
+				lc = LDAP_TAILQ_FIRST( &li->li_conn_mux );
+				if ( lc == NULL ) {
+					ldap_pvt_thread_mutex_unlock( &li->li_conninfo.lai_mutex );
+
+					ldap_pvt_thread_yield();
+					goto retry_lock;
+				}
+
+			} else if ( lc != NULL ) {
+				li->li_conn_mux_ops++;
+				if ( lc->lc_refcnt > 0 ) {
+					li->li_conn_mux_shared++;
+				}
+				if ( lc->lc_refcnt + 1 > li->li_conn_mux_peak ) {
+					li->li_conn_mux_peak = lc->lc_refcnt + 1;
+				}
+			}
+
+		} else if ( LDAP_BACK_PCONN_ISPRIV( &lc_curr ) ) {
 			/* lookup a conn that's not binding */
 			LDAP_TAILQ_FOREACH( lc,
 				&li->li_conn_priv[ LDAP_BACK_CONN2PRIV( &lc_curr ) ].lic_priv,
@@ -970,6 +1040,11 @@ retry_lock:
 		lc->lc_lcflags = lc_curr.lc_lcflags;
 		lc->lc_ldapinfo = li;
 		if ( ldap_back_prepare_conn( lc, op, rs, sendok ) != LDAP_SUCCESS ) {
+			if ( mux_reserved ) {
+				ldap_pvt_thread_mutex_lock( &li->li_conninfo.lai_mutex );
+				li->li_conn_mux_pending--;
+				ldap_pvt_thread_mutex_unlock( &li->li_conninfo.lai_mutex );
+			}
 			ch_free( lc );
 			return NULL;
 		}
@@ -1028,6 +1103,7 @@ retry_lock:
 		 * in cache; in case, destroy the newly created
 		 * connection and use the existing one */
 		if ( LDAP_BACK_PCONN_ISTLS( lc ) 
+				&& !LDAP_BACK_CONN_ISMUX( lc )
 				&& !ldap_tls_inplace( lc->lc_ld ) )
 		{
 			ldapconn_t	*tmplc = NULL;
@@ -1068,7 +1144,25 @@ retry_lock:
 		ldap_back_print_conntree( li, ">>> ldap_back_getconn(insert)" );
 #endif /* LDAP_BACK_PRINT_CONNTREE */
 	
-		if ( LDAP_BACK_PCONN_ISPRIV( lc ) ) {
+		if ( LDAP_BACK_CONN_ISMUX( lc ) ) {
+			if ( mux_reserved ) {
+				li->li_conn_mux_pending--;
+			}
+			if ( mux_reserved && li->li_conn_mux_num < li->li_conn_mux_max ) {
+				LDAP_TAILQ_INSERT_TAIL( &li->li_conn_mux, lc, lc_q );
+				li->li_conn_mux_num++;
+				LDAP_BACK_CONN_CACHED_SET( lc );
+
+			} else {
+				LDAP_BACK_CONN_TAINTED_SET( lc );
+			}
+			li->li_conn_mux_ops++;
+			if ( li->li_conn_mux_peak == 0 ) {
+				li->li_conn_mux_peak = 1;
+			}
+			rs->sr_err = 0;
+
+		} else if ( LDAP_BACK_PCONN_ISPRIV( lc ) ) {
 			if ( li->li_conn_priv[ LDAP_BACK_CONN2PRIV( lc ) ].lic_num < li->li_conn_priv_max ) {
 				LDAP_TAILQ_INSERT_TAIL( &li->li_conn_priv[ LDAP_BACK_CONN2PRIV( lc ) ].lic_priv, lc, lc_q );
 				li->li_conn_priv[ LDAP_BACK_CONN2PRIV( lc ) ].lic_num++;
@@ -1130,7 +1224,10 @@ retry_lock:
 	} else {
 		int	expiring = 0;
 
-		if ( ( li->li_idle_timeout != 0 && op->o_time > lc->lc_time + li->li_idle_timeout )
+		/* multiplexed connections are long-lived,
+		 * so they only honor conn-ttl */
+		if ( ( li->li_idle_timeout != 0 && !LDAP_BACK_CONN_ISMUX( lc )
+				&& op->o_time > lc->lc_time + li->li_idle_timeout )
 			|| ( li->li_conn_ttl != 0 && op->o_time > lc->lc_create_time + li->li_conn_ttl ) )
 		{
 			expiring = 1;
@@ -1981,6 +2078,12 @@ retry:;
 		ldap_controls_free( ctrls );
 	}
 
+	if ( LDAP_BACK_ASYNC_SEARCH( li ) ) {
+		/* responses to asynchronous searches may have been
+		 * read off the connection while waiting for this one */
+		ldap_back_search_kick( li, lc );
+	}
+
 	return( LDAP_ERR_OK( rs->sr_err ) ? LDAP_SUCCESS : rs->sr_err );
 }
 
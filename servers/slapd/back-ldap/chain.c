@@ -97,11 +97,16 @@ typedef struct ldap_chain_t {
 #define	LDAP_CHAIN_F_CHAINING		(0x01U)
 #define	LDAP_CHAIN_F_CACHE_URI		(0x02U)
 #define	LDAP_CHAIN_F_RETURN_ERR		(0x04U)
+#define	LDAP_CHAIN_F_CONCURRENT_REFS	(0x08U)
 
 #define LDAP_CHAIN_ISSET(lc, f)		( ( (lc)->lc_flags & (f) ) == (f) )
 #define	LDAP_CHAIN_CHAINING( lc )	LDAP_CHAIN_ISSET( (lc), LDAP_CHAIN_F_CHAINING )
 #define	LDAP_CHAIN_CACHE_URI( lc )	LDAP_CHAIN_ISSET( (lc), LDAP_CHAIN_F_CACHE_URI )
 #define	LDAP_CHAIN_RETURN_ERR( lc )	LDAP_CHAIN_ISSET( (lc), LDAP_CHAIN_F_RETURN_ERR )
+#define	LDAP_CHAIN_CONCURRENT_REFS( lc )	LDAP_CHAIN_ISSET( (lc), LDAP_CHAIN_F_CONCURRENT_REFS )
+
+	/* counters, also for cn=Monitor */
+	ldap_chain_stats_t	lc_stats;
 
 #ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
 	LDAPControl		lc_chaining_ctrl;
@@ -122,6 +127,46 @@ typedef struct ldap_chain_cb_t {
 	int			lb_depth;
 } ldap_chain_cb_t;
 
+/*
+ * the search of a continuation reference that has been sent,
+ * but whose responses have not been collected yet (see
+ * "chain-concurrent-refs"); it lives on the operation's memctx
+ */
+typedef struct ldap_chain_pending_t {
+	struct ldap_chain_opextra_t	*cp_co;
+	ldap_back_search_t	*cp_ls;
+	ldapinfo_t		*cp_li;
+	struct berval		cp_dn;
+	struct berval		cp_ndn;
+	req_search_s		cp_oq_search;
+	int			cp_free_filter;
+	LDAPControl		**cp_ctrls;
+	ldap_chain_status_t	cp_status;
+	/* the reference, the URLs not tried yet and its entry,
+	 * in case the search fails */
+	BerVarray		cp_ref;
+	int			cp_nextref;
+	Entry			*cp_entry;
+	struct ldap_chain_pending_t	*cp_next;
+} ldap_chain_pending_t;
+
+typedef struct ldap_chain_opextra_t {
+	OpExtra			co_oe;
+	Operation		*co_op;
+	BackendDB		co_db;
+	/* the callback of the overlay stack, see ldap_chain_op_search() */
+	slap_callback		*co_sc;
+	/* protects what follows once the searches are sent */
+	ldap_pvt_thread_mutex_t	co_mutex;
+	/* the thread that ran the local search is done with co_op */
+	int			co_resumed;
+	/* the result of the local search, held until the searches
+	 * of the continuation references are over */
+	int			co_held;
+	SlapReply		co_rs;
+	ldap_chain_pending_t	*co_pending;
+} ldap_chain_opextra_t;
+
 static int
 ldap_chain_op(
 	Operation	*op,
@@ -250,6 +295,101 @@ ldap_chain_uri_dup( void *c1, void *c2 )
 	return 0;
 }
 
+/*
+ * looks up the ldapinfo of the URI of li in the cache; if none is
+ * found, creates one, which is cached if configured to do so and
+ * temporary otherwise.  On success, it is installed in be_private
+ */
+static int
+ldap_chain_li_get(
+	Operation	*op,
+	ldap_chain_t	*lc,
+	ldapinfo_t	*li,
+	struct berval	*ref,
+	const char	*fname,
+	int		*temporaryp )
+{
+	ldapinfo_t	*lip;
+	int		rc;
+
+	*temporaryp = 0;
+
+	/* Searches for a ldapinfo in the avl tree */
+	ldap_pvt_thread_mutex_lock( &lc->lc_lai.lai_mutex );
+	lip = (ldapinfo_t *)avl_find( lc->lc_lai.lai_tree, 
+		(caddr_t)li, ldap_chain_uri_cmp );
+	ldap_pvt_thread_mutex_unlock( &lc->lc_lai.lai_mutex );
+
+	ldap_pvt_thread_mutex_lock( &lc->lc_stats.cs_mutex );
+	if ( lip != NULL ) {
+		lc->lc_stats.cs_uri_hits++;
+
+	} else {
+		lc->lc_stats.cs_uri_misses++;
+	}
+	ldap_pvt_thread_mutex_unlock( &lc->lc_stats.cs_mutex );
+
+	if ( lip != NULL ) {
+		op->o_bd->be_private = (void *)lip;
+
+		Debug( LDAP_DEBUG_TRACE, "%s %s: ref=\"%s\": URI=\"%s\" found in cache\n",
+			op->o_log_prefix, fname, ref->bv_val, li->li_uri );
+
+		return 0;
+	}
+
+	/* if none is found, create a temporary... */
+	rc = ldap_chain_db_init_one( op->o_bd );
+	if ( rc != 0 ) {
+		Debug( LDAP_DEBUG_TRACE, "%s %s: ref=\"%s\" unable to init back-ldap for URI=\"%s\"\n",
+			op->o_log_prefix, fname, ref->bv_val, li->li_uri );
+		return rc;
+	}
+	lip = (ldapinfo_t *)op->o_bd->be_private;
+	lip->li_uri = li->li_uri;
+	lip->li_bvuri = li->li_bvuri;
+	rc = ldap_chain_db_open_one( op->o_bd );
+	if ( rc != 0 ) {
+		Debug( LDAP_DEBUG_TRACE, "%s %s: ref=\"%s\" unable to open back-ldap for URI=\"%s\"\n",
+			op->o_log_prefix, fname, ref->bv_val, li->li_uri );
+		lip->li_uri = NULL;
+		lip->li_bvuri = NULL;
+		(void)ldap_chain_db_destroy_one( op->o_bd, NULL );
+		return rc;
+	}
+
+	*temporaryp = 1;
+	if ( LDAP_CHAIN_CACHE_URI( lc ) ) {
+		/* ...that needs its own copy of the URI once cached */
+		lip->li_uri = ch_strdup( li->li_uri );
+		lip->li_bvuri = NULL;
+		value_add_one( &lip->li_bvuri, &li->li_bvuri[ 0 ] );
+
+		ldap_pvt_thread_mutex_lock( &lc->lc_lai.lai_mutex );
+		if ( avl_insert( &lc->lc_lai.lai_tree,
+			(caddr_t)lip, ldap_chain_uri_cmp, ldap_chain_uri_dup ) == 0 )
+		{
+			*temporaryp = 0;
+		}
+		ldap_pvt_thread_mutex_unlock( &lc->lc_lai.lai_mutex );
+
+		if ( *temporaryp ) {
+			/* someone just inserted another;
+			 * don't bother, use this and then
+			 * just free it */
+			ch_free( lip->li_uri );
+			ber_bvarray_free( lip->li_bvuri );
+			lip->li_uri = li->li_uri;
+			lip->li_bvuri = li->li_bvuri;
+		}
+	}
+
+	Debug( LDAP_DEBUG_TRACE, "%s %s: ref=\"%s\" %s\n",
+		op->o_log_prefix, fname, ref->bv_val, *temporaryp ? "temporary" : "caching" );
+
+	return 0;
+}
+
 /*
  * Search specific response that strips entryDN from entries
  */
@@ -556,57 +696,11 @@ Document: RFC 4511
 
 		ber_str2bv( li.li_uri, 0, 0, &li.li_bvuri[ 0 ] );
 
-		/* Searches for a ldapinfo in the avl tree */
-		ldap_pvt_thread_mutex_lock( &lc->lc_lai.lai_mutex );
-		lip = (ldapinfo_t *)avl_find( lc->lc_lai.lai_tree, 
-			(caddr_t)&li, ldap_chain_uri_cmp );
-		ldap_pvt_thread_mutex_unlock( &lc->lc_lai.lai_mutex );
-
-		if ( lip != NULL ) {
-			op->o_bd->be_private = (void *)lip;
-
-			Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_op: ref=\"%s\": URI=\"%s\" found in cache\n",
-				op->o_log_prefix, ref->bv_val, li.li_uri );
-
-		} else {
-			rc = ldap_chain_db_init_one( op->o_bd );
-			if ( rc != 0 ) {
-				Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_op: ref=\"%s\" unable to init back-ldap for URI=\"%s\"\n",
-					op->o_log_prefix, ref->bv_val, li.li_uri );
-				goto cleanup;
-			}
-			lip = (ldapinfo_t *)op->o_bd->be_private;
-			lip->li_uri = li.li_uri;
-			lip->li_bvuri = bvuri;
-			rc = ldap_chain_db_open_one( op->o_bd );
-			if ( rc != 0 ) {
-				Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_op: ref=\"%s\" unable to open back-ldap for URI=\"%s\"\n",
-					op->o_log_prefix, ref->bv_val, li.li_uri );
-				lip->li_uri = NULL;
-				lip->li_bvuri = NULL;
-				(void)ldap_chain_db_destroy_one( op->o_bd, NULL);
-				goto cleanup;
-			}
-
-			if ( LDAP_CHAIN_CACHE_URI( lc ) ) {
-				ldap_pvt_thread_mutex_lock( &lc->lc_lai.lai_mutex );
-				if ( avl_insert( &lc->lc_lai.lai_tree,
-					(caddr_t)lip, ldap_chain_uri_cmp, ldap_chain_uri_dup ) )
-				{
-					/* someone just inserted another;
-					 * don't bother, use this and then
-					 * just free it */
-					temporary = 1;
-				}
-				ldap_pvt_thread_mutex_unlock( &lc->lc_lai.lai_mutex );
-
-			} else {
-				temporary = 1;
-			}
-
-			Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_op: ref=\"%s\" %s\n",
-				op->o_log_prefix, ref->bv_val, temporary ? "temporary" : "caching" );
+		rc = ldap_chain_li_get( op, lc, &li, ref, "ldap_chain_op", &temporary );
+		if ( rc != 0 ) {
+			goto cleanup;
 		}
+		lip = (ldapinfo_t *)op->o_bd->be_private;
 
 		lb->lb_op_type = op_type;
 		lb->lb_depth = depth + 1;
@@ -671,6 +765,398 @@ further_cleanup:;
 	return rc;
 }
 
+/*
+ * returns the pending searches of the operation, if it may have some
+ * (see ldap_chain_op_search())
+ */
+static ldap_chain_opextra_t *
+ldap_chain_opextra_get( Operation *op, slap_overinst *on )
+{
+	OpExtra			*oex;
+
+	LDAP_SLIST_FOREACH( oex, &op->o_extra, oe_next ) {
+		if ( oex->oe_key == (void *)on ) {
+			return (ldap_chain_opextra_t *)oex;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * takes over whatever the search of a continuation reference
+ * needs until its responses are collected by
+ * ldap_chain_pending_step()
+ */
+static void
+ldap_chain_defer(
+	Operation		*op,
+	ldap_chain_t		*lc,
+	ldap_chain_pending_t	*cp,
+	ldap_back_search_t	*ls,
+	int			*free_dnp,
+	req_search_s		*oqs,
+	BerVarray		ref,
+	int			nextref,
+	Entry			*e )
+{
+	ldap_chain_opextra_t	*co = cp->cp_co;
+	ldap_chain_pending_t	**cpp;
+
+	cp->cp_ls = ls;
+	cp->cp_li = (ldapinfo_t *)op->o_bd->be_private;
+
+	if ( *free_dnp ) {
+		cp->cp_dn = op->o_req_dn;
+		cp->cp_ndn = op->o_req_ndn;
+		*free_dnp = 0;
+
+	} else {
+		/* may belong to the entry of the reference */
+		ber_dupbv_x( &cp->cp_dn, &op->o_req_dn, op->o_tmpmemctx );
+		ber_dupbv_x( &cp->cp_ndn, &op->o_req_ndn, op->o_tmpmemctx );
+	}
+
+	cp->cp_oq_search = op->oq_search;
+	if ( oqs->rs_filter != NULL ) {
+		cp->cp_free_filter = 1;
+		oqs->rs_filter = NULL;
+		BER_BVZERO( &oqs->rs_filterstr );
+	}
+	cp->cp_ctrls = op->o_ctrls;
+
+	ber_bvarray_dup_x( &cp->cp_ref, ref, op->o_tmpmemctx );
+	cp->cp_nextref = nextref;
+	if ( e != NULL ) {
+		cp->cp_entry = entry_dup( e );
+	}
+
+	/* keep the order of the references */
+	for ( cpp = &co->co_pending; *cpp != NULL; cpp = &(*cpp)->cp_next )
+		/* NO OP */ ;
+	*cpp = cp;
+
+	ldap_pvt_thread_mutex_lock( &lc->lc_stats.cs_mutex );
+	lc->lc_stats.cs_deferred++;
+	ldap_pvt_thread_mutex_unlock( &lc->lc_stats.cs_mutex );
+}
+
+static void
+ldap_chain_pending_free( Operation *op, ldap_chain_pending_t *cp )
+{
+	op->o_tmpfree( cp->cp_dn.bv_val, op->o_tmpmemctx );
+	op->o_tmpfree( cp->cp_ndn.bv_val, op->o_tmpmemctx );
+
+	if ( cp->cp_free_filter ) {
+		filter_free_x( op, cp->cp_oq_search.rs_filter, 1 );
+		slap_sl_free( cp->cp_oq_search.rs_filterstr.bv_val, op->o_tmpmemctx );
+	}
+
+	if ( cp->cp_ref != NULL ) {
+		ber_bvarray_free_x( cp->cp_ref, op->o_tmpmemctx );
+	}
+	if ( cp->cp_entry != NULL ) {
+		entry_free( cp->cp_entry );
+	}
+
+	op->o_tmpfree( cp, op->o_tmpmemctx );
+}
+
+/*
+ * the search of a continuation reference failed: as when references
+ * are chased one at a time, the remaining URLs are tried; if none can
+ * be chased, the reference is returned to the client, or the error
+ * is returned in the result of the search if chain-return-error is set
+ */
+static void
+ldap_chain_pending_failed(
+	Operation		*op,
+	SlapReply		*rs,
+	ldap_chain_pending_t	*cp,
+	slap_callback		*sc2,
+	int			err )
+{
+	slap_overinst		*on = (slap_overinst *)op->o_bd->bd_info;
+	ldap_chain_t		*lc = (ldap_chain_t *)on->on_bi.bi_private;
+	ldap_chain_opextra_t	*co = cp->cp_co;
+	ldap_chain_pending_t	*last, *ncp;
+	ldap_chain_cb_t		*lb = (ldap_chain_cb_t *)sc2->sc_private;
+	slap_callback		*sc = op->o_callback;
+	SlapReply		rs2 = { REP_SEARCHREF };
+	int			rc = err;
+
+	Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_pending_failed: "
+		"search of \"%s\" failed (%d)\n",
+		op->o_log_prefix, cp->cp_li->li_uri, err );
+
+	if ( op->o_abandon ) {
+		return;
+	}
+
+#ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
+	if ( cp->cp_status == LDAP_CH_ERR ) {
+		goto cannot_chain;
+	}
+#endif /* LDAP_CONTROL_X_CHAINING_BEHAVIOR */
+
+	if ( !BER_BVISNULL( &cp->cp_ref[ cp->cp_nextref ] ) ) {
+		for ( last = co->co_pending; last && last->cp_next; last = last->cp_next )
+			/* NO OP */ ;
+
+		lb->lb_status = LDAP_CH_NONE;
+		sc2->sc_next = sc->sc_next;
+		op->o_callback = sc2;
+		rs2.sr_entry = cp->cp_entry;
+		rc = ldap_chain_search( op, &rs2, &cp->cp_ref[ cp->cp_nextref ], 0 );
+		op->o_callback = sc;
+
+		if ( rc == LDAP_SUCCESS ) {
+			for ( ncp = co->co_pending; ncp && ncp->cp_next; ncp = ncp->cp_next )
+				/* NO OP */ ;
+
+			if ( ncp != NULL && ncp != last ) {
+				/* sent again: the reference is still the whole one */
+				ber_bvarray_free_x( ncp->cp_ref, op->o_tmpmemctx );
+				ncp->cp_ref = cp->cp_ref;
+				ncp->cp_nextref += cp->cp_nextref;
+				cp->cp_ref = NULL;
+			}
+			return;
+		}
+
+		if ( rc == SLAP_CB_CONTINUE ) {
+			rc = err;
+		}
+	}
+
+#ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
+	if ( lb->lb_status == LDAP_CH_ERR
+		|| ( ( get_chainingBehavior( op ) & SLAP_CH_CONTINUATION_MASK )
+			>> SLAP_CH_CONTINUATION_SHIFT ) == LDAP_CHAINING_REQUIRED )
+	{
+cannot_chain:;
+		rs->sr_err = LDAP_X_CANNOT_CHAIN;
+		return;
+	}
+#endif /* LDAP_CONTROL_X_CHAINING_BEHAVIOR */
+
+	if ( LDAP_CHAIN_RETURN_ERR( lc ) ) {
+		if ( rs->sr_err == LDAP_SUCCESS ) {
+			rs->sr_err = rc;
+		}
+		return;
+	}
+
+	rs2.sr_type = REP_SEARCHREF;
+	rs2.sr_entry = cp->cp_entry;
+	rs2.sr_ref = cp->cp_ref;
+	rs2.sr_flags = 0;
+	op->o_callback = sc->sc_next;
+	(void)send_search_reference( op, &rs2 );
+	op->o_callback = sc;
+}
+
+/*
+ * collects the responses available for cp without blocking; returns 1
+ * when its search is over: then cp has been released, after trying
+ * the remaining URLs of its reference if it failed
+ */
+static int
+ldap_chain_pending_collect( Operation *op, ldap_chain_pending_t *cp )
+{
+	ldap_chain_opextra_t	*co = cp->cp_co;
+	slap_overinst		*on = (slap_overinst *)co->co_db.bd_info;
+	ldap_chain_t		*lc = (ldap_chain_t *)on->on_bi.bi_private;
+	ldap_chain_pending_t	**cpp;
+	BackendDB		db = co->co_db;
+	ldap_chain_cb_t		lb = { 0 };
+	slap_callback		*sc = co->co_sc,
+				sc2 = { 0 };
+	struct berval		odn = op->o_req_dn,
+				ondn = op->o_req_ndn;
+	req_search_s		save_oq_search = op->oq_search;
+	LDAPControl		**ctrls = op->o_ctrls;
+	int			rc,
+				err = LDAP_SUCCESS;
+
+	op->o_bd = &db;
+
+	lb.lb_lc = lc;
+	lb.lb_op_type = op_search;
+	lb.lb_depth = 1;
+	lb.lb_status = cp->cp_status;
+	sc2.sc_private = &lb;
+	sc2.sc_response = ldap_chain_cb_search_response;
+	sc2.sc_next = sc->sc_next;
+
+	db.be_private = (void *)cp->cp_li;
+	op->o_req_dn = cp->cp_dn;
+	op->o_req_ndn = cp->cp_ndn;
+	op->oq_search = cp->cp_oq_search;
+	op->o_ctrls = cp->cp_ctrls;
+#ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
+	if ( op->o_ctrls != ctrls ) {
+		op->o_chaining = lc->lc_chaining_ctrlflag;
+	}
+#endif /* LDAP_CONTROL_X_CHAINING_BEHAVIOR */
+	op->o_callback = &sc2;
+
+	rc = ldap_back_search_collect( op, cp->cp_ls, &err );
+
+	op->o_callback = sc;
+	cp->cp_status = lb.lb_status;
+	op->oq_search = save_oq_search;
+	op->o_req_dn = odn;
+	op->o_req_ndn = ondn;
+
+	if ( rc == 1 ) {
+#ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
+		LDAPControl	**oldctrls = ctrls;
+
+		(void)chaining_control_remove( op, &oldctrls );
+#endif /* LDAP_CONTROL_X_CHAINING_BEHAVIOR */
+		for ( cpp = &co->co_pending; *cpp != cp; cpp = &(*cpp)->cp_next )
+			/* NO OP */ ;
+		*cpp = cp->cp_next;
+		if ( err != LDAP_SUCCESS || cp->cp_status == LDAP_CH_ERR ) {
+			/* may append to co_pending */
+			ldap_chain_pending_failed( op, &co->co_rs, cp, &sc2, err );
+			db.be_private = (void *)cp->cp_li;
+		}
+		ldap_chain_pending_free( op, cp );
+	}
+
+	op->o_ctrls = ctrls;
+#ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
+	op->o_chaining = 0;
+#endif /* LDAP_CONTROL_X_CHAINING_BEHAVIOR */
+	op->o_bd = &co->co_db;
+
+	return rc == 1;
+}
+
+/*
+ * the local search is over, but not the searches of its continuation
+ * references: keeps a copy of its result for ldap_chain_finish()
+ */
+static void
+ldap_chain_hold( Operation *op, SlapReply *rs, ldap_chain_opextra_t *co )
+{
+	SlapReply	*rs2 = &co->co_rs;
+	void		*memctx = op->o_tmpmemctx;
+	int		i;
+
+	rs2->sr_type = REP_RESULT;
+	rs2->sr_err = rs->sr_err;
+	rs2->sr_nentries = rs->sr_nentries;
+	if ( rs->sr_matched != NULL ) {
+		rs2->sr_matched = ber_strdup_x( rs->sr_matched, memctx );
+	}
+	if ( rs->sr_text != NULL ) {
+		rs2->sr_text = ber_strdup_x( rs->sr_text, memctx );
+	}
+	if ( rs->sr_ref != NULL ) {
+		ber_bvarray_dup_x( &rs2->sr_ref, rs->sr_ref, memctx );
+	}
+	if ( rs->sr_ctrls != NULL ) {
+		for ( i = 0; rs->sr_ctrls[ i ] != NULL; i++ )
+			/* count */ ;
+		rs2->sr_ctrls = op->o_tmpalloc( ( i + 1 ) * sizeof( LDAPControl * ), memctx );
+		for ( i = 0; rs->sr_ctrls[ i ] != NULL; i++ ) {
+			LDAPControl	*c = op->o_tmpalloc( sizeof( LDAPControl ), memctx );
+
+			c->ldctl_oid = ber_strdup_x( rs->sr_ctrls[ i ]->ldctl_oid, memctx );
+			ber_dupbv_x( &c->ldctl_value, &rs->sr_ctrls[ i ]->ldctl_value, memctx );
+			c->ldctl_iscritical = rs->sr_ctrls[ i ]->ldctl_iscritical;
+			rs2->sr_ctrls[ i ] = c;
+		}
+		rs2->sr_ctrls[ i ] = NULL;
+	}
+	co->co_held = 1;
+}
+
+/*
+ * all the searches of the continuation references are over: sends
+ * the result of the local search and frees the operation
+ */
+static void
+ldap_chain_finish( Operation *op, ldap_chain_opextra_t *co )
+{
+	void		*ctx = op->o_threadctx,
+			*memctx = op->o_tmpmemctx;
+
+	LDAP_SLIST_REMOVE( &op->o_extra, &co->co_oe, OpExtra, oe_next );
+	ldap_pvt_thread_mutex_unlock( &co->co_mutex );
+	ldap_pvt_thread_mutex_destroy( &co->co_mutex );
+
+	/* as in ldap_chain_response(), give the remaining callbacks
+	 * a chance */
+	op->o_bd = &co->co_db;
+	op->o_callback = co->co_sc->sc_next;
+	send_ldap_result( op, &co->co_rs );
+
+	connection_op_finish( op );
+	slap_op_free( op, ctx );
+	slap_sl_mem_setctx( ctx, NULL );
+	slap_sl_mem_destroy( (void *)1, memctx );
+}
+
+/*
+ * daemon event loop callback: responses to the search of cp may be
+ * available.  Nothing is done until the thread that ran the local
+ * search is done with the operation; the last search to be over
+ * completes it
+ */
+static int
+ldap_chain_pending_step( void *ctx, ldap_back_search_t *ls, void *arg )
+{
+	ldap_chain_pending_t	*cp = (ldap_chain_pending_t *)arg;
+	ldap_chain_opextra_t	*co = cp->cp_co;
+	Operation		*op = co->co_op;
+	int			rc;
+
+	ldap_pvt_thread_mutex_lock( &co->co_mutex );
+	if ( !co->co_resumed ) {
+		/* ldap_chain_handoff() will have it looked at */
+		ldap_pvt_thread_mutex_unlock( &co->co_mutex );
+		return 0;
+	}
+
+	op->o_threadctx = ctx;
+	op->o_tid = ldap_pvt_thread_pool_tid( ctx );
+	slap_sl_mem_setctx( ctx, op->o_tmpmemctx );
+
+	rc = ldap_chain_pending_collect( op, cp );
+	if ( rc && co->co_pending == NULL ) {
+		ldap_chain_finish( op, co );
+		return 1;
+	}
+
+	slap_sl_mem_setctx( ctx, NULL );
+	ldap_pvt_thread_mutex_unlock( &co->co_mutex );
+
+	return rc;
+}
+
+/*
+ * called by connection_operation() once the thread that ran the local
+ * search is done with the operation, which from now on belongs to
+ * ldap_chain_pending_step()
+ */
+static void
+ldap_chain_handoff( void *key, void *arg )
+{
+	ldap_chain_opextra_t	*co = (ldap_chain_opextra_t *)arg;
+	ldap_chain_pending_t	*cp;
+
+	ldap_pvt_thread_mutex_lock( &co->co_mutex );
+	co->co_resumed = 1;
+	for ( cp = co->co_pending; cp != NULL; cp = cp->cp_next ) {
+		ldap_back_search_wakeup( cp->cp_ls );
+	}
+	ldap_pvt_thread_mutex_unlock( &co->co_mutex );
+}
+
 static int
 ldap_chain_search(
 	Operation	*op,
@@ -684,14 +1170,17 @@ ldap_chain_search(
 	ldap_chain_t	*lc = (ldap_chain_t *)on->on_bi.bi_private;
 	ldapinfo_t	li = { 0 }, *lip = NULL;
 	struct berval	bvuri[ 2 ] = { { 0 } };
+	ldap_chain_opextra_t	*co;
 
 	struct berval	odn = op->o_req_dn,
 			ondn = op->o_req_ndn;
 	Entry		*save_entry = rs->sr_entry;
 	slap_mask_t	save_flags = rs->sr_flags;
+	BerVarray	oref = ref;
 
 	int		rc = LDAP_OTHER,
-			first_rc = -1;
+			first_rc = -1,
+			deferred = 0;
 
 #ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
 	LDAPControl	**ctrls = NULL;
@@ -828,65 +1317,46 @@ ldap_chain_search(
 
 		ber_str2bv( li.li_uri, 0, 0, &li.li_bvuri[ 0 ] );
 
-		/* Searches for a ldapinfo in the avl tree */
-		ldap_pvt_thread_mutex_lock( &lc->lc_lai.lai_mutex );
-		lip = (ldapinfo_t *)avl_find( lc->lc_lai.lai_tree, 
-			(caddr_t)&li, ldap_chain_uri_cmp );
-		ldap_pvt_thread_mutex_unlock( &lc->lc_lai.lai_mutex );
-
-		if ( lip != NULL ) {
-			op->o_bd->be_private = (void *)lip;
-
-			Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_search: ref=\"%s\": URI=\"%s\" found in cache\n",
-				op->o_log_prefix, ref->bv_val, li.li_uri );
-
-		} else {
-			/* if none is found, create a temporary... */
-			rc = ldap_chain_db_init_one( op->o_bd );
-			if ( rc != 0 ) {
-				Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_search: ref=\"%s\" unable to init back-ldap for URI=\"%s\"\n",
-					op->o_log_prefix, ref->bv_val, li.li_uri );
-				goto cleanup;
-			}
-			lip = (ldapinfo_t *)op->o_bd->be_private;
-			lip->li_uri = li.li_uri;
-			lip->li_bvuri = bvuri;
-			rc = ldap_chain_db_open_one( op->o_bd );
-			if ( rc != 0 ) {
-				Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_search: ref=\"%s\" unable to open back-ldap for URI=\"%s\"\n",
-					op->o_log_prefix, ref->bv_val, li.li_uri );
-				lip->li_uri = NULL;
-				lip->li_bvuri = NULL;
-				(void)ldap_chain_db_destroy_one( op->o_bd, NULL );
-				goto cleanup;
-			}
-
-			if ( LDAP_CHAIN_CACHE_URI( lc ) ) {
-				ldap_pvt_thread_mutex_lock( &lc->lc_lai.lai_mutex );
-				if ( avl_insert( &lc->lc_lai.lai_tree,
-					(caddr_t)lip, ldap_chain_uri_cmp, ldap_chain_uri_dup ) )
-				{
-					/* someone just inserted another;
-					 * don't bother, use this and then
-					 * just free it */
-					temporary = 1;
-				}
-				ldap_pvt_thread_mutex_unlock( &lc->lc_lai.lai_mutex );
-
-			} else {
-				temporary = 1;
-			}
-
-			Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_search: ref=\"%s\" %s\n",
-				op->o_log_prefix, ref->bv_val, temporary ? "temporary" : "caching" );
+		rc = ldap_chain_li_get( op, lc, &li, ref, "ldap_chain_search", &temporary );
+		if ( rc != 0 ) {
+			goto cleanup;
 		}
+		lip = (ldapinfo_t *)op->o_bd->be_private;
 
 		lb->lb_op_type = op_search;
 		lb->lb_depth = depth + 1;
 
 		/* FIXME: should we also copy filter and scope?
 		 * according to RFC3296, no */
-		rc = lback->bi_op_search( op, &rs2 );
+		/* a temporary instance does not outlive this call,
+		 * so its reference is chased right away */
+		if ( depth == 0 && !temporary
+			&& ( co = ldap_chain_opextra_get( op, on ) ) != NULL )
+		{
+			ldap_chain_pending_t	*cp;
+			ldap_back_search_t	*ls;
+
+			/* just send it; the responses are collected from
+			 * the daemon event loop, along with those of the
+			 * other continuation references */
+			cp = op->o_tmpcalloc( 1, sizeof( ldap_chain_pending_t ), op->o_tmpmemctx );
+			cp->cp_co = co;
+			rc = ldap_back_search_deferred( op, &rs2,
+				ldap_chain_pending_step, cp, &ls );
+			if ( ls != NULL ) {
+				ldap_chain_defer( op, lc, cp, ls,
+					&free_dn, &tmp_oq_search,
+					oref, ref + 1 - oref, save_entry );
+				lb->lb_status = LDAP_CH_RES;
+				deferred = 1;
+
+			} else {
+				op->o_tmpfree( cp, op->o_tmpmemctx );
+			}
+
+		} else {
+			rc = lback->bi_op_search( op, &rs2 );
+		}
 		if ( first_rc == -1 ) {
 			first_rc = rc;
 		}
@@ -924,7 +1394,9 @@ further_cleanup:;
 		op->oq_search = save_oq_search;
 		
 		if ( rc == LDAP_SUCCESS && rs2.sr_err == LDAP_SUCCESS ) {
-			*rs = rs2;
+			if ( !deferred ) {
+				*rs = rs2;
+			}
 			break;
 		}
 
@@ -932,7 +1404,14 @@ further_cleanup:;
 	}
 
 #ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
-	(void)chaining_control_remove( op, &ctrls );
+	if ( deferred && op->o_ctrls != ctrls ) {
+		/* released once the responses have been collected */
+		op->o_ctrls = ctrls;
+		op->o_chaining = 0;
+
+	} else {
+		(void)chaining_control_remove( op, &ctrls );
+	}
 #endif /* LDAP_CONTROL_X_CHAINING_BEHAVIOR */
 
 	rs->sr_type = REP_SEARCHREF;
@@ -974,6 +1453,16 @@ ldap_chain_response( Operation *op, SlapReply *rs )
 	ber_len_t	chain_shift = 0;
 #endif /* LDAP_CONTROL_X_CHAINING_BEHAVIOR */
 
+	if ( rs->sr_type == REP_RESULT && op->o_tag == LDAP_REQ_SEARCH ) {
+		ldap_chain_opextra_t	*co = ldap_chain_opextra_get( op, on );
+
+		/* the continuation references being chased come first */
+		if ( co != NULL && co->co_pending != NULL ) {
+			ldap_chain_hold( op, rs, co );
+			return 0;
+		}
+	}
+
 	if ( rs->sr_err != LDAP_REFERRAL && rs->sr_type != REP_SEARCHREF ) {
 		return SLAP_CB_CONTINUE;
 	}
@@ -1189,6 +1678,76 @@ dont_chain:;
 	return rc;
 }
 
+/*
+ * with chain-concurrent-refs, the searches of the continuation
+ * references returned by the local search are sent as they come, and
+ * their responses are collected from the daemon event loop: the local
+ * search returns SLAPD_ASYNCOP as soon as it is over, rather than
+ * blocking the thread until the last remote search is, and the result
+ * is sent by whoever collects the last responses
+ */
+static int
+ldap_chain_op_search( Operation *op, SlapReply *rs )
+{
+	slap_overinst		*on = (slap_overinst *)op->o_bd->bd_info;
+	ldap_chain_t		*lc = (ldap_chain_t *)on->on_bi.bi_private;
+	ldap_chain_opextra_t	*co;
+	slap_callback		*sc;
+	int			rc;
+
+	/* only a client search whose callbacks are those of overlay
+	 * stacks may outlive the calling thread */
+	if ( !LDAP_CHAIN_CONCURRENT_REFS( lc )
+		|| op->o_conn == NULL
+		|| op->o_conn->c_conn_idx == -1
+		|| op->o_callback == NULL
+		|| op->o_callback->sc_private != (void *)on->on_info
+		|| ldap_chain_opextra_get( op, on ) != NULL )
+	{
+		return SLAP_CB_CONTINUE;
+	}
+	for ( sc = op->o_callback; sc != NULL; sc = sc->sc_next ) {
+		if ( sc->sc_response != op->o_callback->sc_response ) {
+			return SLAP_CB_CONTINUE;
+		}
+	}
+
+	co = op->o_tmpcalloc( 1, sizeof( ldap_chain_opextra_t ), op->o_tmpmemctx );
+	co->co_oe.oe_key = (void *)on;
+	co->co_op = op;
+	co->co_db = *op->o_bd;
+	co->co_db.be_flags &= ~SLAP_DBFLAG_MONITORING;
+	co->co_sc = op->o_callback;
+	ldap_pvt_thread_mutex_init( &co->co_mutex );
+	LDAP_SLIST_INSERT_HEAD( &op->o_extra, &co->co_oe, oe_next );
+
+	rc = overlay_op_walk( op, rs, op_search, on->on_info, on->on_next );
+
+	if ( co->co_pending == NULL ) {
+		LDAP_SLIST_REMOVE( &op->o_extra, &co->co_oe, OpExtra, oe_next );
+		ldap_pvt_thread_mutex_destroy( &co->co_mutex );
+		op->o_tmpfree( co, op->o_tmpmemctx );
+		return rc;
+	}
+
+	if ( !co->co_held ) {
+		/* the local search did not send its result */
+		co->co_rs.sr_type = REP_RESULT;
+		co->co_rs.sr_err = op->o_abandon ? SLAPD_ABANDON : LDAP_OTHER;
+	}
+
+	Debug( LDAP_DEBUG_TRACE, "%s ldap_chain_op_search: "
+		"continuation references handed over to the event loop\n",
+		op->o_log_prefix );
+
+	/* from now on the operation belongs to ldap_chain_pending_step() */
+	slap_sl_mem_setctx( op->o_threadctx, NULL );
+	slap_op_handoff( op, ldap_chain_handoff, co );
+	rs->sr_err = SLAPD_ASYNCOP;
+
+	return rs->sr_err;
+}
+
 #ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
 static int
 ldap_chain_parse_ctrl(
@@ -1225,6 +1784,7 @@ enum {
 	CH_CACHE_URI,
 	CH_MAX_DEPTH,
 	CH_RETURN_ERR,
+	CH_CONCURRENT_REFS,
 
 	CH_LAST
 };
@@ -1264,6 +1824,12 @@ static ConfigTable chaincfg[] = {
 			"DESC 'Errors are returned instead of the original referral' "
 			"EQUALITY booleanMatch "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "chain-concurrent-refs", "TRUE/FALSE",
+		2, 2, 0, ARG_MAGIC|ARG_ON_OFF|CH_CONCURRENT_REFS, chain_cf_gen,
+		"( OLcfgOvAt:3.5 NAME 'olcChainConcurrentRefs' "
+			"DESC 'Continuation references of a search are chased concurrently' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -1278,7 +1844,8 @@ static ConfigOCs chainocs[] = {
 #endif /* LDAP_CONTROL_X_CHAINING_BEHAVIOR */
 			"olcChainCacheURI $ "
 			"olcChainMaxReferralDepth $ "
-			"olcChainReturnError "
+			"olcChainReturnError $ "
+			"olcChainConcurrentRefs "
 			") )",
 		Cft_Overlay, chaincfg, NULL, chain_cfadd },
 	{ "( OLcfgOvOc:3.2 "
@@ -1573,6 +2140,10 @@ chain_cf_gen( ConfigArgs *c )
 			c->value_int = LDAP_CHAIN_RETURN_ERR( lc );
 			break;
 
+		case CH_CONCURRENT_REFS:
+			c->value_int = LDAP_CHAIN_CONCURRENT_REFS( lc );
+			break;
+
 		default:
 			assert( 0 );
 			rc = 1;
@@ -1596,6 +2167,10 @@ chain_cf_gen( ConfigArgs *c )
 			lc->lc_flags &= ~LDAP_CHAIN_F_RETURN_ERR;
 			break;
 
+		case CH_CONCURRENT_REFS:
+			lc->lc_flags &= ~LDAP_CHAIN_F_CONCURRENT_REFS;
+			break;
+
 		default:
 			return 1;
 		}
@@ -1748,6 +2323,14 @@ chain_cf_gen( ConfigArgs *c )
 		}
 		break;
 
+	case CH_CONCURRENT_REFS:
+		if ( c->value_int ) {
+			lc->lc_flags |= LDAP_CHAIN_F_CONCURRENT_REFS;
+		} else {
+			lc->lc_flags &= ~LDAP_CHAIN_F_CONCURRENT_REFS;
+		}
+		break;
+
 	default:
 		assert( 0 );
 		return 1;
@@ -1778,9 +2361,12 @@ ldap_chain_db_init(
 	memset( lc, 0, sizeof( ldap_chain_t ) );
 	lc->lc_max_depth = 1;
 	ldap_pvt_thread_mutex_init( &lc->lc_lai.lai_mutex );
+	ldap_pvt_thread_mutex_init( &lc->lc_stats.cs_mutex );
 
 	on->on_bi.bi_private = (void *)lc;
 
+	(void)ldap_back_chain_monitor_db_init( be );
+
 	return 0;
 }
 
@@ -2002,6 +2588,10 @@ ldap_chain_db_open(
 	rc = ldap_chain_db_func( be, db_open );
 	SLAP_DBFLAGS( be ) |= monitoring;
 
+	if ( rc == 0 && !( slapMode & SLAP_TOOL_MODE ) ) {
+		rc = ldap_back_chain_monitor_db_open( be, on, &lc->lc_stats );
+	}
+
 	return rc;
 }
 
@@ -2010,6 +2600,11 @@ ldap_chain_db_close(
 	BackendDB	*be,
 	ConfigReply	*cr )
 {
+	slap_overinst	*on = (slap_overinst *) be->bd_info;
+	ldap_chain_t	*lc = (ldap_chain_t *)on->on_bi.bi_private;
+
+	(void)ldap_back_chain_monitor_db_close( be, &lc->lc_stats );
+
 #ifdef LDAP_CONTROL_X_CHAINING_BEHAVIOR
 #ifdef SLAP_CONFIG_DELETE
 	overlay_unregister_control( be, LDAP_CONTROL_X_CHAINING_BEHAVIOR );
@@ -2033,6 +2628,7 @@ ldap_chain_db_destroy(
 	if ( lc ) {
 		avl_free( lc->lc_lai.lai_tree, NULL );
 		ldap_pvt_thread_mutex_destroy( &lc->lc_lai.lai_mutex );
+		ldap_pvt_thread_mutex_destroy( &lc->lc_stats.cs_mutex );
 		ch_free( lc );
 	}
 
@@ -2348,6 +2944,8 @@ chain_initialize( void )
 
 	ldapchain.on_bi.bi_connection_destroy = ldap_chain_connection_destroy;
 
+	ldapchain.on_bi.bi_op_search = ldap_chain_op_search;
+
 	ldapchain.on_response = ldap_chain_response;
 
 	ldapchain.on_bi.bi_cf_ocs = chainocs;
@@ -70,6 +70,9 @@ enum {
 
 	LDAP_BACK_CFG_OMIT_UNKNOWN_SCHEMA,
 
+	LDAP_BACK_CFG_ASYNC_SEARCH,
+	LDAP_BACK_CFG_IDASSERT_POOLMAX,
+
 	LDAP_BACK_CFG_LAST
 };
 
@@ -310,6 +313,24 @@ static ConfigTable ldapcfg[] = {
 			"SYNTAX OMsDirectoryString "
 			"SINGLE-VALUE )",
 		NULL, NULL },
+	{ "async-search", "true|FALSE", 2, 2, 0,
+		ARG_MAGIC|ARG_ON_OFF|LDAP_BACK_CFG_ASYNC_SEARCH,
+		ldap_back_cf_gen, "( OLcfgDbAt:3.30 "
+			"NAME 'olcDbAsyncSearch' "
+			"DESC 'Collect search responses from the event loop instead of a waiting thread' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean "
+			"SINGLE-VALUE )",
+		NULL, NULL },
+	{ "idassert-pool-max", "<n>", 2, 2, 0,
+		ARG_MAGIC|ARG_INT|LDAP_BACK_CFG_IDASSERT_POOLMAX,
+		ldap_back_cf_gen, "( OLcfgDbAt:3.31 "
+			"NAME 'olcDbIDAssertPoolMax' "
+			"DESC 'Max size of the pool of connections shared by proxyAuthz operations' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger "
+			"SINGLE-VALUE )",
+		NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED,
 		NULL, NULL, NULL, NULL }
 };
@@ -346,6 +367,8 @@ static ConfigOCs ldapocs[] = {
 			"$ olcDbNoUndefFilter "
 			"$ olcDbOnErr "
 			"$ olcDbKeepalive "
+			"$ olcDbAsyncSearch "
+			"$ olcDbIDAssertPoolMax "
 		") )",
 		 	Cft_Database, ldapcfg},
 	{ NULL, 0, NULL }
@@ -1342,6 +1365,17 @@ ldap_back_cf_gen( ConfigArgs *c )
 			c->value_int = LDAP_BACK_OMIT_UNKNOWN_SCHEMA( li );
 			break;
 
+		case LDAP_BACK_CFG_ASYNC_SEARCH:
+			c->value_int = LDAP_BACK_ASYNC_SEARCH( li );
+			break;
+
+		case LDAP_BACK_CFG_IDASSERT_POOLMAX:
+			if ( li->li_conn_mux_max == 0 ) {
+				return 1;
+			}
+			c->value_int = li->li_conn_mux_max;
+			break;
+
 		case LDAP_BACK_CFG_ONERR:
 			enum_to_verb( onerr_mode, li->li_flags & LDAP_BACK_F_ONERR_STOP, &bv );
 			if ( BER_BVISNULL( &bv )) {
@@ -1513,6 +1547,14 @@ ldap_back_cf_gen( ConfigArgs *c )
 			li->li_flags &= ~LDAP_BACK_F_OMIT_UNKNOWN_SCHEMA;
 			break;
 
+		case LDAP_BACK_CFG_ASYNC_SEARCH:
+			li->li_flags &= ~LDAP_BACK_F_ASYNC_SEARCH;
+			break;
+
+		case LDAP_BACK_CFG_IDASSERT_POOLMAX:
+			li->li_conn_mux_max = 0;
+			break;
+
 		case LDAP_BACK_CFG_ONERR:
 			li->li_flags &= ~LDAP_BACK_F_ONERR_STOP;
 			break;
@@ -2035,6 +2077,35 @@ done_url:;
 		slap_keepalive_parse( ber_bvstrdup(c->argv[1]),
 				 &li->li_tls.sb_keepalive, 0, 0, 0);
 		break;
+
+	case LDAP_BACK_CFG_ASYNC_SEARCH:
+		if ( c->value_int ) {
+			li->li_flags |= LDAP_BACK_F_ASYNC_SEARCH;
+			if ( LDAP_BACK_ISOPEN( li ) ) {
+				ldap_back_search_task_start( c->be );
+			}
+
+		} else {
+			li->li_flags &= ~LDAP_BACK_F_ASYNC_SEARCH;
+		}
+		break;
+
+	case LDAP_BACK_CFG_IDASSERT_POOLMAX:
+		if ( c->value_int < 0
+			|| c->value_int > LDAP_BACK_CONN_PRIV_MAX )
+		{
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"invalid max size "
+				"of idassert connections pool \"%s\" "
+				"in \"idassert-pool-max <n> "
+				"(must be between 0 and %d)\"",
+				c->argv[ 1 ],
+				LDAP_BACK_CONN_PRIV_MAX );
+			Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+			return 1;
+		}
+		li->li_conn_mux_max = c->value_int;
+		break;
 		
 	default:
 		/* FIXME: try to catch inconsistencies */
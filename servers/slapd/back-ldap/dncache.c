@@ -0,0 +1,375 @@
+/* dncache.c - DN to target cache for back-meta and back-asyncmeta */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 1999-2020 The OpenLDAP Foundation.
+ * Portions Copyright 2001-2003 Pierangelo Masarati.
+ * Portions Copyright 1999-2003 Howard Chu.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+/* ACKNOWLEDGEMENTS:
+ * This work was initially developed by the Howard Chu for inclusion
+ * in OpenLDAP Software and subsequently enhanced by Pierangelo
+ * Masarati.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+#include <ac/string.h>
+
+#include "slap.h"
+#include "back-ldap.h"
+
+/*
+ * The dncache maps an entry to the target that holds it.
+ *
+ * Each shard keeps its entries both in an AVL tree, for lookup,
+ * and in a circular list walked by the CLOCK hand, for eviction.
+ * A hit sets the entry's reference bit; when a bounded shard is
+ * full, the hand clears reference bits until it finds an entry
+ * that was not used since the last sweep, and recycles it.
+ * New entries start unreferenced, so the DNs of a large search
+ * that are never looked up again go first.
+ */
+
+typedef struct ldap_dncache_entry_t {
+	struct berval			de_ndn;
+	int				de_target;
+	int				de_referenced;
+	time_t				de_lastupdated;
+
+	struct ldap_dncache_entry_t	*de_next;
+	struct ldap_dncache_entry_t	*de_prev;
+} ldap_dncache_entry_t;
+
+static int
+ldap_back_dncache_cmp(
+	const void	*c1,
+	const void	*c2 )
+{
+	const ldap_dncache_entry_t	*cc1 = c1;
+	const ldap_dncache_entry_t	*cc2 = c2;
+
+	/*
+	 * case sensitive, because the dn MUST be normalized
+	 */
+	return ber_bvcmp( &cc1->de_ndn, &cc2->de_ndn );
+}
+
+static ldap_dncache_shard_t *
+ldap_back_dncache_shard(
+	ldap_dncache_t	*cache,
+	struct berval	*ndn )
+{
+	unsigned	h = 2166136261U;
+	ber_len_t	i;
+
+	/* FNV-1a */
+	for ( i = 0; i < ndn->bv_len; i++ ) {
+		h ^= (unsigned char)ndn->bv_val[ i ];
+		h *= 16777619U;
+	}
+
+	return &cache->dc_shards[ h % LDAP_DNCACHE_SHARDS ];
+}
+
+/* insert right behind the hand, i.e. the last one it will visit */
+static void
+ldap_back_dncache_link(
+	ldap_dncache_shard_t	*ds,
+	ldap_dncache_entry_t	*e )
+{
+	if ( ds->ds_hand == NULL ) {
+		e->de_next = e->de_prev = e;
+		ds->ds_hand = e;
+
+	} else {
+		e->de_next = ds->ds_hand;
+		e->de_prev = ds->ds_hand->de_prev;
+		e->de_prev->de_next = e;
+		ds->ds_hand->de_prev = e;
+	}
+	ds->ds_num++;
+}
+
+static void
+ldap_back_dncache_unlink(
+	ldap_dncache_shard_t	*ds,
+	ldap_dncache_entry_t	*e )
+{
+	if ( e->de_next == e ) {
+		ds->ds_hand = NULL;
+
+	} else {
+		e->de_prev->de_next = e->de_next;
+		e->de_next->de_prev = e->de_prev;
+		if ( ds->ds_hand == e ) {
+			ds->ds_hand = e->de_next;
+		}
+	}
+	ds->ds_num--;
+}
+
+/* unlink and free; shard must be locked */
+static void
+ldap_back_dncache_drop(
+	ldap_dncache_shard_t	*ds,
+	ldap_dncache_entry_t	*e )
+{
+	ldap_back_dncache_unlink( ds, e );
+	(void)avl_delete( &ds->ds_tree, (caddr_t)e, ldap_back_dncache_cmp );
+	ch_free( e );
+}
+
+static void
+ldap_back_dncache_evict(
+	ldap_dncache_shard_t	*ds )
+{
+	ldap_dncache_entry_t	*e = ds->ds_hand;
+
+	assert( e != NULL );
+
+	while ( e->de_referenced ) {
+		e->de_referenced = 0;
+		e = e->de_next;
+	}
+	ds->ds_hand = e;
+
+	ldap_back_dncache_drop( ds, e );
+	ds->ds_evictions++;
+}
+
+int
+ldap_back_dncache_init(
+	ldap_dncache_t	*cache )
+{
+	int		i;
+
+	for ( i = 0; i < LDAP_DNCACHE_SHARDS; i++ ) {
+		ldap_pvt_thread_mutex_init( &cache->dc_shards[ i ].ds_mutex );
+	}
+	cache->dc_size = LDAP_DNCACHE_SIZE_DEFAULT;
+
+	return 0;
+}
+
+void
+ldap_back_dncache_destroy(
+	ldap_dncache_t	*cache )
+{
+	int		i;
+
+	for ( i = 0; i < LDAP_DNCACHE_SHARDS; i++ ) {
+		ldap_dncache_shard_t	*ds = &cache->dc_shards[ i ];
+
+		ldap_pvt_thread_mutex_lock( &ds->ds_mutex );
+		if ( ds->ds_tree ) {
+			avl_free( ds->ds_tree, ch_free );
+			ds->ds_tree = NULL;
+		}
+		ds->ds_hand = NULL;
+		ds->ds_num = 0;
+		ldap_pvt_thread_mutex_unlock( &ds->ds_mutex );
+		ldap_pvt_thread_mutex_destroy( &ds->ds_mutex );
+	}
+}
+
+/*
+ * ldap_back_dncache_get_target
+ *
+ * returns the target a dn belongs to, or LDAP_DNCACHE_TARGET_NONE
+ * in case the dn is not in the cache
+ */
+int
+ldap_back_dncache_get_target(
+	ldap_dncache_t	*cache,
+	struct berval	*ndn )
+{
+	ldap_dncache_shard_t	*ds;
+	ldap_dncache_entry_t	tmp_entry,
+				*entry;
+	int			target = LDAP_DNCACHE_TARGET_NONE;
+
+	assert( cache != NULL );
+	assert( ndn != NULL );
+
+	ds = ldap_back_dncache_shard( cache, ndn );
+	tmp_entry.de_ndn = *ndn;
+
+	ldap_pvt_thread_mutex_lock( &ds->ds_mutex );
+	entry = (ldap_dncache_entry_t *)avl_find( ds->ds_tree,
+			(caddr_t)&tmp_entry, ldap_back_dncache_cmp );
+
+	if ( entry != NULL ) {
+		/*
+		 * if cache->dc_ttl < 0, cache never expires;
+		 * if cache->dc_ttl = 0 no cache is used; shouldn't get here
+		 * else, cache is used with ttl
+		 */
+		if ( cache->dc_ttl < 0
+			|| entry->de_lastupdated + cache->dc_ttl > slap_get_time() )
+		{
+			target = entry->de_target;
+			entry->de_referenced = 1;
+
+		} else {
+			ldap_back_dncache_drop( ds, entry );
+		}
+	}
+
+	if ( target == LDAP_DNCACHE_TARGET_NONE ) {
+		ds->ds_misses++;
+
+	} else {
+		ds->ds_hits++;
+	}
+	ldap_pvt_thread_mutex_unlock( &ds->ds_mutex );
+
+	return target;
+}
+
+/*
+ * ldap_back_dncache_update_entry
+ *
+ * updates target and lastupdated of an entry if it exists,
+ * otherwise it gets created, possibly recycling an entry of the
+ * shard that was not used recently; returns -1 in case of error
+ */
+int
+ldap_back_dncache_update_entry(
+	ldap_dncache_t	*cache,
+	struct berval	*ndn,
+	int		target )
+{
+	ldap_dncache_shard_t	*ds;
+	ldap_dncache_entry_t	tmp_entry,
+				*entry;
+	time_t			curr_time = 0L;
+	unsigned long		max = 0;
+	int			err = 0;
+
+	assert( cache != NULL );
+	assert( ndn != NULL );
+
+	/*
+	 * if cache->dc_ttl < 0, cache never expires;
+	 * if cache->dc_ttl = 0 no cache is used; shouldn't get here
+	 * else, cache is used with ttl
+	 */
+	if ( cache->dc_ttl > 0 ) {
+		curr_time = slap_get_time();
+	}
+
+	if ( cache->dc_size > 0 ) {
+		max = ( cache->dc_size + LDAP_DNCACHE_SHARDS - 1 ) / LDAP_DNCACHE_SHARDS;
+	}
+
+	ds = ldap_back_dncache_shard( cache, ndn );
+	tmp_entry.de_ndn = *ndn;
+
+	ldap_pvt_thread_mutex_lock( &ds->ds_mutex );
+	entry = (ldap_dncache_entry_t *)avl_find( ds->ds_tree,
+			(caddr_t)&tmp_entry, ldap_back_dncache_cmp );
+
+	if ( entry != NULL ) {
+		entry->de_target = target;
+		entry->de_lastupdated = curr_time;
+
+	} else {
+		while ( max > 0 && ds->ds_num >= max ) {
+			ldap_back_dncache_evict( ds );
+		}
+
+		entry = ch_malloc( sizeof( ldap_dncache_entry_t ) + ndn->bv_len + 1 );
+
+		entry->de_ndn.bv_len = ndn->bv_len;
+		entry->de_ndn.bv_val = (char *)&entry[ 1 ];
+		AC_MEMCPY( entry->de_ndn.bv_val, ndn->bv_val, ndn->bv_len );
+		entry->de_ndn.bv_val[ ndn->bv_len ] = '\0';
+
+		entry->de_target = target;
+		entry->de_referenced = 0;
+		entry->de_lastupdated = curr_time;
+
+		err = avl_insert( &ds->ds_tree, (caddr_t)entry,
+				ldap_back_dncache_cmp, avl_dup_error );
+		if ( err == 0 ) {
+			ldap_back_dncache_link( ds, entry );
+
+		} else {
+			ch_free( entry );
+		}
+	}
+	ldap_pvt_thread_mutex_unlock( &ds->ds_mutex );
+
+	return err;
+}
+
+/*
+ * ldap_back_dncache_delete_entry
+ *
+ * removes the entry of a dn, if any
+ */
+int
+ldap_back_dncache_delete_entry(
+	ldap_dncache_t	*cache,
+	struct berval	*ndn )
+{
+	ldap_dncache_shard_t	*ds;
+	ldap_dncache_entry_t	tmp_entry,
+				*entry;
+
+	assert( cache != NULL );
+	assert( ndn != NULL );
+
+	ds = ldap_back_dncache_shard( cache, ndn );
+	tmp_entry.de_ndn = *ndn;
+
+	ldap_pvt_thread_mutex_lock( &ds->ds_mutex );
+	entry = (ldap_dncache_entry_t *)avl_find( ds->ds_tree,
+			(caddr_t)&tmp_entry, ldap_back_dncache_cmp );
+	if ( entry != NULL ) {
+		ldap_back_dncache_drop( ds, entry );
+	}
+	ldap_pvt_thread_mutex_unlock( &ds->ds_mutex );
+
+	return 0;
+}
+
+/*
+ * ldap_back_dncache_stats
+ *
+ * sums up the counters of all shards, for cn=Monitor
+ */
+void
+ldap_back_dncache_stats(
+	ldap_dncache_t	*cache,
+	unsigned long	*num,
+	unsigned long	*hits,
+	unsigned long	*misses,
+	unsigned long	*evictions )
+{
+	int		i;
+
+	*num = *hits = *misses = *evictions = 0;
+
+	for ( i = 0; i < LDAP_DNCACHE_SHARDS; i++ ) {
+		ldap_dncache_shard_t	*ds = &cache->dc_shards[ i ];
+
+		ldap_pvt_thread_mutex_lock( &ds->ds_mutex );
+		*num += ds->ds_num;
+		*hits += ds->ds_hits;
+		*misses += ds->ds_misses;
+		*evictions += ds->ds_evictions;
+		ldap_pvt_thread_mutex_unlock( &ds->ds_mutex );
+	}
+}
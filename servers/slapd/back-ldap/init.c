@@ -29,6 +29,7 @@
 #include <ac/socket.h>
 
 #include "slap.h"
+#include "ldap_rq.h"
 #include "config.h"
 #include "back-ldap.h"
 
@@ -41,7 +42,15 @@ static const ldap_extra_t ldap_extra = {
 	slap_retry_info_destroy,
 	slap_retry_info_parse,
 	slap_retry_info_unparse,
-	ldap_back_connid2str
+	ldap_back_connid2str,
+	ldap_back_dncache_init,
+	ldap_back_dncache_destroy,
+	ldap_back_dncache_get_target,
+	ldap_back_dncache_update_entry,
+	ldap_back_dncache_delete_entry,
+	ldap_back_dncache_monitor_db_init,
+	ldap_back_dncache_monitor_db_open,
+	ldap_back_dncache_monitor_db_close
 };
 
 int
@@ -179,12 +188,15 @@ ldap_back_db_init( Backend *be, ConfigReply *cr )
 		LDAP_TAILQ_INIT( &li->li_conn_priv[ i ].lic_priv );
 	}
 	li->li_conn_priv_max = LDAP_BACK_CONN_PRIV_DEFAULT;
+	LDAP_TAILQ_INIT( &li->li_conn_mux );
 
 	ldap_pvt_thread_mutex_init( &li->li_counter_mutex );
 	for ( i = 0; i < SLAP_OP_LAST; i++ ) {
 		ldap_pvt_mp_init( li->li_ops_completed[ i ] );
 	}
 
+	ldap_pvt_thread_mutex_init( &li->li_async_mutex );
+
 	be->be_private = li;
 	SLAP_DBFLAGS( be ) |= SLAP_DBFLAG_NOLASTMOD;
 
@@ -254,6 +266,10 @@ ldap_back_db_open( BackendDB *be, ConfigReply *cr )
 		rc = 0;
 	}
 
+	if ( LDAP_BACK_ASYNC_SEARCH( li ) ) {
+		ldap_back_search_task_start( be );
+	}
+
 	li->li_flags |= LDAP_BACK_F_ISOPEN;
 
 	return rc;
@@ -288,6 +304,18 @@ ldap_back_db_close( Backend *be, ConfigReply *cr )
 	int		rc = 0;
 
 	if ( be->be_private ) {
+		ldapinfo_t	*li = (ldapinfo_t *)be->be_private;
+
+		if ( li->li_async_task != NULL ) {
+			ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+			if ( ldap_pvt_runqueue_isrunning( &slapd_rq, li->li_async_task ) ) {
+				ldap_pvt_runqueue_stoptask( &slapd_rq, li->li_async_task );
+			}
+			ldap_pvt_runqueue_remove( &slapd_rq, li->li_async_task );
+			ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+			li->li_async_task = NULL;
+		}
+
 		rc = ldap_back_monitor_db_close( be );
 	}
 
@@ -333,6 +361,12 @@ ldap_back_db_destroy( Backend *be, ConfigReply *cr )
 				ldap_back_conn_free( lc );
 			}
 		}
+		while ( !LDAP_TAILQ_EMPTY( &li->li_conn_mux ) ) {
+			ldapconn_t	*lc = LDAP_TAILQ_FIRST( &li->li_conn_mux );
+
+			LDAP_TAILQ_REMOVE( &li->li_conn_mux, lc, lc_q );
+			ldap_back_conn_free( lc );
+		}
 		if ( LDAP_BACK_QUARANTINE( li ) ) {
 			slap_retry_info_destroy( &li->li_quarantine );
 			ldap_pvt_thread_mutex_destroy( &li->li_quarantine_mutex );
@@ -346,6 +380,7 @@ ldap_back_db_destroy( Backend *be, ConfigReply *cr )
 			ldap_pvt_mp_clear( li->li_ops_completed[ i ] );
 		}
 		ldap_pvt_thread_mutex_destroy( &li->li_counter_mutex );
+		ldap_pvt_thread_mutex_destroy( &li->li_async_mutex );
 	}
 
 	ch_free( be->be_private );
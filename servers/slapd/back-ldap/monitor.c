@@ -36,6 +36,8 @@
 
 static ObjectClass		*oc_olmLDAPDatabase;
 static ObjectClass		*oc_olmLDAPConnection;
+static ObjectClass		*oc_olmLDAPDNCache;
+static ObjectClass		*oc_olmLDAPChain;
 
 static ObjectClass		*oc_monitorContainer;
 static ObjectClass		*oc_monitorCounterObject;
@@ -46,6 +48,18 @@ static AttributeDescription	*ad_olmDbBoundDN;
 static AttributeDescription	*ad_olmDbConnFlags;
 static AttributeDescription	*ad_olmDbConnURI;
 static AttributeDescription	*ad_olmDbPeerAddress;
+static AttributeDescription	*ad_olmDbPoolConnections;
+static AttributeDescription	*ad_olmDbPoolOperations;
+static AttributeDescription	*ad_olmDbPoolActiveOperations;
+static AttributeDescription	*ad_olmDbPoolSharedOperations;
+static AttributeDescription	*ad_olmDbPoolPeakOperations;
+static AttributeDescription	*ad_olmDbDNCacheEntries;
+static AttributeDescription	*ad_olmDbDNCacheHits;
+static AttributeDescription	*ad_olmDbDNCacheMisses;
+static AttributeDescription	*ad_olmDbDNCacheEvictions;
+static AttributeDescription	*ad_olmDbChainURICacheHits;
+static AttributeDescription	*ad_olmDbChainURICacheMisses;
+static AttributeDescription	*ad_olmDbChainDeferredSearches;
 
 /*
  * Stolen from back-monitor/operations.c
@@ -154,6 +168,90 @@ static struct {
 		"NO-USER-MODIFICATION "
 		"USAGE dSAOperation )",
 		&ad_olmDbPeerAddress },
+	{ "( olmLDAPAttributes:7 "
+		"NAME ( 'olmDbPoolConnections' ) "
+		"DESC 'monitor connections in the idassert pool' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbPoolConnections },
+	{ "( olmLDAPAttributes:8 "
+		"NAME ( 'olmDbPoolOperations' ) "
+		"DESC 'monitor operations sent over the idassert pool' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbPoolOperations },
+	{ "( olmLDAPAttributes:9 "
+		"NAME ( 'olmDbPoolActiveOperations' ) "
+		"DESC 'monitor operations in progress over the idassert pool' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbPoolActiveOperations },
+	{ "( olmLDAPAttributes:10 "
+		"NAME ( 'olmDbPoolSharedOperations' ) "
+		"DESC 'monitor operations sent over an idassert pool connection already in use' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbPoolSharedOperations },
+	{ "( olmLDAPAttributes:11 "
+		"NAME ( 'olmDbPoolPeakOperations' ) "
+		"DESC 'monitor highest number of concurrent operations over one idassert pool connection' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbPoolPeakOperations },
+	{ "( olmLDAPAttributes:12 "
+		"NAME ( 'olmDbDNCacheEntries' ) "
+		"DESC 'monitor entries in the DN to target cache' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbDNCacheEntries },
+	{ "( olmLDAPAttributes:13 "
+		"NAME ( 'olmDbDNCacheHits' ) "
+		"DESC 'monitor DN to target cache lookups that found a target' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbDNCacheHits },
+	{ "( olmLDAPAttributes:14 "
+		"NAME ( 'olmDbDNCacheMisses' ) "
+		"DESC 'monitor DN to target cache lookups that found no valid target' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbDNCacheMisses },
+	{ "( olmLDAPAttributes:15 "
+		"NAME ( 'olmDbDNCacheEvictions' ) "
+		"DESC 'monitor DN to target cache entries recycled to stay within its size' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbDNCacheEvictions },
+	{ "( olmLDAPAttributes:16 "
+		"NAME ( 'olmDbChainURICacheHits' ) "
+		"DESC 'monitor referral URIs chased by the chain overlay with a cached connection pool' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbChainURICacheHits },
+	{ "( olmLDAPAttributes:17 "
+		"NAME ( 'olmDbChainURICacheMisses' ) "
+		"DESC 'monitor referral URIs chased by the chain overlay that were not cached' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbChainURICacheMisses },
+	{ "( olmLDAPAttributes:18 "
+		"NAME ( 'olmDbChainDeferredSearches' ) "
+		"DESC 'monitor continuation references chased concurrently by the chain overlay' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmDbChainDeferredSearches },
 
 	{ NULL }
 };
@@ -179,6 +277,11 @@ static struct {
 		"SUP top AUXILIARY "
 		"MAY ( "
 			"olmDbURIList "
+			"$ olmDbPoolConnections "
+			"$ olmDbPoolOperations "
+			"$ olmDbPoolActiveOperations "
+			"$ olmDbPoolSharedOperations "
+			"$ olmDbPoolPeakOperations "
 			") )",
 		&oc_olmLDAPDatabase },
 	{ "( olmLDAPObjectClasses:2 "
@@ -191,6 +294,27 @@ static struct {
 			"$ olmDbConnPeerAddress "
 			") )",
 		&oc_olmLDAPConnection },
+	/* augments the database entry of back-meta and back-asyncmeta */
+	{ "( olmLDAPObjectClasses:3 "
+		"NAME ( 'olmLDAPDNCache' ) "
+		"SUP top AUXILIARY "
+		"MAY ( "
+			"olmDbDNCacheEntries "
+			"$ olmDbDNCacheHits "
+			"$ olmDbDNCacheMisses "
+			"$ olmDbDNCacheEvictions "
+			") )",
+		&oc_olmLDAPDNCache },
+	/* augments the entry of the chain overlay */
+	{ "( olmLDAPObjectClasses:4 "
+		"NAME ( 'olmLDAPChain' ) "
+		"SUP top AUXILIARY "
+		"MAY ( "
+			"olmDbChainURICacheHits "
+			"$ olmDbChainURICacheMisses "
+			"$ olmDbChainDeferredSearches "
+			") )",
+		&oc_olmLDAPChain },
 
 	{ NULL }
 };
@@ -225,6 +349,47 @@ ldap_back_monitor_update(
 		ldap_pvt_thread_mutex_unlock( &li->li_uri_mutex );
 	}
 
+	/* update idassert pool statistics */
+	a = attr_find( e->e_attrs, ad_olmDbPoolConnections );
+	if ( a != NULL ) {
+		struct {
+			AttributeDescription	*ad;
+			unsigned long		value;
+		}		pool[ 5 ];
+		ldapconn_t	*lc;
+		char		buf[ LDAP_PVT_INTTYPE_CHARS(unsigned long) ];
+		struct berval	bv;
+		int		i;
+
+		pool[ 0 ].ad = ad_olmDbPoolConnections;
+		pool[ 1 ].ad = ad_olmDbPoolOperations;
+		pool[ 2 ].ad = ad_olmDbPoolActiveOperations;
+		pool[ 3 ].ad = ad_olmDbPoolSharedOperations;
+		pool[ 4 ].ad = ad_olmDbPoolPeakOperations;
+
+		ldap_pvt_thread_mutex_lock( &li->li_conninfo.lai_mutex );
+		pool[ 0 ].value = li->li_conn_mux_num;
+		pool[ 1 ].value = li->li_conn_mux_ops;
+		pool[ 2 ].value = 0;
+		LDAP_TAILQ_FOREACH( lc, &li->li_conn_mux, lc_q ) {
+			pool[ 2 ].value += lc->lc_refcnt;
+		}
+		pool[ 3 ].value = li->li_conn_mux_shared;
+		pool[ 4 ].value = li->li_conn_mux_peak;
+		ldap_pvt_thread_mutex_unlock( &li->li_conninfo.lai_mutex );
+
+		bv.bv_val = buf;
+		for ( i = 0; i < 5; i++ ) {
+			a = attr_find( e->e_attrs, pool[ i ].ad );
+			if ( a == NULL ) {
+				continue;
+			}
+
+			bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", pool[ i ].value );
+			ber_bvreplace( &a->a_vals[ 0 ], &bv );
+		}
+	}
+
 	return SLAP_CB_CONTINUE;
 }
 
@@ -649,6 +814,30 @@ ldap_back_monitor_conn_init(
 			attr_normalize( a2->a_desc, a2->a_vals, &a2->a_nvals, NULL );
 		}
 
+		/* idassert pool statistics; see ldap_back_monitor_update() */
+		{
+			AttributeDescription	**pool[] = {
+				&ad_olmDbPoolConnections,
+				&ad_olmDbPoolOperations,
+				&ad_olmDbPoolActiveOperations,
+				&ad_olmDbPoolSharedOperations,
+				&ad_olmDbPoolPeakOperations,
+				NULL
+			};
+			Attribute		**ap = &a->a_next;
+			int			i;
+
+			BER_BVSTR( &bv, "0" );
+			while ( *ap != NULL ) {
+				ap = &(*ap)->a_next;
+			}
+			for ( i = 0; pool[ i ] != NULL; i++ ) {
+				*ap = attr_alloc( *pool[ i ] );
+				attr_valadd( *ap, &bv, NULL, 1 );
+				ap = &(*ap)->a_next;
+			}
+		}
+
 		cb = ch_calloc( sizeof( monitor_callback_t ), 1 );
 		cb->mc_update = ldap_back_monitor_update;
 		cb->mc_modify = ldap_back_monitor_modify;
@@ -657,8 +846,7 @@ ldap_back_monitor_conn_init(
 
 		rc = mbe->register_entry_attrs( &ms->mss_ndn, a, cb, NULL, -1, NULL );
 
-		attr_free( a->a_next );
-		attr_free( a );
+		attrs_free( a );
 
 		if ( rc != LDAP_SUCCESS )
 		{
@@ -1066,3 +1254,433 @@ ldap_back_monitor_db_destroy( BackendDB *be )
 	return 0;
 }
 
+/*
+ * DN to target cache of back-meta and back-asyncmeta:
+ * its counters are added to the database entry
+ */
+
+static int
+ldap_back_dncache_monitor_update(
+	Operation	*op,
+	SlapReply	*rs,
+	Entry		*e,
+	void		*priv )
+{
+	ldap_dncache_t	*cache = (ldap_dncache_t *)priv;
+	struct {
+		AttributeDescription	*ad;
+		unsigned long		value;
+	}		counters[ 4 ];
+	int		i;
+
+	counters[ 0 ].ad = ad_olmDbDNCacheEntries;
+	counters[ 1 ].ad = ad_olmDbDNCacheHits;
+	counters[ 2 ].ad = ad_olmDbDNCacheMisses;
+	counters[ 3 ].ad = ad_olmDbDNCacheEvictions;
+
+	ldap_back_dncache_stats( cache, &counters[ 0 ].value,
+		&counters[ 1 ].value, &counters[ 2 ].value,
+		&counters[ 3 ].value );
+
+	for ( i = 0; i < 4; i++ ) {
+		Attribute	*a;
+		char		buf[ LDAP_PVT_INTTYPE_CHARS(unsigned long) ];
+		struct berval	bv;
+
+		a = attr_find( e->e_attrs, counters[ i ].ad );
+		if ( a == NULL ) {
+			continue;
+		}
+
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", counters[ i ].value );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
+	return SLAP_CB_CONTINUE;
+}
+
+static int
+ldap_back_dncache_monitor_free(
+	Entry		*e,
+	void		**priv )
+{
+	struct berval	values[ 2 ];
+	Modification	mod = { 0 };
+	AttributeDescription *ads[] = {
+		ad_olmDbDNCacheEntries,
+		ad_olmDbDNCacheHits,
+		ad_olmDbDNCacheMisses,
+		ad_olmDbDNCacheEvictions,
+		NULL };
+
+	const char	*text;
+	char		textbuf[ SLAP_TEXT_BUFLEN ];
+
+	int		i;
+
+	/* NOTE: if slap_shutdown != 0, priv might have already been freed */
+	*priv = NULL;
+
+	/* Remove objectClass */
+	mod.sm_op = LDAP_MOD_DELETE;
+	mod.sm_desc = slap_schema.si_ad_objectClass;
+	mod.sm_values = values;
+	mod.sm_numvals = 1;
+	values[ 0 ] = oc_olmLDAPDNCache->soc_cname;
+	BER_BVZERO( &values[ 1 ] );
+
+	modify_delete_values( e, &mod, 1, &text,
+		textbuf, sizeof( textbuf ) );
+	/* don't care too much about return code... */
+
+	/* remove attrs */
+	mod.sm_values = NULL;
+	mod.sm_numvals = 0;
+	for ( i = 0; ads[ i ]; i++ ) {
+		mod.sm_desc = ads[ i ];
+		modify_delete_values( e, &mod, 1, &text,
+			textbuf, sizeof( textbuf ) );
+	}
+
+	return SLAP_CB_CONTINUE;
+}
+
+/*
+ * call from within the db_init() of back-meta and back-asyncmeta
+ */
+int
+ldap_back_dncache_monitor_db_init( BackendDB *be )
+{
+	return ldap_back_monitor_initialize();
+}
+
+/*
+ * call from within the db_open() of back-meta and back-asyncmeta
+ */
+int
+ldap_back_dncache_monitor_db_open( BackendDB *be, ldap_dncache_t *cache )
+{
+	Attribute		*a, *next;
+	monitor_callback_t	*cb = NULL;
+	int			rc = 0;
+	BackendInfo		*mi;
+	monitor_extra_t		*mbe;
+	struct berval		bv = BER_BVC( "0" );
+	AttributeDescription	*ads[] = {
+		ad_olmDbDNCacheEntries,
+		ad_olmDbDNCacheHits,
+		ad_olmDbDNCacheMisses,
+		ad_olmDbDNCacheEvictions,
+		NULL };
+	int			i;
+
+	if ( !SLAP_DBMONITORING( be ) || cache->dc_monitor_cb != NULL ) {
+		return 0;
+	}
+
+	/* check if monitor is configured and usable */
+	mi = backend_info( "monitor" );
+	if ( !mi || !mi->bi_extra || oc_olmLDAPDNCache == NULL ) {
+		SLAP_DBFLAGS( be ) ^= SLAP_DBFLAG_MONITORING;
+		return 0;
+	}
+	mbe = mi->bi_extra;
+
+	/* don't bother if monitor is not configured */
+	if ( !mbe->is_configured() ) {
+		static int warning = 0;
+
+		if ( warning++ == 0 ) {
+			Debug( LDAP_DEBUG_CONFIG, "ldap_back_dncache_monitor_db_open: "
+				"monitoring disabled; "
+				"configure monitor database to enable\n" );
+		}
+
+		return 0;
+	}
+
+	/* alloc as many as required (plus 1 for objectClass) */
+	a = attrs_alloc( 1 + 4 );
+	if ( a == NULL ) {
+		return 1;
+	}
+
+	a->a_desc = slap_schema.si_ad_objectClass;
+	attr_valadd( a, &oc_olmLDAPDNCache->soc_cname, NULL, 1 );
+	next = a->a_next;
+
+	for ( i = 0; ads[ i ] != NULL; i++ ) {
+		next->a_desc = ads[ i ];
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+	}
+
+	cb = ch_calloc( sizeof( monitor_callback_t ), 1 );
+	cb->mc_update = ldap_back_dncache_monitor_update;
+	cb->mc_free = ldap_back_dncache_monitor_free;
+	cb->mc_private = (void *)cache;
+
+	/* make sure the database is registered; then add monitor attributes */
+	BER_BVZERO( &cache->dc_monitor_ndn );
+	rc = mbe->register_database( be, &cache->dc_monitor_ndn );
+	if ( rc == 0 ) {
+		rc = mbe->register_entry_attrs( &cache->dc_monitor_ndn, a, cb,
+			NULL, -1, NULL );
+	}
+
+	if ( rc != 0 ) {
+		Debug( LDAP_DEBUG_ANY, "ldap_back_dncache_monitor_db_open: "
+			"failed to register the DN cache with back-monitor\n" );
+		ch_free( cb );
+		cb = NULL;
+	}
+
+	/* store for cleanup */
+	cache->dc_monitor_cb = (void *)cb;
+
+	/* ldap_back_dncache_monitor_free() takes care of the attributes */
+	attrs_free( a );
+
+	return rc;
+}
+
+/*
+ * call from within the db_close() of back-meta and back-asyncmeta
+ */
+int
+ldap_back_dncache_monitor_db_close( BackendDB *be, ldap_dncache_t *cache )
+{
+	if ( cache->dc_monitor_cb != NULL ) {
+		BackendInfo		*mi = backend_info( "monitor" );
+		monitor_extra_t		*mbe;
+
+		if ( mi && mi->bi_extra ) {
+			mbe = mi->bi_extra;
+			mbe->unregister_entry_callback( &cache->dc_monitor_ndn,
+				(monitor_callback_t *)cache->dc_monitor_cb,
+				NULL, 0, NULL );
+		}
+		cache->dc_monitor_cb = NULL;
+	}
+
+	return 0;
+}
+
+/*
+ * chain overlay: its counters are added to the overlay entry
+ */
+
+static int
+ldap_back_chain_monitor_update(
+	Operation	*op,
+	SlapReply	*rs,
+	Entry		*e,
+	void		*priv )
+{
+	ldap_chain_stats_t	*cs = (ldap_chain_stats_t *)priv;
+	struct {
+		AttributeDescription	*ad;
+		unsigned long		value;
+	}		counters[ 3 ];
+	int		i;
+
+	counters[ 0 ].ad = ad_olmDbChainURICacheHits;
+	counters[ 1 ].ad = ad_olmDbChainURICacheMisses;
+	counters[ 2 ].ad = ad_olmDbChainDeferredSearches;
+
+	ldap_pvt_thread_mutex_lock( &cs->cs_mutex );
+	counters[ 0 ].value = cs->cs_uri_hits;
+	counters[ 1 ].value = cs->cs_uri_misses;
+	counters[ 2 ].value = cs->cs_deferred;
+	ldap_pvt_thread_mutex_unlock( &cs->cs_mutex );
+
+	for ( i = 0; i < 3; i++ ) {
+		Attribute	*a;
+		char		buf[ LDAP_PVT_INTTYPE_CHARS(unsigned long) ];
+		struct berval	bv;
+
+		a = attr_find( e->e_attrs, counters[ i ].ad );
+		if ( a == NULL ) {
+			continue;
+		}
+
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", counters[ i ].value );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
+	return SLAP_CB_CONTINUE;
+}
+
+static int
+ldap_back_chain_monitor_free(
+	Entry		*e,
+	void		**priv )
+{
+	struct berval	values[ 2 ];
+	Modification	mod = { 0 };
+	AttributeDescription *ads[] = {
+		ad_olmDbChainURICacheHits,
+		ad_olmDbChainURICacheMisses,
+		ad_olmDbChainDeferredSearches,
+		NULL };
+
+	const char	*text;
+	char		textbuf[ SLAP_TEXT_BUFLEN ];
+
+	int		i;
+
+	/* NOTE: if slap_shutdown != 0, priv might have already been freed */
+	*priv = NULL;
+
+	/* Remove objectClass */
+	mod.sm_op = LDAP_MOD_DELETE;
+	mod.sm_desc = slap_schema.si_ad_objectClass;
+	mod.sm_values = values;
+	mod.sm_numvals = 1;
+	values[ 0 ] = oc_olmLDAPChain->soc_cname;
+	BER_BVZERO( &values[ 1 ] );
+
+	modify_delete_values( e, &mod, 1, &text,
+		textbuf, sizeof( textbuf ) );
+	/* don't care too much about return code... */
+
+	/* remove attrs */
+	mod.sm_values = NULL;
+	mod.sm_numvals = 0;
+	for ( i = 0; ads[ i ]; i++ ) {
+		mod.sm_desc = ads[ i ];
+		modify_delete_values( e, &mod, 1, &text,
+			textbuf, sizeof( textbuf ) );
+	}
+
+	return SLAP_CB_CONTINUE;
+}
+
+/*
+ * call from within the db_init() of the chain overlay
+ */
+int
+ldap_back_chain_monitor_db_init( BackendDB *be )
+{
+	if ( backend_info( "monitor" ) != NULL ) {
+		SLAP_DBFLAGS( be ) |= SLAP_DBFLAG_MONITORING;
+	}
+
+	return ldap_back_monitor_initialize();
+}
+
+/*
+ * call from within the db_open() of the chain overlay
+ */
+int
+ldap_back_chain_monitor_db_open( BackendDB *be, slap_overinst *on,
+	ldap_chain_stats_t *cs )
+{
+	Attribute		*a, *next;
+	monitor_callback_t	*cb = NULL;
+	int			rc = 0;
+	BackendInfo		*mi;
+	monitor_extra_t		*mbe;
+	struct berval		bv = BER_BVC( "0" );
+	AttributeDescription	*ads[] = {
+		ad_olmDbChainURICacheHits,
+		ad_olmDbChainURICacheMisses,
+		ad_olmDbChainDeferredSearches,
+		NULL };
+	int			i;
+
+	if ( !SLAP_DBMONITORING( be ) || cs->cs_monitor_cb != NULL ) {
+		return 0;
+	}
+
+	/* check if monitor is configured and usable */
+	mi = backend_info( "monitor" );
+	if ( !mi || !mi->bi_extra || oc_olmLDAPChain == NULL ) {
+		SLAP_DBFLAGS( be ) ^= SLAP_DBFLAG_MONITORING;
+		return 0;
+	}
+	mbe = mi->bi_extra;
+
+	/* don't bother if monitor is not configured */
+	if ( !mbe->is_configured() ) {
+		static int warning = 0;
+
+		if ( warning++ == 0 ) {
+			Debug( LDAP_DEBUG_CONFIG, "ldap_back_chain_monitor_db_open: "
+				"monitoring disabled; "
+				"configure monitor database to enable\n" );
+		}
+
+		return 0;
+	}
+
+	/* alloc as many as required (plus 1 for objectClass) */
+	a = attrs_alloc( 1 + 3 );
+	if ( a == NULL ) {
+		return 1;
+	}
+
+	a->a_desc = slap_schema.si_ad_objectClass;
+	attr_valadd( a, &oc_olmLDAPChain->soc_cname, NULL, 1 );
+	next = a->a_next;
+
+	for ( i = 0; ads[ i ] != NULL; i++ ) {
+		next->a_desc = ads[ i ];
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+	}
+
+	cb = ch_calloc( sizeof( monitor_callback_t ), 1 );
+	cb->mc_update = ldap_back_chain_monitor_update;
+	cb->mc_free = ldap_back_chain_monitor_free;
+	cb->mc_private = (void *)cs;
+
+	/* make sure the overlay is registered; then add monitor attributes */
+	BER_BVZERO( &cs->cs_monitor_ndn );
+	rc = mbe->register_overlay( be, on, &cs->cs_monitor_ndn );
+	if ( rc == 0 ) {
+		rc = mbe->register_entry_attrs( &cs->cs_monitor_ndn, a, cb,
+			NULL, -1, NULL );
+	}
+
+	if ( rc != 0 ) {
+		/* e.g. the overlay is global: chaining is not affected */
+		Debug( LDAP_DEBUG_CONFIG, "ldap_back_chain_monitor_db_open: "
+			"unable to register the chain overlay with back-monitor\n" );
+		ch_free( cb );
+		cb = NULL;
+		rc = 0;
+	}
+
+	/* store for cleanup */
+	cs->cs_monitor_cb = (void *)cb;
+
+	/* ldap_back_chain_monitor_free() takes care of the attributes */
+	attrs_free( a );
+
+	return rc;
+}
+
+/*
+ * call from within the db_close() of the chain overlay
+ */
+int
+ldap_back_chain_monitor_db_close( BackendDB *be, ldap_chain_stats_t *cs )
+{
+	if ( cs->cs_monitor_cb != NULL ) {
+		BackendInfo		*mi = backend_info( "monitor" );
+		monitor_extra_t		*mbe;
+
+		if ( mi && mi->bi_extra ) {
+			mbe = mi->bi_extra;
+			mbe->unregister_entry_callback( &cs->cs_monitor_ndn,
+				(monitor_callback_t *)cs->cs_monitor_cb,
+				NULL, 0, NULL );
+		}
+		cs->cs_monitor_cb = NULL;
+	}
+
+	return 0;
+}
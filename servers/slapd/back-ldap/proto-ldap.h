@@ -53,6 +53,13 @@ int ldap_back_map_result( SlapReply *rs );
 int ldap_back_op_result( ldapconn_t *lc, Operation *op, SlapReply *rs,
 	ber_int_t msgid, time_t timeout, ldap_back_send_t sendok );
 int ldap_back_cancel( ldapconn_t *lc, Operation *op, SlapReply *rs, ber_int_t msgid, ldap_back_send_t sendok );
+void ldap_back_search_kick( ldapinfo_t *li, ldapconn_t *lc );
+int ldap_back_search_deferred( Operation *op, SlapReply *rs,
+	ldap_back_search_step_f *step, void *arg, ldap_back_search_t **lsp );
+int ldap_back_search_collect( Operation *op, ldap_back_search_t *ls,
+	int *errp );
+void ldap_back_search_wakeup( ldap_back_search_t *ls );
+void ldap_back_search_task_start( BackendDB *be );
 
 int ldap_back_init_cf( BackendInfo *bi );
 int ldap_pbind_init_cf( BackendInfo *bi );
@@ -116,6 +123,28 @@ extern int ldap_back_monitor_db_open( BackendDB *be );
 extern int ldap_back_monitor_db_close( BackendDB *be );
 extern int ldap_back_monitor_db_destroy( BackendDB *be );
 
+extern int ldap_back_dncache_init( ldap_dncache_t *cache );
+extern void ldap_back_dncache_destroy( ldap_dncache_t *cache );
+extern int ldap_back_dncache_get_target( ldap_dncache_t *cache,
+	struct berval *ndn );
+extern int ldap_back_dncache_update_entry( ldap_dncache_t *cache,
+	struct berval *ndn, int target );
+extern int ldap_back_dncache_delete_entry( ldap_dncache_t *cache,
+	struct berval *ndn );
+extern void ldap_back_dncache_stats( ldap_dncache_t *cache,
+	unsigned long *num, unsigned long *hits,
+	unsigned long *misses, unsigned long *evictions );
+extern int ldap_back_dncache_monitor_db_init( BackendDB *be );
+extern int ldap_back_dncache_monitor_db_open( BackendDB *be,
+	ldap_dncache_t *cache );
+extern int ldap_back_dncache_monitor_db_close( BackendDB *be,
+	ldap_dncache_t *cache );
+extern int ldap_back_chain_monitor_db_init( BackendDB *be );
+extern int ldap_back_chain_monitor_db_open( BackendDB *be,
+	slap_overinst *on, ldap_chain_stats_t *cs );
+extern int ldap_back_chain_monitor_db_close( BackendDB *be,
+	ldap_chain_stats_t *cs );
+
 extern LDAP_REBIND_PROC		ldap_back_default_rebind;
 extern LDAP_URLLIST_PROC	ldap_back_default_urllist;
 
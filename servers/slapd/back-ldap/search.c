@@ -30,6 +30,7 @@
 #include <ac/time.h>
 
 #include "slap.h"
+#include "ldap_rq.h"
 #include "back-ldap.h"
 #include "../../../libraries/liblber/lber-int.h"
 
@@ -39,6 +40,9 @@ static int
 ldap_build_entry( Operation *op, LDAPMessage *e, Entry *ent,
 	 struct berval *bdn, int remove_unknown_schema );
 
+static void *
+ldap_back_search_resume( void *ctx, void *arg );
+
 
 static ObjectClass *
 oc_bvfind_undef_ex( struct berval *ocname, int flag )
@@ -140,20 +144,906 @@ ldap_back_munge_filter(
 	return gotit;
 }
 
+/*
+ * a search whose responses are collected from the daemon event loop
+ * (see "async-search"), rather than by a pool thread blocked in
+ * ldap_result(); it lives on the operation's memctx
+ */
+struct ldap_back_search_t {
+	Operation		*ls_op;
+	BackendDB		*ls_bd;
+	ldapconn_t		*ls_lc;
+	SlapReply		ls_rs;
+	ber_int_t		ls_msgid;
+	/* the frontend is done with ls_op, see ldap_back_search_handoff() */
+	int			ls_resumed;
+	/* set by the caller of ldap_back_search_deferred() */
+	ldap_back_search_step_f	*ls_step;
+	void			*ls_arg;
+	int			ls_received;
+	time_t			ls_stoptime;
+	time_t			ls_deadline;
+	char			**ls_attrs;
+	LDAPControl		**ls_ctrls;
+	struct berval		ls_filter;
+	struct ldap_back_search_t	*ls_next;
+};
+
+/*
+ * returns LDAP_SUCCESS or LDAP_INSUFFICIENT_ACCESS if the search
+ * may go on; otherwise the request is over and, where appropriate,
+ * it has been cancelled on the remote server
+ */
+static int
+ldap_back_search_entry(
+	Operation	*op,
+	SlapReply	*rs,
+	ldapconn_t	*lc,
+	ber_int_t	msgid,
+	LDAPMessage	*res )
+{
+	ldapinfo_t	*li = (ldapinfo_t *) op->o_bd->be_private;
+	Entry		ent = { 0 };
+	struct berval	bdn = BER_BVNULL;
+	LDAPMessage	*e;
+	int		rc;
+
+	e = ldap_first_entry( lc->lc_ld, res );
+	rc = ldap_build_entry( op, e, &ent, &bdn,
+				LDAP_BACK_OMIT_UNKNOWN_SCHEMA( li ) );
+	if ( rc == LDAP_SUCCESS ) {
+		ldap_get_entry_controls( lc->lc_ld, res, &rs->sr_ctrls );
+		rs->sr_entry = &ent;
+		rs->sr_attrs = op->ors_attrs;
+		rs->sr_operational_attrs = NULL;
+		rs->sr_flags = 0;
+		rs->sr_err = LDAP_SUCCESS;
+		rc = rs->sr_err = send_search_entry( op, rs );
+		if ( rs->sr_ctrls ) {
+			ldap_controls_free( rs->sr_ctrls );
+			rs->sr_ctrls = NULL;
+		}
+		rs->sr_entry = NULL;
+		rs->sr_flags = 0;
+		if ( !BER_BVISNULL( &ent.e_name ) ) {
+			assert( ent.e_name.bv_val != bdn.bv_val );
+			op->o_tmpfree( ent.e_name.bv_val, op->o_tmpmemctx );
+			BER_BVZERO( &ent.e_name );
+		}
+		if ( !BER_BVISNULL( &ent.e_nname ) ) {
+			op->o_tmpfree( ent.e_nname.bv_val, op->o_tmpmemctx );
+			BER_BVZERO( &ent.e_nname );
+		}
+		entry_clean( &ent );
+	}
+	ldap_msgfree( res );
+	switch ( rc ) {
+	case LDAP_SUCCESS:
+	case LDAP_INSUFFICIENT_ACCESS:
+		break;
+
+	default:
+		if ( rc == LDAP_UNAVAILABLE ) {
+			rc = rs->sr_err = LDAP_OTHER;
+		} else {
+			(void)ldap_back_cancel( lc, op, rs, msgid, LDAP_BACK_DONTSEND );
+		}
+		break;
+	}
+
+	return rc;
+}
+
+static void
+ldap_back_search_reference(
+	Operation	*op,
+	SlapReply	*rs,
+	ldapconn_t	*lc,
+	LDAPMessage	*res )
+{
+	ldapinfo_t	*li = (ldapinfo_t *) op->o_bd->be_private;
+	char		**references = NULL;
+	int		rc;
+
+	if ( LDAP_BACK_NOREFS( li ) ) {
+		ldap_msgfree( res );
+		return;
+	}
+
+	rc = ldap_parse_reference( lc->lc_ld, res,
+			&references, &rs->sr_ctrls, 1 );
+
+	if ( rc != LDAP_SUCCESS ) {
+		return;
+	}
+
+	/* FIXME: there MUST be at least one */
+	if ( references && references[ 0 ] && references[ 0 ][ 0 ] ) {
+		int		cnt;
+
+		for ( cnt = 0; references[ cnt ]; cnt++ )
+			/* NO OP */ ;
+
+		/* FIXME: there MUST be at least one */
+		rs->sr_ref = op->o_tmpalloc( ( cnt + 1 ) * sizeof( struct berval ),
+			op->o_tmpmemctx );
+
+		for ( cnt = 0; references[ cnt ]; cnt++ ) {
+			ber_str2bv( references[ cnt ], 0, 0, &rs->sr_ref[ cnt ] );
+		}
+		BER_BVZERO( &rs->sr_ref[ cnt ] );
+
+		/* ignore return value by now */
+		RS_ASSERT( !(rs->sr_flags & REP_ENTRY_MASK) );
+		rs->sr_entry = NULL;
+		( void )send_search_reference( op, rs );
+
+	} else {
+		Debug( LDAP_DEBUG_ANY,
+			"%s ldap_back_search: "
+			"got SEARCH_REFERENCE "
+			"with no referrals\n",
+			op->o_log_prefix );
+	}
+
+	/* cleanup */
+	if ( references ) {
+		ber_memvfree( (void **)references );
+		op->o_tmpfree( rs->sr_ref, op->o_tmpmemctx );
+		rs->sr_ref = NULL;
+	}
+
+	if ( rs->sr_ctrls ) {
+		ldap_controls_free( rs->sr_ctrls );
+		rs->sr_ctrls = NULL;
+	}
+}
+
+static void
+ldap_back_search_intermediate(
+	Operation	*op,
+	SlapReply	*rs,
+	ldapconn_t	*lc,
+	LDAPMessage	*res )
+{
+	int		rc;
+
+	/* FIXME: response controls
+	 * are passed without checks */
+	rc = ldap_parse_intermediate( lc->lc_ld,
+		res,
+		(char **)&rs->sr_rspoid,
+		&rs->sr_rspdata,
+		&rs->sr_ctrls,
+		0 );
+	ldap_msgfree( res );
+	if ( rc != LDAP_SUCCESS ) {
+		return;
+	}
+
+	slap_send_ldap_intermediate( op, rs );
+
+	if ( rs->sr_rspoid != NULL ) {
+		ber_memfree( (char *)rs->sr_rspoid );
+		rs->sr_rspoid = NULL;
+	}
+
+	if ( rs->sr_rspdata != NULL ) {
+		ber_bvfree( rs->sr_rspdata );
+		rs->sr_rspdata = NULL;
+	}
+
+	if ( rs->sr_ctrls != NULL ) {
+		ldap_controls_free( rs->sr_ctrls );
+		rs->sr_ctrls = NULL;
+	}
+}
+
+static void
+ldap_back_search_result(
+	Operation	*op,
+	SlapReply	*rs,
+	ldapconn_t	*lc,
+	LDAPMessage	*res,
+	struct berval	*match,
+	char		***references,
+	int		*freetext )
+{
+	char		*err = NULL;
+	int		rc;
+
+	rc = ldap_parse_result( lc->lc_ld, res, &rs->sr_err,
+			&match->bv_val, &err,
+			references, &rs->sr_ctrls, 1 );
+	if ( rc == LDAP_SUCCESS ) {
+		if ( err ) {
+			rs->sr_text = err;
+			*freetext = 1;
+		}
+	} else {
+		rs->sr_err = rc;
+	}
+	rs->sr_err = slap_map_api2result( rs );
+
+	/* RFC 4511: referrals can only appear
+	 * if result code is LDAP_REFERRAL */
+	if ( *references
+		&& (*references)[ 0 ]
+		&& (*references)[ 0 ][ 0 ] )
+	{
+		if ( rs->sr_err != LDAP_REFERRAL ) {
+			Debug( LDAP_DEBUG_ANY,
+				"%s ldap_back_search: "
+				"got referrals with err=%d\n",
+				op->o_log_prefix,
+				rs->sr_err );
+
+		} else {
+			int	cnt;
+
+			for ( cnt = 0; (*references)[ cnt ]; cnt++ )
+				/* NO OP */ ;
+
+			rs->sr_ref = op->o_tmpalloc( ( cnt + 1 ) * sizeof( struct berval ),
+				op->o_tmpmemctx );
+
+			for ( cnt = 0; (*references)[ cnt ]; cnt++ ) {
+				/* duplicating ...*/
+				ber_str2bv( (*references)[ cnt ], 0, 0, &rs->sr_ref[ cnt ] );
+			}
+			BER_BVZERO( &rs->sr_ref[ cnt ] );
+		}
+
+	} else if ( rs->sr_err == LDAP_REFERRAL ) {
+		Debug( LDAP_DEBUG_ANY,
+			"%s ldap_back_search: "
+			"got err=%d with null "
+			"or empty referrals\n",
+			op->o_log_prefix,
+			rs->sr_err );
+
+		rs->sr_err = LDAP_NO_SUCH_OBJECT;
+	}
+
+	if ( match->bv_val != NULL ) {
+		match->bv_len = strlen( match->bv_val );
+	}
+}
+
+/*
+ * sends the final result and releases whatever the search allocated,
+ * except for the connection
+ */
+static void
+ldap_back_search_finish(
+	Operation	*op,
+	SlapReply	*rs,
+	struct berval	*match,
+	struct berval	*filter,
+	LDAPControl	***ctrlsp,
+	char		**attrs,
+	char		**references,
+	int		freetext )
+{
+	ldapinfo_t	*li = (ldapinfo_t *) op->o_bd->be_private;
+
+	/*
+	 * Rewrite the matched portion of the search base, if required
+	 */
+	if ( !BER_BVISNULL( match ) && !BER_BVISEMPTY( match ) ) {
+		struct berval	pmatch;
+
+		if ( dnPretty( NULL, match, &pmatch, op->o_tmpmemctx ) != LDAP_SUCCESS ) {
+			pmatch.bv_val = match->bv_val;
+			match->bv_val = NULL;
+		}
+		rs->sr_matched = pmatch.bv_val;
+		rs->sr_flags |= REP_MATCHED_MUSTBEFREED;
+	}
+
+	if ( !BER_BVISNULL( match ) ) {
+		ber_memfree( match->bv_val );
+	}
+
+	if ( rs->sr_v2ref ) {
+		rs->sr_err = LDAP_REFERRAL;
+	}
+
+	if ( LDAP_BACK_QUARANTINE( li ) ) {
+		ldap_back_quarantine( op, rs );
+	}
+
+	if ( filter->bv_val != op->ors_filterstr.bv_val ) {
+		op->o_tmpfree( filter->bv_val, op->o_tmpmemctx );
+	}
+
+#if 0
+	/* let send_ldap_result play cleanup handlers (ITS#4645) */
+	if ( rc != SLAPD_ABANDON )
+#endif
+	{
+		send_ldap_result( op, rs );
+	}
+
+	(void)ldap_back_controls_free( op, rs, ctrlsp );
+
+	if ( rs->sr_ctrls ) {
+		ldap_controls_free( rs->sr_ctrls );
+		rs->sr_ctrls = NULL;
+	}
+
+	if ( rs->sr_text ) {
+		if ( freetext ) {
+			ber_memfree( (char *)rs->sr_text );
+		}
+		rs->sr_text = NULL;
+	}
+
+	if ( rs->sr_ref ) {
+		op->o_tmpfree( rs->sr_ref, op->o_tmpmemctx );
+		rs->sr_ref = NULL;
+	}
+
+	if ( references ) {
+		ber_memvfree( (void **)references );
+	}
+
+	if ( attrs ) {
+		op->o_tmpfree( attrs, op->o_tmpmemctx );
+	}
+}
+
+/*
+ * runs ldap_back_search_resume() on behalf of someone who knows
+ * responses may be sitting in the library's queue; holds a reference
+ * to lc for the duration
+ */
+static void *
+ldap_back_search_kicked( void *ctx, void *arg )
+{
+	ldapconn_t	*lc = arg;
+	ldapinfo_t	*li = lc->lc_ldapinfo;
+
+	(void)ldap_back_search_resume( ctx, lc );
+	ldap_back_release_conn( li, lc );
+
+	return NULL;
+}
+
+static void
+ldap_back_search_kick_lc( ldapinfo_t *li, ldapconn_t *lc )
+{
+	ldap_pvt_thread_mutex_lock( &li->li_conninfo.lai_mutex );
+	lc->lc_refcnt++;
+	ldap_pvt_thread_mutex_unlock( &li->li_conninfo.lai_mutex );
+
+	if ( ldap_pvt_thread_pool_submit( &connection_pool,
+			ldap_back_search_kicked, lc ) != 0 )
+	{
+		ldap_back_release_conn( li, lc );
+	}
+}
+
+/*
+ * other users of lc_ld may have read responses to asynchronous
+ * searches off the socket while waiting for their own; have them
+ * looked at
+ */
+void
+ldap_back_search_kick( ldapinfo_t *li, ldapconn_t *lc )
+{
+	ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+	if ( lc->lc_async_conn != NULL ) {
+		ldap_back_search_kick_lc( li, lc );
+	}
+	ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+}
+
+/*
+ * periodically look at the pending searches, so that time limits,
+ * timeouts and abandons are honored even if the remote server is
+ * silent
+ */
+static void *
+ldap_back_search_timeout_loop( void *ctx, void *arg )
+{
+	struct re_s	*rtask = arg;
+	ldapinfo_t	*li = rtask->arg;
+	ldapconn_t	*lc;
+
+	ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+	for ( lc = li->li_async_conns; lc != NULL; lc = lc->lc_async_next ) {
+		ldap_back_search_kick_lc( li, lc );
+	}
+	ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+
+	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+	if ( ldap_pvt_runqueue_isrunning( &slapd_rq, rtask ) ) {
+		ldap_pvt_runqueue_stoptask( &slapd_rq, rtask );
+	}
+	ldap_pvt_runqueue_resched( &slapd_rq, rtask, 0 );
+	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+
+	return NULL;
+}
+
+void
+ldap_back_search_task_start( BackendDB *be )
+{
+	ldapinfo_t	*li = (ldapinfo_t *) be->be_private;
+
+	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+	if ( li->li_async_task == NULL ) {
+		li->li_async_task = ldap_pvt_runqueue_insert( &slapd_rq, 1,
+			ldap_back_search_timeout_loop, li,
+			"ldap_back_search_timeout_loop",
+			be->be_suffix ? be->be_suffix[0].bv_val : "" );
+	}
+	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+}
+
+/*
+ * consumes the responses available for ls without blocking; returns
+ * 1 when the search is over and its result has been sent, 0 if some
+ * responses were consumed and -1 if none was available
+ */
+static int
+ldap_back_search_drain( Operation *op, ldapconn_t *lc, ldap_back_search_t *ls )
+{
+	SlapReply	*rs = &ls->ls_rs;
+	ldapinfo_t	*li = lc->lc_ldapinfo;
+	struct berval	match = BER_BVNULL;
+	char		**references = NULL;
+	int		freetext = 0;
+	int		got = 0;
+	struct timeval	tv = { 0, 0 };
+	LDAPMessage	*res;
+	int		rc;
+
+	for ( ;; ) {
+		/* check for abandon */
+		if ( op->o_abandon || LDAP_BACK_CONN_ABANDON( lc ) || slapd_shutdown ) {
+			(void)ldap_back_cancel( lc, op, rs, ls->ls_msgid, LDAP_BACK_DONTSEND );
+			if ( !op->o_abandon ) {
+				rs->sr_err = LDAP_UNAVAILABLE;
+			}
+			break;
+		}
+
+		rc = ldap_result( lc->lc_ld, ls->ls_msgid, LDAP_MSG_ONE, &tv, &res );
+		if ( rc == 0 ) {
+			time_t	now = slap_get_time();
+
+			/* check timeout */
+			if ( ls->ls_deadline != (time_t)(-1) && now > ls->ls_deadline ) {
+				(void)ldap_back_cancel( lc, op, rs, ls->ls_msgid, LDAP_BACK_DONTSEND );
+				rs->sr_text = "Operation timed out";
+				rs->sr_err = op->o_protocol >= LDAP_VERSION3 ?
+					LDAP_ADMINLIMIT_EXCEEDED : LDAP_OTHER;
+				break;
+			}
+
+			/* check time limit */
+			if ( op->ors_tlimit != SLAP_NO_LIMIT && now > ls->ls_stoptime ) {
+				(void)ldap_back_cancel( lc, op, rs, ls->ls_msgid, LDAP_BACK_DONTSEND );
+				rs->sr_err = LDAP_TIMELIMIT_EXCEEDED;
+				break;
+			}
+
+			return got ? 0 : -1;
+		}
+
+		if ( rc == -1 ) {
+			if ( !ls->ls_received || LDAP_BACK_ONERR_STOP( li ) ) {
+				rs->sr_err = LDAP_SERVER_DOWN;
+				rs->sr_err = slap_map_api2result( rs );
+			}
+			break;
+		}
+
+		/* only touch when activity actually took place... */
+		if ( li->li_idle_timeout ) {
+			lc->lc_time = op->o_time;
+		}
+		got = 1;
+		ls->ls_received = 1;
+		if ( li->li_timeout[ SLAP_OP_SEARCH ] ) {
+			ls->ls_deadline = slap_get_time() + li->li_timeout[ SLAP_OP_SEARCH ];
+		}
+
+		if ( rc == LDAP_RES_SEARCH_ENTRY ) {
+			rc = ldap_back_search_entry( op, rs, lc, ls->ls_msgid, res );
+			if ( rc != LDAP_SUCCESS && rc != LDAP_INSUFFICIENT_ACCESS ) {
+				break;
+			}
+
+		} else if ( rc == LDAP_RES_SEARCH_REFERENCE ) {
+			ldap_back_search_reference( op, rs, lc, res );
+
+		} else if ( rc == LDAP_RES_INTERMEDIATE ) {
+			ldap_back_search_intermediate( op, rs, lc, res );
+
+		} else {
+			ldap_back_search_result( op, rs, lc, res,
+				&match, &references, &freetext );
+			break;
+		}
+	}
+
+	ldap_back_search_finish( op, rs, &match, &ls->ls_filter,
+		&ls->ls_ctrls, ls->ls_attrs, references, freetext );
+
+	return 1;
+}
+
+/*
+ * consumes the responses available for ls without blocking;
+ * returns 1 when the search is over and the operation has been freed
+ */
+static int
+ldap_back_search_step( void *ctx, ldapconn_t *lc, ldap_back_search_t *ls )
+{
+	Operation	*op = ls->ls_op;
+	ldapinfo_t	*li = lc->lc_ldapinfo;
+	void		*memctx;
+	int		resumed;
+
+	ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+	resumed = ls->ls_resumed;
+	ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+	if ( !resumed ) {
+		/* the thread that sent it is still unwinding the op;
+		 * ldap_back_search_handoff() will have it looked at */
+		return 0;
+	}
+
+	op->o_bd = ls->ls_bd;
+	op->o_threadctx = ctx;
+	op->o_tid = ldap_pvt_thread_pool_tid( ctx );
+	slap_sl_mem_setctx( ctx, op->o_tmpmemctx );
+
+	if ( ldap_back_search_drain( op, lc, ls ) != 1 ) {
+		/* nothing more for now, give the memctx back */
+		slap_sl_mem_setctx( ctx, NULL );
+		return 0;
+	}
+
+	memctx = op->o_tmpmemctx;
+	connection_op_finish( op );
+	slap_op_free( op, ctx );
+	slap_sl_mem_setctx( ctx, NULL );
+	slap_sl_mem_destroy( (void *)1, memctx );
+
+	return 1;
+}
+
+/*
+ * looks at the pending searches of lc, the socket of lc_ld is
+ * readable or someone asked for them to be looked at; the caller
+ * holds a reference to lc
+ */
+static void *
+ldap_back_search_resume( void *ctx, void *arg )
+{
+	ldapconn_t		*lc = arg;
+	ldapinfo_t		*li = lc->lc_ldapinfo;
+	ldap_back_search_t	*ls, *next, *keep, **tail;
+	void			*oldctx;
+	int			ndone = 0, rc;
+
+	ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+	rc = ++lc->lc_async_active;
+	ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+	if ( rc > 1 ) {
+		/* the active instance will go around once more */
+		return NULL;
+	}
+
+	/* the searches finished below each hold a reference to lc;
+	 * keep one of our own until the last pass is over */
+	ldap_pvt_thread_mutex_lock( &li->li_conninfo.lai_mutex );
+	lc->lc_refcnt++;
+	ldap_pvt_thread_mutex_unlock( &li->li_conninfo.lai_mutex );
+
+	oldctx = slap_sl_mem_create( SLAP_SLAB_SIZE, SLAP_SLAB_STACK, ctx, 0 );
+
+	do {
+		ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+		ls = lc->lc_async;
+		lc->lc_async = NULL;
+		lc->lc_async_active = 1;
+		ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+
+		keep = NULL;
+		tail = &keep;
+		for ( ; ls != NULL; ls = next ) {
+			next = ls->ls_next;
+			if ( ls->ls_step != NULL ) {
+				/* once over, ls is gone along with
+				 * its reference to lc */
+				if ( ls->ls_step( ctx, ls, ls->ls_arg ) ) {
+					continue;
+				}
+
+			} else if ( ldap_back_search_step( ctx, lc, ls ) ) {
+				ndone++;
+				continue;
+			}
+
+			*tail = ls;
+			tail = &ls->ls_next;
+		}
+
+		ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+		/* searches queued in the meanwhile go after the survivors */
+		*tail = lc->lc_async;
+		lc->lc_async = keep;
+		if ( lc->lc_async == NULL && lc->lc_async_conn != NULL ) {
+			ldapconn_t	**lcp;
+
+			connection_client_stop( lc->lc_async_conn );
+			lc->lc_async_conn = NULL;
+			for ( lcp = &li->li_async_conns; *lcp != lc; lcp = &(*lcp)->lc_async_next )
+				/* NO OP */ ;
+			*lcp = lc->lc_async_next;
+			lc->lc_async_next = NULL;
+		}
+		rc = --lc->lc_async_active;
+		if ( rc == 0 && lc->lc_async_conn != NULL && !slapd_shutdown ) {
+			connection_client_enable( lc->lc_async_conn );
+		}
+		ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+	} while ( rc > 0 );
+
+	slap_sl_mem_setctx( ctx, oldctx );
+
+	/* drop the references of the finished searches, then ours;
+	 * lc must not be touched afterwards */
+	ldap_pvt_thread_mutex_lock( &li->li_conninfo.lai_mutex );
+	assert( lc->lc_refcnt > ndone );
+	lc->lc_refcnt -= ndone;
+	ldap_back_release_conn_lock( li, &lc, 0 );
+	ldap_pvt_thread_mutex_unlock( &li->li_conninfo.lai_mutex );
+
+	return NULL;
+}
+
+/*
+ * daemon callback: the socket of lc_ld is readable.  The search
+ * that registered the socket may have finished and released lc
+ * meanwhile, so only look at lc if it is still being watched, and
+ * hold a reference to it while the searches are resumed
+ */
+static void *
+ldap_back_search_readable( void *ctx, void *arg )
+{
+	ldapconn_t	*lc = arg, *tmplc;
+	ldapinfo_t	*li = lc->lc_ldapinfo;
+
+	ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+	for ( tmplc = li->li_async_conns; tmplc != NULL; tmplc = tmplc->lc_async_next ) {
+		if ( tmplc == lc ) {
+			ldap_pvt_thread_mutex_lock( &li->li_conninfo.lai_mutex );
+			lc->lc_refcnt++;
+			ldap_pvt_thread_mutex_unlock( &li->li_conninfo.lai_mutex );
+			break;
+		}
+	}
+	ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+	if ( tmplc == NULL ) {
+		return NULL;
+	}
+
+	(void)ldap_back_search_resume( ctx, lc );
+	ldap_back_release_conn( li, lc );
+
+	return NULL;
+}
+
+/*
+ * called by connection_operation() once the thread that sent the
+ * search has returned SLAPD_ASYNCOP and is done with the operation,
+ * which from now on belongs to ldap_back_search_resume()
+ */
+static void
+ldap_back_search_handoff( void *key, void *arg )
+{
+	ldap_back_search_t	*ls = arg;
+	ldapconn_t		*lc = ls->ls_lc;
+	ldapinfo_t		*li = lc->lc_ldapinfo;
+
+	ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+	ls->ls_resumed = 1;
+	ldap_back_search_kick_lc( li, lc );
+	ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+}
+
+/*
+ * keeps track of a search whose request has been sent
+ */
+static ldap_back_search_t *
+ldap_back_search_new(
+	Operation	*op,
+	ldapconn_t	*lc,
+	ber_int_t	msgid,
+	time_t		stoptime,
+	char		**attrs,
+	LDAPControl	**ctrls,
+	struct berval	*filter )
+{
+	ldapinfo_t		*li = (ldapinfo_t *) op->o_bd->be_private;
+	ldap_back_search_t	*ls;
+
+	ls = op->o_tmpcalloc( 1, sizeof( ldap_back_search_t ), op->o_tmpmemctx );
+	ls->ls_op = op;
+	ls->ls_bd = op->o_bd;
+	ls->ls_lc = lc;
+	ls->ls_rs.sr_type = REP_RESULT;
+	ls->ls_rs.sr_err = LDAP_SUCCESS;
+	ls->ls_msgid = msgid;
+	ls->ls_stoptime = stoptime;
+	ls->ls_deadline = (time_t)(-1);
+	if ( li->li_timeout[ SLAP_OP_SEARCH ] ) {
+		ls->ls_deadline = slap_get_time() + li->li_timeout[ SLAP_OP_SEARCH ];
+	}
+	ls->ls_attrs = attrs;
+	ls->ls_ctrls = ctrls;
+	ls->ls_filter = *filter;
+
+	return ls;
+}
+
+/*
+ * has the daemon event loop watch the connection of ls, and look
+ * at ls when responses may be available
+ */
+static int
+ldap_back_search_queue( ldapconn_t *lc, ldap_back_search_t *ls )
+{
+	ldapinfo_t	*li = lc->lc_ldapinfo;
+	ber_socket_t	s;
+
+	if ( ldap_get_option( lc->lc_ld, LDAP_OPT_DESC, &s ) != LDAP_OPT_SUCCESS
+		|| s == AC_SOCKET_INVALID )
+	{
+		return LDAP_OTHER;
+	}
+
+	ldap_pvt_thread_mutex_lock( &li->li_async_mutex );
+	if ( lc->lc_async_conn == NULL ) {
+		lc->lc_async_conn = connection_client_setup( s,
+			ldap_back_search_readable, lc );
+		if ( lc->lc_async_conn == NULL ) {
+			ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+			return LDAP_OTHER;
+		}
+		lc->lc_async_next = li->li_async_conns;
+		li->li_async_conns = lc;
+	}
+	ls->ls_next = lc->lc_async;
+	lc->lc_async = ls;
+	connection_client_enable( lc->lc_async_conn );
+	ldap_pvt_thread_mutex_unlock( &li->li_async_mutex );
+
+	return LDAP_SUCCESS;
+}
+
+/*
+ * hands a search whose request has been sent over to the daemon
+ * event loop; on success the operation, the reference to lc and
+ * the search's allocations belong to ldap_back_search_resume()
+ */
+static int
+ldap_back_search_async(
+	Operation	*op,
+	ldapconn_t	*lc,
+	ber_int_t	msgid,
+	time_t		stoptime,
+	char		**attrs,
+	LDAPControl	**ctrls,
+	struct berval	*filter )
+{
+	ldapinfo_t		*li = (ldapinfo_t *) op->o_bd->be_private;
+	ldap_back_search_t	*ls;
+
+	/* only a plain client search may outlive the calling thread;
+	 * callers that installed callbacks (overlays included), internal
+	 * operations and copies of the database expect the results by
+	 * the time ldap_back_search() returns. Referrals chased by
+	 * libldap would arrive on connections we do not watch */
+	if ( !LDAP_BACK_ASYNC_SEARCH( li )
+		|| li->li_async_task == NULL
+		|| LDAP_BACK_CHASE_REFERRALS( li )
+		|| op->o_callback != NULL
+		|| op->o_bd != op->o_bd->bd_self
+		|| op->o_conn == NULL
+		|| op->o_conn->c_conn_idx == -1
+		|| ( LDAP_BACK_SAVECRED( li ) && SLAP_IS_AUTHZ_BACKEND( op ) ) )
+	{
+		return LDAP_OTHER;
+	}
+
+	ls = ldap_back_search_new( op, lc, msgid, stoptime,
+		attrs, ctrls, filter );
+	if ( ldap_back_search_queue( lc, ls ) != LDAP_SUCCESS ) {
+		op->o_tmpfree( ls, op->o_tmpmemctx );
+		return LDAP_OTHER;
+	}
+
+	Debug( LDAP_DEBUG_TRACE, "%s ldap_back_search: "
+		"msgid=%d handed over to the event loop\n",
+		op->o_log_prefix, msgid );
+
+	/* the memctx goes with the operation; the responses are not
+	 * looked at before ldap_back_search_handoff() is called, and
+	 * they may already be queued by the library, so it kicks lc */
+	slap_sl_mem_setctx( op->o_threadctx, NULL );
+	slap_op_handoff( op, ldap_back_search_handoff, ls );
+
+	return LDAP_SUCCESS;
+}
+
+/*
+ * has ls looked at, e.g. because its step function returned 0
+ * without looking at it
+ */
+void
+ldap_back_search_wakeup( ldap_back_search_t *ls )
+{
+	ldapconn_t	*lc = ls->ls_lc;
+
+	ldap_back_search_kick( lc->lc_ldapinfo, lc );
+}
+
+/*
+ * collects the responses of a search started by
+ * ldap_back_search_deferred() without blocking, from its step
+ * function; returns 1 when the search is over: its result has been
+ * sent, its code is in *errp, the connection released and ls freed.
+ * Otherwise returns 0 if some responses were consumed, -1 if none
+ * was available
+ */
 int
-ldap_back_search(
+ldap_back_search_collect(
+	Operation		*op,
+	ldap_back_search_t	*ls,
+	int			*errp )
+{
+	ldapconn_t	*lc = ls->ls_lc;
+	ldapinfo_t	*li = lc->lc_ldapinfo;
+	int		rc;
+
+	rc = ldap_back_search_drain( op, lc, ls );
+	if ( rc != 1 ) {
+		return rc;
+	}
+	*errp = ls->ls_rs.sr_err;
+
+	if ( LDAP_BACK_ASYNC_SEARCH( li ) ) {
+		ldap_back_search_kick( li, lc );
+	}
+	ldap_back_release_conn( li, lc );
+	op->o_tmpfree( ls, op->o_tmpmemctx );
+
+	return 1;
+}
+
+static int
+ldap_back_do_search(
 		Operation	*op,
-		SlapReply	*rs )
+		SlapReply	*rs,
+		ldap_back_search_step_f *step,
+		void		*arg,
+		ldap_back_search_t **lsp )
 {
 	ldapinfo_t	*li = (ldapinfo_t *) op->o_bd->be_private;
 
 	ldapconn_t	*lc = NULL;
 	struct timeval	tv;
 	time_t		stoptime = (time_t)(-1);
-	LDAPMessage	*res,
-			*e;
+	LDAPMessage	*res;
 	int		rc = 0,
-			msgid; 
+			msgid;
 	struct berval	match = BER_BVNULL,
 			filter = BER_BVNULL;
 	int		i, x;
@@ -162,8 +1052,6 @@ ldap_back_search(
 	int		do_retry = 1, dont_retry = 0;
 	LDAPControl	**ctrls = NULL;
 	char		**references = NULL;
-	int		remove_unknown_schema =
-				 LDAP_BACK_OMIT_UNKNOWN_SCHEMA (li);
 
 	rs_assert_ready( rs );
 	rs->sr_flags &= ~REP_ENTRY_MASK; /* paranoia, we can set rs = non-entry */
@@ -209,7 +1097,7 @@ ldap_back_search(
 			goto finish;
 		}
 
-		if ( i > 0 ) {	
+		if ( i > 0 ) {
 			for ( i = 0; !BER_BVISNULL( &op->ors_attrs[i].an_name ); i++, j++ ) {
 				attrs[ j ] = op->ors_attrs[i].an_name.bv_val;
 			}
@@ -274,7 +1162,7 @@ retry:
 			} else {
 				rc = ldap_back_op_result( lc, op, rs, msgid, 0, LDAP_BACK_DONTSEND );
 			}
-				
+
 			goto finish;
 
 		case LDAP_FILTER_ERROR:
@@ -293,7 +1181,7 @@ retry:
 			rs->sr_err = LDAP_SUCCESS;
 			rs->sr_text = NULL;
 			goto finish;
-		
+
 		default:
 			rs->sr_err = slap_map_api2result( rs );
 			rs->sr_text = NULL;
@@ -301,6 +1189,37 @@ retry:
 		}
 	}
 
+	/* the caller collects the responses from the event loop */
+	if ( step != NULL ) {
+		ldap_back_search_t	*ls;
+
+		ls = ldap_back_search_new( op, lc, msgid, stoptime,
+			attrs, ctrls, &filter );
+		ls->ls_resumed = 1;
+		ls->ls_step = step;
+		ls->ls_arg = arg;
+		if ( ldap_back_search_queue( lc, ls ) == LDAP_SUCCESS ) {
+			/* time limits and abandons are checked periodically */
+			ldap_back_search_task_start( op->o_bd );
+			*lsp = ls;
+			return rs->sr_err;
+		}
+
+		op->o_tmpfree( ls, op->o_tmpmemctx );
+		(void)ldap_back_cancel( lc, op, rs, msgid, LDAP_BACK_DONTSEND );
+		rs->sr_err = LDAP_OTHER;
+		rs->sr_text = "Unable to watch the connection";
+		goto finish;
+	}
+
+	/* let the daemon event loop collect the responses, if allowed */
+	if ( ldap_back_search_async( op, lc, msgid, stoptime,
+			attrs, ctrls, &filter ) == LDAP_SUCCESS )
+	{
+		rs->sr_err = SLAPD_ASYNCOP;
+		return rs->sr_err;
+	}
+
 	/* if needed, initialize timeout */
 	if ( li->li_timeout[ SLAP_OP_SEARCH ] ) {
 		if ( tv.tv_sec == 0 || tv.tv_sec > li->li_timeout[ SLAP_OP_SEARCH ] ) {
@@ -365,200 +1284,22 @@ retry:
 
 
 		if ( rc == LDAP_RES_SEARCH_ENTRY ) {
-			Entry		ent = { 0 };
-			struct berval	bdn = BER_BVNULL;
-
 			do_retry = 0;
-
-			e = ldap_first_entry( lc->lc_ld, res );
-			rc = ldap_build_entry( op, e, &ent, &bdn,
-						remove_unknown_schema);
-			if ( rc == LDAP_SUCCESS ) {
-				ldap_get_entry_controls( lc->lc_ld, res, &rs->sr_ctrls );
-				rs->sr_entry = &ent;
-				rs->sr_attrs = op->ors_attrs;
-				rs->sr_operational_attrs = NULL;
-				rs->sr_flags = 0;
-				rs->sr_err = LDAP_SUCCESS;
-				rc = rs->sr_err = send_search_entry( op, rs );
-				if ( rs->sr_ctrls ) {
-					ldap_controls_free( rs->sr_ctrls );
-					rs->sr_ctrls = NULL;
-				}
-				rs->sr_entry = NULL;
-				rs->sr_flags = 0;
-				if ( !BER_BVISNULL( &ent.e_name ) ) {
-					assert( ent.e_name.bv_val != bdn.bv_val );
-					op->o_tmpfree( ent.e_name.bv_val, op->o_tmpmemctx );
-					BER_BVZERO( &ent.e_name );
-				}
-				if ( !BER_BVISNULL( &ent.e_nname ) ) {
-					op->o_tmpfree( ent.e_nname.bv_val, op->o_tmpmemctx );
-					BER_BVZERO( &ent.e_nname );
-				}
-				entry_clean( &ent );
-			}
-			ldap_msgfree( res );
-			switch ( rc ) {
-			case LDAP_SUCCESS:
-			case LDAP_INSUFFICIENT_ACCESS:
-				break;
-
-			default:
-				if ( rc == LDAP_UNAVAILABLE ) {
-					rc = rs->sr_err = LDAP_OTHER;
-				} else {
-					(void)ldap_back_cancel( lc, op, rs, msgid, LDAP_BACK_DONTSEND );
-				}
+			rc = ldap_back_search_entry( op, rs, lc, msgid, res );
+			if ( rc != LDAP_SUCCESS && rc != LDAP_INSUFFICIENT_ACCESS ) {
 				goto finish;
 			}
 
 		} else if ( rc == LDAP_RES_SEARCH_REFERENCE ) {
-			if ( LDAP_BACK_NOREFS( li ) ) {
-				ldap_msgfree( res );
-				continue;
-			}
-
 			do_retry = 0;
-			rc = ldap_parse_reference( lc->lc_ld, res,
-					&references, &rs->sr_ctrls, 1 );
-
-			if ( rc != LDAP_SUCCESS ) {
-				continue;
-			}
-
-			/* FIXME: there MUST be at least one */
-			if ( references && references[ 0 ] && references[ 0 ][ 0 ] ) {
-				int		cnt;
-
-				for ( cnt = 0; references[ cnt ]; cnt++ )
-					/* NO OP */ ;
-
-				/* FIXME: there MUST be at least one */
-				rs->sr_ref = op->o_tmpalloc( ( cnt + 1 ) * sizeof( struct berval ),
-					op->o_tmpmemctx );
-
-				for ( cnt = 0; references[ cnt ]; cnt++ ) {
-					ber_str2bv( references[ cnt ], 0, 0, &rs->sr_ref[ cnt ] );
-				}
-				BER_BVZERO( &rs->sr_ref[ cnt ] );
-
-				/* ignore return value by now */
-				RS_ASSERT( !(rs->sr_flags & REP_ENTRY_MASK) );
-				rs->sr_entry = NULL;
-				( void )send_search_reference( op, rs );
-
-			} else {
-				Debug( LDAP_DEBUG_ANY,
-					"%s ldap_back_search: "
-					"got SEARCH_REFERENCE "
-					"with no referrals\n",
-					op->o_log_prefix );
-			}
-
-			/* cleanup */
-			if ( references ) {
-				ber_memvfree( (void **)references );
-				op->o_tmpfree( rs->sr_ref, op->o_tmpmemctx );
-				rs->sr_ref = NULL;
-				references = NULL;
-			}
-
-			if ( rs->sr_ctrls ) {
-				ldap_controls_free( rs->sr_ctrls );
-				rs->sr_ctrls = NULL;
-			}
+			ldap_back_search_reference( op, rs, lc, res );
 
 		} else if ( rc == LDAP_RES_INTERMEDIATE ) {
-			/* FIXME: response controls
-			 * are passed without checks */
-			rc = ldap_parse_intermediate( lc->lc_ld,
-				res,
-				(char **)&rs->sr_rspoid,
-				&rs->sr_rspdata,
-				&rs->sr_ctrls,
-				0 );
-			if ( rc != LDAP_SUCCESS ) {
-				continue;
-			}
-
-			slap_send_ldap_intermediate( op, rs );
-
-			if ( rs->sr_rspoid != NULL ) {
-				ber_memfree( (char *)rs->sr_rspoid );
-				rs->sr_rspoid = NULL;
-			}
-
-			if ( rs->sr_rspdata != NULL ) {
-				ber_bvfree( rs->sr_rspdata );
-				rs->sr_rspdata = NULL;
-			}
-
-			if ( rs->sr_ctrls != NULL ) {
-				ldap_controls_free( rs->sr_ctrls );
-				rs->sr_ctrls = NULL;
-			}
+			ldap_back_search_intermediate( op, rs, lc, res );
 
 		} else {
-			char		*err = NULL;
-
-			rc = ldap_parse_result( lc->lc_ld, res, &rs->sr_err,
-					&match.bv_val, &err,
-					&references, &rs->sr_ctrls, 1 );
-			if ( rc == LDAP_SUCCESS ) {
-				if ( err ) {
-					rs->sr_text = err;
-					freetext = 1;
-				}
-			} else {
-				rs->sr_err = rc;
-			}
-			rs->sr_err = slap_map_api2result( rs );
-
-			/* RFC 4511: referrals can only appear
-			 * if result code is LDAP_REFERRAL */
-			if ( references 
-				&& references[ 0 ]
-				&& references[ 0 ][ 0 ] )
-			{
-				if ( rs->sr_err != LDAP_REFERRAL ) {
-					Debug( LDAP_DEBUG_ANY,
-						"%s ldap_back_search: "
-						"got referrals with err=%d\n",
-						op->o_log_prefix,
-						rs->sr_err );
-
-				} else {
-					int	cnt;
-
-					for ( cnt = 0; references[ cnt ]; cnt++ )
-						/* NO OP */ ;
-				
-					rs->sr_ref = op->o_tmpalloc( ( cnt + 1 ) * sizeof( struct berval ),
-						op->o_tmpmemctx );
-
-					for ( cnt = 0; references[ cnt ]; cnt++ ) {
-						/* duplicating ...*/
-						ber_str2bv( references[ cnt ], 0, 0, &rs->sr_ref[ cnt ] );
-					}
-					BER_BVZERO( &rs->sr_ref[ cnt ] );
-				}
-
-			} else if ( rs->sr_err == LDAP_REFERRAL ) {
-				Debug( LDAP_DEBUG_ANY,
-					"%s ldap_back_search: "
-					"got err=%d with null "
-					"or empty referrals\n",
-					op->o_log_prefix,
-					rs->sr_err );
-
-				rs->sr_err = LDAP_NO_SUCH_OBJECT;
-			}
-
-			if ( match.bv_val != NULL ) {
-				match.bv_len = strlen( match.bv_val );
-			}
-
+			ldap_back_search_result( op, rs, lc, res,
+				&match, &references, &freetext );
 			rc = 0;
 			break;
 		}
@@ -593,73 +1334,14 @@ retry:
 		}
 	}
 
-	/*
-	 * Rewrite the matched portion of the search base, if required
-	 */
-	if ( !BER_BVISNULL( &match ) && !BER_BVISEMPTY( &match ) ) {
-		struct berval	pmatch;
-
-		if ( dnPretty( NULL, &match, &pmatch, op->o_tmpmemctx ) != LDAP_SUCCESS ) {
-			pmatch.bv_val = match.bv_val;
-			match.bv_val = NULL;
-		}
-		rs->sr_matched = pmatch.bv_val;
-		rs->sr_flags |= REP_MATCHED_MUSTBEFREED;
-	}
-
 finish:;
-	if ( !BER_BVISNULL( &match ) ) {
-		ber_memfree( match.bv_val );
-	}
-
-	if ( rs->sr_v2ref ) {
-		rs->sr_err = LDAP_REFERRAL;
-	}
-
-	if ( LDAP_BACK_QUARANTINE( li ) ) {
-		ldap_back_quarantine( op, rs );
-	}
-
-	if ( filter.bv_val != op->ors_filterstr.bv_val ) {
-		op->o_tmpfree( filter.bv_val, op->o_tmpmemctx );
-	}
-
-#if 0
-	/* let send_ldap_result play cleanup handlers (ITS#4645) */
-	if ( rc != SLAPD_ABANDON )
-#endif
-	{
-		send_ldap_result( op, rs );
-	}
-
-	(void)ldap_back_controls_free( op, rs, &ctrls );
-
-	if ( rs->sr_ctrls ) {
-		ldap_controls_free( rs->sr_ctrls );
-		rs->sr_ctrls = NULL;
-	}
-
-	if ( rs->sr_text ) {
-		if ( freetext ) {
-			ber_memfree( (char *)rs->sr_text );
-		}
-		rs->sr_text = NULL;
-	}
-
-	if ( rs->sr_ref ) {
-		op->o_tmpfree( rs->sr_ref, op->o_tmpmemctx );
-		rs->sr_ref = NULL;
-	}
-
-	if ( references ) {
-		ber_memvfree( (void **)references );
-	}
-
-	if ( attrs ) {
-		op->o_tmpfree( attrs, op->o_tmpmemctx );
-	}
+	ldap_back_search_finish( op, rs, &match, &filter, &ctrls,
+		attrs, references, freetext );
 
 	if ( lc != NULL ) {
+		if ( LDAP_BACK_ASYNC_SEARCH( li ) ) {
+			ldap_back_search_kick( li, lc );
+		}
 		ldap_back_release_conn( li, lc );
 	}
 
@@ -673,6 +1355,35 @@ finish:;
 	return rs->sr_err;
 }
 
+int
+ldap_back_search(
+		Operation	*op,
+		SlapReply	*rs )
+{
+	return ldap_back_do_search( op, rs, NULL, NULL, NULL );
+}
+
+/*
+ * sends the request without waiting for the responses; on success,
+ * the daemon event loop calls step( ctx, *lsp, arg ) when responses
+ * may be available, which hands *lsp to ldap_back_search_collect()
+ * with op->o_bd, the request DN, scope and filter as they were here,
+ * and returns 1 once the search is over, 0 otherwise.  Otherwise,
+ * the result has been sent already and *lsp is NULL
+ */
+int
+ldap_back_search_deferred(
+		Operation	*op,
+		SlapReply	*rs,
+		ldap_back_search_step_f *step,
+		void		*arg,
+		ldap_back_search_t **lsp )
+{
+	*lsp = NULL;
+
+	return ldap_back_do_search( op, rs, step, arg, lsp );
+}
+
 static int
 ldap_build_entry(
 		Operation	*op,
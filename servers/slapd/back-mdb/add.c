@@ -36,6 +36,7 @@ mdb_add(Operation *op, SlapReply *rs )
 	MDB_cursor	*mcd;
 	ID eid, pid = 0;
 	mdb_op_info opinfo = {{{ 0 }}}, *moi = &opinfo;
+	size_t txnid;
 	int subentry;
 	int numads = mdb->mi_numads;
 
@@ -366,6 +367,7 @@ mdb_add(Operation *op, SlapReply *rs )
 			goto return_results;
 		}
 
+		txnid = mdb_txn_id( txn );
 		rs->sr_err = mdb_txn_commit( txn );
 		txn = NULL;
 		if ( rs->sr_err != 0 ) {
@@ -377,6 +379,15 @@ mdb_add(Operation *op, SlapReply *rs )
 			rs->sr_err = LDAP_OTHER;
 			goto return_results;
 		}
+		rs->sr_err = mdb_txn_durable( mdb, moi, txnid );
+		if ( rs->sr_err != 0 ) {
+			rs->sr_text = "txn_sync failed";
+			Debug( LDAP_DEBUG_ANY,
+				LDAP_XSTRING(mdb_add) ": %s : %s (%d)\n",
+				rs->sr_text, mdb_strerror(rs->sr_err), rs->sr_err );
+			rs->sr_err = LDAP_OTHER;
+			goto return_results;
+		}
 	}
 
 	Debug(LDAP_DEBUG_TRACE,
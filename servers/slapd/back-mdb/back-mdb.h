@@ -81,14 +81,33 @@ struct mdb_info {
 	void		*mi_search_stack;
 	int			mi_search_stack_depth;
 	int			mi_readers;
+	unsigned	mi_dirtylimit;
 
 	unsigned	mi_rtxn_size;
 	int			mi_txn_cp;
 	unsigned	mi_txn_cp_min;
 	unsigned	mi_txn_cp_kbyte;
+	int			mi_groupcommit;	/* batch window in usec, -1 if off */
+	int			mi_rdncompress;	/* elide pretty RDNs equal to normalized */
+	int			mi_compress;	/* id2entry codec, MDB_COMPRESS_NONE if off */
+	unsigned	mi_compress_min;	/* compress entries at least this large */
+#define	MDB_COMPRESS_NONE	0
+#define	MDB_COMPRESS_LZ4	1
+#define	MDB_COMPRESS_MIN	2048	/* about where overflow pages start */
+
+	/* online compaction */
+	unsigned	mi_compact_interval;	/* seconds between steps, 0 if off */
+	unsigned	mi_compact_pages;	/* max pages moved per step */
+	unsigned	mi_compact_pct;		/* percent free that starts a pass */
+	size_t		mi_compact_limit;	/* move pages at or above, 0 if idle */
+	int			mi_compact_db;		/* DB being swept */
+	struct berval	mi_compact_key;		/* key to resume the sweep at */
+	size_t		mi_compact_moved;
+	size_t		mi_compact_released;
 
 	struct re_s		*mi_txn_cp_task;
 	struct re_s		*mi_index_task;
+	struct re_s		*mi_compact_task;
 
 	mdb_monitor_t	mi_monitor;
 
@@ -132,6 +151,7 @@ typedef struct mdb_op_info {
 #define MOI_READER	0x01
 #define MOI_FREEIT	0x02
 #define MOI_KEEPER	0x04
+#define MOI_GROUPSYNC	0x08
 
 LDAP_END_DECL
 
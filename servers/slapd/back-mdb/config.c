@@ -37,6 +37,7 @@ enum {
 	MDB_CHKPT = 1,
 	MDB_DIRECTORY,
 	MDB_DBNOSYNC,
+	MDB_DIRTYLIMIT,
 	MDB_ENVFLAGS,
 	MDB_INDEX,
 	MDB_MAXREADERS,
@@ -45,6 +46,9 @@ enum {
 	MDB_SSTACK,
 	MDB_MULTIVAL,
 	MDB_IDLEXP,
+	MDB_GROUPCOMMIT,
+	MDB_COMPACT,
+	MDB_COMPRESS,
 };
 
 static ConfigTable mdbcfg[] = {
@@ -63,11 +67,31 @@ static ConfigTable mdbcfg[] = {
 			"DESC 'Database checkpoint interval in kbytes and minutes' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString SINGLE-VALUE )",NULL, NULL },
+	{ "compact", "interval> <pages> <percent", 4, 4, 0, ARG_MAGIC|MDB_COMPACT,
+		mdb_cf_gen, "( OLcfgDbAt:12.8 NAME 'olcDbCompact' "
+			"DESC 'Online compaction interval in seconds, pages per step, and percent free that starts a pass' "
+			"EQUALITY caseIgnoreMatch "
+			"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
+	{ "compress", "codec> <minsize", 2, 3, 0, ARG_MAGIC|MDB_COMPRESS,
+		mdb_cf_gen, "( OLcfgDbAt:12.11 NAME 'olcDbCompress' "
+			"DESC 'Codec and minimum size in bytes for compressing stored entries' "
+			"EQUALITY caseIgnoreMatch "
+			"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
 	{ "dbnosync", NULL, 1, 2, 0, ARG_ON_OFF|ARG_MAGIC|MDB_DBNOSYNC,
 		mdb_cf_gen, "( OLcfgDbAt:1.4 NAME 'olcDbNoSync' "
 			"DESC 'Disable synchronous database writes' "
 			"EQUALITY booleanMatch "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "groupcommit", "usec", 2, 2, 0, ARG_INT|ARG_MAGIC|MDB_GROUPCOMMIT,
+		mdb_cf_gen, "( OLcfgDbAt:12.7 NAME 'olcDbGroupCommit' "
+			"DESC 'Share syncs between concurrent writes, waiting usec for more to join' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "dirtylimit", "pages", 2, 2, 0, ARG_UINT|ARG_MAGIC|MDB_DIRTYLIMIT,
+		mdb_cf_gen, "( OLcfgDbAt:12.10 NAME 'olcDbDirtyLimit' "
+			"DESC 'Dirty pages a write transaction keeps in memory before spilling' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "envflags", "flags", 2, 0, 0, ARG_MAGIC|MDB_ENVFLAGS,
 		mdb_cf_gen, "( OLcfgDbAt:12.3 NAME 'olcDbEnvFlags' "
 			"DESC 'Database environment flags' "
@@ -105,6 +129,12 @@ static ConfigTable mdbcfg[] = {
 		"DESC 'Hi/Lo thresholds for splitting multivalued attr out of main blob' "
 		"EQUALITY caseIgnoreMatch "
 		"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "rdncompress", NULL, 2, 2, 0, ARG_ON_OFF|ARG_OFFSET,
+		(void *)offsetof(struct mdb_info, mi_rdncompress),
+		"( OLcfgDbAt:12.9 NAME 'olcDbRdnCompress' "
+		"DESC 'Store RDNs once in dn2id when pretty and normalized forms match' "
+		"EQUALITY booleanMatch "
+		"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ "rtxnsize", "entries", 2, 2, 0, ARG_UINT|ARG_OFFSET,
 		(void *)offsetof(struct mdb_info, mi_rtxn_size),
 		"( OLcfgDbAt:12.5 NAME 'olcDbRtxnSize' "
@@ -137,17 +167,27 @@ static ConfigOCs mdbocs[] = {
 		"MAY ( olcDbCheckpoint $ olcDbEnvFlags $ "
 		"olcDbNoSync $ olcDbIndex $ olcDbMaxReaders $ olcDbMaxSize $ "
 		"olcDbMode $ olcDbSearchStack $ olcDbMaxEntrySize $ olcDbRtxnSize $ "
-		"olcDbMultival ) )",
+		"olcDbMultival $ olcDbGroupCommit $ olcDbCompact $ "
+		"olcDbRdnCompress $ olcDbDirtyLimit $ olcDbCompress ) )",
 			Cft_Database, mdbcfg+1 },
 	{ NULL, 0, NULL }
 };
 
+static slap_verbmasks mdb_codecs[] = {
+	{ BER_BVC("none"),	MDB_COMPRESS_NONE },
+	{ BER_BVC("lz4"),	MDB_COMPRESS_LZ4 },
+	{ BER_BVNULL, 0 }
+};
+
 static slap_verbmasks mdb_envflags[] = {
 	{ BER_BVC("nosync"),	MDB_NOSYNC },
 	{ BER_BVC("nometasync"),	MDB_NOMETASYNC },
 	{ BER_BVC("writemap"),	MDB_WRITEMAP },
 	{ BER_BVC("mapasync"),	MDB_MAPASYNC },
 	{ BER_BVC("nordahead"),	MDB_NORDAHEAD },
+	{ BER_BVC("hugepage"),	MDB_HUGEPAGE },
+	{ BER_BVC("numainterleave"),	MDB_NUMAINTERLEAVE },
+	{ BER_BVC("mlockbranch"),	MDB_MLOCKBRANCH },
 	{ BER_BVNULL, 0 }
 };
 
@@ -191,6 +231,147 @@ mdb_checkpoint( void *ctx, void *arg )
 	return NULL;
 }
 
+/* Get the i'th DB swept by compaction, 0 if unused */
+static int
+mdb_compact_dbi( struct mdb_info *mdb, int i, MDB_dbi *dbi )
+{
+	if ( i < MDB_NDB ) {
+		*dbi = mdb->mi_dbis[i];
+		return 1;
+	}
+	i -= MDB_NDB;
+	if ( i < mdb->mi_nattrs ) {
+		*dbi = mdb->mi_attrs[i]->ai_dbi;
+		return 1;
+	}
+	return 0;
+}
+
+/* move pages from the end of the file to free pages below, and
+ * release the free tail, a few pages per write txn
+ */
+static void *
+mdb_compact( void *ctx, void *arg )
+{
+	struct re_s *rtask = arg;
+	BackendDB *be = rtask->arg;
+	struct mdb_info *mdb = be->be_private;
+
+	MDB_txn *txn;
+	MDB_cursor *curs;
+	MDB_val key, data;
+	MDB_dbi dbi;
+	size_t moved = 0, released = 0;
+	unsigned npages, left = mdb->mi_compact_pages;
+	int rc;
+
+	if ( !( mdb->mi_flags & MDB_IS_OPEN ) || slapd_shutdown )
+		goto done;
+
+	if ( !mdb->mi_compact_limit ) {
+		/* Start a pass if enough of the file is free */
+		MDB_envinfo mei;
+		size_t pages = 0, *iptr;
+
+		rc = mdb_txn_begin( mdb->mi_dbenv, NULL, MDB_RDONLY, &txn );
+		if ( rc )
+			goto fail;
+		rc = mdb_cursor_open( txn, 0, &curs );
+		if ( rc ) {
+			mdb_txn_abort( txn );
+			goto fail;
+		}
+		while (( rc = mdb_cursor_get( curs, &key, &data, MDB_NEXT )) == 0 ) {
+			iptr = data.mv_data;
+			pages += *iptr;
+		}
+		mdb_cursor_close( curs );
+		mdb_env_info( mdb->mi_dbenv, &mei );
+		mdb_txn_abort( txn );
+		if ( pages && pages * 100 >= ( mei.me_last_pgno + 1 ) * mdb->mi_compact_pct ) {
+			/* Aim for the live pages, with some room for the freeDB */
+			mdb->mi_compact_limit = mei.me_last_pgno + 1 - pages;
+			mdb->mi_compact_limit += mdb->mi_compact_limit / 32 + 1;
+			mdb->mi_compact_db = 0;
+			mdb->mi_compact_key.bv_len = 0;
+			Debug( LDAP_DEBUG_TRACE, LDAP_XSTRING(mdb_compact)
+				": database %s: %lu of %lu pages free, moving pages above %lu\n",
+				be->be_suffix[0].bv_val, pages, mei.me_last_pgno + 1,
+				mdb->mi_compact_limit );
+		}
+	}
+
+	rc = mdb_txn_begin( mdb->mi_dbenv, NULL, 0, &txn );
+	if ( rc )
+		goto fail;
+
+	while ( mdb->mi_compact_limit && left ) {
+		if ( !mdb_compact_dbi( mdb, mdb->mi_compact_db, &dbi )) {
+			Debug( LDAP_DEBUG_TRACE, LDAP_XSTRING(mdb_compact)
+				": database %s: pass done, %lu pages moved\n",
+				be->be_suffix[0].bv_val, mdb->mi_compact_moved + moved );
+			mdb->mi_compact_limit = 0;
+			break;
+		}
+		if ( !dbi ) {
+			mdb->mi_compact_db++;
+			continue;
+		}
+		rc = mdb_cursor_open( txn, dbi, &curs );
+		if ( rc )
+			break;
+		key.mv_data = mdb->mi_compact_key.bv_val;
+		key.mv_size = mdb->mi_compact_key.bv_len;
+		npages = left;
+		rc = mdb_cursor_compact( curs, &key, mdb->mi_compact_limit, &npages );
+		moved += npages;
+		left -= npages;
+		if ( rc == MDB_NOTFOUND ) {
+			mdb->mi_compact_db++;
+			mdb->mi_compact_key.bv_len = 0;
+			rc = 0;
+		} else if ( rc == 0 ) {
+			/* Out of budget, or out of free pages below the limit
+			 * until readers let go of the ones freed so far.
+			 */
+			struct berval bv;
+			bv.bv_val = key.mv_data;
+			bv.bv_len = key.mv_size;
+			ber_bvreplace( &mdb->mi_compact_key, &bv );
+			left = 0;
+		}
+		mdb_cursor_close( curs );
+		if ( rc )
+			break;
+	}
+
+	if ( !rc )
+		rc = mdb_txn_shrink( txn, &released );
+	if ( !rc ) {
+		rc = mdb_txn_commit( txn );
+	} else {
+		mdb_txn_abort( txn );
+	}
+	if ( !rc ) {
+		mdb->mi_compact_moved += moved;
+		mdb->mi_compact_released += released;
+		goto done;
+	}
+
+fail:
+	Debug( LDAP_DEBUG_ANY, LDAP_XSTRING(mdb_compact)
+		": database %s: compaction failed: %s (%d)\n",
+		be->be_suffix[0].bv_val, mdb_strerror(rc), rc );
+	/* Start over next time */
+	mdb->mi_compact_limit = 0;
+
+done:
+	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+	ldap_pvt_runqueue_stoptask( &slapd_rq, rtask );
+	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+	return NULL;
+}
+
 /* reindex entries on the fly */
 static void *
 mdb_online_index( void *ctx, void *arg )
@@ -369,6 +550,42 @@ mdb_cf_gen( ConfigArgs *c )
 			}
 			break;
 
+		case MDB_COMPACT:
+			if ( mdb->mi_compact_interval ) {
+				char buf[64];
+				struct berval bv;
+				bv.bv_len = snprintf( buf, sizeof(buf), "%u %u %u",
+					mdb->mi_compact_interval, mdb->mi_compact_pages,
+					mdb->mi_compact_pct );
+				if ( bv.bv_len > 0 && bv.bv_len < sizeof(buf) ) {
+					bv.bv_val = buf;
+					value_add_one( &c->rvalue_vals, &bv );
+				} else {
+					rc = 1;
+				}
+			} else {
+				rc = 1;
+			}
+			break;
+
+		case MDB_COMPRESS:
+			if ( mdb->mi_compress ) {
+				char buf[64];
+				struct berval bv, codec;
+				enum_to_verb( mdb_codecs, mdb->mi_compress, &codec );
+				bv.bv_len = snprintf( buf, sizeof(buf), "%s %u",
+					codec.bv_val, mdb->mi_compress_min );
+				if ( bv.bv_len > 0 && bv.bv_len < sizeof(buf) ) {
+					bv.bv_val = buf;
+					value_add_one( &c->rvalue_vals, &bv );
+				} else {
+					rc = 1;
+				}
+			} else {
+				rc = 1;
+			}
+			break;
+
 		case MDB_DIRECTORY:
 			if ( mdb->mi_dbenv_home ) {
 				c->value_string = ch_strdup( mdb->mi_dbenv_home );
@@ -382,6 +599,13 @@ mdb_cf_gen( ConfigArgs *c )
 				c->value_int = 1;
 			break;
 
+		case MDB_GROUPCOMMIT:
+			if ( mdb->mi_groupcommit >= 0 )
+				c->value_int = mdb->mi_groupcommit;
+			else
+				rc = 1;
+			break;
+
 		case MDB_ENVFLAGS:
 			if ( mdb->mi_dbenv_flags ) {
 				mask_to_verbs( mdb_envflags, mdb->mi_dbenv_flags, &c->rvalue_vals );
@@ -402,6 +626,13 @@ mdb_cf_gen( ConfigArgs *c )
 			c->value_int = mdb->mi_readers;
 			break;
 
+		case MDB_DIRTYLIMIT:
+			if ( mdb->mi_dirtylimit )
+				c->value_uint = mdb->mi_dirtylimit;
+			else
+				rc = 1;
+			break;
+
 		case MDB_MAXSIZE:
 			c->value_ulong = mdb->mi_mapsize;
 			break;
@@ -429,6 +660,14 @@ mdb_cf_gen( ConfigArgs *c )
 		case MDB_MAXSIZE:
 			break;
 
+		case MDB_DIRTYLIMIT:
+			mdb->mi_dirtylimit = 0;
+			if ( mdb->mi_flags & MDB_IS_OPEN ) {
+				mdb->mi_flags |= MDB_RE_OPEN;
+				config_push_cleanup( c, mdb_cf_cleanup );
+			}
+			break;
+
 		case MDB_CHKPT:
 			if ( mdb->mi_txn_cp_task ) {
 				struct re_s *re = mdb->mi_txn_cp_task;
@@ -441,6 +680,22 @@ mdb_cf_gen( ConfigArgs *c )
 			}
 			mdb->mi_txn_cp = 0;
 			break;
+		case MDB_COMPACT:
+			if ( mdb->mi_compact_task ) {
+				struct re_s *re = mdb->mi_compact_task;
+				mdb->mi_compact_task = NULL;
+				ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+				if ( ldap_pvt_runqueue_isrunning( &slapd_rq, re ) )
+					ldap_pvt_runqueue_stoptask( &slapd_rq, re );
+				ldap_pvt_runqueue_remove( &slapd_rq, re );
+				ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+			}
+			mdb->mi_compact_interval = 0;
+			mdb->mi_compact_limit = 0;
+			break;
+		case MDB_COMPRESS:
+			mdb->mi_compress = MDB_COMPRESS_NONE;
+			break;
 		case MDB_DIRECTORY:
 			mdb->mi_flags |= MDB_RE_OPEN;
 			ch_free( mdb->mi_dbenv_home );
@@ -453,6 +708,10 @@ mdb_cf_gen( ConfigArgs *c )
 			mdb->mi_dbenv_flags &= ~MDB_NOSYNC;
 			break;
 
+		case MDB_GROUPCOMMIT:
+			mdb->mi_groupcommit = -1;
+			break;
+
 		case MDB_ENVFLAGS:
 			if ( c->valx == -1 ) {
 				int i;
@@ -683,6 +942,68 @@ mdb_cf_gen( ConfigArgs *c )
 		}
 		} break;
 
+	case MDB_COMPACT: {
+		unsigned interval, pages, pct;
+		if ( lutil_atoux( &interval, c->argv[1], 0 ) != 0 || !interval ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"invalid interval \"%s\"", c->argv[1] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+			return 1;
+		}
+		if ( lutil_atoux( &pages, c->argv[2], 0 ) != 0 || !pages ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"invalid pages \"%s\"", c->argv[2] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+			return 1;
+		}
+		if ( lutil_atoux( &pct, c->argv[3], 0 ) != 0 || pct > 100 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"invalid percent \"%s\"", c->argv[3] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+			return 1;
+		}
+		mdb->mi_compact_interval = interval;
+		mdb->mi_compact_pages = pages;
+		mdb->mi_compact_pct = pct;
+		if ( slapMode & SLAP_SERVER_MODE ) {
+			struct re_s *re = mdb->mi_compact_task;
+			if ( re ) {
+				re->interval.tv_sec = interval;
+			} else {
+				if ( c->be->be_suffix == NULL || BER_BVISNULL( &c->be->be_suffix[0] ) ) {
+					snprintf( c->cr_msg, sizeof( c->cr_msg ),
+						"\"compact\" must occur after \"suffix\"" );
+					Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+					return 1;
+				}
+				ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+				mdb->mi_compact_task = ldap_pvt_runqueue_insert( &slapd_rq,
+					interval, mdb_compact, c->be,
+					LDAP_XSTRING(mdb_compact), c->be->be_suffix[0].bv_val );
+				ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+			}
+		}
+		} break;
+
+	case MDB_COMPRESS: {
+		unsigned minsize = MDB_COMPRESS_MIN;
+		int i = verb_to_mask( c->argv[1], mdb_codecs );
+		if ( BER_BVISNULL( &mdb_codecs[i].word )) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"unknown codec \"%s\"", c->argv[1] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+			return 1;
+		}
+		if ( c->argc > 2 && lutil_atoux( &minsize, c->argv[2], 0 ) != 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"invalid minsize \"%s\"", c->argv[2] );
+			Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+			return 1;
+		}
+		mdb->mi_compress = mdb_codecs[i].mask;
+		mdb->mi_compress_min = minsize;
+		} break;
+
 	case MDB_DIRECTORY: {
 		FILE *f;
 		char *ptr, *testpath;
@@ -726,6 +1047,17 @@ mdb_cf_gen( ConfigArgs *c )
 		}
 		break;
 
+	case MDB_GROUPCOMMIT:
+		if ( c->value_int < 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"%s: invalid window \"%s\"",
+				c->argv[0], c->argv[1] );
+			Debug( LDAP_DEBUG_ANY, "%s %s\n", c->log, c->cr_msg );
+			return 1;
+		}
+		mdb->mi_groupcommit = c->value_int;
+		break;
+
 	case MDB_ENVFLAGS: {
 		int i, j;
 		for ( i=1; i<c->argc; i++ ) {
@@ -789,6 +1121,14 @@ mdb_cf_gen( ConfigArgs *c )
 		mdb->mi_search_stack_depth = c->value_int;
 		break;
 
+	case MDB_DIRTYLIMIT:
+		mdb->mi_dirtylimit = c->value_uint;
+		if ( mdb->mi_flags & MDB_IS_OPEN ) {
+			mdb->mi_flags |= MDB_RE_OPEN;
+			config_push_cleanup( c, mdb_cf_cleanup );
+		}
+		break;
+
 	case MDB_MAXREADERS:
 		mdb->mi_readers = c->value_int;
 		if ( mdb->mi_flags & MDB_IS_OPEN ) {
@@ -35,6 +35,7 @@ mdb_delete( Operation *op, SlapReply *rs )
 	MDB_txn		*txn = NULL;
 	MDB_cursor	*mc;
 	mdb_op_info opinfo = {{{ 0 }}}, *moi = &opinfo;
+	size_t txnid;
 
 	LDAPControl **preread_ctrl = NULL;
 	LDAPControl *ctrls[SLAP_MAX_RESPONSE_CONTROLS];
@@ -358,6 +359,8 @@ mdb_delete( Operation *op, SlapReply *rs )
 			}
 			parent_is_leaf = 1;
 		}
+		/* MDB_NOTFOUND only means p has no other children */
+		rs->sr_err = LDAP_SUCCESS;
 		mdb_entry_return( op, p );
 		p = NULL;
 	}
@@ -371,7 +374,10 @@ mdb_delete( Operation *op, SlapReply *rs )
 			txn = NULL;
 			goto return_results;
 		} else {
+			txnid = mdb_txn_id( txn );
 			rs->sr_err = mdb_txn_commit( txn );
+			if ( rs->sr_err == 0 )
+				rs->sr_err = mdb_txn_durable( mdb, moi, txnid );
 		}
 		txn = NULL;
 	}
@@ -39,6 +39,11 @@
  * Also each child node contains a count of the number of entries in
  * its subtree, appended after its entryID.
  *
+ * With rdncompress enabled, a pretty RDN that is byte-identical to its
+ * normalized RDN is stored as an empty string and read back from nrdn.
+ * An empty rdn never occurs otherwise, except when nrdn is also empty,
+ * so readers handle both forms regardless of the setting.
+ *
  * The diskNode is a variable length structure. This definition is not
  * directly usable for in-memory manipulation.
  */
@@ -50,6 +55,10 @@ typedef struct diskNode {
 	/* unsigned char nsubs[sizeof(ID)];	in child nodes only */
 } diskNode;
 
+/* The pretty RDN of a diskNode, given its normalized RDN length */
+#define	DN2ID_RDN(d, nrlen)	(*((d)->nrdn+(nrlen)+1) ? \
+	(d)->nrdn+(nrlen)+1 : (d)->nrdn)
+
 /* Sort function for the sorted duplicate data items of a dn2id key.
  * Sorts based on normalized RDN, in length order.
  */
@@ -106,6 +115,9 @@ mdb_dn2id_add(
 		nrlen = e->e_nname.bv_len;
 		rlen = e->e_name.bv_len;
 	}
+	if ( mdb->mi_rdncompress && rlen == nrlen &&
+		!memcmp( e->e_name.bv_val, e->e_nname.bv_val, rlen ))
+		rlen = 0;
 
 	d = op->o_tmpalloc(sizeof(diskNode) + rlen + nrlen + sizeof(ID), op->o_tmpmemctx);
 	d->nrdnlen[1] = nrlen & 0xff;
@@ -372,9 +384,11 @@ mdb_dn2id(
 			int rlen;
 			d = data.mv_data;
 			rlen = data.mv_size - sizeof(diskNode) - tmp.bv_len - sizeof(ID);
+			if ( !rlen )
+				rlen = tmp.bv_len;
 			matched->bv_len += rlen;
 			matched->bv_val -= rlen + 1;
-			ptr = lutil_strcopy( matched->bv_val, d->rdn + tmp.bv_len );
+			ptr = lutil_strcopy( matched->bv_val, DN2ID_RDN( d, tmp.bv_len ));
 			if ( pid ) {
 				*ptr = ',';
 				matched->bv_len++;
@@ -590,6 +604,8 @@ mdb_id2name(
 		d = data.mv_data;
 		nrlen = (d->nrdnlen[0] << 8) | d->nrdnlen[1];
 		rlen = data.mv_size - sizeof(diskNode) - nrlen;
+		if ( !rlen )
+			rlen = nrlen;
 		assert( nrlen < 1024 && rlen < 1024 );	/* FIXME: Sanity check */
 		if (nptr > ndn) {
 			*nptr++ = ',';
@@ -597,7 +613,7 @@ mdb_id2name(
 		}
 		/* copy name and trailing NUL */
 		memcpy( nptr, d->nrdn, nrlen+1 );
-		memcpy( dptr, d->nrdn+nrlen+1, rlen+1 );
+		memcpy( dptr, DN2ID_RDN( d, nrlen ), rlen+1 );
 		nptr += nrlen;
 		dptr += rlen;
 	}
@@ -756,10 +772,12 @@ mdb_idscopes(
 		d = data.mv_data;
 		nrlen = (d->nrdnlen[0] << 8) | d->nrdnlen[1];
 		rlen = data.mv_size - sizeof(diskNode) - nrlen;
+		if ( !rlen )
+			rlen = nrlen;
 		isc->nrdns[isc->numrdns].bv_len = nrlen;
 		isc->nrdns[isc->numrdns].bv_val = d->nrdn;
 		isc->rdns[isc->numrdns].bv_len = rlen;
-		isc->rdns[isc->numrdns].bv_val = d->nrdn+nrlen+1;
+		isc->rdns[isc->numrdns].bv_val = DN2ID_RDN( d, nrlen );
 		isc->numrdns++;
 
 		if (!rc && id != isc->id) {
@@ -896,8 +914,10 @@ mdb_dn2id_walk(
 			n--;
 			isc->nrdns[n].bv_len = ((d->nrdnlen[0] & 0x7f) << 8) | d->nrdnlen[1];
 			isc->nrdns[n].bv_val = d->nrdn;
-			isc->rdns[n].bv_val = d->nrdn+isc->nrdns[n].bv_len+1;
+			isc->rdns[n].bv_val = DN2ID_RDN( d, isc->nrdns[n].bv_len );
 			isc->rdns[n].bv_len = data.mv_size - sizeof(diskNode) - isc->nrdns[n].bv_len - sizeof(ID);
+			if ( !isc->rdns[n].bv_len )
+				isc->rdns[n].bv_len = isc->nrdns[n].bv_len;
 			/* return this ID to caller */
 			if ( !isc->nscope )
 				break;
@@ -976,6 +996,6 @@ void mdb_dn2id_wrestore (
 		/* now we're back to where we wanted to be */
 		d = data.mv_data;
 		isc->nrdns[n].bv_val = d->nrdn;
-		isc->rdns[n].bv_val = d->nrdn+isc->nrdns[n].bv_len+1;
+		isc->rdns[n].bv_val = DN2ID_RDN( d, isc->nrdns[n].bv_len );
 	}
 }
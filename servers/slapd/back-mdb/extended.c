@@ -18,14 +18,115 @@
 
 #include <stdio.h>
 #include <ac/string.h>
+#include <ac/unistd.h>
 
 #include "back-mdb.h"
 #include "lber_pvt.h"
 
+#ifdef HAVE_PIPE
+static struct berval mdb_exop_snapshot = BER_BVC( LDAP_EXOP_X_SNAPSHOT );
+
+/* Size of each intermediate response carrying snapshot data */
+#define MDB_SNAPSHOT_CHUNK	(256*1024)
+
+typedef struct mdb_snapshot_t {
+	MDB_env	*ms_env;
+	int	ms_fd;
+	int	ms_rc;
+} mdb_snapshot_t;
+
+static void *
+mdb_snapshot_copy( void *ctx )
+{
+	mdb_snapshot_t *ms = ctx;
+
+	ms->ms_rc = mdb_env_copyfd2( ms->ms_env, ms->ms_fd, MDB_CP_COMPACT );
+	close( ms->ms_fd );
+	return NULL;
+}
+
+/* Stream a compacted copy of the environment to the client. The copy
+ * is written into a pipe by a helper thread and forwarded here in
+ * fixed-size chunks, so the whole database is never buffered.
+ */
+static int
+mdb_snapshot( Operation *op, SlapReply *rs )
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	mdb_snapshot_t ms;
+	ldap_pvt_thread_t tid;
+	struct berval bv;
+	ber_len_t total = 0;
+	ssize_t len;
+	int fds[2];
+
+	if ( pipe( fds ) ) {
+		rs->sr_text = "unable to create pipe";
+		return rs->sr_err = LDAP_OTHER;
+	}
+
+	ms.ms_env = mdb->mi_dbenv;
+	ms.ms_fd = fds[1];
+	ms.ms_rc = 0;
+	if ( ldap_pvt_thread_create( &tid, 0, mdb_snapshot_copy, &ms ) ) {
+		close( fds[0] );
+		close( fds[1] );
+		rs->sr_text = "unable to start copy";
+		return rs->sr_err = LDAP_OTHER;
+	}
+
+	bv.bv_val = ch_malloc( MDB_SNAPSHOT_CHUNK );
+	rs->sr_rspoid = LDAP_EXOP_X_SNAPSHOT;
+	rs->sr_rspdata = &bv;
+	rs->sr_err = LDAP_SUCCESS;
+
+	for (;;) {
+		bv.bv_len = 0;
+		while ( bv.bv_len < MDB_SNAPSHOT_CHUNK ) {
+			len = read( fds[0], bv.bv_val + bv.bv_len,
+				MDB_SNAPSHOT_CHUNK - bv.bv_len );
+			if ( len <= 0 )
+				break;
+			bv.bv_len += len;
+		}
+		if ( bv.bv_len == 0 || op->o_abandon )
+			break;
+		slap_send_ldap_intermediate( op, rs );
+		total += bv.bv_len;
+	}
+
+	/* if we stopped early the writer fails with EPIPE */
+	close( fds[0] );
+	ldap_pvt_thread_join( tid, NULL );
+
+	ch_free( bv.bv_val );
+	rs->sr_rspoid = NULL;
+	rs->sr_rspdata = NULL;
+
+	if ( op->o_abandon ) {
+		return rs->sr_err = SLAPD_ABANDON;
+	}
+	if ( ms.ms_rc ) {
+		Debug( LDAP_DEBUG_ANY, LDAP_XSTRING(mdb_snapshot)
+			": copy failed: %s (%d)\n",
+			mdb_strerror( ms.ms_rc ), ms.ms_rc );
+		rs->sr_text = "snapshot failed";
+		return rs->sr_err = LDAP_OTHER;
+	}
+
+	Debug( LDAP_DEBUG_STATS, "%s SNAPSHOT sent %lu bytes\n",
+		op->o_log_prefix, (unsigned long) total );
+	return rs->sr_err = LDAP_SUCCESS;
+}
+#endif /* HAVE_PIPE */
+
 static struct exop {
 	struct berval *oid;
 	BI_op_extended	*extended;
 } exop_table[] = {
+#ifdef HAVE_PIPE
+	{ &mdb_exop_snapshot, mdb_snapshot },
+#endif
 	{ NULL, NULL }
 };
 
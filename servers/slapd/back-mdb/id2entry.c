@@ -35,7 +35,10 @@ static int mdb_entry_partsize(struct mdb_info *mdb, MDB_txn *txn, Entry *e,
 	Ecount *eh);
 static int mdb_entry_encode(Operation *op, Entry *e, MDB_val *data,
 	Ecount *ec);
-static Entry *mdb_entry_alloc( Operation *op, int nattrs, int nvals );
+static int mdb_entry_compress(Operation *op, Entry *e, Ecount *ec,
+	MDB_val *data);
+static Entry *mdb_entry_alloc( Operation *op, int nattrs, int nvals,
+	ber_len_t extra );
 
 #define ID2VKSZ	(sizeof(ID)+2)
 
@@ -271,7 +274,7 @@ static int mdb_id2entry_put(
 {
 	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
 	Ecount ec;
-	MDB_val key, data;
+	MDB_val key, data, cdata = { 0, NULL };
 	int rc, adding = flag, prev_ads = mdb->mi_numads;
 
 	/* We only store rdns, and they go in the dn2id database. */
@@ -295,16 +298,29 @@ static int mdb_id2entry_put(
 		goto fail;
 	}
 
+	/* Compressed entries are encoded up front and copied in */
+	if (mdb->mi_compress && ec.dlen >= mdb->mi_compress_min) {
+		rc = mdb_entry_compress( op, e, &ec, &cdata );
+		if (rc)
+			goto fail;
+		flag &= ~MDB_RESERVE;
+	}
+
 again:
-	data.mv_size = ec.dlen;
+	if ( cdata.mv_data )
+		data = cdata;
+	else
+		data.mv_size = ec.dlen;
 	if ( mc )
 		rc = mdb_cursor_put( mc, &key, &data, flag );
 	else
 		rc = mdb_put( txn, mdb->mi_id2entry, &key, &data, flag );
 	if (rc == MDB_SUCCESS) {
-		rc = mdb_entry_encode( op, e, &data, &ec );
-		if( rc != LDAP_SUCCESS )
-			goto fail;
+		if ( !cdata.mv_data ) {
+			rc = mdb_entry_encode( op, e, &data, &ec );
+			if( rc != LDAP_SUCCESS )
+				goto fail;
+		}
 		/* Handle adds of large multi-valued attrs here.
 		 * Modifies handle them directly.
 		 */
@@ -346,6 +362,8 @@ again:
 			rc = LDAP_OTHER;
 	}
 fail:
+	if (cdata.mv_data)
+		op->o_tmpfree( cdata.mv_data, op->o_tmpmemctx );
 	if (rc) {
 		mdb_ad_unwind( mdb, prev_ads );
 	}
@@ -413,7 +431,7 @@ int mdb_id2entry(
 		/* Looking for root entry on an empty-dn suffix? */
 		if ( !id && BER_BVISEMPTY( &op->o_bd->be_nsuffix[0] )) {
 			struct berval gluebv = BER_BVC("glue");
-			Entry *r = mdb_entry_alloc(op, 2, 4);
+			Entry *r = mdb_entry_alloc(op, 2, 4, 0);
 			Attribute *a = r->e_attrs;
 			struct berval *bptr;
 
@@ -498,14 +516,18 @@ int mdb_id2entry_delete(
 	return rc;
 }
 
+/* Allocate an Entry with room for its attributes and values. Any
+ * extra space follows the values and is freed along with the Entry.
+ */
 static Entry * mdb_entry_alloc(
 	Operation *op,
 	int nattrs,
-	int nvals )
+	int nvals,
+	ber_len_t extra )
 {
 	Entry *e = op->o_tmpalloc( sizeof(Entry) +
 		nattrs * sizeof(Attribute) +
-		nvals * sizeof(struct berval), op->o_tmpmemctx );
+		nvals * sizeof(struct berval) + extra, op->o_tmpmemctx );
 	BER_BVZERO(&e->e_bv);
 	e->e_private = e;
 	if (nattrs) {
@@ -748,6 +770,12 @@ mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **m
 				if ( get_lazyCommit( op ))
 					flag |= MDB_NOMETASYNC;
 #endif
+				/* group commit: sync later, see mdb_txn_durable() */
+				if ( mdb->mi_groupcommit >= 0 &&
+					!( mdb->mi_dbenv_flags & MDB_NOSYNC )) {
+					flag |= MDB_NOMETASYNC;
+					moi->moi_flag |= MOI_GROUPSYNC;
+				}
 				rc = mdb_txn_begin( mdb->mi_dbenv, NULL, flag, &moi->moi_txn );
 				if (rc) {
 					Debug( LDAP_DEBUG_ANY, "mdb_opinfo_get: err %s(%d)\n",
@@ -825,12 +853,16 @@ int mdb_txn( Operation *op, int txnop, OpExtra **ptr )
 			moi->moi_flag |= MOI_KEEPER;
 		}
 		return rc;
-	case SLAP_TXN_COMMIT:
+	case SLAP_TXN_COMMIT: {
+		size_t txnid = mdb_txn_id( moi->moi_txn );
 		rc = mdb_txn_commit( moi->moi_txn );
 		if ( rc )
 			mdb->mi_numads = 0;
+		else
+			rc = mdb_txn_durable( mdb, moi, txnid );
 		op->o_tmpfree( moi, op->o_tmpmemctx );
 		return rc;
+		}
 	case SLAP_TXN_ABORT:
 		mdb->mi_numads = 0;
 		mdb_txn_abort( moi->moi_txn );
@@ -840,6 +872,17 @@ int mdb_txn( Operation *op, int txnop, OpExtra **ptr )
 	return LDAP_OTHER;
 }
 
+/* Wait until a write txn begun for group commit is on disk. The
+ * sync is shared with the other writers that committed meanwhile.
+ */
+int mdb_txn_durable( struct mdb_info *mdb, mdb_op_info *moi, size_t txnid )
+{
+	if ( !( moi->moi_flag & MOI_GROUPSYNC ))
+		return 0;
+	return mdb_env_sync_txn( mdb->mi_dbenv, txnid,
+		mdb->mi_groupcommit > 0 ? mdb->mi_groupcommit : 0 );
+}
+
 /* Count up the sizes of the components of an entry */
 static int mdb_entry_partsize(struct mdb_info *mdb, MDB_txn *txn, Entry *e,
 	Ecount *eh)
@@ -1002,6 +1045,204 @@ static int mdb_entry_encode(Operation *op, Entry *e, MDB_val *data, Ecount *eh)
 	return 0;
 }
 
+/* Compressed entries replace the header with the MDB_ENC_COMPRESSED
+ * bit or'd into the attribute count, the value count, the length of
+ * the uncompressed buffer and the codec used. The whole buffer built
+ * by mdb_entry_encode follows, compressed.
+ */
+#define MDB_ENC_COMPRESSED	(1U<<(sizeof(unsigned int)*CHAR_BIT-1))
+#define MDB_ENC_HDRSIZE	(4*sizeof(unsigned int))
+
+/* A self-contained codec producing LZ4 block format. Matches are found
+ * through a small hash table of recent positions; there is no search
+ * for longer matches, favoring speed over ratio.
+ */
+#define LZ_HASHLOG	12
+#define LZ_MINMATCH	4
+#define LZ_MFLIMIT	12	/* last match must start this far from the end */
+#define LZ_LASTLITS	5	/* last bytes are always literals */
+#define LZ_MAXOFF	65535
+
+static unsigned int
+mdb_lz_hash( const unsigned char *p )
+{
+	unsigned int v;
+	memcpy( &v, p, 4 );
+	return ( v * 2654435761U & 0xffffffffU ) >> ( 32 - LZ_HASHLOG );
+}
+
+static unsigned char *
+mdb_lz_putlen( unsigned char *op, size_t len )
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+/* Returns the compressed size, or 0 if it doesn't fit in dmax */
+static size_t
+mdb_lz_compress( const unsigned char *src, size_t slen,
+	unsigned char *dst, size_t dmax )
+{
+	unsigned int table[1<<LZ_HASHLOG];
+	const unsigned char *ip = src, *anchor = src, *ref, *m, *r;
+	const unsigned char *iend = src + slen;
+	unsigned char *op = dst, *oend = dst + dmax, *token;
+	size_t lits, mlen;
+	unsigned int h;
+
+	memset( table, 0, sizeof(table) );
+	if ( slen > LZ_MFLIMIT ) {
+		const unsigned char *mflimit = iend - LZ_MFLIMIT;
+		const unsigned char *matchlimit = iend - LZ_LASTLITS;
+		while ( ip < mflimit ) {
+			h = mdb_lz_hash( ip );
+			ref = src + table[h];
+			table[h] = ip - src;
+			if ( ref >= ip || ip - ref > LZ_MAXOFF ||
+				memcmp( ref, ip, LZ_MINMATCH )) {
+				ip++;
+				continue;
+			}
+			while ( ip > anchor && ref > src && ip[-1] == ref[-1] ) {
+				ip--;
+				ref--;
+			}
+			m = ip + LZ_MINMATCH;
+			r = ref + LZ_MINMATCH;
+			while ( m < matchlimit && *m == *r ) {
+				m++;
+				r++;
+			}
+			lits = ip - anchor;
+			mlen = m - ip - LZ_MINMATCH;
+			if ( (size_t)(oend - op) < 1 + lits/255 + 1 + lits + 2 + mlen/255 + 1 )
+				return 0;
+			token = op++;
+			*token = ( lits < 15 ? lits : 15 ) << 4;
+			if ( lits >= 15 )
+				op = mdb_lz_putlen( op, lits - 15 );
+			memcpy( op, anchor, lits );
+			op += lits;
+			*op++ = ( ip - ref ) & 0xff;
+			*op++ = ( ip - ref ) >> 8;
+			*token |= mlen < 15 ? mlen : 15;
+			if ( mlen >= 15 )
+				op = mdb_lz_putlen( op, mlen - 15 );
+			ip = anchor = m;
+		}
+	}
+	lits = iend - anchor;
+	if ( (size_t)(oend - op) < 1 + lits/255 + 1 + lits )
+		return 0;
+	token = op++;
+	*token = ( lits < 15 ? lits : 15 ) << 4;
+	if ( lits >= 15 )
+		op = mdb_lz_putlen( op, lits - 15 );
+	memcpy( op, anchor, lits );
+	op += lits;
+	return op - dst;
+}
+
+/* Returns 0 if src decompresses to exactly dlen bytes */
+static int
+mdb_lz_decompress( const unsigned char *src, size_t slen,
+	unsigned char *dst, size_t dlen )
+{
+	const unsigned char *ip = src, *iend = src + slen, *ref;
+	unsigned char *op = dst, *oend = dst + dlen;
+	size_t len, off;
+	unsigned int token, c;
+
+	for (;;) {
+		if ( ip >= iend )
+			return -1;
+		token = *ip++;
+		len = token >> 4;
+		if ( len == 15 ) {
+			do {
+				if ( ip >= iend )
+					return -1;
+				c = *ip++;
+				len += c;
+			} while ( c == 255 );
+		}
+		if ( len > (size_t)(iend - ip) || len > (size_t)(oend - op) )
+			return -1;
+		memcpy( op, ip, len );
+		op += len;
+		ip += len;
+		if ( ip == iend )
+			break;
+		if ( iend - ip < 2 )
+			return -1;
+		off = ip[0] | ( ip[1] << 8 );
+		ip += 2;
+		if ( !off || off > (size_t)(op - dst) )
+			return -1;
+		len = token & 15;
+		if ( len == 15 ) {
+			do {
+				if ( ip >= iend )
+					return -1;
+				c = *ip++;
+				len += c;
+			} while ( c == 255 );
+		}
+		len += LZ_MINMATCH;
+		if ( len > (size_t)(oend - op) )
+			return -1;
+		/* may overlap, copy bytewise */
+		for ( ref = op - off; len; len-- )
+			*op++ = *ref++;
+	}
+	return op == oend ? 0 : -1;
+}
+
+/* Encode an entry and compress it into a buffer for mdb_put. Entries
+ * that don't shrink by at least an eighth are stored uncompressed,
+ * saving the decompression on every read.
+ */
+static int mdb_entry_compress(Operation *op, Entry *e, Ecount *ec,
+	MDB_val *data)
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	MDB_val raw;
+	unsigned int *lp = NULL;
+	size_t clen = 0, cmax;
+	int rc;
+
+	raw.mv_size = ec->dlen;
+	raw.mv_data = op->o_tmpalloc( raw.mv_size, op->o_tmpmemctx );
+	rc = mdb_entry_encode( op, e, &raw, ec );
+	if ( rc != LDAP_SUCCESS ) {
+		op->o_tmpfree( raw.mv_data, op->o_tmpmemctx );
+		return rc;
+	}
+
+	cmax = raw.mv_size - raw.mv_size / 8;
+	if ( cmax > MDB_ENC_HDRSIZE ) {
+		data->mv_data = op->o_tmpalloc( cmax, op->o_tmpmemctx );
+		lp = data->mv_data;
+		clen = mdb_lz_compress( raw.mv_data, raw.mv_size,
+			(unsigned char *)(lp + 4), cmax - MDB_ENC_HDRSIZE );
+	}
+	if ( clen ) {
+		op->o_tmpfree( raw.mv_data, op->o_tmpmemctx );
+		*lp++ = ec->nattrs | MDB_ENC_COMPRESSED;
+		*lp++ = ec->nvals;
+		*lp++ = raw.mv_size;
+		*lp++ = mdb->mi_compress;
+		data->mv_size = clen + MDB_ENC_HDRSIZE;
+	} else {
+		if ( cmax > MDB_ENC_HDRSIZE )
+			op->o_tmpfree( data->mv_data, op->o_tmpmemctx );
+		*data = raw;
+	}
+	return 0;
+}
+
 /* Retrieve an Entry that was stored using entry_encode above.
  *
  * Note: everything is stored in a single contiguous block, so
@@ -1025,9 +1266,37 @@ int mdb_entry_decode(Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **
 	Debug( LDAP_DEBUG_TRACE,
 		"=> mdb_entry_decode:\n" );
 
-	nattrs = *lp++;
-	nvals = *lp++;
-	x = mdb_entry_alloc(op, nattrs, nvals);
+	if ( lp[0] & MDB_ENC_COMPRESSED ) {
+		/* Decompress into space following the Entry's values */
+		unsigned int rawlen;
+		if ( data->mv_size < MDB_ENC_HDRSIZE ||
+			lp[3] != MDB_COMPRESS_LZ4 ) {
+			Debug( LDAP_DEBUG_ANY,
+				"mdb_entry_decode: entry %lu has a bad compression header\n",
+				(unsigned long) id );
+			return LDAP_OTHER;
+		}
+		rawlen = lp[2];
+		nattrs = lp[0] ^ MDB_ENC_COMPRESSED;
+		nvals = lp[1];
+		x = mdb_entry_alloc(op, nattrs, nvals, rawlen);
+		lp = (unsigned int *)((struct berval *)((Attribute *)(x+1) +
+			nattrs) + nvals);
+		if ( mdb_lz_decompress( (unsigned char *)data->mv_data + MDB_ENC_HDRSIZE,
+				data->mv_size - MDB_ENC_HDRSIZE, (unsigned char *)lp, rawlen )) {
+			Debug( LDAP_DEBUG_ANY,
+				"mdb_entry_decode: entry %lu failed to decompress\n",
+				(unsigned long) id );
+			x->e_nname.bv_val = x->e_name.bv_val = NULL;
+			mdb_entry_return( op, x );
+			return LDAP_OTHER;
+		}
+		lp += 2;
+	} else {
+		nattrs = *lp++;
+		nvals = *lp++;
+		x = mdb_entry_alloc(op, nattrs, nvals, 0);
+	}
 	x->e_ocflags = *lp++;
 	if (!nvals) {
 		goto done;
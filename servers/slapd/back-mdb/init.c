@@ -63,6 +63,7 @@ mdb_db_init( BackendDB *be, ConfigReply *cr )
 
 	mdb->mi_mapsize = DEFAULT_MAPSIZE;
 	mdb->mi_rtxn_size = DEFAULT_RTXN_SIZE;
+	mdb->mi_groupcommit = -1;
 	mdb->mi_multi_hi = UINT_MAX;
 	mdb->mi_multi_lo = UINT_MAX;
 
@@ -135,6 +136,17 @@ mdb_db_open( BackendDB *be, ConfigReply *cr )
 		}
 	}
 
+	if ( mdb->mi_dirtylimit ) {
+		rc = mdb_env_set_dirtylimit( mdb->mi_dbenv, mdb->mi_dirtylimit );
+		if( rc != 0 ) {
+			Debug( LDAP_DEBUG_ANY,
+				LDAP_XSTRING(mdb_db_open) ": database \"%s\": "
+				"mdb_env_set_dirtylimit failed: %s (%d).\n",
+				be->be_suffix[0].bv_val, mdb_strerror(rc), rc );
+			goto fail;
+		}
+	}
+
 	rc = mdb_env_set_mapsize( mdb->mi_dbenv, mdb->mi_mapsize );
 	if( rc != 0 ) {
 		Debug( LDAP_DEBUG_ANY,
@@ -246,7 +258,10 @@ mdb_db_open( BackendDB *be, ConfigReply *cr )
 					unsigned char *ptr;
 					ptr = data.mv_data;
 					len = (ptr[0] & 0x7f) << 8 | ptr[1];
-					if (data.mv_size < 2*len + 4 + 2*sizeof(ID)) {
+					/* an empty rdn shares the nrdn, see dn2id.c */
+					if (ptr[len+3])
+						len *= 2;
+					if (data.mv_size < len + 4 + 2*sizeof(ID)) {
 						snprintf( cr->msg, sizeof(cr->msg),
 						"database \"%s\": DN index needs upgrade, "
 						"run \"slapindex entryDN\".",
@@ -367,6 +382,18 @@ mdb_db_destroy( BackendDB *be, ConfigReply *cr )
 		ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
 	}
 
+	/* stop and remove compaction task */
+	if ( mdb->mi_compact_task ) {
+		struct re_s *re = mdb->mi_compact_task;
+		mdb->mi_compact_task = NULL;
+		ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+		if ( ldap_pvt_runqueue_isrunning( &slapd_rq, re ) )
+			ldap_pvt_runqueue_stoptask( &slapd_rq, re );
+		ldap_pvt_runqueue_remove( &slapd_rq, re );
+		ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+	}
+	ch_free( mdb->mi_compact_key.bv_val );
+
 	/* monitor handling */
 	(void)mdb_monitor_db_destroy( be );
 
@@ -578,6 +578,7 @@ mdb_modify( Operation *op, SlapReply *rs )
 	size_t textlen = sizeof textbuf;
 	MDB_txn	*txn = NULL;
 	mdb_op_info opinfo = {{{ 0 }}}, *moi = &opinfo;
+	size_t txnid;
 	Entry		dummy = {0};
 
 	LDAPControl **preread_ctrl = NULL;
@@ -765,9 +766,12 @@ mdb_modify( Operation *op, SlapReply *rs )
 			txn = NULL;
 			goto return_results;
 		} else {
+			txnid = mdb_txn_id( txn );
 			rs->sr_err = mdb_txn_commit( txn );
 			if ( rs->sr_err )
 				mdb->mi_numads = numads;
+			else
+				rs->sr_err = mdb_txn_durable( mdb, moi, txnid );
 			txn = NULL;
 		}
 	}
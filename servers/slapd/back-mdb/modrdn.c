@@ -37,6 +37,7 @@ mdb_modrdn( Operation	*op, SlapReply *rs )
 	MDB_txn		*txn = NULL;
 	MDB_cursor	*mc;
 	struct mdb_op_info opinfo = {{{ 0 }}}, *moi = &opinfo;
+	size_t txnid;
 	Entry dummy = {0};
 
 	Entry		*np = NULL;			/* newSuperior Entry */
@@ -539,8 +540,11 @@ mdb_modrdn( Operation	*op, SlapReply *rs )
 			goto return_results;
 
 		} else {
+			txnid = mdb_txn_id( txn );
 			if(( rs->sr_err=mdb_txn_commit( txn )) != 0 ) {
 				rs->sr_text = "txn_commit failed";
+			} else if(( rs->sr_err=mdb_txn_durable( mdb, moi, txnid )) != 0 ) {
+				rs->sr_text = "txn_sync failed";
 			} else {
 				rs->sr_err = LDAP_SUCCESS;
 			}
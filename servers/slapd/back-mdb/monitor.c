@@ -50,6 +50,9 @@ static AttributeDescription *ad_olmMDBReadersMax,
 
 static AttributeDescription *ad_olmMDBEntries;
 
+static AttributeDescription *ad_olmMDBCompactLimit,
+	*ad_olmMDBPagesMoved, *ad_olmMDBPagesReleased;
+
 /*
  * NOTE: there's some confusion in monitor OID arc;
  * by now, let's consider:
@@ -143,6 +146,30 @@ static struct {
 		"NO-USER-MODIFICATION "
 		"USAGE dSAOperation )",
 		&ad_olmMDBEntries },
+
+	{ "( olmMDBAttributes:7 "
+		"NAME ( 'olmMDBCompactLimit' ) "
+		"DESC 'Page number above which compaction moves pages, 0 when idle' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBCompactLimit },
+
+	{ "( olmMDBAttributes:8 "
+		"NAME ( 'olmMDBPagesMoved' ) "
+		"DESC 'Number of pages moved by compaction' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBPagesMoved },
+
+	{ "( olmMDBAttributes:9 "
+		"NAME ( 'olmMDBPagesReleased' ) "
+		"DESC 'Number of free pages cut off the end of the file' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBPagesReleased },
 	{ NULL }
 };
 
@@ -162,6 +189,7 @@ static struct {
 #endif /* MDB_MONITOR_IDX */
 			"$ olmMDBPagesMax $ olmMDBPagesUsed $ olmMDBPagesFree "
 			"$ olmMDBReadersMax $ olmMDBReadersUsed $ olmMDBEntries "
+			"$ olmMDBCompactLimit $ olmMDBPagesMoved $ olmMDBPagesReleased "
 			") )",
 		&oc_olmMDBDatabase },
 
@@ -216,6 +244,24 @@ mdb_monitor_update(
 	bv.bv_len = snprintf( buf, sizeof( buf ), "%u", mei.me_numreaders );
 	ber_bvreplace( &a->a_vals[ 0 ], &bv );
 
+	a = attr_find( e->e_attrs, ad_olmMDBCompactLimit );
+	assert( a != NULL );
+	bv.bv_val = buf;
+	bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", mdb->mi_compact_limit );
+	ber_bvreplace( &a->a_vals[ 0 ], &bv );
+
+	a = attr_find( e->e_attrs, ad_olmMDBPagesMoved );
+	assert( a != NULL );
+	bv.bv_val = buf;
+	bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", mdb->mi_compact_moved );
+	ber_bvreplace( &a->a_vals[ 0 ], &bv );
+
+	a = attr_find( e->e_attrs, ad_olmMDBPagesReleased );
+	assert( a != NULL );
+	bv.bv_val = buf;
+	bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", mdb->mi_compact_released );
+	ber_bvreplace( &a->a_vals[ 0 ], &bv );
+
 	rc = mdb_txn_begin( mdb->mi_dbenv, NULL, MDB_RDONLY, &txn );
 	if ( !rc ) {
 		MDB_cursor *cursor;
@@ -436,7 +482,7 @@ mdb_monitor_db_open( BackendDB *be )
 	}
 
 	/* alloc as many as required (plus 1 for objectClass) */
-	a = attrs_alloc( 1 + 7 );
+	a = attrs_alloc( 1 + 10 );
 	if ( a == NULL ) {
 		rc = 1;
 		goto cleanup;
@@ -472,6 +518,18 @@ mdb_monitor_db_open( BackendDB *be )
 		next->a_desc = ad_olmMDBEntries;
 		attr_valadd( next, &bv, NULL, 1 );
 		next = next->a_next;
+
+		next->a_desc = ad_olmMDBCompactLimit;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBPagesMoved;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBPagesReleased;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
 	}
 
 	{
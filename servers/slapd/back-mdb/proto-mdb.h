@@ -214,6 +214,7 @@ int mdb_entry_return( Operation *op, Entry *e );
 BI_entry_release_rw mdb_entry_release;
 BI_entry_get_rw mdb_entry_get;
 BI_op_txn mdb_txn;
+int mdb_txn_durable( struct mdb_info *mdb, mdb_op_info *moi, size_t txnid );
 
 int mdb_entry_decode( Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **e );
 
@@ -287,6 +287,48 @@ mdb_get_nextid(MDB_cursor *mci, ID *cursor)
 	return 0;
 }
 
+/* Fetch id2entry data for a sorted candidate list in batches, so
+ * the lookups share one descent of the tree and the leaf pages for
+ * upcoming candidates are read ahead.
+ */
+#define MDB_PREFETCH	64
+
+typedef struct mdb_prefetch {
+	ID pf_first;	/* IDL cursor of pf_data[0] */
+	unsigned pf_num;	/* 0 if nothing is batched */
+	MDB_val pf_data[MDB_PREFETCH];
+} mdb_prefetch;
+
+static int
+mdb_id2edata_batch( MDB_cursor *mci, ID *ids, ID cursor, mdb_prefetch *pf,
+	MDB_val *data )
+{
+	if ( cursor < pf->pf_first || cursor >= pf->pf_first + pf->pf_num ) {
+		MDB_val keys[MDB_PREFETCH];
+		unsigned i, n;
+		int rc;
+
+		n = ids[0] - cursor + 1;
+		if ( n > MDB_PREFETCH )
+			n = MDB_PREFETCH;
+		for ( i = 0; i < n; i++ ) {
+			keys[i].mv_size = sizeof(ID);
+			keys[i].mv_data = &ids[cursor+i];
+		}
+		pf->pf_num = 0;
+		rc = mdb_cursor_get_multi( mci, keys, pf->pf_data, n );
+		if ( rc )
+			return rc;
+		pf->pf_first = cursor;
+		pf->pf_num = n;
+	}
+	*data = pf->pf_data[cursor - pf->pf_first];
+	/* missing, or stubs from missing parents */
+	if ( !data->mv_size )
+		return MDB_NOTFOUND;
+	return 0;
+}
+
 static void scope_chunk_free( void *key, void *data )
 {
 	ID2 *p1, *p2;
@@ -435,6 +477,7 @@ mdb_search( Operation *op, SlapReply *rs )
 	IdScopes	isc;
 	MDB_cursor	*mci, *mcd;
 	ww_ctx wwctx;
+	mdb_prefetch pf;
 	slap_callback cb = { 0 };
 
 	mdb_op_info	opinfo = {{{0}}}, *moi = &opinfo;
@@ -795,6 +838,7 @@ adminlimit:
 	} else {
 		id = mdb_idl_first( candidates, &cursor );
 	}
+	pf.pf_first = pf.pf_num = 0;
 
 	while (id != NOID)
 	{
@@ -901,7 +945,10 @@ scopeok:
 		} else {
 
 			/* get the entry */
-			rs->sr_err = mdb_id2edata( op, mci, id, &edata );
+			if ( nsubs >= ncand && !MDB_IDL_IS_RANGE( candidates ))
+				rs->sr_err = mdb_id2edata_batch( mci, candidates, cursor, &pf, &edata );
+			else
+				rs->sr_err = mdb_id2edata( op, mci, id, &edata );
 			if ( rs->sr_err == MDB_NOTFOUND ) {
 notfound:
 				if( nsubs < ncand )
@@ -1145,6 +1192,8 @@ loop_continue:
 			}
 		}
 		if ( wwctx.flag ) {
+			/* batched data went with the old txn */
+			pf.pf_num = 0;
 			rs->sr_err = mdb_waitfixup( op, &wwctx, mci, mcd, &isc );
 			if ( rs->sr_err ) {
 				send_ldap_result( op, rs );
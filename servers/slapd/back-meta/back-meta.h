@@ -392,14 +392,9 @@ typedef struct metatarget_t {
 
 } metatarget_t;
 
-typedef struct metadncache_t {
-	ldap_pvt_thread_mutex_t mutex;
-	Avlnode			*tree;
-
-#define META_DNCACHE_DISABLED   (0)
-#define META_DNCACHE_FOREVER    ((time_t)(-1))
-	time_t			ttl;  /* seconds; 0: no cache, -1: no expiry */
-} metadncache_t;
+/* the dn cache is shared with back-asyncmeta; see back-ldap/dncache.c */
+#define META_DNCACHE_DISABLED   LDAP_DNCACHE_DISABLED
+#define META_DNCACHE_FOREVER    LDAP_DNCACHE_FOREVER
 
 typedef struct metacandidates_t {
 	int			mc_ntargets;
@@ -431,7 +426,7 @@ typedef struct metainfo_t {
 	LDAP_REBIND_PROC	*mi_rebind_f;
 	LDAP_URLLIST_PROC	*mi_urllist_f;
 
-	metadncache_t		mi_cache;
+	ldap_dncache_t		mi_cache;
 	
 	/* cached connections; 
 	 * special conns are in tailq rather than in tree */
@@ -455,6 +450,7 @@ typedef struct metainfo_t {
 #define	META_BACK_F_PROXYAUTHZ_ALWAYS	(0x08000000U)	/* users always proxyauthz */
 #define	META_BACK_F_PROXYAUTHZ_ANON	(0x10000000U)	/* anonymous always proxyauthz */
 #define	META_BACK_F_PROXYAUTHZ_NOANON	(0x20000000U)	/* anonymous remains anonymous */
+#define	META_BACK_F_SORT_MERGE		(0x40000000U)	/* merge sorted target results */
 
 #define	META_BACK_ONERR_STOP(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_ONERR_STOP )
 #define	META_BACK_ONERR_REPORT(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_ONERR_REPORT )
@@ -464,6 +460,7 @@ typedef struct metainfo_t {
 #define META_BACK_PROXYAUTHZ_ALWAYS(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_PROXYAUTHZ_ALWAYS )
 #define META_BACK_PROXYAUTHZ_ANON(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_PROXYAUTHZ_ANON )
 #define META_BACK_PROXYAUTHZ_NOANON(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_PROXYAUTHZ_NOANON )
+#define META_BACK_SORT_MERGE(mi)	LDAP_BACK_ISSET( (mi), META_BACK_F_SORT_MERGE )
 
 #define META_BACK_QUARANTINE(mi)	LDAP_BACK_ISSET( (mi), LDAP_BACK_F_QUARANTINE )
 
@@ -633,39 +630,8 @@ meta_clear_one_candidate(
 	metaconn_t		*mc,
 	int			candidate );
 
-/*
- * Dn cache stuff (experimental)
- */
-extern int
-meta_dncache_cmp(
-	const void		*c1,
-	const void		*c2 );
-
-extern int
-meta_dncache_dup(
-	void			*c1,
-	void			*c2 );
-
-#define META_TARGET_NONE	(-1)
+#define META_TARGET_NONE	LDAP_DNCACHE_TARGET_NONE
 #define META_TARGET_MULTIPLE	(-2)
-extern int
-meta_dncache_get_target(
-	metadncache_t		*cache,
-	struct berval		*ndn );
-
-extern int
-meta_dncache_update_entry(
-	metadncache_t		*cache,
-	struct berval		*ndn,
-	int			target );
-
-extern int
-meta_dncache_delete_entry(
-	metadncache_t		*cache,
-	struct berval		*ndn );
-
-extern void
-meta_dncache_free( void *entry );
 
 extern void
 meta_back_map_free( struct ldapmap *lm );
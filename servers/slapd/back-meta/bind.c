@@ -543,10 +543,10 @@ meta_back_single_bind(
 	}
 
 cache_refresh:;
-	if ( mi->mi_cache.ttl != META_DNCACHE_DISABLED
+	if ( mi->mi_cache.dc_ttl != META_DNCACHE_DISABLED
 			&& !BER_BVISEMPTY( &op->o_req_ndn ) )
 	{
-		( void )meta_dncache_update_entry( &mi->mi_cache,
+		( void )mi->mi_ldap_extra->dncache_update_entry( &mi->mi_cache,
 				&op->o_req_ndn, candidate );
 	}
 
@@ -64,6 +64,8 @@ enum {
 	LDAP_BACK_CFG_SINGLECONN,
 	LDAP_BACK_CFG_USETEMP,
 	LDAP_BACK_CFG_CONNPOOLMAX,
+	LDAP_BACK_CFG_SORT_MERGE,
+	LDAP_BACK_CFG_DNCACHE_SIZE,
 	LDAP_BACK_CFG_LAST_BASE
 };
 
@@ -346,6 +348,15 @@ static ConfigTable metacfg[] = {
 			"SYNTAX OMsDirectoryString "
 			"SINGLE-VALUE )",
 		NULL, NULL },
+	{ "dncache-size", "entries", 2, 2, 0,
+		ARG_MAGIC|ARG_ULONG|LDAP_BACK_CFG_DNCACHE_SIZE,
+		meta_back_cf_gen, "( OLcfgDbAt:3.120 "
+			"NAME 'olcDbDnCacheSize' "
+			"DESC 'max number of entries in the dncache' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger "
+			"SINGLE-VALUE )",
+		NULL, NULL },
 	{ "bind-timeout", "microseconds", 2, 2, 0,
 		ARG_MAGIC|ARG_ULONG|LDAP_BACK_CFG_BIND_TIMEOUT,
 		meta_back_cf_gen, "( OLcfgDbAt:3.107 "
@@ -400,6 +411,15 @@ static ConfigTable metacfg[] = {
 			"SYNTAX OMsDirectoryString "
 			"SINGLE-VALUE )",
 		NULL, NULL },
+	{ "sort-merge", "true|FALSE", 2, 2, 0,
+		ARG_MAGIC|ARG_ON_OFF|LDAP_BACK_CFG_SORT_MERGE,
+		meta_back_cf_gen, "( OLcfgDbAt:3.119 "
+			"NAME 'olcDbSortMerge' "
+			"DESC 'merge server-side sorted results of targets' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean "
+			"SINGLE-VALUE )",
+		NULL, NULL },
 
 	{ "", "", 0, 0, 0, ARG_IGNORED,
 		NULL, "( OLcfgDbAt:3.100 NAME 'olcMetaSub' "
@@ -461,12 +481,14 @@ static ConfigOCs metaocs[] = {
 		"SUP olcDatabaseConfig "
 		"MAY ( olcDbConnTtl "
 			"$ olcDbDnCacheTtl "
+			"$ olcDbDnCacheSize "
 			"$ olcDbIdleTimeout "
 			"$ olcDbOnErr "
 			"$ olcDbPseudoRootBindDefer "
 			"$ olcDbSingleConn "
 			"$ olcDbUseTemporaryConn "
 			"$ olcDbConnectionPoolMax "
+			"$ olcDbSortMerge "
 
 			/* defaults, may be overridden per-target */
 			COMMON_ATTRS
@@ -1073,6 +1095,24 @@ static slap_cf_aux_table timeout_table[] = {
 	{ BER_BVNULL, 0, 0, 0, NULL }
 };
 
+/*
+ * with sort-merge, the server-side sort control is honored by the
+ * proxy even without the sssvlv overlay; the control is left in
+ * op->o_ctrls and decoded by meta_back_search()
+ */
+static int
+meta_sort_parse_ctrl( Operation *op, SlapReply *rs, LDAPControl *ctrl )
+{
+	if ( BER_BVISNULL( &ctrl->ldctl_value )
+		|| BER_BVISEMPTY( &ctrl->ldctl_value ) )
+	{
+		rs->sr_text = "sorted results control value is absent";
+		return LDAP_PROTOCOL_ERROR;
+	}
+
+	return LDAP_SUCCESS;
+}
+
 static int
 meta_cf_cleanup( ConfigArgs *c )
 {
@@ -1124,19 +1164,23 @@ meta_back_cf_gen( ConfigArgs *c )
 			break;
 
 		case LDAP_BACK_CFG_DNCACHE_TTL:
-			if ( mi->mi_cache.ttl == META_DNCACHE_DISABLED ) {
+			if ( mi->mi_cache.dc_ttl == META_DNCACHE_DISABLED ) {
 				return 1;
-			} else if ( mi->mi_cache.ttl == META_DNCACHE_FOREVER ) {
+			} else if ( mi->mi_cache.dc_ttl == META_DNCACHE_FOREVER ) {
 				BER_BVSTR( &bv, "forever" );
 			} else {
 				char	buf[ SLAP_TEXT_BUFLEN ];
 
-				lutil_unparse_time( buf, sizeof( buf ), mi->mi_cache.ttl );
+				lutil_unparse_time( buf, sizeof( buf ), mi->mi_cache.dc_ttl );
 				ber_str2bv( buf, 0, 0, &bv );
 			}
 			value_add_one( &c->rvalue_vals, &bv );
 			break;
 
+		case LDAP_BACK_CFG_DNCACHE_SIZE:
+			c->value_ulong = mi->mi_cache.dc_size;
+			break;
+
 		case LDAP_BACK_CFG_IDLE_TIMEOUT:
 			if ( mi->mi_idle_timeout == 0 ) {
 				return 1;
@@ -1174,6 +1218,10 @@ meta_back_cf_gen( ConfigArgs *c )
 			c->value_int = mi->mi_conn_priv_max;
 			break;
 
+		case LDAP_BACK_CFG_SORT_MERGE:
+			c->value_int = META_BACK_SORT_MERGE( mi );
+			break;
+
 		/* common attrs */
 		case LDAP_BACK_CFG_BIND_TIMEOUT:
 			if ( mc->mc_bind_timeout.tv_sec == 0 &&
@@ -1617,7 +1665,11 @@ meta_back_cf_gen( ConfigArgs *c )
 			break;
 
 		case LDAP_BACK_CFG_DNCACHE_TTL:
-			mi->mi_cache.ttl = META_DNCACHE_DISABLED;
+			mi->mi_cache.dc_ttl = META_DNCACHE_DISABLED;
+			break;
+
+		case LDAP_BACK_CFG_DNCACHE_SIZE:
+			mi->mi_cache.dc_size = LDAP_DNCACHE_SIZE_DEFAULT;
 			break;
 
 		case LDAP_BACK_CFG_IDLE_TIMEOUT:
@@ -1644,6 +1696,15 @@ meta_back_cf_gen( ConfigArgs *c )
 			mi->mi_conn_priv_max = LDAP_BACK_CONN_PRIV_MIN;
 			break;
 
+		case LDAP_BACK_CFG_SORT_MERGE:
+#ifdef SLAP_CONFIG_DELETE
+			if ( META_BACK_SORT_MERGE( mi ) ) {
+				overlay_unregister_control( c->be, LDAP_CONTROL_SORTREQUEST );
+			}
+#endif /* SLAP_CONFIG_DELETE */
+			mi->mi_flags &= ~META_BACK_F_SORT_MERGE;
+			break;
+
 		/* common attrs */
 		case LDAP_BACK_CFG_BIND_TIMEOUT:
 			mc->mc_bind_timeout.tv_sec = 0;
@@ -2196,13 +2257,18 @@ meta_back_cf_gen( ConfigArgs *c )
 		}
 		break;
 
+	case LDAP_BACK_CFG_DNCACHE_SIZE:
+	/* max number of entries in dn cache; 0 means unbounded */
+		mi->mi_cache.dc_size = c->value_ulong;
+		break;
+
 	case LDAP_BACK_CFG_DNCACHE_TTL:
 	/* ttl of dn cache */
 		if ( strcasecmp( c->argv[ 1 ], "forever" ) == 0 ) {
-			mi->mi_cache.ttl = META_DNCACHE_FOREVER;
+			mi->mi_cache.dc_ttl = META_DNCACHE_FOREVER;
 
 		} else if ( strcasecmp( c->argv[ 1 ], "disabled" ) == 0 ) {
-			mi->mi_cache.ttl = META_DNCACHE_DISABLED;
+			mi->mi_cache.dc_ttl = META_DNCACHE_DISABLED;
 
 		} else {
 			unsigned long	t;
@@ -2214,7 +2280,7 @@ meta_back_cf_gen( ConfigArgs *c )
 				Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
 				return 1;
 			}
-			mi->mi_cache.ttl = (time_t)t;
+			mi->mi_cache.dc_ttl = (time_t)t;
 		}
 		break;
 
@@ -2408,6 +2474,40 @@ meta_back_cf_gen( ConfigArgs *c )
 		mi->mi_conn_priv_max = c->value_int;
 		break;
 
+	case LDAP_BACK_CFG_SORT_MERGE:
+	/* sort-merge? */
+		if ( c->value_int ) {
+			int	cid;
+
+			/* if sssvlv registered it already, leave it alone */
+			if ( slap_find_control_id( LDAP_CONTROL_SORTREQUEST, &cid )
+				== LDAP_CONTROL_NOT_FOUND )
+			{
+				rc = register_supported_control2( LDAP_CONTROL_SORTREQUEST,
+					SLAP_CTRL_SEARCH, NULL, meta_sort_parse_ctrl,
+					0, &cid );
+				if ( rc != LDAP_SUCCESS ) {
+					snprintf( c->cr_msg, sizeof( c->cr_msg ),
+						"unable to register sort request control (%d)",
+						rc );
+					Debug( LDAP_DEBUG_ANY, "%s: %s.\n", c->log, c->cr_msg );
+					return 1;
+				}
+			}
+			if ( !META_BACK_SORT_MERGE( mi ) ) {
+				overlay_register_control( c->be, LDAP_CONTROL_SORTREQUEST );
+			}
+			mi->mi_flags |= META_BACK_F_SORT_MERGE;
+		} else {
+#ifdef SLAP_CONFIG_DELETE
+			if ( META_BACK_SORT_MERGE( mi ) ) {
+				overlay_unregister_control( c->be, LDAP_CONTROL_SORTREQUEST );
+			}
+#endif /* SLAP_CONFIG_DELETE */
+			mi->mi_flags &= ~META_BACK_F_SORT_MERGE;
+		}
+		break;
+
 	case LDAP_BACK_CFG_CANCEL:
 		i = verb_to_mask( c->argv[1], cancel_mode );
 		if ( BER_BVISNULL( &cancel_mode[i].word ) ) {
@@ -1352,8 +1352,8 @@ retry_lock:;
 	/*
 	 * looks in cache, if any
 	 */
-	if ( mi->mi_cache.ttl != META_DNCACHE_DISABLED ) {
-		cached = i = meta_dncache_get_target( &mi->mi_cache, &op->o_req_ndn );
+	if ( mi->mi_cache.dc_ttl != META_DNCACHE_DISABLED ) {
+		cached = i = mi->mi_ldap_extra->dncache_get_target( &mi->mi_cache, &op->o_req_ndn );
 	}
 
 	if ( op_type == META_OP_REQUIRE_SINGLE ) {
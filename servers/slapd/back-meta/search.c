@@ -425,6 +425,522 @@ meta_search_dobind_result(
 	return retcode;
 }
 
+/*
+ * Sorted merge (sort-merge): when the client requests server-side
+ * sorting, each target is asked to sort its own results, and the
+ * candidates' result streams are merged while they are read;
+ * at most one entry per target is held at any time.
+ */
+#ifndef LDAP_MATCHRULE_IDENTIFIER
+#define LDAP_MATCHRULE_IDENTIFIER	0x80L
+#define LDAP_REVERSEORDER_IDENTIFIER	0x81L
+#endif
+
+typedef struct meta_sort_key_t {
+	AttributeDescription	*msk_ad;
+	MatchingRule		*msk_ordering;
+	int			msk_direction;	/* 1=normal, -1=reverse */
+} meta_sort_key_t;
+
+typedef struct meta_sort_head_t {
+	LDAPMessage		*msh_res;	/* entry waiting to be sent */
+	struct berval		*msh_vals;	/* its normalized sort keys */
+} meta_sort_head_t;
+
+typedef struct meta_sort_t {
+	int			ms_nkeys;
+	meta_sort_key_t		*ms_keys;
+	meta_sort_head_t	*ms_heads;	/* one per target */
+	int			ms_result;	/* first sortResult failure */
+} meta_sort_t;
+
+static LDAPSortKey **
+meta_sort_keys_get( LDAPControl *ctrl )
+{
+	BerElementBuffer	berbuf;
+	BerElement		*ber = (BerElement *)&berbuf;
+	LDAPSortKey		**keys = NULL;
+	ber_tag_t		tag;
+	ber_len_t		len;
+	int			n = 0;
+
+	if ( BER_BVISNULL( &ctrl->ldctl_value )
+		|| BER_BVISEMPTY( &ctrl->ldctl_value ) )
+	{
+		return NULL;
+	}
+
+	ber_init2( ber, &ctrl->ldctl_value, 0 );
+	if ( ber_scanf( ber, "{" ) == LBER_ERROR ) {
+		return NULL;
+	}
+
+	do {
+		LDAPSortKey	*key;
+		ber_int_t	reverse = 0;
+
+		key = ber_memcalloc( 1, sizeof( LDAPSortKey ) );
+		keys = ber_memrealloc( keys, ( n + 2 ) * sizeof( LDAPSortKey * ) );
+		keys[ n++ ] = key;
+		keys[ n ] = NULL;
+
+		if ( ber_scanf( ber, "{a", &key->attributeType ) == LBER_ERROR ) {
+			goto fail;
+		}
+
+		tag = ber_peek_tag( ber, &len );
+		if ( tag == LDAP_MATCHRULE_IDENTIFIER ) {
+			if ( ber_scanf( ber, "a", &key->orderingRule ) == LBER_ERROR ) {
+				goto fail;
+			}
+			tag = ber_peek_tag( ber, &len );
+		}
+
+		if ( tag == LDAP_REVERSEORDER_IDENTIFIER ) {
+			if ( ber_scanf( ber, "b", &reverse ) == LBER_ERROR ) {
+				goto fail;
+			}
+		}
+		key->reverseOrder = reverse;
+
+		if ( ber_scanf( ber, "}" ) == LBER_ERROR ) {
+			goto fail;
+		}
+
+		tag = ber_peek_tag( ber, &len );
+	} while ( tag != LBER_DEFAULT );
+
+	return keys;
+
+fail:;
+	ldap_free_sort_keylist( keys );
+	return NULL;
+}
+
+/*
+ * sets *msp to NULL if the request carries no sort control, or if
+ * the sort keys cannot be compared locally; in the latter case,
+ * the sortResult code is returned, and results are returned as
+ * they come, as without sort-merge
+ */
+static int
+meta_sort_init( Operation *op, meta_sort_t **msp )
+{
+	metainfo_t	*mi = ( metainfo_t * )op->o_bd->be_private;
+	LDAPControl	*ctrl;
+	LDAPSortKey	**keys;
+	meta_sort_t	*ms = NULL;
+	struct berval	*vals;
+	int		i, nkeys, rc = LDAP_SUCCESS;
+
+	*msp = NULL;
+
+	ctrl = ldap_control_find( LDAP_CONTROL_SORTREQUEST, op->o_ctrls, NULL );
+	if ( ctrl == NULL ) {
+		return LDAP_SUCCESS;
+	}
+
+	keys = meta_sort_keys_get( ctrl );
+	if ( keys == NULL ) {
+		return LDAP_OTHER;
+	}
+
+	for ( nkeys = 0; keys[ nkeys ] != NULL; nkeys++ )
+		/* count'em */ ;
+
+	ms = op->o_tmpcalloc( 1, sizeof( meta_sort_t )
+		+ nkeys * sizeof( meta_sort_key_t )
+		+ mi->mi_ntargets * ( sizeof( meta_sort_head_t )
+			+ nkeys * sizeof( struct berval ) ),
+		op->o_tmpmemctx );
+	ms->ms_nkeys = nkeys;
+	ms->ms_keys = (meta_sort_key_t *)&ms[ 1 ];
+	ms->ms_heads = (meta_sort_head_t *)&ms->ms_keys[ nkeys ];
+	vals = (struct berval *)&ms->ms_heads[ mi->mi_ntargets ];
+	for ( i = 0; i < mi->mi_ntargets; i++ ) {
+		ms->ms_heads[ i ].msh_vals = &vals[ i * nkeys ];
+	}
+
+	for ( i = 0; i < nkeys; i++ ) {
+		AttributeDescription	*ad = NULL;
+		MatchingRule		*mr;
+		const char		*text;
+
+		if ( slap_str2ad( keys[ i ]->attributeType, &ad, &text ) != LDAP_SUCCESS ) {
+			Debug( LDAP_DEBUG_TRACE, "%s meta_sort_init: "
+				"unrecognized attribute type \"%s\" in sort key\n",
+				op->o_log_prefix, keys[ i ]->attributeType );
+			rc = LDAP_NO_SUCH_ATTRIBUTE;
+			goto fail;
+		}
+
+		if ( keys[ i ]->orderingRule != NULL ) {
+			mr = mr_find( keys[ i ]->orderingRule );
+		} else {
+			mr = ad->ad_type->sat_ordering;
+		}
+
+		if ( mr == NULL || mr->smr_match == NULL ) {
+			Debug( LDAP_DEBUG_TRACE, "%s meta_sort_init: "
+				"no ordering rule for attribute \"%s\"\n",
+				op->o_log_prefix, keys[ i ]->attributeType );
+			rc = LDAP_INAPPROPRIATE_MATCHING;
+			goto fail;
+		}
+
+		ms->ms_keys[ i ].msk_ad = ad;
+		ms->ms_keys[ i ].msk_ordering = mr;
+		ms->ms_keys[ i ].msk_direction = keys[ i ]->reverseOrder ? -1 : 1;
+	}
+
+	ldap_free_sort_keylist( keys );
+	*msp = ms;
+	return LDAP_SUCCESS;
+
+fail:;
+	ldap_free_sort_keylist( keys );
+	op->o_tmpfree( ms, op->o_tmpmemctx );
+	return rc;
+}
+
+/*
+ * records the sortResult of a target; a target that did not sort
+ * its results, or did not say it did, makes the merge meaningless,
+ * so what is held and what follows is sent as it comes
+ */
+static void
+meta_sort_target_result(
+	Operation	*op,
+	LDAP		*ld,
+	int		candidate,
+	meta_sort_t	*ms,
+	LDAPControl	**ctrls,
+	int		err,
+	int		nentries )
+{
+	LDAPControl	*ctrl;
+	ber_int_t	code = LDAP_UNWILLING_TO_PERFORM;
+
+	ctrl = ldap_control_find( LDAP_CONTROL_SORTRESPONSE, ctrls, NULL );
+	if ( ctrl != NULL ) {
+		if ( ldap_parse_sortresponse_control( ld, ctrl, &code, NULL )
+			!= LDAP_SUCCESS )
+		{
+			code = LDAP_OTHER;
+		}
+
+	} else if ( nentries == 0
+		&& err != LDAP_UNAVAILABLE_CRITICAL_EXTENSION )
+	{
+		/* e.g. noSuchObject, nothing was merged */
+		return;
+	}
+
+	if ( code != LDAP_SUCCESS && ms->ms_result == LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_TRACE, "%s meta_sort_target_result[%d]: "
+			"target did not sort (%d), merge stopped\n",
+			op->o_log_prefix, candidate, code );
+		ms->ms_result = code;
+	}
+}
+
+/*
+ * sends the result, with a sortResult control carrying code
+ * unless it is -1, i.e. the request did not ask for sorting
+ */
+static int
+meta_sort_result_send( Operation *op, SlapReply *rs, int code )
+{
+	LDAPControl		*ctrls[ 2 ] = { NULL, NULL };
+	BerElementBuffer	berbuf;
+	BerElement		*ber = (BerElement *)&berbuf;
+	struct berval		bv;
+
+	if ( code == -1 || rs->sr_ctrls != NULL ) {
+		send_ldap_result( op, rs );
+		return rs->sr_err;
+	}
+
+	ber_init2( ber, NULL, LBER_USE_DER );
+	ber_set_option( ber, LBER_OPT_BER_MEMCTX, &op->o_tmpmemctx );
+
+	if ( ber_printf( ber, "{e}", (ber_int_t)code ) != -1
+		&& ber_flatten2( ber, &bv, 0 ) != -1 )
+	{
+		ctrls[ 0 ] = op->o_tmpalloc( sizeof( LDAPControl ) + bv.bv_len,
+			op->o_tmpmemctx );
+		ctrls[ 0 ]->ldctl_oid = LDAP_CONTROL_SORTRESPONSE;
+		ctrls[ 0 ]->ldctl_iscritical = 0;
+		ctrls[ 0 ]->ldctl_value.bv_val = (char *)&ctrls[ 0 ][ 1 ];
+		ctrls[ 0 ]->ldctl_value.bv_len = bv.bv_len;
+		AC_MEMCPY( ctrls[ 0 ]->ldctl_value.bv_val, bv.bv_val, bv.bv_len );
+		rs->sr_ctrls = ctrls;
+	}
+	ber_free_buf( ber );
+
+	send_ldap_result( op, rs );
+
+	if ( ctrls[ 0 ] != NULL ) {
+		rs->sr_ctrls = NULL;
+		op->o_tmpfree( ctrls[ 0 ], op->o_tmpmemctx );
+	}
+
+	return rs->sr_err;
+}
+
+/*
+ * the sort keys are in the proxy's schema; if the target maps
+ * attributes, returns a copy of the request controls with the
+ * sort control rewritten in terms of the target's attributes
+ */
+static LDAPControl **
+meta_sort_ctrls_map( Operation *op, metatarget_t *mt, LDAP *ld )
+{
+	LDAPControl	*ctrl, **ctrls = NULL;
+	LDAPSortKey	**keys;
+	struct berval	val = BER_BVNULL;
+	int		i, n, mapped = 0;
+
+	if ( mt->mt_rwmap.rwm_at.remap == NULL ) {
+		return NULL;
+	}
+
+	ctrl = ldap_control_find( LDAP_CONTROL_SORTREQUEST, op->o_ctrls, NULL );
+	if ( ctrl == NULL ) {
+		return NULL;
+	}
+
+	keys = meta_sort_keys_get( ctrl );
+	if ( keys == NULL ) {
+		return NULL;
+	}
+
+	for ( i = 0; keys[ i ] != NULL; i++ ) {
+		struct berval	bv, mbv;
+
+		ber_str2bv( keys[ i ]->attributeType, 0, 0, &bv );
+		ldap_back_map( &mt->mt_rwmap.rwm_at, &bv, &mbv, BACKLDAP_MAP );
+		if ( !BER_BVISNULL( &mbv ) && !BER_BVISEMPTY( &mbv )
+			&& mbv.bv_val != bv.bv_val )
+		{
+			ber_memfree( keys[ i ]->attributeType );
+			keys[ i ]->attributeType = ber_strdup( mbv.bv_val );
+			mapped++;
+		}
+	}
+
+	if ( mapped && ldap_create_sort_control_value( ld, keys, &val ) == LDAP_SUCCESS ) {
+		for ( n = 0; op->o_ctrls[ n ] != NULL; n++ )
+			/* count'em */ ;
+
+		ctrls = op->o_tmpalloc( ( n + 1 ) * sizeof( LDAPControl * )
+			+ sizeof( LDAPControl ) + val.bv_len + 1, op->o_tmpmemctx );
+		for ( i = 0; i < n; i++ ) {
+			if ( op->o_ctrls[ i ] != ctrl ) {
+				ctrls[ i ] = op->o_ctrls[ i ];
+				continue;
+			}
+
+			ctrls[ i ] = (LDAPControl *)&ctrls[ n + 1 ];
+			*ctrls[ i ] = *ctrl;
+			ctrls[ i ]->ldctl_value.bv_val = (char *)&ctrls[ i ][ 1 ];
+			ctrls[ i ]->ldctl_value.bv_len = val.bv_len;
+			AC_MEMCPY( ctrls[ i ]->ldctl_value.bv_val, val.bv_val, val.bv_len + 1 );
+		}
+		ctrls[ n ] = NULL;
+		ber_memfree( val.bv_val );
+	}
+
+	ldap_free_sort_keylist( keys );
+
+	return ctrls;
+}
+
+static int
+meta_sort_cmp( meta_sort_t *ms, meta_sort_head_t *h1, meta_sort_head_t *h2 )
+{
+	int	i, cmp = 0;
+
+	/* entries without a value for a key sort last, as in sssvlv */
+	for ( i = 0; cmp == 0 && i < ms->ms_nkeys; i++ ) {
+		if ( BER_BVISNULL( &h1->msh_vals[ i ] ) ) {
+			if ( !BER_BVISNULL( &h2->msh_vals[ i ] ) ) {
+				cmp = ms->ms_keys[ i ].msk_direction;
+			}
+
+		} else if ( BER_BVISNULL( &h2->msh_vals[ i ] ) ) {
+			cmp = -ms->ms_keys[ i ].msk_direction;
+
+		} else {
+			MatchingRule	*mr = ms->ms_keys[ i ].msk_ordering;
+
+			mr->smr_match( &cmp, 0, mr->smr_syntax, mr,
+				&h1->msh_vals[ i ], &h2->msh_vals[ i ] );
+			cmp *= ms->ms_keys[ i ].msk_direction;
+		}
+	}
+
+	return cmp;
+}
+
+/*
+ * holds the entry in res as the head of the target's stream,
+ * extracting its sort keys; with multiple values, the smallest
+ * one counts, as in sssvlv
+ */
+static void
+meta_sort_head_set(
+	Operation	*op,
+	metaconn_t	*mc,
+	int		candidate,
+	meta_sort_t	*ms,
+	LDAPMessage	*res )
+{
+	metainfo_t		*mi = ( metainfo_t * )op->o_bd->be_private;
+	metatarget_t		*mt = mi->mi_targets[ candidate ];
+	LDAP			*ld = mc->mc_conns[ candidate ].msc_ld;
+	meta_sort_head_t	*msh = &ms->ms_heads[ candidate ];
+	LDAPMessage		*e = ldap_first_entry( ld, res );
+	int			i;
+
+	assert( msh->msh_res == NULL );
+	msh->msh_res = res;
+
+	for ( i = 0; i < ms->ms_nkeys; i++ ) {
+		AttributeDescription	*ad = ms->ms_keys[ i ].msk_ad;
+		MatchingRule		*mr = ms->ms_keys[ i ].msk_ordering;
+		MatchingRule		*eq = ad->ad_type->sat_equality;
+		struct berval		mapped, **vals,
+					*best = &msh->msh_vals[ i ];
+		int			j;
+
+		BER_BVZERO( best );
+
+		ldap_back_map( &mt->mt_rwmap.rwm_at, &ad->ad_cname,
+			&mapped, BACKLDAP_MAP );
+		if ( BER_BVISNULL( &mapped ) || BER_BVISEMPTY( &mapped ) ) {
+			continue;
+		}
+
+		vals = ldap_get_values_len( ld, e, mapped.bv_val );
+		if ( vals == NULL ) {
+			continue;
+		}
+
+		for ( j = 0; vals[ j ] != NULL; j++ ) {
+			struct berval	nval;
+			int		cmp;
+
+			if ( eq != NULL && eq->smr_normalize ) {
+				if ( ordered_value_normalize(
+					SLAP_MR_VALUE_OF_ATTRIBUTE_SYNTAX,
+					ad, eq, vals[ j ], &nval,
+					op->o_tmpmemctx ) )
+				{
+					continue;
+				}
+
+			} else {
+				ber_dupbv_x( &nval, vals[ j ], op->o_tmpmemctx );
+			}
+
+			if ( !BER_BVISNULL( best ) ) {
+				mr->smr_match( &cmp, 0, mr->smr_syntax, mr,
+					best, &nval );
+				if ( cmp <= 0 ) {
+					op->o_tmpfree( nval.bv_val, op->o_tmpmemctx );
+					continue;
+				}
+				op->o_tmpfree( best->bv_val, op->o_tmpmemctx );
+			}
+			*best = nval;
+		}
+
+		ldap_value_free_len( vals );
+	}
+}
+
+static void
+meta_sort_head_free( Operation *op, meta_sort_t *ms, meta_sort_head_t *msh )
+{
+	int	i;
+
+	ldap_msgfree( msh->msh_res );
+	msh->msh_res = NULL;
+
+	for ( i = 0; i < ms->ms_nkeys; i++ ) {
+		if ( !BER_BVISNULL( &msh->msh_vals[ i ] ) ) {
+			op->o_tmpfree( msh->msh_vals[ i ].bv_val, op->o_tmpmemctx );
+			BER_BVZERO( &msh->msh_vals[ i ] );
+		}
+	}
+}
+
+/*
+ * sends the held entries in order, as long as every target that
+ * is still active has one, or all of them once merging stopped;
+ * *sent is set if any entry was sent
+ */
+static int
+meta_sort_send(
+	Operation	*op,
+	SlapReply	*rs,
+	metaconn_t	*mc,
+	SlapReply	*candidates,
+	meta_sort_t	*ms,
+	int		*sent )
+{
+	metainfo_t	*mi = ( metainfo_t * )op->o_bd->be_private;
+
+	for ( ;; ) {
+		void		*savepriv;
+		long		i, best = -1;
+		int		rc;
+
+		for ( i = 0; i < mi->mi_ntargets; i++ ) {
+			if ( candidates[ i ].sr_msgid == META_MSGID_IGNORE ) {
+				assert( ms->ms_heads[ i ].msh_res == NULL );
+				continue;
+			}
+
+			if ( ms->ms_heads[ i ].msh_res == NULL ) {
+				/* no longer merging, send what is held */
+				if ( ms->ms_result != LDAP_SUCCESS ) {
+					continue;
+				}
+
+				/* need the next entry of this target first */
+				return LDAP_SUCCESS;
+			}
+
+			if ( best == -1 || meta_sort_cmp( ms,
+				&ms->ms_heads[ i ], &ms->ms_heads[ best ] ) < 0 )
+			{
+				best = i;
+			}
+		}
+
+		if ( best == -1 ) {
+			return LDAP_SUCCESS;
+		}
+
+		savepriv = op->o_private;
+		op->o_private = (void *)best;
+		rc = meta_send_entry( op, rs, mc, best,
+			ldap_first_entry( mc->mc_conns[ best ].msc_ld,
+				ms->ms_heads[ best ].msh_res ) );
+		op->o_private = savepriv;
+		meta_sort_head_free( op, ms, &ms->ms_heads[ best ] );
+		*sent = 1;
+
+		switch ( rc ) {
+		case LDAP_SIZELIMIT_EXCEEDED:
+		case LDAP_UNAVAILABLE:
+			return rc;
+		}
+	}
+}
+
 static meta_search_candidate_t
 meta_back_search_start(
 	Operation		*op,
@@ -449,6 +965,7 @@ meta_back_search_start(
 	struct timeval		tv, *tvp = NULL;
 	int			nretries = 1;
 	LDAPControl		**ctrls = NULL;
+	LDAPControl		**sort_ctrls = NULL, **sort_save = NULL;
 #ifdef SLAPD_META_CLIENT_PR
 	LDAPControl		**save_ctrls = NULL;
 #endif /* SLAPD_META_CLIENT_PR */
@@ -698,6 +1215,14 @@ done_pr:;
 	}
 #endif /* SLAPD_META_CLIENT_PR */
 
+	if ( META_BACK_SORT_MERGE( mi ) ) {
+		sort_ctrls = meta_sort_ctrls_map( op, mt, msc->msc_ld );
+		if ( sort_ctrls != NULL ) {
+			sort_save = op->o_ctrls;
+			op->o_ctrls = sort_ctrls;
+		}
+	}
+
 retry:;
 	ctrls = op->o_ctrls;
 	if ( meta_back_controls_add( op, rs, *mcp, candidate, &ctrls )
@@ -744,6 +1269,10 @@ retry:;
 
 done:;
 	(void)mi->mi_ldap_extra->controls_free( op, rs, &ctrls );
+	if ( sort_ctrls != NULL ) {
+		op->o_ctrls = sort_save;
+		op->o_tmpfree( sort_ctrls, op->o_tmpmemctx );
+	}
 #ifdef SLAPD_META_CLIENT_PR
 	if ( save_ctrls != op->o_ctrls ) {
 		op->o_tmpfree( op->o_ctrls, op->o_tmpmemctx );
@@ -788,11 +1317,34 @@ meta_back_search( Operation *op, SlapReply *rs )
 	int		is_ok = 0;
 	void		*savepriv;
 	SlapReply	*candidates = NULL;
+	meta_sort_t	*ms = NULL;
+	int		sort_rc = -1,	/* sortResult code, if sorting */
+			sort_critical = 0;
 	int		do_taint = 0;
 
 	rs_assert_ready( rs );
 	rs->sr_flags &= ~REP_ENTRY_MASK; /* paranoia, we can set rs = non-entry */
 
+	if ( META_BACK_SORT_MERGE( mi ) ) {
+		LDAPControl	*ctrl;
+
+		ctrl = ldap_control_find( LDAP_CONTROL_SORTREQUEST, op->o_ctrls, NULL );
+		if ( ctrl != NULL ) {
+			sort_rc = meta_sort_init( op, &ms );
+			sort_critical = ctrl->ldctl_iscritical;
+
+			/* RFC 2891: a critical request that cannot be
+			 * honored must fail, not return unsorted results */
+			if ( ms == NULL && sort_critical ) {
+				rs->sr_err = LDAP_UNAVAILABLE_CRITICAL_EXTENSION;
+				rs->sr_text = "sort keys cannot be merged";
+				meta_sort_result_send( op, rs, sort_rc );
+				rs->sr_text = NULL;
+				return rs->sr_err;
+			}
+		}
+	}
+
 	/*
 	 * controls are set in ldap_back_dobind()
 	 * 
@@ -1111,6 +1663,11 @@ getconn:;
 				break;
 			}
 
+			/* holding an entry that has not been merged yet */
+			if ( ms != NULL && ms->ms_heads[ i ].msh_res != NULL ) {
+				continue;
+			}
+
 #ifdef DEBUG_205
 			if ( msc->msc_ld == NULL ) {
 				ldap_pvt_thread_mutex_lock( &mi->mi_conninfo.lai_mutex );
@@ -1134,7 +1691,8 @@ getconn:;
 			 */
 			tv = save_tv;
 			rc = ldap_result( msc->msc_ld, candidates[ i ].sr_msgid,
-					LDAP_MSG_RECEIVED, &tv, &res );
+					ms != NULL ? LDAP_MSG_ONE : LDAP_MSG_RECEIVED,
+					&tv, &res );
 			switch ( rc ) {
 			case 0:
 				/* FIXME: res should not need to be freed */
@@ -1234,6 +1792,18 @@ really_bad:;
 
 					is_ok++;
 
+					/* don't wait any longer... */
+					gotit = 1;
+					save_tv.tv_sec = 0;
+					save_tv.tv_usec = 0;
+
+					if ( ms != NULL ) {
+						/* res only contains this entry */
+						meta_sort_head_set( op, mc, i, ms, res );
+						res = NULL;
+						break;
+					}
+
 					e = ldap_first_entry( msc->msc_ld, msg );
 					savepriv = op->o_private;
 					op->o_private = (void *)i;
@@ -1243,7 +1813,7 @@ really_bad:;
 					case LDAP_SIZELIMIT_EXCEEDED:
 						savepriv = op->o_private;
 						op->o_private = (void *)i;
-						send_ldap_result( op, rs );
+						meta_sort_result_send( op, rs, sort_rc );
 						op->o_private = savepriv;
 						rs->sr_err = LDAP_SUCCESS;
 						ldap_msgfree( res );
@@ -1258,11 +1828,6 @@ really_bad:;
 					}
 					op->o_private = savepriv;
 
-					/* don't wait any longer... */
-					gotit = 1;
-					save_tv.tv_sec = 0;
-					save_tv.tv_usec = 0;
-
 				} else if ( rc == LDAP_RES_SEARCH_REFERENCE ) {
 					char		**references = NULL;
 					int		cnt;
@@ -1406,6 +1971,13 @@ really_bad:;
 
 					rs->sr_err = candidates[ i ].sr_err;
 
+					if ( ms != NULL ) {
+						meta_sort_target_result( op, msc->msc_ld,
+							i, ms, ctrls, rs->sr_err,
+							candidates[ i ].sr_nentries );
+						sort_rc = ms->ms_result;
+					}
+
 					/* massage matchedDN if need be */
 					if ( candidates[ i ].sr_matched != NULL ) {
 						struct berval	match, mmatch;
@@ -1631,7 +2203,7 @@ got_err:
 							savepriv = op->o_private;
 							op->o_private = (void *)i;
 							rs->sr_text = candidates[ i ].sr_text;
-							send_ldap_result( op, rs );
+							meta_sort_result_send( op, rs, sort_rc );
 							rs->sr_text = save_text;
 							op->o_private = savepriv;
 							ldap_msgfree( res );
@@ -1762,6 +2334,21 @@ free_message:;
 			break;
 		}
 
+		/* send what can be sent in order */
+		if ( ms != NULL ) {
+			rs->sr_err = meta_sort_send( op, rs, mc, candidates, ms, &gotit );
+			switch ( rs->sr_err ) {
+			case LDAP_SIZELIMIT_EXCEEDED:
+				meta_sort_result_send( op, rs, sort_rc );
+				rs->sr_err = LDAP_SUCCESS;
+				goto finish;
+
+			case LDAP_UNAVAILABLE:
+				rs->sr_err = LDAP_OTHER;
+				goto finish;
+			}
+		}
+
 		/* if no entry was found during this loop,
 		 * set a minimal timeout */
 		if ( ncandidates > 0 && gotit == 0 ) {
@@ -1898,10 +2485,16 @@ free_message:;
 		}
 	}
 
+	/* a target did not sort what was asked critically */
+	if ( sres == LDAP_SUCCESS && sort_critical && sort_rc != LDAP_SUCCESS ) {
+		sres = LDAP_UNAVAILABLE_CRITICAL_EXTENSION;
+		rs->sr_text = "a target could not sort its results";
+	}
+
 	rs->sr_err = sres;
 	rs->sr_matched = ( sres == LDAP_SUCCESS ? NULL : matched );
 	rs->sr_ref = ( sres == LDAP_REFERRAL ? rs->sr_v2ref : NULL );
-	send_ldap_result( op, rs );
+	meta_sort_result_send( op, rs, sort_rc );
 	op->o_private = savepriv;
 	rs->sr_matched = NULL;
 	rs->sr_ref = NULL;
@@ -1915,6 +2508,15 @@ finish:;
 		ber_bvarray_free_x( rs->sr_v2ref, op->o_tmpmemctx );
 	}
 
+	if ( ms != NULL ) {
+		for ( i = 0; i < mi->mi_ntargets; i++ ) {
+			if ( ms->ms_heads[ i ].msh_res != NULL ) {
+				meta_sort_head_free( op, ms, &ms->ms_heads[ i ] );
+			}
+		}
+		op->o_tmpfree( ms, op->o_tmpmemctx );
+	}
+
 	for ( i = 0; i < mi->mi_ntargets; i++ ) {
 		if ( !META_IS_CANDIDATE( &candidates[ i ] ) ) {
 			continue;
@@ -2074,8 +2676,8 @@ meta_send_entry(
 	/*
 	 * cache dn
 	 */
-	if ( mi->mi_cache.ttl != META_DNCACHE_DISABLED ) {
-		( void )meta_dncache_update_entry( &mi->mi_cache,
+	if ( mi->mi_cache.dc_ttl != META_DNCACHE_DISABLED ) {
+		( void )mi->mi_ldap_extra->dncache_update_entry( &mi->mi_cache,
 				&ent.e_nname, target );
 	}
 
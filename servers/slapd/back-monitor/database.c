@@ -107,7 +107,7 @@ monitor_subsys_overlay_init_one(
 	monitor_subsys_t	*ms_overlay,
 	slap_overinst		*on,
 	Entry			*e_database,
-	Entry			**ep_overlay )
+	Entry			***epp_overlay )
 {
 	char			buf[ BACKMONITOR_BUFSIZE ];
 	int			j, o;
@@ -188,8 +188,8 @@ monitor_subsys_overlay_init_one(
 		return -1;
 	}
 
-	*ep_overlay = e_overlay;
-	ep_overlay = &mp_overlay->mp_next;
+	**epp_overlay = e_overlay;
+	*epp_overlay = &mp_overlay->mp_next;
 
 	return 0;
 }
@@ -366,7 +366,7 @@ monitor_subsys_database_init_one(
 
 		for ( ; on; on = on->on_next ) {
 			monitor_subsys_overlay_init_one( mi, be,
-				ms, ms_overlay, on, e, ep_overlay );
+				ms, ms_overlay, on, e, &ep_overlay );
 		}
 	}
 
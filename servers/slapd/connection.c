@@ -1171,7 +1171,18 @@ operations_error:
 		 * to complete it later. Don't do anything
 		 * else with it now. Detach memctx too.
 		 */
+		void *arg;
+		ldap_pvt_thread_pool_keyfree_t *func;
+
 		slap_sl_mem_setctx( ctx, NULL );
+		/* let the owner know it may go on (see slap_op_handoff) */
+		if ( ldap_pvt_thread_pool_getkey( ctx, (void *)slap_op_handoff,
+			&arg, &func ) == 0 )
+		{
+			ldap_pvt_thread_pool_setkey( ctx, (void *)slap_op_handoff,
+				NULL, 0, NULL, NULL );
+			func( (void *)slap_op_handoff, arg );
+		}
 		ldap_pvt_thread_mutex_lock( &conn->c_mutex );
 		connection_resched( conn );
 		ldap_pvt_thread_mutex_unlock( &conn->c_mutex );
@@ -156,6 +156,23 @@ slap_op_free( Operation *op, void *ctx )
 	}
 }
 
+/*
+ * op will be completed by another thread, which must not touch it
+ * before the thread that started it is done with it: once op's
+ * handler has returned SLAPD_ASYNCOP to connection_operation(),
+ * func( (void *)slap_op_handoff, arg ) is called there. Only to be
+ * used right before returning SLAPD_ASYNCOP
+ */
+void
+slap_op_handoff(
+	Operation *op,
+	ldap_pvt_thread_pool_keyfree_t *func,
+	void *arg )
+{
+	ldap_pvt_thread_pool_setkey( op->o_threadctx, (void *)slap_op_handoff,
+		arg, func, NULL, NULL );
+}
+
 void
 slap_op_time(time_t *t, int *nop)
 {
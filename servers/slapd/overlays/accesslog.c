@@ -32,6 +32,12 @@
 #include "config.h"
 #include "lutil.h"
 #include "ldap_rq.h"
+#include "../back-monitor/back-monitor.h"
+
+/*
+ * Monitoring
+ */
+#define ACCESSLOG_MONITOR
 
 #define LOG_OP_ADD	0x001
 #define LOG_OP_DELETE	0x002
@@ -69,12 +75,21 @@ typedef struct log_info {
 	slap_mask_t li_ops;
 	int li_age;
 	int li_cycle;
+	int li_purgebatch;
+	unsigned long li_purge_deleted;
+	unsigned long li_purge_pending;
+	unsigned long li_purge_batches;
+#ifdef ACCESSLOG_MONITOR
+	void *li_monitor_cb;
+	struct berval li_monitor_ndn;
+#endif /* ACCESSLOG_MONITOR */
 	struct re_s *li_task;
 	Filter *li_oldf;
 	Entry *li_old;
 	log_attr *li_oldattrs;
 	struct berval li_uuid;
 	int li_success;
+	int li_modbinary;
 	log_base *li_bases;
 	BerVarray li_mincsn;
 	int *li_sids, li_numcsns;
@@ -91,7 +106,9 @@ enum {
 	LOG_SUCCESS,
 	LOG_OLD,
 	LOG_OLDATTR,
-	LOG_BASE
+	LOG_BASE,
+	LOG_MODBINARY,
+	LOG_PURGEBATCH
 };
 
 static ConfigTable log_cfats[] = {
@@ -132,6 +149,16 @@ static ConfigTable log_cfats[] = {
 			"DESC 'Operation types to log under a specific branch' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "logmodbinary", NULL, 2, 2, 0, ARG_MAGIC|ARG_ON_OFF|LOG_MODBINARY,
+		log_cf_gen, "( OLcfgOvAt:4.8 NAME 'olcAccessLogModBinary' "
+			"DESC 'Log modifications as a single compact binary reqMod value' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "logpurgebatch", "entries", 2, 2, 0, ARG_MAGIC|ARG_INT|LOG_PURGEBATCH,
+		log_cf_gen, "( OLcfgOvAt:4.9 NAME 'olcAccessLogPurgeBatch' "
+			"DESC 'Number of expired log entries deleted per transaction' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ NULL }
 };
 
@@ -142,7 +169,8 @@ static ConfigOCs log_cfocs[] = {
 		"SUP olcOverlayConfig "
 		"MUST olcAccessLogDB "
 		"MAY ( olcAccessLogOps $ olcAccessLogPurge $ olcAccessLogSuccess $ "
-			"olcAccessLogOld $ olcAccessLogOldAttr $ olcAccessLogBase ) )",
+			"olcAccessLogOld $ olcAccessLogOldAttr $ olcAccessLogBase $ "
+			"olcAccessLogModBinary $ olcAccessLogPurgeBatch ) )",
 			Cft_Overlay, log_cfats },
 	{ NULL }
 };
@@ -203,6 +231,12 @@ static AttributeDescription *ad_reqDN, *ad_reqStart, *ad_reqEnd, *ad_reqType,
 	*ad_reqReferral, *ad_reqOld, *ad_auditContext, *ad_reqEntryUUID,
 	*ad_minCSN;
 
+#ifdef ACCESSLOG_MONITOR
+static AttributeDescription *ad_purgeDeleted, *ad_purgePending,
+	*ad_purgeBatches;
+static ObjectClass *oc_olmAccessLog;
+#endif /* ACCESSLOG_MONITOR */
+
 static int
 logSchemaControlValidate(
 	Syntax		*syntax,
@@ -425,6 +459,26 @@ static struct {
 		"SYNTAX 1.3.6.1.4.1.4203.666.11.2.1{64} "
 		"NO-USER-MODIFICATION "
 		"USAGE dSAOperation )", &ad_minCSN },
+#ifdef ACCESSLOG_MONITOR
+	{ "( " LOG_SCHEMA_AT ".33 NAME 'olmAccessLogPurgeDeleted' "
+		"DESC 'Number of log entries deleted by purge' "
+		"EQUALITY integerMatch "
+		"SYNTAX OMsInteger "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )", &ad_purgeDeleted },
+	{ "( " LOG_SCHEMA_AT ".34 NAME 'olmAccessLogPurgePending' "
+		"DESC 'Number of expired log entries not yet deleted by the running purge' "
+		"EQUALITY integerMatch "
+		"SYNTAX OMsInteger "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )", &ad_purgePending },
+	{ "( " LOG_SCHEMA_AT ".35 NAME 'olmAccessLogPurgeBatches' "
+		"DESC 'Number of purge transactions committed in batch mode' "
+		"EQUALITY integerMatch "
+		"SYNTAX OMsInteger "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )", &ad_purgeBatches },
+#endif /* ACCESSLOG_MONITOR */
 	{ NULL, NULL }
 };
 
@@ -488,6 +542,14 @@ static struct {
 		"DESC 'Extended operation' "
 		"SUP auditObject STRUCTURAL "
 		"MAY reqData )", &log_ocs[LOG_EN_EXTENDED] },
+#ifdef ACCESSLOG_MONITOR
+	/* augments an existing object, so it must be AUXILIARY */
+	{ "( " LOG_SCHEMA_OC ".13 NAME 'olmAccessLog' "
+		"DESC 'Accesslog monitor information' "
+		"SUP top AUXILIARY "
+		"MAY ( olmAccessLogPurgeDeleted $ olmAccessLogPurgePending $ "
+			"olmAccessLogPurgeBatches ) )", &oc_olmAccessLog },
+#endif /* ACCESSLOG_MONITOR */
 	{ NULL, NULL }
 };
 
@@ -657,6 +719,56 @@ log_old_lookup( Operation *op, SlapReply *rs )
 	return 0;
 }
 
+/* Delete a batch of expired entries inside a single backend transaction,
+ * instead of paying for one commit per entry. Returns the number of
+ * entries handled, or -1 if the batch was rolled back. The number of
+ * entries actually deleted is returned in *deleted.
+ */
+static int
+accesslog_purge_batch( Operation *op, purge_data *pd, int first, int num,
+	int *deleted )
+{
+	SlapReply rs = {REP_RESULT};
+	OpExtra *txn = NULL;
+	int i, rc, ndel = 0;
+
+	rc = op->o_bd->bd_info->bi_op_txn( op, SLAP_TXN_BEGIN, &txn );
+	if ( rc ) {
+		Debug( LDAP_DEBUG_ANY, "accesslog_purge_batch: "
+			"couldn't start transaction (%d)\n", rc );
+		return -1;
+	}
+
+	for ( i = first; i < first + num; i++ ) {
+		op->o_req_dn = pd->dn[i];
+		op->o_req_ndn = pd->ndn[i];
+		rs_reinit( &rs, REP_RESULT );
+		rc = op->o_bd->be_delete( op, &rs );
+		if ( rc == LDAP_SUCCESS )
+			ndel++;
+		/* an entry that's already gone is not worth a rollback */
+		else if ( rc != LDAP_NO_SUCH_OBJECT )
+			break;
+		rc = LDAP_SUCCESS;
+	}
+
+	/* the txn must not outlive this op's extra list */
+	LDAP_SLIST_REMOVE( &op->o_extra, txn, OpExtra, oe_next );
+	if ( rc == LDAP_SUCCESS ) {
+		rc = op->o_bd->bd_info->bi_op_txn( op, SLAP_TXN_COMMIT, &txn );
+	} else {
+		op->o_bd->bd_info->bi_op_txn( op, SLAP_TXN_ABORT, &txn );
+	}
+	if ( rc ) {
+		Debug( LDAP_DEBUG_ANY, "accesslog_purge_batch: "
+			"batch of %d entries at %s rolled back (%d)\n",
+			num, pd->dn[first].bv_val, rc );
+		return -1;
+	}
+	*deleted = ndel;
+	return num;
+}
+
 /* Periodically search for old entries in the log database and delete them */
 static void *
 accesslog_purge( void *ctx, void *arg )
@@ -746,17 +858,42 @@ accesslog_purge( void *ctx, void *arg )
 
 		/* delete the expired entries */
 		op->o_tag = LDAP_REQ_DELETE;
-		for (i=0; i<pd.used; i++) {
-			op->o_req_dn = pd.dn[i];
-			op->o_req_ndn = pd.ndn[i];
+		li->li_purge_pending = pd.used;
+		for (i=0; i<pd.used; ) {
+			int num = 1;
+
 			if ( !slapd_shutdown ) {
-				rs_reinit( &rs, REP_RESULT );
-				op->o_bd->be_delete( op, &rs );
+				int done = 0, deleted = 0;
+
+				if ( li->li_purgebatch > 1 && op->o_bd->bd_info->bi_op_txn ) {
+					num = pd.used - i;
+					if ( num > li->li_purgebatch )
+						num = li->li_purgebatch;
+					if ( accesslog_purge_batch( op, &pd, i, num, &deleted ) > 0 ) {
+						li->li_purge_batches++;
+						done = 1;
+					} else {
+						/* step over this entry alone, then resume batching */
+						num = 1;
+					}
+				}
+				if ( !done ) {
+					op->o_req_dn = pd.dn[i];
+					op->o_req_ndn = pd.ndn[i];
+					rs_reinit( &rs, REP_RESULT );
+					if ( op->o_bd->be_delete( op, &rs ) == LDAP_SUCCESS )
+						deleted = 1;
+				}
+				li->li_purge_deleted += deleted;
+			}
+			li->li_purge_pending -= num;
+			for ( num += i; i < num; i++ ) {
+				ch_free( pd.ndn[i].bv_val );
+				ch_free( pd.dn[i].bv_val );
 			}
-			ch_free( pd.ndn[i].bv_val );
-			ch_free( pd.dn[i].bv_val );
 			ldap_pvt_thread_pool_pausecheck( &connection_pool );
 		}
+		li->li_purge_pending = 0;
 		ch_free( pd.ndn );
 		ch_free( pd.dn );
 	}
@@ -820,6 +957,18 @@ log_cf_gen(ConfigArgs *c)
 			else
 				rc = 1;
 			break;
+		case LOG_MODBINARY:
+			if ( li->li_modbinary )
+				c->value_int = li->li_modbinary;
+			else
+				rc = 1;
+			break;
+		case LOG_PURGEBATCH:
+			if ( li->li_purgebatch )
+				c->value_int = li->li_purgebatch;
+			else
+				rc = 1;
+			break;
 		case LOG_OLD:
 			if ( li->li_oldf ) {
 				filter2bv( li->li_oldf, &agebv );
@@ -880,6 +1029,12 @@ log_cf_gen(ConfigArgs *c)
 		case LOG_SUCCESS:
 			li->li_success = 0;
 			break;
+		case LOG_MODBINARY:
+			li->li_modbinary = 0;
+			break;
+		case LOG_PURGEBATCH:
+			li->li_purgebatch = 0;
+			break;
 		case LOG_OLD:
 			if ( li->li_oldf ) {
 				filter_free( li->li_oldf );
@@ -979,6 +1134,20 @@ log_cf_gen(ConfigArgs *c)
 		case LOG_SUCCESS:
 			li->li_success = c->value_int;
 			break;
+		case LOG_MODBINARY:
+			li->li_modbinary = c->value_int;
+			break;
+		case LOG_PURGEBATCH:
+			if ( c->value_int < 0 ) {
+				snprintf( c->cr_msg, sizeof( c->cr_msg ),
+					"%s: invalid batch size \"%d\"",
+					c->argv[0], c->value_int );
+				Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg );
+				rc = 1;
+				break;
+			}
+			li->li_purgebatch = c->value_int;
+			break;
 		case LOG_OLD:
 			li->li_oldf = str2filter( c->argv[1] );
 			if ( !li->li_oldf ) {
@@ -1457,6 +1626,32 @@ static void accesslog_val2val(AttributeDescription *ad, struct berval *val,
 	dst->bv_val[dst->bv_len] = '\0';
 }
 
+static void accesslog_bin_put( BerElement *ber, int mop,
+	AttributeDescription *ad, BerVarray vals )
+{
+	ber_printf( ber, "{e{O[W]N}N}", (ber_int_t)mop, &ad->ad_cname, vals );
+}
+
+static Attribute *accesslog_bin_flatten( BerElement *ber, Attribute *last_attr )
+{
+	Attribute *a;
+	BerVarray vals;
+
+	ber_printf( ber, /*{*/ "N}" );
+
+	vals = ch_malloc( 2 * sizeof( struct berval ));
+	ber_flatten2( ber, &vals[0], 1 );
+	BER_BVZERO( &vals[1] );
+	ber_free_buf( ber );
+
+	a = attr_alloc( ad_reqMod );
+	a->a_numvals = 1;
+	a->a_vals = vals;
+	a->a_nvals = vals;
+	last_attr->a_next = a;
+	return a;
+}
+
 static int
 accesslog_op2logop( Operation *op )
 {
@@ -1491,6 +1686,8 @@ static int accesslog_response(Operation *op, SlapReply *rs) {
 	BerVarray vals;
 	Operation op2 = {0};
 	SlapReply rs2 = {REP_RESULT};
+	BerElementBuffer berbuf;
+	BerElement *ber = (BerElement *)&berbuf;
 
 	{
 		slap_callback *sc = op->o_callback;
@@ -1581,6 +1778,15 @@ static int accesslog_response(Operation *op, SlapReply *rs) {
 			e2 = old;
 			c_op = 0;
 		}
+		if ( logop == LOG_EN_ADD && li->li_modbinary ) {
+			ber_init2( ber, NULL, LBER_USE_DER );
+			ber_printf( ber, "t{" /*}*/, SLAP_ACCESSLOG_MODBIN_TAG );
+			for ( a=e2->e_attrs; a; a=a->a_next ) {
+				accesslog_bin_put( ber, LDAP_MOD_ADD, a->a_desc, a->a_vals );
+			}
+			accesslog_bin_flatten( ber, last_attr );
+			break;
+		}
 		/* count all the vals */
 		i = 0;
 		for ( a=e2->e_attrs; a; a=a->a_next ) {
@@ -1622,7 +1828,13 @@ static int accesslog_response(Operation *op, SlapReply *rs) {
 				i++;
 			}
 		}
-		vals = ch_malloc( (i+1) * sizeof( struct berval ));
+		if ( li->li_modbinary ) {
+			vals = NULL;
+			ber_init2( ber, NULL, LBER_USE_DER );
+			ber_printf( ber, "t{" /*}*/, SLAP_ACCESSLOG_MODBIN_TAG );
+		} else {
+			vals = ch_malloc( (i+1) * sizeof( struct berval ));
+		}
 		i = 0;
 
 		/* init flags on old entry */
@@ -1657,13 +1869,40 @@ static int accesslog_response(Operation *op, SlapReply *rs) {
 				continue;
 			}
 
+			if ( li->li_modbinary ) {
+				int mop;
+
+				/* only LDAP ops go in the record, consumers
+				 * know nothing of the internal ones */
+				switch ( m->sml_op ) {
+				case LDAP_MOD_ADD:
+				case LDAP_MOD_DELETE:
+				case LDAP_MOD_REPLACE:
+				case LDAP_MOD_INCREMENT: mop = m->sml_op; break;
+				case SLAP_MOD_SOFTADD:	/* FALLTHRU */
+				case SLAP_MOD_ADD_IF_NOT_PRESENT: mop = LDAP_MOD_ADD; break;
+				case SLAP_MOD_SOFTDEL: mop = LDAP_MOD_DELETE; break;
+				default:
+					Debug( LDAP_DEBUG_ANY, "accesslog_response: "
+						"unknown mod op 0x%x on %s not logged\n",
+						m->sml_op, m->sml_desc->ad_cname.bv_val );
+					continue;
+				}
+				/* each change is its own element, so ITS#6545
+				 * transitions need no separator */
+				accesslog_bin_put( ber, mop, m->sml_desc, m->sml_values );
+				i++;
+				continue;
+			}
+
 			if ( m->sml_values ) {
 				for ( b = m->sml_values; !BER_BVISNULL( b ); b++, i++ ) {
 					char c_op;
 
 					switch ( m->sml_op ) {
 					case LDAP_MOD_ADD:	/* FALLTHRU */
-					case SLAP_MOD_SOFTADD: c_op = '+'; break;
+					case SLAP_MOD_SOFTADD:	/* FALLTHRU */
+					case SLAP_MOD_ADD_IF_NOT_PRESENT: c_op = '+'; break;
 					case LDAP_MOD_DELETE: /* FALLTHRU */
 					case SLAP_MOD_SOFTDEL: c_op = '-'; break;
 					case LDAP_MOD_REPLACE:	c_op = '='; break;
@@ -1703,7 +1942,14 @@ static int accesslog_response(Operation *op, SlapReply *rs) {
 			}
 		}
 
-		if ( i > 0 ) {
+		if ( li->li_modbinary ) {
+			if ( i > 0 ) {
+				last_attr = accesslog_bin_flatten( ber, last_attr );
+			} else {
+				ber_free_buf( ber );
+			}
+
+		} else if ( i > 0 ) {
 			BER_BVZERO( &vals[i] );
 			a = attr_alloc( ad_reqMod );
 			a->a_numvals = i;
@@ -2212,6 +2458,11 @@ accesslog_db_init(
 	on->on_bi.bi_private = li;
 	ldap_pvt_thread_mutex_recursive_init( &li->li_op_rmutex );
 	ldap_pvt_thread_mutex_init( &li->li_log_mutex );
+#ifdef ACCESSLOG_MONITOR
+	if ( backend_info( "monitor" ) != NULL ) {
+		SLAP_DBFLAGS( be ) |= SLAP_DBFLAG_MONITORING;
+	}
+#endif /* ACCESSLOG_MONITOR */
 	return 0;
 }
 
@@ -2377,6 +2628,204 @@ accesslog_db_root(
 	return NULL;
 }
 
+#ifdef ACCESSLOG_MONITOR
+
+static int
+accesslog_monitor_update(
+	Operation	*op,
+	SlapReply	*rs,
+	Entry		*e,
+	void		*priv )
+{
+	log_info	*li = (log_info *) priv;
+	struct {
+		AttributeDescription *ad;
+		unsigned long val;
+	} counters[] = {
+		{ ad_purgeDeleted, li->li_purge_deleted },
+		{ ad_purgePending, li->li_purge_pending },
+		{ ad_purgeBatches, li->li_purge_batches },
+		{ NULL }
+	};
+	int		i;
+
+	for ( i = 0; counters[i].ad; i++ ) {
+		Attribute	*a;
+		char		buf[ SLAP_TEXT_BUFLEN ];
+		struct berval	bv;
+
+		a = attr_find( e->e_attrs, counters[i].ad );
+		assert( a != NULL );
+
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", counters[i].val );
+
+		if ( a->a_nvals != a->a_vals ) {
+			ber_bvreplace( &a->a_nvals[ 0 ], &bv );
+		}
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
+	return SLAP_CB_CONTINUE;
+}
+
+static int
+accesslog_monitor_free(
+	Entry		*e,
+	void		**priv )
+{
+	struct berval	values[ 2 ];
+	Modification	mod = { 0 };
+	AttributeDescription *ads[] = {
+		ad_purgeDeleted, ad_purgePending, ad_purgeBatches, NULL };
+
+	const char	*text;
+	char		textbuf[ SLAP_TEXT_BUFLEN ];
+
+	int		i;
+
+	/* NOTE: if slap_shutdown != 0, priv might have already been freed */
+	*priv = NULL;
+
+	/* Remove objectClass */
+	mod.sm_op = LDAP_MOD_DELETE;
+	mod.sm_desc = slap_schema.si_ad_objectClass;
+	mod.sm_values = values;
+	mod.sm_numvals = 1;
+	values[ 0 ] = oc_olmAccessLog->soc_cname;
+	BER_BVZERO( &values[ 1 ] );
+
+	modify_delete_values( e, &mod, 1, &text,
+		textbuf, sizeof( textbuf ) );
+	/* don't care too much about return code... */
+
+	/* remove attrs */
+	mod.sm_values = NULL;
+	mod.sm_numvals = 0;
+	for ( i = 0; ads[i]; i++ ) {
+		mod.sm_desc = ads[i];
+		modify_delete_values( e, &mod, 1, &text,
+			textbuf, sizeof( textbuf ) );
+	}
+
+	return SLAP_CB_CONTINUE;
+}
+
+static int
+accesslog_monitor_db_open( BackendDB *be )
+{
+	slap_overinst		*on = (slap_overinst *)be->bd_info;
+	log_info		*li = on->on_bi.bi_private;
+	Attribute		*a, *next;
+	monitor_callback_t	*cb = NULL;
+	int			rc = 0;
+	BackendInfo		*mi;
+	monitor_extra_t		*mbe;
+	struct berval		bv = BER_BVC( "0" );
+
+	if ( !SLAP_DBMONITORING( be ) ) {
+		return 0;
+	}
+
+	mi = backend_info( "monitor" );
+	if ( !mi || !mi->bi_extra ) {
+		SLAP_DBFLAGS( be ) ^= SLAP_DBFLAG_MONITORING;
+		return 0;
+	}
+	mbe = mi->bi_extra;
+
+	/* don't bother if monitor is not configured */
+	if ( !mbe->is_configured() ) {
+		static int warning = 0;
+
+		if ( warning++ == 0 ) {
+			Debug( LDAP_DEBUG_CONFIG, "accesslog_monitor_db_open: "
+				"monitoring disabled; "
+				"configure monitor database to enable\n" );
+		}
+
+		return 0;
+	}
+
+	/* alloc as many as required (plus 1 for objectClass) */
+	a = attrs_alloc( 1 + 3 );
+	if ( a == NULL ) {
+		rc = 1;
+		goto cleanup;
+	}
+
+	a->a_desc = slap_schema.si_ad_objectClass;
+	attr_valadd( a, &oc_olmAccessLog->soc_cname, NULL, 1 );
+	next = a->a_next;
+
+	next->a_desc = ad_purgeDeleted;
+	attr_valadd( next, &bv, NULL, 1 );
+	next = next->a_next;
+
+	next->a_desc = ad_purgePending;
+	attr_valadd( next, &bv, NULL, 1 );
+	next = next->a_next;
+
+	next->a_desc = ad_purgeBatches;
+	attr_valadd( next, &bv, NULL, 1 );
+
+	cb = ch_calloc( sizeof( monitor_callback_t ), 1 );
+	cb->mc_update = accesslog_monitor_update;
+	cb->mc_free = accesslog_monitor_free;
+	cb->mc_private = (void *)li;
+
+	/* make sure the database is registered; then add monitor attributes */
+	BER_BVZERO( &li->li_monitor_ndn );
+	rc = mbe->register_overlay( be, on, &li->li_monitor_ndn );
+	if ( rc == 0 ) {
+		rc = mbe->register_entry_attrs( &li->li_monitor_ndn, a, cb,
+			NULL, -1, NULL );
+	}
+
+cleanup:;
+	if ( rc != 0 ) {
+		if ( cb != NULL ) {
+			ch_free( cb );
+			cb = NULL;
+		}
+	}
+
+	/* store for cleanup */
+	li->li_monitor_cb = (void *)cb;
+
+	/* we don't need to keep track of the attributes, because
+	 * accesslog_monitor_free() takes care of everything */
+	if ( a != NULL ) {
+		attrs_free( a );
+	}
+
+	return rc;
+}
+
+static int
+accesslog_monitor_db_close( BackendDB *be )
+{
+	slap_overinst *on = (slap_overinst *)be->bd_info;
+	log_info *li = on->on_bi.bi_private;
+
+	if ( li->li_monitor_cb != NULL ) {
+		BackendInfo		*mi = backend_info( "monitor" );
+		monitor_extra_t		*mbe;
+
+		if ( mi && mi->bi_extra ) {
+			mbe = mi->bi_extra;
+			mbe->unregister_entry_callback( &li->li_monitor_ndn,
+				(monitor_callback_t *)li->li_monitor_cb,
+				NULL, 0, NULL );
+		}
+		li->li_monitor_cb = NULL;
+	}
+
+	return 0;
+}
+
+#endif /* ACCESSLOG_MONITOR */
+
 static int
 accesslog_db_open(
 	BackendDB *be,
@@ -2411,7 +2860,24 @@ accesslog_db_open(
 		"accesslog_db_root", li->li_db->be_suffix[0].bv_val );
 	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
 
+#ifdef ACCESSLOG_MONITOR
+	return accesslog_monitor_db_open( be );
+#else /* ! ACCESSLOG_MONITOR */
+	return 0;
+#endif /* ! ACCESSLOG_MONITOR */
+}
+
+static int
+accesslog_db_close(
+	BackendDB *be,
+	ConfigReply *cr
+)
+{
+#ifdef ACCESSLOG_MONITOR
+	return accesslog_monitor_db_close( be );
+#else /* ! ACCESSLOG_MONITOR */
 	return 0;
+#endif /* ! ACCESSLOG_MONITOR */
 }
 
 enum { start = 0 };
@@ -2580,6 +3046,7 @@ int accesslog_initialize()
 	accesslog.on_bi.bi_db_init = accesslog_db_init;
 	accesslog.on_bi.bi_db_destroy = accesslog_db_destroy;
 	accesslog.on_bi.bi_db_open = accesslog_db_open;
+	accesslog.on_bi.bi_db_close = accesslog_db_close;
 
 	accesslog.on_bi.bi_op_add = accesslog_op_mod;
 	accesslog.on_bi.bi_op_bind = accesslog_op_misc;
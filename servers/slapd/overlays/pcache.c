@@ -26,10 +26,12 @@
 #include <stdio.h>
 
 #include <ac/string.h>
+#include <ac/socket.h>
 #include <ac/time.h>
 
 #include "slap.h"
 #include "lutil.h"
+#include "lutil_sha1.h"
 #include "ldap_rq.h"
 #include "avl.h"
 
@@ -78,6 +80,7 @@ typedef struct cached_query_s {
 	int						scope;
 	struct berval			q_uuid;		/* query identifier */
 	int						q_sizelimit;
+	int						q_negative;	/* cached as an empty result */
 	struct query_template_s		*qtemp;	/* template of the query */
 	time_t						expiry_time;	/* time till the query is considered invalid */
 	time_t						refresh_time;	/* time till the query is refreshed */
@@ -90,6 +93,7 @@ typedef struct cached_query_s {
 	struct cached_query_s  		*prev;  	/* previous query in the template */
 	struct cached_query_s		*lru_up;	/* previous query in the LRU list */
 	struct cached_query_s		*lru_down;	/* next query in the LRU list */
+	int						lru_touched;	/* answered since last moved in the LRU list */
 	ldap_pvt_thread_rdwr_t		rwlock;
 } CachedQuery;
 
@@ -180,8 +184,8 @@ struct query_manager_s;
 typedef CachedQuery *(QCfunc)(Operation *op, struct query_manager_s*,
 	Query*, QueryTemplate*);
 typedef CachedQuery *(AddQueryfunc)(Operation *op, struct query_manager_s*,
-	Query*, QueryTemplate*, pc_caching_reason_t, int wlock);
-typedef void (CRfunc)(struct query_manager_s*, struct berval*);
+	Query*, QueryTemplate*, pc_caching_reason_t, int neglru, int wlock);
+typedef int (CRfunc)(struct query_manager_s*, struct berval*);
 
 /* LDAP query cache */
 typedef struct query_manager_s {
@@ -190,6 +194,8 @@ typedef struct query_manager_s {
 
 	CachedQuery*		lru_top;		/* top and bottom of LRU list */
 	CachedQuery*		lru_bottom;
+	CachedQuery*		neg_lru_top;	/* same, for negative queries */
+	CachedQuery*		neg_lru_bottom;
 
 	ldap_pvt_thread_mutex_t		lru_mutex;	/* mutex for accessing LRU list */
 
@@ -199,11 +205,56 @@ typedef struct query_manager_s {
 	AddQueryfunc	*addfunc;			/* add query */
 } query_manager;
 
+/* dedicated bind cache: the password a DN last bound with, salted
+ * and hashed, spread over shards to keep binds off a single mutex */
+#define PCACHE_BINDCACHE_SHARDS	16
+#define PCACHE_BINDCACHE_SALT	8
+
+typedef struct bindcache_entry_s {
+	struct berval	bc_ndn;
+	unsigned char	bc_salt[PCACHE_BINDCACHE_SALT];
+	unsigned char	bc_hash[LUTIL_SHA1_BYTES];
+	time_t		bc_expiry;		/* time till the bind is trusted */
+	struct bindcache_entry_s	*bc_lru_up;
+	struct bindcache_entry_s	*bc_lru_down;
+} bindcache_entry;
+
+typedef struct bindcache_shard_s {
+	ldap_pvt_thread_mutex_t	bs_mutex;
+	Avlnode		*bs_tree;
+	bindcache_entry	*bs_lru_top;
+	bindcache_entry	*bs_lru_bottom;
+	unsigned long	bs_num;
+	unsigned long	bs_gen;		/* bumped by each invalidation */
+	unsigned long	bs_hits;
+} bindcache_shard;
+
+/* a query sent to the underlying database on behalf of identical
+ * queries waiting for it to be cached */
+typedef struct pc_inflight_s {
+	QueryTemplate	*if_qtemp;
+	struct berval	if_base;
+	int		if_scope;
+	struct berval	if_filter;	/* normalized filter string */
+	int		if_waiters;
+	int		if_done;
+	int		if_cached;	/* result was added to the cache */
+} pc_inflight;
+
+/* beyond this many queries waiting for the same one, the others are
+ * sent to the underlying database */
+#define PCACHE_INFLIGHT_MAX_WAITERS	32
+/* longest pause between two looks at the query waited for, in usec */
+#define PCACHE_INFLIGHT_UTIMEOUT	50000
+
 /* LDAP query cache manager */
 typedef struct cache_manager_s {
 	BackendDB	db;	/* underlying database */
 	unsigned long	num_cached_queries; 		/* total number of cached queries */
 	unsigned long   max_queries;			/* upper bound on # of cached queries */
+	unsigned long	num_negative_queries;		/* cached queries with no entries */
+	unsigned long	max_negative_queries;		/* if set, negative queries don't
+							 * count against max_queries */
 	int		save_queries;			/* save cached queries across restarts */
 	int	check_cacheability;		/* check whether a query is cacheable */
 	int 	numattrsets;			/* number of attribute sets */
@@ -218,6 +269,15 @@ typedef struct cache_manager_s {
 	char	defer_db_open;			/* defer open for online add */
 	char	cache_binds;			/* cache binds or just passthru */
 
+	time_t	bindcache_ttl;			/* 0 disables the bind cache */
+	unsigned long	bindcache_max;		/* upper bound on # of cached binds */
+	bindcache_shard	bindcache[PCACHE_BINDCACHE_SHARDS];
+
+	int	coalesce;			/* let identical queries wait for one */
+	Avlnode	*inflight;			/* queries being fetched */
+	unsigned long	num_coalesced;		/* queries answered after waiting */
+	ldap_pvt_thread_mutex_t		inflight_mutex;
+
 	time_t	cc_period;		/* interval between successive consistency checks (sec) */
 #define PCACHE_CC_PAUSED	1
 #define PCACHE_CC_OFFLINE	2
@@ -250,7 +310,9 @@ static int privDB_cid;
 static AttributeDescription	*ad_queryId, *ad_cachedQueryURL;
 
 #ifdef PCACHE_MONITOR
-static AttributeDescription	*ad_numQueries, *ad_numEntries;
+static AttributeDescription	*ad_numQueries, *ad_numEntries,
+				*ad_numNegativeQueries, *ad_numCachedBinds,
+				*ad_numBindCacheHits, *ad_numCoalescedQueries;
 static ObjectClass		*oc_olmPCache;
 #endif /* PCACHE_MONITOR */
 
@@ -302,6 +364,38 @@ static struct {
 		"NO-USER-MODIFICATION "
 		"USAGE directoryOperation )",
 		&ad_numEntries },
+	{ "( PCacheAttributes:5 "
+		"NAME 'pcacheNumNegativeQueries' "
+		"DESC 'Number of negative queries in their own LRU list' "
+		"EQUALITY integerMatch "
+		"SYNTAX 1.3.6.1.4.1.1466.115.121.1.27 "
+		"NO-USER-MODIFICATION "
+		"USAGE directoryOperation )",
+		&ad_numNegativeQueries },
+	{ "( PCacheAttributes:6 "
+		"NAME 'pcacheNumCachedBinds' "
+		"DESC 'Number of DNs in the bind cache' "
+		"EQUALITY integerMatch "
+		"SYNTAX 1.3.6.1.4.1.1466.115.121.1.27 "
+		"NO-USER-MODIFICATION "
+		"USAGE directoryOperation )",
+		&ad_numCachedBinds },
+	{ "( PCacheAttributes:7 "
+		"NAME 'pcacheNumBindCacheHits' "
+		"DESC 'Number of binds answered by the bind cache' "
+		"EQUALITY integerMatch "
+		"SYNTAX 1.3.6.1.4.1.1466.115.121.1.27 "
+		"NO-USER-MODIFICATION "
+		"USAGE directoryOperation )",
+		&ad_numBindCacheHits },
+	{ "( PCacheAttributes:8 "
+		"NAME 'pcacheNumCoalescedQueries' "
+		"DESC 'Number of queries answered from the result of an identical concurrent query' "
+		"EQUALITY integerMatch "
+		"SYNTAX 1.3.6.1.4.1.1466.115.121.1.27 "
+		"NO-USER-MODIFICATION "
+		"USAGE directoryOperation )",
+		&ad_numCoalescedQueries },
 #endif /* PCACHE_MONITOR */
 
 	{ NULL }
@@ -320,6 +414,10 @@ static struct {
 			"pcacheQueryURL "
 			"$ pcacheNumQueries "
 			"$ pcacheNumEntries "
+			"$ pcacheNumNegativeQueries "
+			"$ pcacheNumCachedBinds "
+			"$ pcacheNumBindCacheHits "
+			"$ pcacheNumCoalescedQueries "
 			" ) )",
 		&oc_olmPCache },
 #endif /* PCACHE_MONITOR */
@@ -340,6 +438,7 @@ add_query(
 	Query* query,
 	QueryTemplate *templ,
 	pc_caching_reason_t why,
+	int neglru,
 	int wlock);
 
 static int
@@ -801,7 +900,7 @@ url2query(
 			goto error;
 		}
 
-		cq = add_query( op, qm, &query, qt, PC_POSITIVE, 0 );
+		cq = add_query( op, qm, &query, qt, PC_POSITIVE, 0, 0 );
 		if ( cq != NULL ) {
 			cq->expiry_time = expiry_time;
 			cq->refresh_time = refresh_time;
@@ -1040,12 +1139,15 @@ static int pcache_query_cmp( const void *v1, const void *v2 )
 static void
 add_query_on_top (query_manager* qm, CachedQuery* qc)
 {
-	CachedQuery* top = qm->lru_top;
+	CachedQuery** topp = qc->q_negative ? &qm->neg_lru_top : &qm->lru_top;
+	CachedQuery* top = *topp;
 
-	qm->lru_top = qc;
+	*topp = qc;
 
 	if (top)
 		top->lru_up = qc;
+	else if (qc->q_negative)
+		qm->neg_lru_bottom = qc;
 	else
 		qm->lru_bottom = qc;
 
@@ -1069,11 +1171,19 @@ remove_query (query_manager* qm, CachedQuery* qc)
 	up = qc->lru_up;
 	down = qc->lru_down;
 
-	if (!up)
-		qm->lru_top = down;
+	if (!up) {
+		if (qc->q_negative)
+			qm->neg_lru_top = down;
+		else
+			qm->lru_top = down;
+	}
 
-	if (!down)
-		qm->lru_bottom = up;
+	if (!down) {
+		if (qc->q_negative)
+			qm->neg_lru_bottom = up;
+		else
+			qm->lru_bottom = up;
+	}
 
 	if (down)
 		down->lru_up = up;
@@ -1271,163 +1381,266 @@ typedef struct fstack {
 	Filter *fs_fi;
 } fstack;
 
+/* check whether the filter of a cached query contains the input filter;
+ * returns 1 if it does, 0 if it doesn't, -1 on error, and 2 if the
+ * first assertion of an equality input filter doesn't match */
+static int
+filter_containment( Operation *op, Filter *stored, Filter *inputf, Filter *first )
+{
+	Filter* fs = stored;
+	Filter* fi = inputf;
+	MatchingRule* mrule = NULL;
+	int res = 0, ret = 0, rc;
+	fstack *stack = NULL, *fsp;
+
+	do {
+		res=0;
+		switch (fs->f_choice) {
+		case LDAP_FILTER_EQUALITY:
+			if (fi->f_choice == LDAP_FILTER_EQUALITY)
+				mrule = fs->f_ava->aa_desc->ad_type->sat_equality;
+			else
+				ret = 1;
+			break;
+		case LDAP_FILTER_GE:
+		case LDAP_FILTER_LE:
+			mrule = fs->f_ava->aa_desc->ad_type->sat_ordering;
+			break;
+		default:
+			mrule = NULL; 
+		}
+		if (mrule) {
+			const char *text;
+			rc = value_match(&ret, fs->f_ava->aa_desc, mrule,
+				SLAP_MR_VALUE_OF_ASSERTION_SYNTAX,
+				&(fi->f_ava->aa_value),
+				&(fs->f_ava->aa_value), &text);
+			if (rc != LDAP_SUCCESS) {
+				res = -1;
+				break;
+			}
+			if ( fi==first && fi->f_choice==LDAP_FILTER_EQUALITY && ret ) {
+				res = 2;
+				break;
+			}
+		}
+		switch (fs->f_choice) {
+		case LDAP_FILTER_OR:
+		case LDAP_FILTER_AND:
+			if ( fs->f_next ) {
+				/* save our stack position */
+				fsp = op->o_tmpalloc(sizeof(fstack), op->o_tmpmemctx);
+				fsp->fs_next = stack;
+				fsp->fs_fs = fs->f_next;
+				fsp->fs_fi = fi->f_next;
+				stack = fsp;
+			}
+			fs = fs->f_and;
+			fi = fi->f_and;
+			res=1;
+			break;
+		case LDAP_FILTER_SUBSTRINGS:
+			/* check if the equality query can be
+			* answered with cached substring query */
+			if ((fi->f_choice == LDAP_FILTER_EQUALITY)
+				&& substr_containment_equality( op,
+				fs, fi))
+				res=1;
+			/* check if the substring query can be
+			* answered with cached substring query */
+			if ((fi->f_choice ==LDAP_FILTER_SUBSTRINGS
+				) && substr_containment_substr( op,
+				fs, fi))
+				res= 1;
+			fs=fs->f_next;
+			fi=fi->f_next;
+			break;
+		case LDAP_FILTER_PRESENT:
+			res=1;
+			fs=fs->f_next;
+			fi=fi->f_next;
+			break;
+		case LDAP_FILTER_EQUALITY:
+			if (ret == 0)
+				res = 1;
+			fs=fs->f_next;
+			fi=fi->f_next;
+			break;
+		case LDAP_FILTER_GE:
+			if (mrule && ret >= 0)
+				res = 1;
+			fs=fs->f_next;
+			fi=fi->f_next;
+			break;
+		case LDAP_FILTER_LE:
+			if (mrule && ret <= 0)
+				res = 1;
+			fs=fs->f_next;
+			fi=fi->f_next;
+			break;
+		case LDAP_FILTER_NOT:
+			res=0;
+			break;
+		default:
+			break;
+		}
+		if (!fs && !fi && stack) {
+			/* pop the stack */
+			fsp = stack;
+			stack = fsp->fs_next;
+			fs = fsp->fs_fs;
+			fi = fsp->fs_fi;
+			op->o_tmpfree(fsp, op->o_tmpmemctx);
+		}
+	} while((res == 1) && (fi != NULL) && (fs != NULL));
+
+	while ( stack ) {
+		fsp = stack;
+		stack = fsp->fs_next;
+		op->o_tmpfree(fsp, op->o_tmpmemctx);
+	}
+
+	return res;
+}
+
+/* walk the cached substring queries whose initial substring is
+ * exactly the given one (or absent, if val is NULL) */
+static CachedQuery *
+find_filter_substr_initial( Operation *op, TAvlnode *root,
+	Filter *inputf, Filter *first, Filter *probe, SubstringsAssertion *ssa,
+	struct berval *val )
+{
+	CachedQuery cq, *qc;
+	TAvlnode *ptr;
+	int ret, rc;
+
+	if ( val != NULL ) {
+		ssa->sa_initial = *val;
+	} else {
+		BER_BVZERO( &ssa->sa_initial );
+	}
+
+	/* the probe sorts before all the queries with the same initial
+	 * substring, so start from its successor */
+	cq.filter = probe;
+	cq.first = filter_first( probe );
+	ptr = tavl_find3( root, &cq, pcache_query_cmp, &ret );
+	if ( ptr != NULL && ret > 0 )
+		ptr = tavl_next( ptr, TAVL_DIR_RIGHT );
+
+	for ( ; ptr; ptr = tavl_next( ptr, TAVL_DIR_RIGHT ) ) {
+		qc = ptr->avl_data;
+		if ( qc->first->f_choice != LDAP_FILTER_SUBSTRINGS )
+			break;
+		if ( val == NULL ) {
+			if ( !BER_BVISNULL( &qc->first->f_sub_initial ) )
+				break;
+		} else if ( !bvmatch( &qc->first->f_sub_initial, val ) ) {
+			break;
+		}
+
+		rc = filter_containment( op, qc->filter, inputf, first );
+		if ( rc == 1 )
+			return qc;
+		if ( rc < 0 )
+			break;
+	}
+
+	return NULL;
+}
+
+/* an input filter whose first assertion is a substring or an equality
+ * can only be contained by cached substring queries whose initial
+ * substring is absent or is a prefix of the input's initial substring
+ * or value; since they sort lexically, look up each prefix in turn
+ * rather than walking all of them */
+static CachedQuery *
+find_filter_substr( Operation *op, TAvlnode *root, Filter *inputf, Filter *first )
+{
+	struct berval *val = NULL, prefix;
+	SubstringsAssertion ssa = { 0 };
+	Filter *probe, *f;
+	CachedQuery *qc = NULL;
+	int depth = 0, i;
+
+	if ( first->f_choice == LDAP_FILTER_SUBSTRINGS ) {
+		if ( !BER_BVISNULL( &first->f_sub_initial ) )
+			val = &first->f_sub_initial;
+	} else {
+		val = &first->f_av_value;
+	}
+
+	/* same nesting as the input filter, with a single
+	 * substring assertion at the bottom */
+	for ( f = inputf; f != first; f = f->f_and )
+		depth++;
+	probe = op->o_tmpcalloc( depth + 1, sizeof( Filter ), op->o_tmpmemctx );
+	for ( f = inputf, i = 0; i < depth; f = f->f_and, i++ ) {
+		probe[ i ].f_choice = f->f_choice;
+		probe[ i ].f_and = &probe[ i + 1 ];
+	}
+	probe[ depth ].f_choice = LDAP_FILTER_SUBSTRINGS;
+	probe[ depth ].f_sub = &ssa;
+	ssa.sa_desc = first->f_choice == LDAP_FILTER_SUBSTRINGS ?
+		first->f_sub_desc : first->f_av_desc;
+
+	qc = find_filter_substr_initial( op, root, inputf, first,
+		probe, &ssa, NULL );
+	if ( val != NULL ) {
+		prefix.bv_val = val->bv_val;
+		for ( prefix.bv_len = 1; qc == NULL && prefix.bv_len <= val->bv_len;
+			prefix.bv_len++ )
+		{
+			qc = find_filter_substr_initial( op, root, inputf, first,
+				probe, &ssa, &prefix );
+		}
+	}
+
+	op->o_tmpfree( probe, op->o_tmpmemctx );
+	return qc;
+}
+
 static CachedQuery *
 find_filter( Operation *op, TAvlnode *root, Filter *inputf, Filter *first )
 {
-	Filter* fs;
-	Filter* fi;
-	MatchingRule* mrule = NULL;
-	int res=0, eqpass= 0;
 	int ret, rc, dir;
 	TAvlnode *ptr;
 	CachedQuery cq, *qc;
-	fstack *stack = NULL, *fsp;
+
+	/* substring matches sort to the end */
+	if ( first->f_choice == LDAP_FILTER_SUBSTRINGS )
+		return find_filter_substr( op, root, inputf, first );
 
 	cq.filter = inputf;
 	cq.first = first;
 
-	/* substring matches sort to the end, and we just have to
-	 * walk the entire list.
-	 */
-	if ( first->f_choice == LDAP_FILTER_SUBSTRINGS ) {
-		ptr = tavl_end( root, 1 );
-		dir = TAVL_DIR_LEFT;
-	} else {
-		ptr = tavl_find3( root, &cq, pcache_query_cmp, &ret );
-		dir = (first->f_choice == LDAP_FILTER_GE) ? TAVL_DIR_LEFT :
-			TAVL_DIR_RIGHT;
-	}
+	ptr = tavl_find3( root, &cq, pcache_query_cmp, &ret );
+	dir = (first->f_choice == LDAP_FILTER_GE) ? TAVL_DIR_LEFT :
+		TAVL_DIR_RIGHT;
 
 	while (ptr) {
 		qc = ptr->avl_data;
-		fi = inputf;
-		fs = qc->filter;
-
-		/* an incoming substr query can only be satisfied by a cached
-		 * substr query.
-		 */
-		if ( first->f_choice == LDAP_FILTER_SUBSTRINGS &&
-			qc->first->f_choice != LDAP_FILTER_SUBSTRINGS )
-			break;
 
 		/* an incoming eq query can be satisfied by a cached eq or substr
 		 * query
 		 */
-		if ( first->f_choice == LDAP_FILTER_EQUALITY ) {
-			if ( eqpass == 0 ) {
-				if ( qc->first->f_choice != LDAP_FILTER_EQUALITY ) {
-nextpass:			eqpass = 1;
-					ptr = tavl_end( root, 1 );
-					dir = TAVL_DIR_LEFT;
-					continue;
-				}
-			} else {
-				if ( qc->first->f_choice != LDAP_FILTER_SUBSTRINGS )
-					break;
-			}
-		}
-		do {
-			res=0;
-			switch (fs->f_choice) {
-			case LDAP_FILTER_EQUALITY:
-				if (fi->f_choice == LDAP_FILTER_EQUALITY)
-					mrule = fs->f_ava->aa_desc->ad_type->sat_equality;
-				else
-					ret = 1;
-				break;
-			case LDAP_FILTER_GE:
-			case LDAP_FILTER_LE:
-				mrule = fs->f_ava->aa_desc->ad_type->sat_ordering;
-				break;
-			default:
-				mrule = NULL; 
-			}
-			if (mrule) {
-				const char *text;
-				rc = value_match(&ret, fs->f_ava->aa_desc, mrule,
-					SLAP_MR_VALUE_OF_ASSERTION_SYNTAX,
-					&(fi->f_ava->aa_value),
-					&(fs->f_ava->aa_value), &text);
-				if (rc != LDAP_SUCCESS) {
-					return NULL;
-				}
-				if ( fi==first && fi->f_choice==LDAP_FILTER_EQUALITY && ret )
-					goto nextpass;
-			}
-			switch (fs->f_choice) {
-			case LDAP_FILTER_OR:
-			case LDAP_FILTER_AND:
-				if ( fs->f_next ) {
-					/* save our stack position */
-					fsp = op->o_tmpalloc(sizeof(fstack), op->o_tmpmemctx);
-					fsp->fs_next = stack;
-					fsp->fs_fs = fs->f_next;
-					fsp->fs_fi = fi->f_next;
-					stack = fsp;
-				}
-				fs = fs->f_and;
-				fi = fi->f_and;
-				res=1;
-				break;
-			case LDAP_FILTER_SUBSTRINGS:
-				/* check if the equality query can be
-				* answered with cached substring query */
-				if ((fi->f_choice == LDAP_FILTER_EQUALITY)
-					&& substr_containment_equality( op,
-					fs, fi))
-					res=1;
-				/* check if the substring query can be
-				* answered with cached substring query */
-				if ((fi->f_choice ==LDAP_FILTER_SUBSTRINGS
-					) && substr_containment_substr( op,
-					fs, fi))
-					res= 1;
-				fs=fs->f_next;
-				fi=fi->f_next;
-				break;
-			case LDAP_FILTER_PRESENT:
-				res=1;
-				fs=fs->f_next;
-				fi=fi->f_next;
-				break;
-			case LDAP_FILTER_EQUALITY:
-				if (ret == 0)
-					res = 1;
-				fs=fs->f_next;
-				fi=fi->f_next;
-				break;
-			case LDAP_FILTER_GE:
-				if (mrule && ret >= 0)
-					res = 1;
-				fs=fs->f_next;
-				fi=fi->f_next;
-				break;
-			case LDAP_FILTER_LE:
-				if (mrule && ret <= 0)
-					res = 1;
-				fs=fs->f_next;
-				fi=fi->f_next;
-				break;
-			case LDAP_FILTER_NOT:
-				res=0;
-				break;
-			default:
-				break;
-			}
-			if (!fs && !fi && stack) {
-				/* pop the stack */
-				fsp = stack;
-				stack = fsp->fs_next;
-				fs = fsp->fs_fs;
-				fi = fsp->fs_fi;
-				op->o_tmpfree(fsp, op->o_tmpmemctx);
-			}
-		} while((res) && (fi != NULL) && (fs != NULL));
+		if ( first->f_choice == LDAP_FILTER_EQUALITY &&
+			qc->first->f_choice != LDAP_FILTER_EQUALITY )
+			break;
 
-		if ( res )
+		rc = filter_containment( op, qc->filter, inputf, first );
+		if ( rc == 1 )
 			return qc;
+		if ( rc < 0 )
+			return NULL;
+		if ( rc == 2 )
+			break;
 		ptr = tavl_next( ptr, dir );
 	}
+
+	if ( first->f_choice == LDAP_FILTER_EQUALITY )
+		return find_filter_substr( op, root, inputf, first );
+
 	return NULL;
 }
 
@@ -1508,12 +1721,11 @@ query_containment(Operation *op, query_manager *qm,
 							ldap_pvt_thread_rdwr_runlock(&templa->t_rwlock);
 							return NULL;
 						}
-						ldap_pvt_thread_mutex_lock(&qm->lru_mutex);
-						if (qm->lru_top != qc) {
-							remove_query(qm, qc);
-							add_query_on_top(qm, qc);
-						}
-						ldap_pvt_thread_mutex_unlock(&qm->lru_mutex);
+						/* don't serialize answerable lookups on
+						 * lru_mutex; cache_replacement() moves
+						 * touched queries up when it needs a victim */
+						if ( !qc->lru_touched )
+							qc->lru_touched = 1;
 						return qc;
 					}
 				}
@@ -1546,7 +1758,8 @@ free_query (CachedQuery* qc)
 }
 
 
-/* Add query to query cache, the returned Query is locked for writing */
+/* Add query to query cache, the returned Query is locked for writing;
+ * negative queries go to their own LRU list if neglru is set */
 static CachedQuery *
 add_query(
 	Operation *op,
@@ -1554,6 +1767,7 @@ add_query(
 	Query* query,
 	QueryTemplate *templ,
 	pc_caching_reason_t why,
+	int neglru,
 	int wlock)
 {
 	CachedQuery* new_cached_query = (CachedQuery*) ch_malloc(sizeof(CachedQuery));
@@ -1598,6 +1812,8 @@ add_query(
 
 	new_cached_query->lru_up = NULL;
 	new_cached_query->lru_down = NULL;
+	new_cached_query->lru_touched = 0;
+	new_cached_query->q_negative = ( why == PC_NEGATIVE && neglru );
 	Debug( pcache_debug, "Added query expires at %ld (%s)\n",
 			(long) new_cached_query->expiry_time,
 			pc_caching_reason_str[ why ] );
@@ -1697,25 +1913,43 @@ remove_from_template (CachedQuery* qc, QueryTemplate* template)
  *
  * - if result->bv_val is NULL, the query at the bottom of the LRU
  *   is removed
- * - otherwise, the query whose UUID is *result is removed
+ * - otherwise, the query whose UUID is *result is removed, from
+ *   either LRU list
  *	- if not found, result->bv_val is zeroed
+ *
+ * returns 1 if the removed query was in the negative LRU list
  */
-static void
+static int
 cache_replacement(query_manager* qm, struct berval *result)
 {
 	CachedQuery* bottom;
 	QueryTemplate *temp;
+	int negative;
 
 	ldap_pvt_thread_mutex_lock(&qm->lru_mutex);
 	if ( BER_BVISNULL( result ) ) {
-		bottom = qm->lru_bottom;
+		CachedQuery *first = NULL;
+
+		/* apply the touches deferred by query_containment():
+		 * queries answered since they were last moved get
+		 * a second chance; stop after a full round */
+		for ( bottom = qm->lru_bottom;
+			bottom != NULL && bottom != first && bottom->lru_touched;
+			bottom = qm->lru_bottom )
+		{
+			bottom->lru_touched = 0;
+			if ( first == NULL )
+				first = bottom;
+			remove_query(qm, bottom);
+			add_query_on_top(qm, bottom);
+		}
 
 		if (!bottom) {
 			Debug ( pcache_debug,
 				"Cache replacement invoked without "
 				"any query in LRU list\n" );
 			ldap_pvt_thread_mutex_unlock(&qm->lru_mutex);
-			return;
+			return 0;
 		}
 
 	} else {
@@ -1728,17 +1962,29 @@ cache_replacement(query_manager* qm, struct berval *result)
 			}
 		}
 
+		if ( !bottom ) {
+			for ( bottom = qm->neg_lru_bottom;
+				bottom != NULL;
+				bottom = bottom->lru_up )
+			{
+				if ( bvmatch( result, &bottom->q_uuid ) ) {
+					break;
+				}
+			}
+		}
+
 		if ( !bottom ) {
 			Debug ( pcache_debug,
 				"Could not find query with uuid=\"%s\""
 				"in LRU list\n", result->bv_val );
 			ldap_pvt_thread_mutex_unlock(&qm->lru_mutex);
 			BER_BVZERO( result );
-			return;
+			return 0;
 		}
 	}
 
 	temp = bottom->qtemp;
+	negative = bottom->q_negative;
 	remove_query(qm, bottom);
 	ldap_pvt_thread_mutex_unlock(&qm->lru_mutex);
 
@@ -1753,6 +1999,48 @@ cache_replacement(query_manager* qm, struct berval *result)
 	Debug( pcache_debug, "Unlock CR index = %p\n", (void *) temp );
 	ldap_pvt_thread_rdwr_wunlock(&temp->t_rwlock);
 	free_query(bottom);
+
+	return negative;
+}
+
+/* remove bottom query of the negative LRU list; negative queries
+ * have no entries, so only the query itself is dropped */
+static int
+negative_replacement(query_manager* qm)
+{
+	CachedQuery *bottom, *first = NULL;
+	QueryTemplate *temp;
+
+	ldap_pvt_thread_mutex_lock(&qm->lru_mutex);
+	for ( bottom = qm->neg_lru_bottom;
+		bottom != NULL && bottom != first && bottom->lru_touched;
+		bottom = qm->neg_lru_bottom )
+	{
+		bottom->lru_touched = 0;
+		if ( first == NULL )
+			first = bottom;
+		remove_query(qm, bottom);
+		add_query_on_top(qm, bottom);
+	}
+
+	if ( !bottom ) {
+		ldap_pvt_thread_mutex_unlock(&qm->lru_mutex);
+		return 0;
+	}
+
+	temp = bottom->qtemp;
+	remove_query(qm, bottom);
+	ldap_pvt_thread_mutex_unlock(&qm->lru_mutex);
+
+	Debug( pcache_debug, "Lock NR index = %p\n", (void *) temp );
+	ldap_pvt_thread_rdwr_wlock(&temp->t_rwlock);
+	remove_from_template(bottom, temp);
+	Debug( pcache_debug, "TEMPLATE %p QUERIES-- %d\n",
+		(void *) temp, temp->no_of_queries );
+	Debug( pcache_debug, "Unlock NR index = %p\n", (void *) temp );
+	ldap_pvt_thread_rdwr_wunlock(&temp->t_rwlock);
+	free_query(bottom);
+	return 1;
 }
 
 struct query_info {
@@ -2006,6 +2294,7 @@ struct search_info {
 	pc_caching_reason_t caching_reason;
 	Entry *head, *tail;
 	bindinfo *pbi;
+	pc_inflight *inflight;
 };
 
 static void
@@ -2015,8 +2304,9 @@ remove_query_and_data(
 	struct berval	*uuid )
 {
 	query_manager*		qm = cm->qm;
+	int			negative;
 
-	qm->crfunc( qm, uuid );
+	negative = qm->crfunc( qm, uuid );
 	if ( !BER_BVISNULL( uuid ) ) {
 		int	return_val;
 
@@ -2030,6 +2320,8 @@ remove_query_and_data(
 		ldap_pvt_thread_mutex_lock( &cm->cache_mutex );
 		cm->cur_entries -= return_val;
 		cm->num_cached_queries--;
+		if ( negative )
+			cm->num_negative_queries--;
 		Debug( pcache_debug,
 			"STORED QUERIES = %lu\n",
 			cm->num_cached_queries );
@@ -2340,6 +2632,150 @@ cache_entries(
 	return return_val;
 }
 
+static int
+pc_inflight_cmp( const void *v1, const void *v2 )
+{
+	const pc_inflight *if1 = v1, *if2 = v2;
+	int rc;
+
+	if ( if1->if_qtemp != if2->if_qtemp )
+		return if1->if_qtemp < if2->if_qtemp ? -1 : 1;
+	rc = if1->if_scope - if2->if_scope;
+	if ( rc == 0 )
+		rc = ber_bvcmp( &if1->if_base, &if2->if_base );
+	if ( rc == 0 )
+		rc = ber_bvcmp( &if1->if_filter, &if2->if_filter );
+	return rc;
+}
+
+/* If an identical query is already being fetched, wait until it is
+ * done and return 1 if its result was cached, 0 otherwise; 0 is also
+ * returned if too many queries are waiting for it already.  If not,
+ * register this one as being fetched and return -1; *pifp must then
+ * be released with pc_inflight_done() once the result is known.
+ * Waiting is given up when the time limit of the query is exceeded,
+ * it is abandoned or slapd shuts down; -2 is returned and the result
+ * to send is in rs->sr_err, SLAPD_ABANDON if abandoned.
+ */
+static int
+pc_inflight_wait(
+	Operation	*op,
+	SlapReply	*rs,
+	cache_manager	*cm,
+	QueryTemplate	*qtemp,
+	pc_inflight	**pifp )
+{
+	pc_inflight	tmp, *pif;
+	struct berval	fstr;
+	struct timeval	save_tv = { 0, 0 }, tv;
+	time_t		stoptime = (time_t)(-1);
+	int		rc = -1, last = 0;
+
+	*pifp = NULL;
+	filter2bv_x( op, op->ors_filter, &fstr );
+
+	tmp.if_qtemp = qtemp;
+	tmp.if_base = op->o_req_ndn;
+	tmp.if_scope = op->ors_scope;
+	tmp.if_filter = fstr;
+
+	ldap_pvt_thread_mutex_lock( &cm->inflight_mutex );
+	pif = avl_find( cm->inflight, &tmp, pc_inflight_cmp );
+	if ( pif && pif->if_waiters >= PCACHE_INFLIGHT_MAX_WAITERS ) {
+		Debug( pcache_debug, "QUERY IN FLIGHT, too many waiting\n" );
+		pif = NULL;
+		rc = 0;
+
+	} else if ( pif ) {
+		Debug( pcache_debug, "QUERY IN FLIGHT, waiting\n" );
+		if ( op->ors_tlimit != SLAP_NO_LIMIT )
+			stoptime = op->o_time + op->ors_tlimit;
+		pif->if_waiters++;
+
+		/* as in back-meta, look again after a pause, a little
+		 * longer each time */
+		while ( !pif->if_done ) {
+			if ( op->o_abandon ) {
+				rs->sr_err = SLAPD_ABANDON;
+				break;
+			}
+			if ( slapd_shutdown ) {
+				rs->sr_err = LDAP_UNAVAILABLE;
+				break;
+			}
+			if ( stoptime != (time_t)(-1) && slap_get_time() > stoptime ) {
+				rs->sr_err = LDAP_TIMELIMIT_EXCEEDED;
+				break;
+			}
+
+			if ( save_tv.tv_sec == 0 && save_tv.tv_usec == 0 ) {
+				save_tv.tv_usec = PCACHE_INFLIGHT_UTIMEOUT/64;
+
+			} else if ( save_tv.tv_usec < PCACHE_INFLIGHT_UTIMEOUT/2 ) {
+				lutil_timermul( &save_tv, 2, &save_tv );
+			}
+
+			ldap_pvt_thread_mutex_unlock( &cm->inflight_mutex );
+			tv = save_tv;
+			(void)select( 0, NULL, NULL, NULL, &tv );
+			ldap_pvt_thread_mutex_lock( &cm->inflight_mutex );
+		}
+
+		if ( pif->if_done ) {
+			rc = pif->if_cached;
+			if ( rc )
+				cm->num_coalesced++;
+		} else {
+			Debug( pcache_debug, "QUERY IN FLIGHT, gave up waiting (%d)\n",
+				rs->sr_err );
+			rc = -2;
+		}
+		/* once done, the last one to look at it frees it */
+		last = ( --pif->if_waiters == 0 && pif->if_done );
+
+	} else {
+		pif = ch_malloc( sizeof( pc_inflight ) + tmp.if_base.bv_len + 1 +
+			fstr.bv_len + 1 );
+		*pif = tmp;
+		pif->if_base.bv_val = (char *)&pif[1];
+		AC_MEMCPY( pif->if_base.bv_val, tmp.if_base.bv_val,
+			tmp.if_base.bv_len + 1 );
+		pif->if_filter.bv_val = pif->if_base.bv_val + tmp.if_base.bv_len + 1;
+		AC_MEMCPY( pif->if_filter.bv_val, fstr.bv_val, fstr.bv_len + 1 );
+		pif->if_waiters = 0;
+		pif->if_done = 0;
+		pif->if_cached = 0;
+		avl_insert( &cm->inflight, (caddr_t)pif, pc_inflight_cmp,
+			avl_dup_error );
+		*pifp = pif;
+		pif = NULL;
+	}
+	ldap_pvt_thread_mutex_unlock( &cm->inflight_mutex );
+
+	if ( last )
+		ch_free( pif );
+	op->o_tmpfree( fstr.bv_val, op->o_tmpmemctx );
+
+	return rc;
+}
+
+/* let the queries waiting for this one know it is done */
+static void
+pc_inflight_done( cache_manager *cm, pc_inflight *pif, int cached )
+{
+	int last;
+
+	ldap_pvt_thread_mutex_lock( &cm->inflight_mutex );
+	avl_delete( &cm->inflight, (caddr_t)pif, pc_inflight_cmp );
+	pif->if_done = 1;
+	pif->if_cached = cached;
+	last = ( pif->if_waiters == 0 );
+	ldap_pvt_thread_mutex_unlock( &cm->inflight_mutex );
+
+	if ( last )
+		ch_free( pif );
+}
+
 static int
 pcache_op_cleanup( Operation *op, SlapReply *rs ) {
 	slap_callback	*cb = op->o_callback;
@@ -2347,6 +2783,7 @@ pcache_op_cleanup( Operation *op, SlapReply *rs ) {
 	slap_overinst *on = si->on;
 	cache_manager *cm = on->on_bi.bi_private;
 	query_manager*		qm = cm->qm;
+	int cached = 0;
 
 	if ( rs->sr_type == REP_RESULT || 
 		op->o_abandon || rs->sr_err == SLAPD_ABANDON )
@@ -2370,10 +2807,25 @@ pcache_op_cleanup( Operation *op, SlapReply *rs ) {
 			}
 
 		} else if ( si->caching_reason != PC_IGNORE ) {
-			CachedQuery *qc = qm->addfunc(op, qm, &si->query,
-				si->qtemp, si->caching_reason, 1 );
+			CachedQuery *qc;
+
+			if ( si->caching_reason == PC_NEGATIVE &&
+				cm->max_negative_queries &&
+				cm->num_negative_queries >= cm->max_negative_queries &&
+				negative_replacement( qm ) )
+			{
+				ldap_pvt_thread_mutex_lock(&cm->cache_mutex);
+				cm->num_cached_queries--;
+				cm->num_negative_queries--;
+				ldap_pvt_thread_mutex_unlock(&cm->cache_mutex);
+			}
+
+			qc = qm->addfunc(op, qm, &si->query,
+				si->qtemp, si->caching_reason,
+				cm->max_negative_queries > 0, 1 );
 
 			if ( qc != NULL ) {
+				cached = 1;
 				switch ( si->caching_reason ) {
 				case PC_POSITIVE:
 					cache_entries( op, &qc->q_uuid );
@@ -2397,6 +2849,8 @@ pcache_op_cleanup( Operation *op, SlapReply *rs ) {
 				ldap_pvt_thread_rdwr_wunlock(&qc->rwlock);
 				ldap_pvt_thread_mutex_lock(&cm->cache_mutex);
 				cm->num_cached_queries++;
+				if ( qc->q_negative )
+					cm->num_negative_queries++;
 				Debug( pcache_debug, "STORED QUERIES = %lu\n",
 						cm->num_cached_queries );
 				ldap_pvt_thread_mutex_unlock(&cm->cache_mutex);
@@ -2413,13 +2867,17 @@ pcache_op_cleanup( Operation *op, SlapReply *rs ) {
 					ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
 				}
 
-			} else if ( si->count ) {
-				/* duplicate query, free it */
-				Entry *e;
-				for (;si->head; si->head=e) {
-					e = si->head->e_private;
-					si->head->e_private = NULL;
-					entry_free(si->head);
+			} else {
+				/* duplicate query: an identical one was cached
+				 * meanwhile, its waiters can use that */
+				cached = 1;
+				if ( si->count ) {
+					Entry *e;
+					for (;si->head; si->head=e) {
+						e = si->head->e_private;
+						si->head->e_private = NULL;
+						entry_free(si->head);
+					}
 				}
 			}
 
@@ -2427,6 +2885,9 @@ pcache_op_cleanup( Operation *op, SlapReply *rs ) {
 			filter_free( si->query.filter );
 		}
 
+		if ( si->inflight )
+			pc_inflight_done( cm, si->inflight, cached );
+
 		op->o_callback = op->o_callback->sc_next;
 		op->o_tmpfree( cb, op->o_tmpmemctx );
 	}
@@ -2762,6 +3223,282 @@ pc_bind_resp( Operation *op, SlapReply *rs )
 	return SLAP_CB_CONTINUE;
 }
 
+static int
+pc_bindcache_cmp( const void *v1, const void *v2 )
+{
+	const bindcache_entry *bc1 = v1, *bc2 = v2;
+
+	return ber_bvcmp( &bc1->bc_ndn, &bc2->bc_ndn );
+}
+
+static bindcache_shard *
+pc_bindcache_shard( cache_manager *cm, struct berval *ndn )
+{
+	unsigned	h = 2166136261U;
+	ber_len_t	i;
+
+	/* FNV-1a */
+	for ( i = 0; i < ndn->bv_len; i++ ) {
+		h ^= (unsigned char)ndn->bv_val[ i ];
+		h *= 16777619U;
+	}
+
+	return &cm->bindcache[ h % PCACHE_BINDCACHE_SHARDS ];
+}
+
+static void
+pc_bindcache_digest( unsigned char *salt, struct berval *cred,
+	unsigned char *digest )
+{
+	lutil_SHA1_CTX	ctx;
+
+	lutil_SHA1Init( &ctx );
+	lutil_SHA1Update( &ctx, salt, PCACHE_BINDCACHE_SALT );
+	lutil_SHA1Update( &ctx, (const unsigned char *)cred->bv_val,
+		cred->bv_len );
+	lutil_SHA1Final( digest, &ctx );
+}
+
+/* LRU handling; the shard must be locked */
+static void
+pc_bindcache_link( bindcache_shard *bs, bindcache_entry *bc )
+{
+	bc->bc_lru_up = NULL;
+	bc->bc_lru_down = bs->bs_lru_top;
+	if ( bs->bs_lru_top )
+		bs->bs_lru_top->bc_lru_up = bc;
+	else
+		bs->bs_lru_bottom = bc;
+	bs->bs_lru_top = bc;
+}
+
+static void
+pc_bindcache_unlink( bindcache_shard *bs, bindcache_entry *bc )
+{
+	if ( bc->bc_lru_up )
+		bc->bc_lru_up->bc_lru_down = bc->bc_lru_down;
+	else
+		bs->bs_lru_top = bc->bc_lru_down;
+	if ( bc->bc_lru_down )
+		bc->bc_lru_down->bc_lru_up = bc->bc_lru_up;
+	else
+		bs->bs_lru_bottom = bc->bc_lru_up;
+}
+
+static void
+pc_bindcache_drop( bindcache_shard *bs, bindcache_entry *bc )
+{
+	pc_bindcache_unlink( bs, bc );
+	avl_delete( &bs->bs_tree, (caddr_t)bc, pc_bindcache_cmp );
+	bs->bs_num--;
+	ch_free( bc );
+}
+
+/* compares two digests in a time that does not depend on where
+ * they differ; returns 0 if they match */
+static int
+pc_bindcache_digest_cmp( const unsigned char *d1, const unsigned char *d2 )
+{
+	volatile unsigned char	diff = 0;
+	int			i;
+
+	for ( i = 0; i < LUTIL_SHA1_BYTES; i++ )
+		diff |= d1[i] ^ d2[i];
+
+	return diff;
+}
+
+/* returns 1 if the credentials match those the DN last bound with,
+ * 0 otherwise; in the latter case *genp is set to the generation
+ * a successful bind must still find to be cached */
+static int
+pc_bindcache_check( Operation *op, cache_manager *cm, unsigned long *genp )
+{
+	bindcache_shard	*bs = pc_bindcache_shard( cm, &op->o_req_ndn );
+	bindcache_entry	tmp, *bc;
+	unsigned char	digest[LUTIL_SHA1_BYTES];
+	int		rc = 0;
+
+	tmp.bc_ndn = op->o_req_ndn;
+
+	ldap_pvt_thread_mutex_lock( &bs->bs_mutex );
+	bc = avl_find( bs->bs_tree, &tmp, pc_bindcache_cmp );
+	if ( bc ) {
+		if ( op->o_time >= bc->bc_expiry ) {
+			pc_bindcache_drop( bs, bc );
+
+		} else {
+			pc_bindcache_digest( bc->bc_salt, &op->orb_cred, digest );
+			if ( !pc_bindcache_digest_cmp( digest, bc->bc_hash )) {
+				pc_bindcache_unlink( bs, bc );
+				pc_bindcache_link( bs, bc );
+				rc = 1;
+			}
+		}
+	}
+	if ( rc ) {
+		bs->bs_hits++;
+	} else {
+		*genp = bs->bs_gen;
+	}
+	ldap_pvt_thread_mutex_unlock( &bs->bs_mutex );
+
+	return rc;
+}
+
+static void
+pc_bindcache_add( Operation *op, cache_manager *cm, unsigned long gen )
+{
+	bindcache_shard	*bs = pc_bindcache_shard( cm, &op->o_req_ndn );
+	bindcache_entry	tmp, *bc;
+	unsigned char	salt[PCACHE_BINDCACHE_SALT];
+	unsigned char	digest[LUTIL_SHA1_BYTES];
+	unsigned long	max = 0;
+
+	if ( lutil_entropy( salt, sizeof( salt )) < 0 ) {
+		Debug( pcache_debug, "pc_bindcache_add: no entropy, "
+			"not caching bind for %s\n", op->o_req_dn.bv_val );
+		return;
+	}
+	pc_bindcache_digest( salt, &op->orb_cred, digest );
+
+	if ( cm->bindcache_max ) {
+		max = ( cm->bindcache_max + PCACHE_BINDCACHE_SHARDS - 1 ) /
+			PCACHE_BINDCACHE_SHARDS;
+	}
+	tmp.bc_ndn = op->o_req_ndn;
+
+	ldap_pvt_thread_mutex_lock( &bs->bs_mutex );
+	/* the entry changed while the bind was in progress */
+	if ( bs->bs_gen != gen ) {
+		ldap_pvt_thread_mutex_unlock( &bs->bs_mutex );
+		return;
+	}
+	bc = avl_find( bs->bs_tree, &tmp, pc_bindcache_cmp );
+	if ( bc ) {
+		pc_bindcache_unlink( bs, bc );
+
+	} else {
+		while ( max && bs->bs_num >= max )
+			pc_bindcache_drop( bs, bs->bs_lru_bottom );
+
+		bc = ch_malloc( sizeof( bindcache_entry ) + op->o_req_ndn.bv_len + 1 );
+		bc->bc_ndn.bv_len = op->o_req_ndn.bv_len;
+		bc->bc_ndn.bv_val = (char *)&bc[1];
+		AC_MEMCPY( bc->bc_ndn.bv_val, op->o_req_ndn.bv_val,
+			op->o_req_ndn.bv_len + 1 );
+		avl_insert( &bs->bs_tree, (caddr_t)bc, pc_bindcache_cmp,
+			avl_dup_error );
+		bs->bs_num++;
+	}
+	AC_MEMCPY( bc->bc_salt, salt, sizeof( salt ));
+	AC_MEMCPY( bc->bc_hash, digest, sizeof( digest ));
+	bc->bc_expiry = op->o_time + cm->bindcache_ttl;
+	pc_bindcache_link( bs, bc );
+	ldap_pvt_thread_mutex_unlock( &bs->bs_mutex );
+
+	Debug( pcache_debug, "pc_bindcache_add: CACHING BIND for %s\n",
+		op->o_req_dn.bv_val );
+}
+
+/* forget the cached bind of a DN, and keep binds already in
+ * progress from caching their result */
+static void
+pc_bindcache_delete( cache_manager *cm, struct berval *ndn )
+{
+	bindcache_shard	*bs = pc_bindcache_shard( cm, ndn );
+	bindcache_entry	tmp, *bc;
+
+	tmp.bc_ndn = *ndn;
+
+	ldap_pvt_thread_mutex_lock( &bs->bs_mutex );
+	bc = avl_find( bs->bs_tree, &tmp, pc_bindcache_cmp );
+	if ( bc )
+		pc_bindcache_drop( bs, bc );
+	bs->bs_gen++;
+	ldap_pvt_thread_mutex_unlock( &bs->bs_mutex );
+}
+
+static void
+pc_bindcache_flush( cache_manager *cm )
+{
+	int i;
+
+	for ( i = 0; i < PCACHE_BINDCACHE_SHARDS; i++ ) {
+		bindcache_shard *bs = &cm->bindcache[i];
+
+		ldap_pvt_thread_mutex_lock( &bs->bs_mutex );
+		avl_free( bs->bs_tree, ch_free );
+		bs->bs_tree = NULL;
+		bs->bs_lru_top = bs->bs_lru_bottom = NULL;
+		bs->bs_num = 0;
+		bs->bs_gen++;
+		ldap_pvt_thread_mutex_unlock( &bs->bs_mutex );
+	}
+}
+
+typedef struct bindcacheop {
+	slap_overinst *on;
+	unsigned long gen;
+} bindcacheop;
+
+/* cache a bind the underlying database accepted */
+static int
+pc_bindcache_save( Operation *op, SlapReply *rs )
+{
+	bindcacheop *bco = op->o_callback->sc_private;
+	cache_manager *cm = bco->on->on_bi.bi_private;
+
+	if ( rs->sr_err == LDAP_SUCCESS ) {
+		pc_bindcache_add( op, cm, bco->gen );
+	} else if ( rs->sr_err == LDAP_INVALID_CREDENTIALS ) {
+		pc_bindcache_delete( cm, &op->o_req_ndn );
+	}
+	return SLAP_CB_CONTINUE;
+}
+
+typedef struct bindcachewatch {
+	slap_overinst *on;
+	struct berval ndn;
+} bindcachewatch;
+
+/* forget the cached bind of an entry once a change to it is done */
+static int
+pc_bindcache_invalidate( Operation *op, SlapReply *rs )
+{
+	if ( rs->sr_type == REP_RESULT || rs->sr_type == REP_EXTENDED ) {
+		bindcachewatch *bcw = op->o_callback->sc_private;
+		cache_manager *cm = bcw->on->on_bi.bi_private;
+
+		pc_bindcache_delete( cm, &bcw->ndn );
+	}
+	return SLAP_CB_CONTINUE;
+}
+
+/* the target DN is copied, as the password modify exop
+ * releases it before its result is sent */
+static void
+pc_bindcache_watch( Operation *op, slap_overinst *on )
+{
+	slap_callback *sc;
+	bindcachewatch *bcw;
+
+	sc = op->o_tmpalloc( sizeof(slap_callback) + sizeof(bindcachewatch) +
+		op->o_req_ndn.bv_len + 1, op->o_tmpmemctx );
+	sc->sc_response = pc_bindcache_invalidate;
+	sc->sc_cleanup = NULL;
+	sc->sc_private = sc+1;
+	sc->sc_writewait = NULL;
+	bcw = sc->sc_private;
+	bcw->on = on;
+	bcw->ndn.bv_len = op->o_req_ndn.bv_len;
+	bcw->ndn.bv_val = (char *)&bcw[1];
+	AC_MEMCPY( bcw->ndn.bv_val, op->o_req_ndn.bv_val, op->o_req_ndn.bv_len );
+	bcw->ndn.bv_val[bcw->ndn.bv_len] = '\0';
+	sc->sc_next = op->o_callback;
+	op->o_callback = sc;
+}
+
 #ifdef PCACHE_CONTROL_PRIVDB
 static int
 pcache_op_privdb(
@@ -2848,6 +3585,36 @@ pcache_op_bind(
 		return pcache_op_privdb( op, rs );
 #endif /* PCACHE_CONTROL_PRIVDB */
 
+	/* Simple binds without controls can be checked against the
+	 * password the DN last bound with, without going anywhere */
+	if ( cm->bindcache_ttl && op->orb_method == LDAP_AUTH_SIMPLE &&
+		!BER_BVISEMPTY( &op->o_req_ndn ) &&
+		!BER_BVISEMPTY( &op->orb_cred ) && op->o_ctrls == NULL )
+	{
+		bindcacheop *bco;
+		unsigned long gen;
+
+		if ( pc_bindcache_check( op, cm, &gen )) {
+			Debug( pcache_debug, "pcache_op_bind: CACHED BIND for %s "
+				"from bind cache\n", op->o_req_dn.bv_val );
+			op->o_conn->c_authz_cookie = cm->db.be_private;
+			rs->sr_err = LDAP_SUCCESS;
+			return rs->sr_err;
+		}
+
+		sc = op->o_tmpalloc( sizeof(slap_callback) + sizeof(bindcacheop),
+			op->o_tmpmemctx );
+		sc->sc_response = pc_bindcache_save;
+		sc->sc_cleanup = NULL;
+		sc->sc_private = sc+1;
+		sc->sc_writewait = NULL;
+		bco = sc->sc_private;
+		sc->sc_next = op->o_callback;
+		op->o_callback = sc;
+		bco->on = on;
+		bco->gen = gen;
+	}
+
 	/* Skip if we're not configured for Binds, or cache DB isn't open yet */
 	if ( !cm->cache_binds || cm->defer_db_open )
 		return SLAP_CB_CONTINUE;
@@ -2943,6 +3710,26 @@ pcache_op_bind(
 	return SLAP_CB_CONTINUE;
 }
 
+/* changes to an entry may change the outcome of its binds */
+static int
+pcache_op_update(
+	Operation		*op,
+	SlapReply		*rs )
+{
+	slap_overinst 	*on = (slap_overinst *)op->o_bd->bd_info;
+	cache_manager 	*cm = on->on_bi.bi_private;
+
+#ifdef PCACHE_CONTROL_PRIVDB
+	if ( op->o_ctrlflag[ privDB_cid ] == SLAP_CONTROL_CRITICAL )
+		return pcache_op_privdb( op, rs );
+#endif /* PCACHE_CONTROL_PRIVDB */
+
+	if ( cm->bindcache_ttl )
+		pc_bindcache_watch( op, on );
+
+	return SLAP_CB_CONTINUE;
+}
+
 static slap_response refresh_merge;
 
 static int
@@ -2963,6 +3750,10 @@ pcache_op_search(
 	int 		attr_set = -1;
 	CachedQuery 	*answerable = NULL;
 	int 		cacheable = 0;
+	int		negonly = 0;
+	unsigned long	nqueries;
+	pc_inflight	*inflight = NULL;
+	int		coalesced = 0;
 
 	struct berval	tempstr;
 
@@ -3001,6 +3792,7 @@ pcache_op_search(
 
 	/* FIXME: cannot cache/answer requests with pagedResults control */
 
+retry:;
 	query.filter = op->ors_filter;
 
 	if ( pbi ) {
@@ -3064,7 +3856,11 @@ pcache_op_search(
 			answerable->answerable_cnt );
 		ldap_pvt_thread_mutex_unlock( &answerable->answerable_cnt_mutex );
 
-		ldap_pvt_thread_rdwr_wlock(&answerable->rwlock);
+		/* only the bind cache needs to update the query */
+		if ( pbi )
+			ldap_pvt_thread_rdwr_wlock(&answerable->rwlock);
+		else
+			ldap_pvt_thread_rdwr_rlock(&answerable->rwlock);
 		if ( BER_BVISNULL( &answerable->q_uuid )) {
 			/* No entries cached, just an empty result set */
 			i = rs->sr_err = 0;
@@ -3097,7 +3893,10 @@ pcache_op_search(
 			}
 			i = cm->db.bd_info->bi_op_search( op, rs );
 		}
-		ldap_pvt_thread_rdwr_wunlock(&answerable->rwlock);
+		if ( pbi )
+			ldap_pvt_thread_rdwr_wunlock(&answerable->rwlock);
+		else
+			ldap_pvt_thread_rdwr_runlock(&answerable->rwlock);
 		/* locked by qtemp->qcfunc (query_containment) */
 		ldap_pvt_thread_rdwr_runlock(&qtemp->t_rwlock);
 		op->o_bd = save_bd;
@@ -3107,14 +3906,40 @@ pcache_op_search(
 	Debug( pcache_debug, "QUERY NOT ANSWERABLE\n" );
 
 	ldap_pvt_thread_mutex_lock(&cm->cache_mutex);
-	if (cm->num_cached_queries >= cm->max_queries) {
-		cacheable = 0;
+	nqueries = cm->num_cached_queries;
+	if ( cm->max_negative_queries ) {
+		/* negative queries have their own budget */
+		nqueries -= cm->num_negative_queries;
+	}
+	if (nqueries >= cm->max_queries) {
+		/* only an empty result may still be cached */
+		if ( cm->max_negative_queries && qtemp->negttl )
+			negonly = 1;
+		else
+			cacheable = 0;
 	}
 	ldap_pvt_thread_mutex_unlock(&cm->cache_mutex);
 
 	if (op->ors_attrsonly)
 		cacheable = 0;
 
+	/* If the same query is already being fetched, wait for its result
+	 * to be cached rather than fetching it again */
+	if ( cacheable && cm->coalesce && !pbi && !coalesced ) {
+		int rc = pc_inflight_wait( op, rs, cm, qtemp, &inflight );
+
+		if ( rc == -2 ) {
+			/* only plays the cleanups if abandoned */
+			send_ldap_result( op, rs );
+			return rs->sr_err;
+		}
+		if ( rc >= 0 ) {
+			coalesced = 1;
+			if ( rc > 0 )
+				goto retry;
+		}
+	}
+
 	if (cacheable) {
 		slap_callback		*cb;
 		struct search_info	*si;
@@ -3131,7 +3956,7 @@ pcache_op_search(
 		si->on = on;
 		si->query = query;
 		si->qtemp = qtemp;
-		si->max = cm->num_entries_limit ;
+		si->max = negonly ? 0 : cm->num_entries_limit ;
 		si->over = 0;
 		si->count = 0;
 		si->slimit = 0;
@@ -3148,6 +3973,7 @@ pcache_op_search(
 		si->pbi = pbi;
 		if ( pbi )
 			pbi->bi_si = si;
+		si->inflight = inflight;
 
 		op->ors_attrs = qtemp->t_attrs.attrs;
 
@@ -3589,6 +4415,8 @@ consistency_check(
 				ldap_pvt_thread_mutex_lock(&cm->cache_mutex);
 				cm->cur_entries -= return_val;
 				cm->num_cached_queries--;
+				if ( query->q_negative )
+					cm->num_negative_queries--;
 				Debug( pcache_debug, "STORED QUERIES = %lu\n",
 						cm->num_cached_queries );
 				ldap_pvt_thread_mutex_unlock(&cm->cache_mutex);
@@ -3641,8 +4469,11 @@ enum {
 	PC_TEMP,
 	PC_RESP,
 	PC_QUERIES,
+	PC_NEGQUERIES,
 	PC_OFFLINE,
 	PC_BIND,
+	PC_BINDCACHE,
+	PC_COALESCE,
 	PC_PRIVATE_DB
 };
 
@@ -3709,6 +4540,24 @@ static ConfigTable pccfg[] = {
 			"DESC 'Parameters for caching Binds' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "pcacheMaxNegativeQueries", "queries",
+		2, 2, 0, ARG_INT|ARG_MAGIC|PC_NEGQUERIES, pc_cf_gen,
+		"( OLcfgOvAt:2.10 NAME 'olcPcacheMaxNegativeQueries' "
+			"DESC 'Maximum number of negative queries to cache' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "pcacheBindCache", "TTL> <max_binds",
+		2, 3, 0, ARG_MAGIC|PC_BINDCACHE, pc_cf_gen,
+		"( OLcfgOvAt:2.11 NAME 'olcPcacheBindCache' "
+			"DESC 'TTL and size of the dedicated Bind cache' "
+			"EQUALITY caseIgnoreMatch "
+			"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
+	{ "pcacheCoalesce", "TRUE|FALSE",
+		2, 2, 0, ARG_ON_OFF|ARG_MAGIC|PC_COALESCE, pc_cf_gen,
+		"( OLcfgOvAt:2.12 NAME 'olcPcacheCoalesce' "
+			"DESC 'Let concurrent identical queries wait for a single fetch' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ "pcache-", "private database args",
 		1, 0, STRLENOF("pcache-"), ARG_MAGIC|PC_PRIVATE_DB, pc_cf_gen,
 		NULL, NULL, NULL },
@@ -3747,7 +4596,9 @@ static ConfigOCs pcocs[] = {
 		"SUP olcOverlayConfig "
 		"MUST ( olcPcache $ olcPcacheAttrset $ olcPcacheTemplate ) "
 		"MAY ( olcPcachePosition $ olcPcacheMaxQueries $ olcPcachePersist $ "
-			"olcPcacheValidate $ olcPcacheOffline $ olcPcacheBind ) )",
+			"olcPcacheValidate $ olcPcacheOffline $ olcPcacheBind $ "
+			"olcPcacheMaxNegativeQueries $ olcPcacheBindCache $ "
+			"olcPcacheCoalesce ) )",
 		Cft_Overlay, pccfg, NULL, pc_cfadd },
 	{ "( OLcfgOvOc:2.2 "
 		"NAME 'olcPcacheDatabase' "
@@ -3931,9 +4782,29 @@ pc_cf_gen( ConfigArgs *c )
 		case PC_QUERIES:
 			c->value_int = cm->max_queries;
 			break;
+		case PC_NEGQUERIES:
+			if ( cm->max_negative_queries == 0 ) {
+				rc = 1;
+				break;
+			}
+			c->value_int = cm->max_negative_queries;
+			break;
 		case PC_OFFLINE:
 			c->value_int = (cm->cc_paused & PCACHE_CC_OFFLINE) != 0;
 			break;
+		case PC_BINDCACHE:
+			if ( cm->bindcache_ttl == 0 ) {
+				rc = 1;
+				break;
+			}
+			bv.bv_len = snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"%ld %lu", (long)cm->bindcache_ttl, cm->bindcache_max );
+			bv.bv_val = c->cr_msg;
+			value_add_one( &c->rvalue_vals, &bv );
+			break;
+		case PC_COALESCE:
+			c->value_int = cm->coalesce;
+			break;
 		}
 		return rc;
 	} else if ( c->op == LDAP_MOD_DELETE ) {
@@ -3943,6 +4814,20 @@ pc_cf_gen( ConfigArgs *c )
 		case PC_TEMP:
 		case PC_BIND:
 			break;
+		case PC_NEGQUERIES:
+			cm->max_negative_queries = 0;
+			rc = 0;
+			break;
+		case PC_BINDCACHE:
+			cm->bindcache_ttl = 0;
+			cm->bindcache_max = 0;
+			pc_bindcache_flush( cm );
+			rc = 0;
+			break;
+		case PC_COALESCE:
+			cm->coalesce = 0;
+			rc = 0;
+			break;
 		case PC_OFFLINE:
 			cm->cc_paused &= ~PCACHE_CC_OFFLINE;
 			/* If there were cached queries when we went offline,
@@ -4406,6 +5291,36 @@ pc_bind_fail:
 		}
 		cm->max_queries = c->value_int;
 		break;
+	case PC_NEGQUERIES:
+		if ( c->value_int < 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ), "max negative queries must not be negative" );
+			Debug( LDAP_DEBUG_CONFIG, "%s: %s.\n", c->log, c->cr_msg );
+			return( 1 );
+		}
+		cm->max_negative_queries = c->value_int;
+		break;
+	case PC_BINDCACHE:
+		if ( lutil_parse_time( c->argv[1], &t ) != 0 || t == 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"unable to parse bind cache ttl=\"%s\"",
+				c->argv[1] );
+			Debug( LDAP_DEBUG_CONFIG, "%s: %s.\n", c->log, c->cr_msg );
+			return( 1 );
+		}
+		if ( c->argc == 2 ) {
+			cm->bindcache_max = 0;
+		} else if ( lutil_atoul( &cm->bindcache_max, c->argv[2] ) != 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"unable to parse bind cache size=\"%s\"",
+				c->argv[2] );
+			Debug( LDAP_DEBUG_CONFIG, "%s: %s.\n", c->log, c->cr_msg );
+			return( 1 );
+		}
+		cm->bindcache_ttl = (time_t)t;
+		break;
+	case PC_COALESCE:
+		cm->coalesce = c->value_int;
+		break;
 	case PC_OFFLINE:
 		if ( c->value_int )
 			cm->cc_paused |= PCACHE_CC_OFFLINE;
@@ -4498,6 +5413,7 @@ pcache_db_init(
 	slap_overinst *on = (slap_overinst *)be->bd_info;
 	cache_manager *cm;
 	query_manager *qm;
+	int i;
 
 	cm = (cache_manager *)ch_malloc(sizeof(cache_manager));
 	on->on_bi.bi_private = cm;
@@ -4517,11 +5433,29 @@ pcache_db_init(
 	cm->max_entries = 0;
 	cm->cur_entries = 0;
 	cm->max_queries = 10000;
+	cm->num_negative_queries = 0;
+	cm->max_negative_queries = 0;
 	cm->save_queries = 0;
 	cm->check_cacheability = 0;
 	cm->response_cb = PCACHE_RESPONSE_CB_TAIL;
 	cm->defer_db_open = 1;
 	cm->cache_binds = 0;
+	cm->bindcache_ttl = 0;
+	cm->bindcache_max = 0;
+	for ( i = 0; i < PCACHE_BINDCACHE_SHARDS; i++ ) {
+		bindcache_shard *bs = &cm->bindcache[i];
+
+		ldap_pvt_thread_mutex_init( &bs->bs_mutex );
+		bs->bs_tree = NULL;
+		bs->bs_lru_top = bs->bs_lru_bottom = NULL;
+		bs->bs_num = 0;
+		bs->bs_gen = 0;
+		bs->bs_hits = 0;
+	}
+	cm->coalesce = 0;
+	cm->inflight = NULL;
+	cm->num_coalesced = 0;
+	ldap_pvt_thread_mutex_init( &cm->inflight_mutex );
 	cm->cc_period = 1000;
 	cm->cc_paused = 0;
 	cm->cc_arg = NULL;
@@ -4533,6 +5467,8 @@ pcache_db_init(
 	qm->templates = NULL;
 	qm->lru_top = NULL;
 	qm->lru_bottom = NULL;
+	qm->neg_lru_top = NULL;
+	qm->neg_lru_bottom = NULL;
 
 	qm->qcfunc = query_containment;
 	qm->crfunc = cache_replacement;
@@ -4940,6 +5876,12 @@ pcache_db_destroy(
 	free( qm->attr_sets );
 	qm->attr_sets = NULL;
 
+	pc_bindcache_flush( cm );
+	for ( i = 0; i < PCACHE_BINDCACHE_SHARDS; i++ ) {
+		ldap_pvt_thread_mutex_destroy( &cm->bindcache[i].bs_mutex );
+	}
+	ldap_pvt_thread_mutex_destroy( &cm->inflight_mutex );
+
 	ldap_pvt_thread_mutex_destroy( &qm->lru_mutex );
 	ldap_pvt_thread_mutex_destroy( &cm->cache_mutex );
 	free( qm );
@@ -5296,6 +6238,8 @@ pcache_op_extended( Operation *op, SlapReply *rs )
 			/* remove all queries related to the selected entry */
 			rs->sr_err = pcache_remove_entry_queries_from_cache( op,
 				cm, &op->o_req_ndn, &uuid );
+			if ( cm->bindcache_ttl )
+				pc_bindcache_delete( cm, &op->o_req_ndn );
 
 		} else if ( tag == LDAP_TAG_EXOP_QUERY_DELETE_BASE ) {
 			if ( !BER_BVISNULL( &uuid ) ) {
@@ -5315,6 +6259,11 @@ pcache_op_extended( Operation *op, SlapReply *rs )
 	}
 #endif /* PCACHE_EXOP_QUERY_DELETE */
 
+	if ( bvmatch( &op->ore_reqoid, &pcache_exop_MODIFY_PASSWD ) &&
+		cm->bindcache_ttl ) {
+		pc_bindcache_watch( op, on );
+	}
+
 	/* We only care if we're configured for Bind caching */
 	if ( bvmatch( &op->ore_reqoid, &pcache_exop_MODIFY_PASSWD ) &&
 		cm->cache_binds ) {
@@ -5438,6 +6387,71 @@ pcache_monitor_update(
 			ber_bvreplace( &a->a_nvals[ 0 ], &bv );
 		}
 		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+
+		/* number of cached negative queries */
+		a = attr_find( e->e_attrs, ad_numNegativeQueries );
+		assert( a != NULL );
+
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", cm->num_negative_queries );
+
+		if ( a->a_nvals != a->a_vals ) {
+			ber_bvreplace( &a->a_nvals[ 0 ], &bv );
+		}
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
+	{
+		Attribute	*a;
+		char		buf[ SLAP_TEXT_BUFLEN ];
+		struct berval	bv;
+		unsigned long	num = 0, hits = 0;
+		int		i;
+
+		for ( i = 0; i < PCACHE_BINDCACHE_SHARDS; i++ ) {
+			bindcache_shard *bs = &cm->bindcache[i];
+
+			ldap_pvt_thread_mutex_lock( &bs->bs_mutex );
+			num += bs->bs_num;
+			hits += bs->bs_hits;
+			ldap_pvt_thread_mutex_unlock( &bs->bs_mutex );
+		}
+
+		/* number of cached binds */
+		a = attr_find( e->e_attrs, ad_numCachedBinds );
+		assert( a != NULL );
+
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", num );
+
+		if ( a->a_nvals != a->a_vals ) {
+			ber_bvreplace( &a->a_nvals[ 0 ], &bv );
+		}
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+
+		/* number of binds answered from the bind cache */
+		a = attr_find( e->e_attrs, ad_numBindCacheHits );
+		assert( a != NULL );
+
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", hits );
+
+		if ( a->a_nvals != a->a_vals ) {
+			ber_bvreplace( &a->a_nvals[ 0 ], &bv );
+		}
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+
+		/* number of queries answered after waiting for another */
+		a = attr_find( e->e_attrs, ad_numCoalescedQueries );
+		assert( a != NULL );
+
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", cm->num_coalesced );
+
+		if ( a->a_nvals != a->a_vals ) {
+			ber_bvreplace( &a->a_nvals[ 0 ], &bv );
+		}
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
 	}
 
 	return SLAP_CB_CONTINUE;
@@ -5495,6 +6509,38 @@ pcache_monitor_free(
 		textbuf, sizeof( textbuf ) );
 	/* don't care too much about return code... */
 
+	/* remove attrs */
+	mod.sm_values = NULL;
+	mod.sm_desc = ad_numNegativeQueries;
+	mod.sm_numvals = 0;
+	rc = modify_delete_values( e, &mod, 1, &text,
+		textbuf, sizeof( textbuf ) );
+	/* don't care too much about return code... */
+
+	/* remove attrs */
+	mod.sm_values = NULL;
+	mod.sm_desc = ad_numCachedBinds;
+	mod.sm_numvals = 0;
+	rc = modify_delete_values( e, &mod, 1, &text,
+		textbuf, sizeof( textbuf ) );
+	/* don't care too much about return code... */
+
+	/* remove attrs */
+	mod.sm_values = NULL;
+	mod.sm_desc = ad_numBindCacheHits;
+	mod.sm_numvals = 0;
+	rc = modify_delete_values( e, &mod, 1, &text,
+		textbuf, sizeof( textbuf ) );
+	/* don't care too much about return code... */
+
+	/* remove attrs */
+	mod.sm_values = NULL;
+	mod.sm_desc = ad_numCoalescedQueries;
+	mod.sm_numvals = 0;
+	rc = modify_delete_values( e, &mod, 1, &text,
+		textbuf, sizeof( textbuf ) );
+	/* don't care too much about return code... */
+
 	return SLAP_CB_CONTINUE;
 }
 
@@ -5563,7 +6609,7 @@ pcache_monitor_db_open( BackendDB *be )
 	}
 
 	/* alloc as many as required (plus 1 for objectClass) */
-	a = attrs_alloc( 1 + 2 );
+	a = attrs_alloc( 1 + 6 );
 	if ( a == NULL ) {
 		rc = 1;
 		goto cleanup;
@@ -5583,6 +6629,22 @@ pcache_monitor_db_open( BackendDB *be )
 		next->a_desc = ad_numEntries;
 		attr_valadd( next, &bv, NULL, 1 );
 		next = next->a_next;
+
+		next->a_desc = ad_numNegativeQueries;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_numCachedBinds;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_numBindCacheHits;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_numCoalescedQueries;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
 	}
 
 	cb = ch_calloc( sizeof( monitor_callback_t ), 1 );
@@ -5754,12 +6816,12 @@ pcache_initialize()
 
 	pcache.on_bi.bi_op_search = pcache_op_search;
 	pcache.on_bi.bi_op_bind = pcache_op_bind;
+	pcache.on_bi.bi_op_modrdn = pcache_op_update;
+	pcache.on_bi.bi_op_modify = pcache_op_update;
+	pcache.on_bi.bi_op_delete = pcache_op_update;
 #ifdef PCACHE_CONTROL_PRIVDB
 	pcache.on_bi.bi_op_compare = pcache_op_privdb;
-	pcache.on_bi.bi_op_modrdn = pcache_op_privdb;
-	pcache.on_bi.bi_op_modify = pcache_op_privdb;
 	pcache.on_bi.bi_op_add = pcache_op_privdb;
-	pcache.on_bi.bi_op_delete = pcache_op_privdb;
 #endif /* PCACHE_CONTROL_PRIVDB */
 	pcache.on_bi.bi_extended = pcache_op_extended;
 
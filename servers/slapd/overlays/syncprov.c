@@ -45,11 +45,21 @@ typedef struct modtarget {
 	ldap_pvt_thread_mutex_t mt_mutex;
 } modtarget;
 
+/* An encoding of a psearch result's entry, shared by all the
+ * psearches whose requests would produce identical output
+ */
+typedef struct resenc {
+	struct resenc *re_next;
+	struct berval re_key;	/* see syncprov_enckey() */
+	struct berval re_ber;	/* SearchResultEntry protocolOp */
+} resenc;
+
 /* All the info of a psearch result that's shared between
  * multiple queues
  */
 typedef struct resinfo {
 	struct syncres *ri_list;
+	resenc *ri_enc;
 	Entry *ri_e;
 	struct berval ri_dn;
 	struct berval ri_ndn;
@@ -89,6 +99,8 @@ typedef struct syncops {
 	int		s_inuse;	/* reference count */
 	struct syncres *s_res;
 	struct syncres *s_restail;
+	struct berval s_enckey;	/* identifies searches with identical output */
+	int		s_encprivate;	/* output may differ from same-keyed searches */
 	void *s_pool_cookie;
 	ldap_pvt_thread_mutex_t	s_mutex;
 } syncops;
@@ -161,18 +173,27 @@ typedef struct syncprov_info_t {
 	int		si_numops;	/* number of ops since last checkpoint */
 	int		si_nopres;	/* Skip present phase */
 	int		si_usehint;	/* use reload hint */
+	int		si_shareenc;	/* share entry encodings between psearches */
 	int		si_active;	/* True if there are active mods */
 	int		si_dirty;	/* True if the context is dirty, i.e changes
 						 * have been made without updating the csn. */
 	time_t	si_chklast;	/* time of last checkpoint */
+	int		si_chkstate;	/* background checkpoint state */
+	void	*si_chkcookie;	/* pool cookie of queued checkpoint */
 	Avlnode	*si_mods;	/* entries being modified */
 	sessionlog	*si_logs;
 	ldap_pvt_thread_rdwr_t	si_csn_rwlock;
 	ldap_pvt_thread_mutex_t	si_ops_mutex;
 	ldap_pvt_thread_mutex_t	si_mods_mutex;
 	ldap_pvt_thread_mutex_t	si_resp_mutex;
+	ldap_pvt_thread_mutex_t	si_chk_mutex;
+	ldap_pvt_thread_cond_t	si_chk_cond;	/* signalled when si_chkstate clears */
 } syncprov_info_t;
 
+#define	CHK_QUEUED	0x01
+#define	CHK_RUNNING	0x02
+#define	CHK_AGAIN	0x04
+
 typedef struct opcookie {
 	slap_overinst *son;
 	syncmatches *smatches;
@@ -855,7 +876,14 @@ static void free_resinfo( syncres *sr )
 		freeit = 1;
 	ldap_pvt_thread_mutex_unlock( &sr->s_info->ri_mutex );
 	if ( freeit ) {
+		resenc *re, *renext;
+
 		ldap_pvt_thread_mutex_destroy( &sr->s_info->ri_mutex );
+		for ( re = sr->s_info->ri_enc; re; re = renext ) {
+			renext = re->re_next;
+			ch_free( re->re_ber.bv_val );
+			ch_free( re );
+		}
 		if ( sr->s_info->ri_e )
 			entry_free( sr->s_info->ri_e );
 		if ( !BER_BVISNULL( &sr->s_info->ri_cookie ))
@@ -902,6 +930,8 @@ syncprov_free_syncop( syncops *so, int flags )
 		ch_free( so->s_op );
 	}
 	ch_free( so->s_base.bv_val );
+	if ( !BER_BVISNULL( &so->s_enckey ))
+		ch_free( so->s_enckey.bv_val );
 	for ( sr=so->s_res; sr; sr=srnext ) {
 		srnext = sr->s_next;
 		free_resinfo( sr );
@@ -912,6 +942,125 @@ syncprov_free_syncop( syncops *so, int flags )
 	return 1;
 }
 
+/* Does any ACL clause depend on the client's connection rather
+ * than on its identity?
+ */
+static int
+syncprov_acl_connbound( AccessControl *a )
+{
+	Access *b;
+
+	for ( ; a; a = a->acl_next ) {
+		for ( b = a->acl_access; b; b = b->a_next ) {
+			if ( !BER_BVISEMPTY( &b->a_peername_pat ) ||
+				!BER_BVISEMPTY( &b->a_sockname_pat ) ||
+				!BER_BVISEMPTY( &b->a_domain_pat ) ||
+				!BER_BVISEMPTY( &b->a_sockurl_pat ))
+				return 1;
+		}
+	}
+	return 0;
+}
+
+/* Everything in a psearch request that can change the encoding of
+ * an entry sent to it: the identities and security factors that ACLs
+ * are evaluated against, and the requested attributes. Searches whose
+ * output may differ for other reasons never share: those with a
+ * ValuesReturnFilter or response callbacks, and any search when ACLs
+ * look at connection properties.
+ */
+static void
+syncprov_enckey( Operation *op, syncops *so )
+{
+	Operation *sop = so->s_op;
+	AttributeName *an;
+	char buf[ 64 ], *ptr;
+	ber_len_t len;
+
+	if ( op->o_callback ||
+		syncprov_acl_connbound( sop->o_bd->be_acl ) ||
+		syncprov_acl_connbound( frontendDB->be_acl ))
+	{
+		so->s_encprivate = 1;
+		return;
+	}
+
+	len = snprintf( buf, sizeof( buf ), "%d %u %u %u %u ",
+		sop->ors_attrsonly, sop->o_ssf, sop->o_transport_ssf,
+		sop->o_tls_ssf, sop->o_sasl_ssf );
+	len += sop->o_ndn.bv_len + 1;
+	len += sop->o_conn->c_ndn.bv_len + 1;
+	for ( an = sop->ors_attrs; an && !BER_BVISNULL( &an->an_name ); an++ )
+		len += an->an_name.bv_len + 1;
+
+	so->s_enckey.bv_val = ch_malloc( len + 1 );
+	ptr = lutil_strcopy( so->s_enckey.bv_val, buf );
+	ptr = lutil_strncopy( ptr, sop->o_ndn.bv_val, sop->o_ndn.bv_len );
+	*ptr++ = '\n';
+	ptr = lutil_strncopy( ptr, sop->o_conn->c_ndn.bv_val,
+		sop->o_conn->c_ndn.bv_len );
+	*ptr++ = '\n';
+	for ( an = sop->ors_attrs; an && !BER_BVISNULL( &an->an_name ); an++ ) {
+		ptr = lutil_strncopy( ptr, an->an_name.bv_val, an->an_name.bv_len );
+		*ptr++ = ',';
+	}
+	*ptr = '\0';
+	so->s_enckey.bv_len = ptr - so->s_enckey.bv_val;
+}
+
+/* Find an encoding of ri's entry made for an identical psearch.
+ * It stays valid as long as the caller's syncres is on ri_list.
+ */
+static int
+syncprov_enc_get( Operation *op, resinfo *ri, syncops *so, struct berval *bv )
+{
+	resenc *re;
+
+	if ( BER_BVISNULL( &so->s_enckey ) && !so->s_encprivate )
+		syncprov_enckey( op, so );
+	if ( so->s_encprivate )
+		return -1;
+
+	ldap_pvt_thread_mutex_lock( &ri->ri_mutex );
+	for ( re = ri->ri_enc; re; re = re->re_next ) {
+		if ( bvmatch( &re->re_key, &so->s_enckey )) {
+			*bv = re->re_ber;
+			break;
+		}
+	}
+	ldap_pvt_thread_mutex_unlock( &ri->ri_mutex );
+
+	return re != NULL;
+}
+
+/* Publish a fresh encoding for other psearches to reuse */
+static void
+syncprov_enc_put( resinfo *ri, syncops *so, struct berval *bv )
+{
+	resenc *re;
+
+	ldap_pvt_thread_mutex_lock( &ri->ri_mutex );
+	for ( re = ri->ri_enc; re; re = re->re_next ) {
+		if ( bvmatch( &re->re_key, &so->s_enckey ))
+			break;
+	}
+	if ( re ) {
+		/* another psearch got there first */
+		ch_free( bv->bv_val );
+	} else {
+		re = ch_malloc( sizeof( resenc ) + so->s_enckey.bv_len + 1 );
+		re->re_key.bv_val = (char *)(re + 1);
+		re->re_key.bv_len = so->s_enckey.bv_len;
+		AC_MEMCPY( re->re_key.bv_val, so->s_enckey.bv_val,
+			so->s_enckey.bv_len + 1 );
+		re->re_ber = *bv;
+		re->re_next = ri->ri_enc;
+		ri->ri_enc = re;
+	}
+	ldap_pvt_thread_mutex_unlock( &ri->ri_mutex );
+	BER_BVZERO( bv );
+}
+
 /* Send a persistent search response */
 static int
 syncprov_sendresp( Operation *op, resinfo *ri, syncops *so, int mode )
@@ -920,6 +1069,8 @@ syncprov_sendresp( Operation *op, resinfo *ri, syncops *so, int mode )
 	struct berval cookie, csns[2];
 	Entry e_uuid = {0};
 	Attribute a_uuid = {0};
+	struct berval enc = BER_BVNULL;
+	int shared = 0;
 
 	if ( so->s_op->o_abandon )
 		return SLAPD_ABANDON;
@@ -970,7 +1121,14 @@ syncprov_sendresp( Operation *op, resinfo *ri, syncops *so, int mode )
 			mode == LDAP_SYNC_ADD ? "LDAP_SYNC_ADD" : "LDAP_SYNC_MODIFY",
 			e_uuid.e_nname.bv_val );
 		rs.sr_attrs = op->ors_attrs;
+		if ( so->s_si && so->s_si->si_shareenc ) {
+			shared = syncprov_enc_get( op, ri, so, &enc );
+			if ( shared >= 0 )
+				rs.sr_encoded = &enc;
+		}
 		rs.sr_err = send_search_entry( op, &rs );
+		if ( !shared && !BER_BVISNULL( &enc ))
+			syncprov_enc_put( ri, so, &enc );
 		break;
 	case LDAP_SYNC_DELETE:
 		Debug( LDAP_DEBUG_SYNC, "%s syncprov_sendresp: "
@@ -1165,6 +1323,7 @@ syncprov_qresp( opcookie *opc, syncops *so, int mode )
 			}
 		}
 		ri->ri_list = &opc->ssres;
+		ri->ri_enc = NULL;
 		ri->ri_e = opc->se;
 		ri->ri_csn.bv_len = csn.bv_len;
 		ri->ri_isref = opc->sreference;
@@ -1552,7 +1711,8 @@ syncprov_op_cleanup( Operation *op, SlapReply *rs )
 }
 
 static void
-syncprov_checkpoint( Operation *op, slap_overinst *on )
+syncprov_checkpoint( Operation *op, slap_overinst *on,
+	BerVarray ctxcsn, int numcsns )
 {
 	syncprov_info_t *si = (syncprov_info_t *)on->on_bi.bi_private;
 	Modifications mod;
@@ -1566,16 +1726,16 @@ syncprov_checkpoint( Operation *op, slap_overinst *on )
 	Syntax *syn = slap_schema.si_ad_contextCSN->ad_type->sat_syntax;
 
 	int i;
-	for ( i=0; i<si->si_numcsns; i++ ) {
-		assert( !syn->ssyn_validate( syn, si->si_ctxcsn+i ));
+	for ( i=0; i<numcsns; i++ ) {
+		assert( !syn->ssyn_validate( syn, ctxcsn+i ));
 	}
 #endif
 
 	Debug( LDAP_DEBUG_SYNC, "%s syncprov_checkpoint: running checkpoint\n",
 		op->o_log_prefix );
 
-	mod.sml_numvals = si->si_numcsns;
-	mod.sml_values = si->si_ctxcsn;
+	mod.sml_numvals = numcsns;
+	mod.sml_values = ctxcsn;
 	mod.sml_nvalues = NULL;
 	mod.sml_desc = slap_schema.si_ad_contextCSN;
 	mod.sml_op = LDAP_MOD_REPLACE;
@@ -1621,12 +1781,106 @@ syncprov_checkpoint( Operation *op, slap_overinst *on )
 		slap_mods_free( mod.sml_next, 1 );
 	}
 #ifdef CHECK_CSN
-	for ( i=0; i<si->si_numcsns; i++ ) {
-		assert( !syn->ssyn_validate( syn, si->si_ctxcsn+i ));
+	for ( i=0; i<numcsns; i++ ) {
+		assert( !syn->ssyn_validate( syn, ctxcsn+i ));
 	}
 #endif
 }
 
+/* Write the contextCSN from a pool thread, so that the write that
+ * triggered the checkpoint doesn't wait for it, and doesn't hold
+ * si_csn_rwlock against the writes that follow it. Only one checkpoint
+ * runs at a time; requests arriving meanwhile are folded into one rerun.
+ */
+static void *
+syncprov_checkpoint_task( void *ctx, void *arg )
+{
+	slap_overinst *on = arg;
+	syncprov_info_t *si = (syncprov_info_t *)on->on_bi.bi_private;
+	Connection conn = {0};
+	OperationBuffer opbuf;
+	Operation *op;
+	BackendDB be;
+	BerVarray ctxcsn = NULL;
+	int numcsns;
+
+	ldap_pvt_thread_mutex_lock( &si->si_chk_mutex );
+	si->si_chkstate = CHK_RUNNING;
+	ldap_pvt_thread_mutex_unlock( &si->si_chk_mutex );
+
+	ldap_pvt_thread_rdwr_rlock( &si->si_csn_rwlock );
+	ber_bvarray_dup_x( &ctxcsn, si->si_ctxcsn, NULL );
+	numcsns = si->si_numcsns;
+	ldap_pvt_thread_rdwr_runlock( &si->si_csn_rwlock );
+
+	if ( numcsns ) {
+		connection_fake_init2( &conn, &opbuf, ctx, 0 );
+		op = &opbuf.ob_op;
+		be = *on->on_info->oi_origdb;
+		op->o_bd = &be;
+		op->o_dn = be.be_rootdn;
+		op->o_ndn = be.be_rootndn;
+		syncprov_checkpoint( op, on, ctxcsn, numcsns );
+	}
+	ber_bvarray_free( ctxcsn );
+
+	ldap_pvt_thread_mutex_lock( &si->si_chk_mutex );
+	if ( ( si->si_chkstate & CHK_AGAIN ) &&
+		!ldap_pvt_thread_pool_submit2( &connection_pool,
+			syncprov_checkpoint_task, on, &si->si_chkcookie )) {
+		si->si_chkstate = CHK_QUEUED;
+	} else {
+		si->si_chkstate = 0;
+		ldap_pvt_thread_cond_broadcast( &si->si_chk_cond );
+	}
+	ldap_pvt_thread_mutex_unlock( &si->si_chk_mutex );
+
+	return NULL;
+}
+
+/* Schedule a background checkpoint */
+static void
+syncprov_checkpoint_queue( slap_overinst *on )
+{
+	syncprov_info_t *si = (syncprov_info_t *)on->on_bi.bi_private;
+	int rc = 0;
+
+	ldap_pvt_thread_mutex_lock( &si->si_chk_mutex );
+	if ( si->si_chkstate & CHK_RUNNING ) {
+		si->si_chkstate |= CHK_AGAIN;
+	} else if ( !si->si_chkstate ) {
+		rc = ldap_pvt_thread_pool_submit2( &connection_pool,
+			syncprov_checkpoint_task, on, &si->si_chkcookie );
+		if ( !rc )
+			si->si_chkstate = CHK_QUEUED;
+	}
+	ldap_pvt_thread_mutex_unlock( &si->si_chk_mutex );
+
+	if ( rc ) {
+		/* pool is shutting down, leave it to db_close */
+		ldap_pvt_thread_rdwr_wlock( &si->si_csn_rwlock );
+		si->si_numops++;
+		ldap_pvt_thread_rdwr_wunlock( &si->si_csn_rwlock );
+	}
+}
+
+/* Wait for any background checkpoint to finish */
+static void
+syncprov_checkpoint_drain( syncprov_info_t *si )
+{
+	ldap_pvt_thread_mutex_lock( &si->si_chk_mutex );
+	if ( ( si->si_chkstate & CHK_QUEUED ) &&
+		ldap_pvt_thread_pool_retract( si->si_chkcookie ) == 1 ) {
+		si->si_chkstate = 0;
+		/* the pending checkpoint is taken over by db_close */
+		si->si_numops++;
+	}
+	si->si_chkstate &= ~CHK_AGAIN;
+	while ( si->si_chkstate )
+		ldap_pvt_thread_cond_wait( &si->si_chk_cond, &si->si_chk_mutex );
+	ldap_pvt_thread_mutex_unlock( &si->si_chk_mutex );
+}
+
 static void
 syncprov_add_slog( Operation *op )
 {
@@ -2472,9 +2726,7 @@ syncprov_op_response( Operation *op, SlapReply *rs )
 
 added:
 		if ( do_check ) {
-			ldap_pvt_thread_rdwr_rlock( &si->si_csn_rwlock );
-			syncprov_checkpoint( op, on );
-			ldap_pvt_thread_rdwr_runlock( &si->si_csn_rwlock );
+			syncprov_checkpoint_queue( on );
 		}
 
 		/* only update consumer ctx if this is a newer csn */
@@ -3038,6 +3290,8 @@ syncprov_op_search( Operation *op, SlapReply *rs )
 		so.s_eid = NOID;
 		so.s_op = op;
 		so.s_flags = PS_IS_REFRESHING | PS_FIND_BASE;
+		/* the detached copy loses the controls */
+		so.s_encprivate = ( op->o_vrFilter != NULL );
 		/* syncprov_findbase expects to be called as a callback... */
 		sc.sc_private = &opc;
 		opc.son = on;
@@ -3491,7 +3745,8 @@ enum {
 	SP_SESSL,
 	SP_NOPRES,
 	SP_USEHINT,
-	SP_LOGDB
+	SP_LOGDB,
+	SP_SHAREENC
 };
 
 static ConfigDriver sp_cf_gen;
@@ -3521,6 +3776,11 @@ static ConfigTable spcfg[] = {
 		sp_cf_gen, "( OLcfgOvAt:1.5 NAME 'olcSpSessionlogSource' "
 			"DESC 'On startup, try loading sessionlog from this subtree' "
 			"SYNTAX OMsDN SINGLE-VALUE )", NULL, NULL },
+	{ "syncprov-sharedencoding", NULL, 2, 2, 0, ARG_ON_OFF|ARG_MAGIC|SP_SHAREENC,
+		sp_cf_gen, "( OLcfgOvAt:1.6 NAME 'olcSpSharedEncoding' "
+			"DESC 'Encode each change once for all identical persistent searches' "
+			"EQUALITY booleanMatch "
+			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -3534,6 +3794,7 @@ static ConfigOCs spocs[] = {
 			"$ olcSpNoPresent "
 			"$ olcSpReloadHint "
 			"$ olcSpSessionlogSource "
+			"$ olcSpSharedEncoding "
 		") )",
 			Cft_Overlay, spcfg },
 	{ NULL, 0, NULL }
@@ -3587,6 +3848,13 @@ sp_cf_gen(ConfigArgs *c)
 				rc = 1;
 			}
 			break;
+		case SP_SHAREENC:
+			if ( si->si_shareenc ) {
+				c->value_int = 1;
+			} else {
+				rc = 1;
+			}
+			break;
 		case SP_LOGDB:
 			if ( BER_BVISEMPTY( &si->si_logbase ) ) {
 				rc = 1;
@@ -3612,6 +3880,9 @@ sp_cf_gen(ConfigArgs *c)
 		case SP_USEHINT:
 			si->si_usehint = 0;
 			break;
+		case SP_SHAREENC:
+			si->si_shareenc = 0;
+			break;
 		case SP_LOGDB:
 			if ( !BER_BVISNULL( &si->si_logbase ) ) {
 				ch_free( si->si_logbase.bv_val );
@@ -3685,6 +3956,9 @@ sp_cf_gen(ConfigArgs *c)
 	case SP_USEHINT:
 		si->si_usehint = c->value_int;
 		break;
+	case SP_SHAREENC:
+		si->si_shareenc = c->value_int;
+		break;
 	case SP_LOGDB:
 		if ( si->si_logs ) {
 			Debug( LDAP_DEBUG_ANY, "syncprov_config: while configuring "
@@ -3930,6 +4204,7 @@ syncprov_db_close(
 	if ( slapMode & SLAP_TOOL_MODE ) {
 		return 0;
 	}
+	syncprov_checkpoint_drain( si );
 	if ( si->si_numops ) {
 		Connection conn = {0};
 		OperationBuffer opbuf;
@@ -3942,7 +4217,7 @@ syncprov_db_close(
 		op->o_bd = be;
 		op->o_dn = be->be_rootdn;
 		op->o_ndn = be->be_rootndn;
-		syncprov_checkpoint( op, on );
+		syncprov_checkpoint( op, on, si->si_ctxcsn, si->si_numcsns );
 	}
 
 #ifdef SLAP_CONFIG_DELETE
@@ -3988,6 +4263,8 @@ syncprov_db_init(
 	ldap_pvt_thread_mutex_init( &si->si_ops_mutex );
 	ldap_pvt_thread_mutex_init( &si->si_mods_mutex );
 	ldap_pvt_thread_mutex_init( &si->si_resp_mutex );
+	ldap_pvt_thread_mutex_init( &si->si_chk_mutex );
+	ldap_pvt_thread_cond_init( &si->si_chk_cond );
 
 	csn_anlist[0].an_desc = slap_schema.si_ad_entryCSN;
 	csn_anlist[0].an_name = slap_schema.si_ad_entryCSN->ad_cname;
@@ -4027,6 +4304,8 @@ syncprov_db_destroy(
 		if ( si->si_sids )
 			ch_free( si->si_sids );
 		ldap_pvt_thread_mutex_destroy( &si->si_resp_mutex );
+		ldap_pvt_thread_cond_destroy( &si->si_chk_cond );
+		ldap_pvt_thread_mutex_destroy( &si->si_chk_mutex );
 		ldap_pvt_thread_mutex_destroy( &si->si_mods_mutex );
 		ldap_pvt_thread_mutex_destroy( &si->si_ops_mutex );
 		ldap_pvt_thread_rdwr_destroy( &si->si_csn_rwlock );
@@ -4153,6 +4432,96 @@ static int syncprov_parseCtrl (
 
 static slap_overinst 		syncprov;
 
+static struct berval slap_EXOP_SNAPSHOT = BER_BVC( LDAP_EXOP_X_SNAPSHOT );
+
+/* Stream a copy of a provider's database to a new replica. The
+ * request value is the DN of the naming context; the backend sends
+ * the snapshot as a sequence of intermediate responses. The context's
+ * contextCSN is checkpointed first so that the copy never claims to be
+ * newer than its contents, and the replica can resume syncrepl from it.
+ */
+static int
+syncprov_exop_snapshot(
+	Operation	*op,
+	SlapReply	*rs )
+{
+	BackendDB	*bd = op->o_bd;
+	slap_overinst	*on = NULL;
+	syncprov_info_t	*si;
+
+	if ( op->ore_reqdata == NULL ) {
+		rs->sr_text = "naming context DN required";
+		return rs->sr_err = LDAP_PROTOCOL_ERROR;
+	}
+
+	rs->sr_err = dnNormalize( 0, NULL, NULL, op->ore_reqdata,
+		&op->o_req_ndn, op->o_tmpmemctx );
+	if ( rs->sr_err != LDAP_SUCCESS ) {
+		rs->sr_text = "invalid DN";
+		return rs->sr_err = LDAP_INVALID_DN_SYNTAX;
+	}
+
+	Debug( LDAP_DEBUG_STATS, "%s SNAPSHOT dn=\"%s\"\n",
+		op->o_log_prefix, op->o_req_ndn.bv_val );
+	op->o_req_dn = op->o_req_ndn;
+
+	op->o_bd = select_backend( &op->o_req_ndn, 0 );
+	if ( op->o_bd == NULL || !be_issuffix( op->o_bd, &op->o_req_ndn ) ) {
+		rs->sr_err = LDAP_NO_SUCH_OBJECT;
+		rs->sr_text = "not a naming context";
+		goto done;
+	}
+
+	if ( overlay_is_over( op->o_bd ) ) {
+		slap_overinfo *oi = op->o_bd->bd_info->bi_private;
+
+		for ( on = oi->oi_list; on; on = on->on_next ) {
+			if ( on->on_bi.bi_type == syncprov.on_bi.bi_type )
+				break;
+		}
+	}
+	if ( on == NULL ) {
+		rs->sr_err = LDAP_UNWILLING_TO_PERFORM;
+		rs->sr_text = "syncprov not configured on this context";
+		goto done;
+	}
+
+	/* the copy bypasses access control, so only the rootdn may ask */
+	if ( !be_isroot( op ) ) {
+		rs->sr_err = LDAP_INSUFFICIENT_ACCESS;
+		rs->sr_text = "snapshot requires rootdn";
+		goto done;
+	}
+
+	rs->sr_err = backend_check_restrictions( op, rs, &slap_EXOP_SNAPSHOT );
+	if ( rs->sr_err != LDAP_SUCCESS ) {
+		goto done;
+	}
+
+	if ( op->o_bd->be_extended == NULL ) {
+		rs->sr_err = LDAP_UNWILLING_TO_PERFORM;
+		rs->sr_text = "backend does not support snapshots";
+		goto done;
+	}
+
+	si = on->on_bi.bi_private;
+	ldap_pvt_thread_rdwr_rlock( &si->si_csn_rwlock );
+	if ( si->si_numops ) {
+		syncprov_checkpoint( op, on, si->si_ctxcsn, si->si_numcsns );
+	}
+	ldap_pvt_thread_rdwr_runlock( &si->si_csn_rwlock );
+
+	rs->sr_err = op->o_bd->be_extended( op, rs );
+
+done:;
+	op->o_tmpfree( op->o_req_ndn.bv_val, op->o_tmpmemctx );
+	BER_BVZERO( &op->o_req_ndn );
+	BER_BVZERO( &op->o_req_dn );
+	op->o_bd = bd;
+
+	return rs->sr_err;
+}
+
 int
 syncprov_initialize()
 {
@@ -4167,6 +4536,14 @@ syncprov_initialize()
 		return rc;
 	}
 
+	rc = load_extop( &slap_EXOP_SNAPSHOT, 0,
+		syncprov_exop_snapshot );
+	if ( rc != LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_ANY,
+			"syncprov_init: Failed to register snapshot exop %d\n", rc );
+		return rc;
+	}
+
 	syncprov.on_bi.bi_type = "syncprov";
 	syncprov.on_bi.bi_flags = SLAPO_BFLAG_SINGLE;
 	syncprov.on_bi.bi_db_init = syncprov_db_init;
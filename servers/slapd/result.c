@@ -1052,6 +1052,26 @@ slap_send_search_entry( Operation *op, SlapReply *rs )
 		goto error_return;
 	}
 
+	/* The caller already has the protocolOp encoded for an identical
+	 * request; only the messageID and the controls are per-operation.
+	 */
+	if ( rs->sr_encoded && !BER_BVISNULL( rs->sr_encoded ) &&
+		op->o_res_ber == NULL
+#ifdef LDAP_CONNECTIONLESS
+		&& !( op->o_conn && op->o_conn->c_is_udp )
+#endif
+		)
+	{
+		ber_init_w_nullc( ber, LBER_USE_DER );
+		ber_set_option( ber, LBER_OPT_BER_MEMCTX, &op->o_tmpmemctx );
+		rc = ber_printf( ber, "{i" /*}*/, op->o_msgid );
+		if ( rc != -1 ) {
+			rc = ber_write( ber, rs->sr_encoded->bv_val,
+				rs->sr_encoded->bv_len, 0 );
+		}
+		goto encoded;
+	}
+
 	/* eventually will loop through generated operational attribute types
 	 * currently implemented types include:
 	 *	entryDN, subschemaSubentry, and hasSubordinates */
@@ -1455,6 +1475,7 @@ slap_send_search_entry( Operation *op, SlapReply *rs )
 
 	rc = ber_printf( ber, /*{{*/ "}N}" );
 
+encoded:;
 	if( rc != -1 ) {
 		rc = send_ldap_controls( op, ber, rs->sr_ctrls );
 	}
@@ -1481,6 +1502,26 @@ slap_send_search_entry( Operation *op, SlapReply *rs )
 		goto error_return;
 	}
 
+	/* Hand a copy of the protocolOp back for reuse */
+	if ( rs->sr_encoded && BER_BVISNULL( rs->sr_encoded ) &&
+		op->o_res_ber == NULL )
+	{
+		BerElementBuffer rberbuf;
+		BerElement *rber = (BerElement *) &rberbuf;
+		struct berval bv;
+		ber_len_t len;
+
+		if ( ber_flatten2( ber, &bv, 0 ) == 0 ) {
+			ber_init2( rber, &bv, 0 );
+			if ( ber_skip_tag( rber, &len ) != LBER_DEFAULT &&
+				ber_skip_element( rber, &bv ) != LBER_DEFAULT &&
+				ber_skip_raw( rber, &bv ) != LBER_DEFAULT )
+			{
+				ber_dupbv( rs->sr_encoded, &bv );
+			}
+		}
+	}
+
 	Debug( LDAP_DEBUG_STATS2, "%s ENTRY dn=\"%s\"\n",
 	    op->o_log_prefix, rs->sr_entry->e_nname.bv_val );
 
@@ -1767,6 +1767,12 @@ struct syncinfo_s;
 
 #define SLAP_SYNCUUID_SET_SIZE 256
 
+/* accesslog "logmodbinary" stores the changes of a write as a single
+ * reqMod value: a BER sequence of LDAP modify changes with this tag.
+ * Textual reqMod values always begin with an attribute name or ':'
+ * so the leading octet is unambiguous. */
+#define SLAP_ACCESSLOG_MODBIN_TAG	((ber_tag_t) 0xa0U)
+
 struct sync_cookie {
 	BerVarray ctxcsn;
 	int *sids;
@@ -2126,6 +2132,7 @@ typedef struct rep_search_s {
 	AttributeName *r_attrs;
 	int r_nentries;
 	BerVarray r_v2ref;
+	struct berval *r_encoded;	/* shared protocolOp encoding, if any */
 } rep_search_s;
 
 struct SlapReply {
@@ -2170,6 +2177,7 @@ struct SlapReply {
 #define sr_attr_flags sr_un.sru_search.r_attr_flags
 #define	sr_v2ref sr_un.sru_search.r_v2ref
 #define	sr_nentries sr_un.sru_search.r_nentries
+#define	sr_encoded sr_un.sru_search.r_encoded
 #define	sr_rspoid sr_un.sru_extended.r_rspoid
 #define	sr_rspdata sr_un.sru_extended.r_rspdata
 #define	sr_sasldata sr_un.sru_sasl.r_sasldata
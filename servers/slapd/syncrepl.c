@@ -2221,6 +2221,121 @@ static slap_verbmasks modops[] = {
 	{ BER_BVNULL, 0 }
 };
 
+/* Decode a compact reqMod value written by accesslog "logmodbinary" */
+static int
+syncrepl_accesslog_binmods(
+	syncinfo_t *si,
+	struct berval *val,
+	struct Modifications **modres
+)
+{
+	BerElementBuffer berbuf;
+	BerElement *ber = (BerElement *)&berbuf;
+	ber_tag_t tag;
+	ber_len_t len;
+	char *last;
+	const char *text;
+	AttributeDescription *ad;
+	struct berval type, bv2, *vals;
+	ber_int_t op;
+	Modifications *mod, *modlist = NULL, **modtail;
+	int i, rc = 0;
+
+	modtail = &modlist;
+
+	ber_init2( ber, val, LBER_USE_DER );
+	if ( ber_peek_tag( ber, &len ) != SLAP_ACCESSLOG_MODBIN_TAG ) {
+		rc = -1;
+		goto done;
+	}
+
+	for ( tag = ber_first_element( ber, &len, &last );
+		tag != LBER_DEFAULT;
+		tag = ber_next_element( ber, &len, last ) )
+	{
+		/* the value may live in a read-only map, so don't let
+		 * the type be terminated in place */
+		vals = NULL;
+		if ( ber_scanf( ber, "{e{" /*}}*/, &op ) == LBER_ERROR ||
+			ber_get_stringbv( ber, &type, LBER_BV_NOTERM ) == LBER_DEFAULT ||
+			ber_scanf( ber, /*{{*/ "[W]}}", &vals ) == LBER_ERROR )
+		{
+			Debug( LDAP_DEBUG_ANY, "syncrepl_accesslog_binmods: %s "
+				"decoding error\n", si->si_ridtxt );
+			rc = -1;
+			break;
+		}
+
+		ad = NULL;
+		if ( slap_bv2ad( &type, &ad, &text ) ) {
+			/* Invalid */
+			Debug( LDAP_DEBUG_ANY, "syncrepl_accesslog_binmods: %s "
+				"Invalid attribute %.*s, %s\n",
+				si->si_ridtxt, (int)type.bv_len, type.bv_val, text );
+			ber_bvarray_free( vals );
+			rc = -1;
+			break;
+		}
+
+		if ( op != LDAP_MOD_ADD && op != LDAP_MOD_DELETE &&
+			op != LDAP_MOD_REPLACE && op != LDAP_MOD_INCREMENT )
+		{
+			Debug( LDAP_DEBUG_ANY, "syncrepl_accesslog_binmods: %s "
+				"unknown operation %d on %s ignored\n",
+				si->si_ridtxt, op, ad->ad_cname.bv_val );
+			ber_bvarray_free( vals );
+			continue;
+		}
+
+		/* Ignore dynamically generated and excluded attrs */
+		if (( ad->ad_type->sat_flags & SLAP_AT_DYNAMIC ) ||
+			ldap_charray_inlist( si->si_exattrs,
+				ad->ad_type->sat_cname.bv_val ))
+		{
+			ber_bvarray_free( vals );
+			continue;
+		}
+
+		mod = (Modifications *) ch_malloc( sizeof( Modifications ) );
+		mod->sml_flags = 0;
+		mod->sml_op = op;
+		mod->sml_next = NULL;
+		mod->sml_desc = ad;
+		mod->sml_type = ad->ad_cname;
+		mod->sml_values = vals;
+		mod->sml_nvalues = NULL;
+		mod->sml_numvals = 0;
+
+		/* Keep 'op' to reflect what we read out from accesslog */
+		if ( op == LDAP_MOD_ADD && is_at_single_value( ad->ad_type ))
+			mod->sml_op = LDAP_MOD_REPLACE;
+
+		if ( vals ) {
+			for ( i = 0; !BER_BVISNULL( &vals[i] ); i++ ) {
+				if ( si->si_rewrite && ad->ad_type->sat_syntax ==
+					slap_schema.si_syn_distinguishedName )
+				{
+					REWRITE_VAL( si, ad, vals[i], bv2 );
+					ch_free( vals[i].bv_val );
+					vals[i] = bv2;
+				}
+			}
+			mod->sml_numvals = i;
+		}
+
+		*modtail = mod;
+		modtail = &mod->sml_next;
+	}
+
+done:
+	if ( rc ) {
+		slap_mods_free( modlist, 1 );
+		modlist = NULL;
+	}
+	*modres = modlist;
+	return rc;
+}
+
 static int
 syncrepl_accesslog_mods(
 	syncinfo_t *si,
@@ -2236,6 +2351,12 @@ syncrepl_accesslog_mods(
 	Modifications *mod = NULL, *modlist = NULL, **modtail;
 	int i, rc = 0;
 
+	if ( !BER_BVISEMPTY( &vals[0] ) && BER_BVISNULL( &vals[1] ) &&
+		(unsigned char)vals[0].bv_val[0] == SLAP_ACCESSLOG_MODBIN_TAG )
+	{
+		return syncrepl_accesslog_binmods( si, &vals[0], modres );
+	}
+
 	modtail = &modlist;
 
 	for (i=0; !BER_BVISNULL( &vals[i] ); i++) {
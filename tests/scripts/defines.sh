@@ -39,6 +39,7 @@ PPOLICY=${AC_ppolicy-ppolicyno}
 REFINT=${AC_refint-refintno}
 RETCODE=${AC_retcode-retcodeno}
 RWM=${AC_rwm-rwmno}
+SSSVLV=${AC_sssvlv-sssvlvno}
 SYNCPROV=${AC_syncprov-syncprovno}
 TRANSLUCENT=${AC_translucent-translucentno}
 UNIQUE=${AC_unique-uniqueno}
@@ -97,6 +98,7 @@ DSRPROVIDERCONF=$DATADIR/slapd-deltasync-provider.conf
 DSRCONSUMERCONF=$DATADIR/slapd-deltasync-consumer.conf
 PPOLICYCONF=$DATADIR/slapd-ppolicy.conf
 PROXYCACHECONF=$DATADIR/slapd-proxycache.conf
+LDAPASYNCCONF=$DATADIR/slapd-ldap-async.conf
 PROXYAUTHZCONF=$DATADIR/slapd-proxyauthz.conf
 CACHEPROVIDERCONF=$DATADIR/slapd-cache-provider.conf
 PROXYAUTHZPROVIDERCONF=$DATADIR/slapd-cache-provider-proxyauthz.conf
@@ -136,6 +138,7 @@ METACONF=$DATADIR/slapd-meta.conf
 METACONF1=$DATADIR/slapd-meta-target1.conf
 METACONF2=$DATADIR/slapd-meta-target2.conf
 ASYNCMETACONF=$DATADIR/slapd-asyncmeta.conf
+ASYNCMETAREPLCONF=$DATADIR/slapd-asyncmeta-replicas.conf
 GLUELDAPCONF=$DATADIR/slapd-glue-ldap.conf
 ACICONF=$DATADIR/slapd-aci.conf
 VALSORTCONF=$DATADIR/slapd-valsort.conf